@@ -0,0 +1,148 @@
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "pbrt_proto/shared/compression.h"
+
+namespace {
+
+using ::pbrt_proto::GetMeshDecoder;
+using ::pbrt_proto::MeshDecoder;
+using ::pbrt_proto::MeshDecoderKernel;
+
+// The number of vertices in the mesh decoded, which is small enough for its
+// arrays to stay in cache so that the kernels rather than memory are measured
+constexpr size_t kNumVertices = 1 << 14;
+
+// The arrays of a mesh of `kNumVertices` vertices as `--compress_meshes` writes
+// them at its default precision
+struct EncodedMesh {
+  std::vector<uint32_t> positions;
+  std::vector<double> mins = {-1.0, -2.0, -3.0};
+  std::vector<double> steps;
+  std::vector<uint32_t> normals;
+  double zero = std::ldexp(1.0, 11) - 1.0;
+  std::vector<int32_t> index_deltas;
+};
+
+EncodedMesh MakeMesh() {
+  std::mt19937 random(0);
+  std::uniform_int_distribution<uint32_t> position(0, (1u << 16) - 1);
+  std::uniform_int_distribution<uint32_t> normal(0, (1u << 12) - 1);
+  std::uniform_int_distribution<int32_t> index_delta(-64, 64);
+
+  EncodedMesh mesh;
+  mesh.steps = {2.0 / 65535.0, 4.0 / 65535.0, 6.0 / 65535.0};
+  for (size_t i = 0; i < 3 * kNumVertices; i++) {
+    mesh.positions.push_back(position(random));
+  }
+  for (size_t i = 0; i < 2 * kNumVertices; i++) {
+    mesh.normals.push_back(normal(random));
+  }
+  for (size_t i = 0; i < 6 * kNumVertices; i++) {
+    mesh.index_deltas.push_back(index_delta(random));
+  }
+  return mesh;
+}
+
+template <typename T>
+void BM_Dequantize(benchmark::State& state, const MeshDecoder* decoder,
+                   const EncodedMesh* mesh) {
+  std::vector<T> output(mesh->positions.size());
+  for (auto _ : state) {
+    if constexpr (std::is_same_v<T, float>) {
+      decoder->dequantize_float(mesh->positions.data(),
+                                mesh->positions.size(), mesh->mins.data(),
+                                mesh->steps.data(), 3, output.data());
+    } else {
+      decoder->dequantize_double(mesh->positions.data(),
+                                 mesh->positions.size(), mesh->mins.data(),
+                                 mesh->steps.data(), 3, output.data());
+    }
+    benchmark::DoNotOptimize(output.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->positions.size());
+}
+
+template <typename T>
+void BM_DecodeOctahedral(benchmark::State& state, const MeshDecoder* decoder,
+                         const EncodedMesh* mesh) {
+  size_t num_directions = mesh->normals.size() / 2;
+  std::vector<T> output(3 * num_directions);
+  T zero = static_cast<T>(mesh->zero);
+  for (auto _ : state) {
+    if constexpr (std::is_same_v<T, float>) {
+      decoder->decode_octahedral_float(mesh->normals.data(), num_directions,
+                                       zero, 1.0f / zero, output.data());
+    } else {
+      decoder->decode_octahedral_double(mesh->normals.data(), num_directions,
+                                        zero, 1.0 / zero, output.data());
+    }
+    benchmark::DoNotOptimize(output.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * num_directions);
+}
+
+void BM_DeltaDecode(benchmark::State& state, const MeshDecoder* decoder,
+                    const EncodedMesh* mesh) {
+  std::vector<uint32_t> output(mesh->index_deltas.size());
+  for (auto _ : state) {
+    decoder->delta_decode(mesh->index_deltas.data(),
+                          mesh->index_deltas.size(), output.data());
+    benchmark::DoNotOptimize(output.data());
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->index_deltas.size());
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  static const EncodedMesh mesh = MakeMesh();
+
+  struct {
+    const char* name;
+    MeshDecoderKernel kernel;
+  } kernels[] = {
+      {"Scalar", MeshDecoderKernel::SCALAR},
+      {"AVX2", MeshDecoderKernel::AVX2},
+  };
+
+  for (const auto& [name, kernel] : kernels) {
+    const MeshDecoder* decoder = GetMeshDecoder(kernel);
+    if (decoder == nullptr) {
+      continue;
+    }
+
+    benchmark::RegisterBenchmark(
+        (std::string("BM_Dequantize/double/") + name).c_str(),
+        BM_Dequantize<double>, decoder, &mesh);
+    benchmark::RegisterBenchmark(
+        (std::string("BM_Dequantize/float/") + name).c_str(),
+        BM_Dequantize<float>, decoder, &mesh);
+    benchmark::RegisterBenchmark(
+        (std::string("BM_DecodeOctahedral/double/") + name).c_str(),
+        BM_DecodeOctahedral<double>, decoder, &mesh);
+    benchmark::RegisterBenchmark(
+        (std::string("BM_DecodeOctahedral/float/") + name).c_str(),
+        BM_DecodeOctahedral<float>, decoder, &mesh);
+    benchmark::RegisterBenchmark(
+        (std::string("BM_DeltaDecode/") + name).c_str(), BM_DeltaDecode,
+        decoder, &mesh);
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,133 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "pbrt_proto/shared/parser.h"
+#include "pbrt_proto/v1/convert.h"
+#include "pbrt_proto/v1/v1.pb.h"
+#include "pbrt_proto/v2/convert.h"
+#include "pbrt_proto/v2/v2.pb.h"
+#include "pbrt_proto/v3/convert.h"
+#include "pbrt_proto/v3/v3.pb.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+namespace {
+
+using ::bazel::tools::cpp::runfiles::Runfiles;
+using ::pbrt_proto::ParseStats;
+
+// The overload of `Convert` of each PBRT version that passes each directive to
+// a sink as it is converted
+template <typename Directive>
+using ConvertFunction = absl::Status (*)(
+    absl::string_view, absl::FunctionRef<absl::Status(Directive&)>,
+    ParseStats*);
+
+std::string LoadScene(const Runfiles& runfiles, const std::string& path) {
+  std::ifstream input(runfiles.Rlocation("_main/tools/test_data/" + path),
+                      std::ios::in | std::ios::binary);
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return std::move(contents).str();
+}
+
+// Converts a scene, discarding each directive once it has been built so that
+// the cost of accumulating a `PbrtProto` is not included.
+template <typename Directive>
+void BM_Convert(benchmark::State& state, ConvertFunction<Directive> convert,
+                const std::string* scene) {
+  size_t num_directives = 0;
+  for (auto _ : state) {
+    num_directives = 0;
+    absl::Status status = convert(
+        *scene,
+        [&](Directive& directive) {
+          benchmark::DoNotOptimize(directive);
+          num_directives += 1;
+          return absl::OkStatus();
+        },
+        nullptr);
+    if (!status.ok()) {
+      state.SkipWithError(std::string(status.message()).c_str());
+      break;
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * scene->size());
+  state.counters["directives"] = benchmark::Counter(
+      state.iterations() * num_directives, benchmark::Counter::kIsRate);
+}
+
+template <typename Directive>
+bool RegisterScene(const Runfiles& runfiles, const char* name,
+                   const std::string& path,
+                   ConvertFunction<Directive> convert) {
+  static std::vector<std::unique_ptr<std::string>> scenes;
+
+  std::string scene = LoadScene(runfiles, path);
+  if (scene.empty()) {
+    std::cerr << "ERROR: Could not load " << path << std::endl;
+    return false;
+  }
+
+  scenes.push_back(std::make_unique<std::string>(std::move(scene)));
+  benchmark::RegisterBenchmark((std::string("BM_Convert/") + name).c_str(),
+                               BM_Convert<Directive>, convert,
+                               scenes.back().get());
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  std::string error;
+  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv[0], &error));
+  if (!runfiles) {
+    std::cerr << "ERROR: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  ConvertFunction<pbrt_proto::v1::Directive> v1 = &pbrt_proto::v1::Convert;
+  ConvertFunction<pbrt_proto::v2::Directive> v2 = &pbrt_proto::v2::Convert;
+  ConvertFunction<pbrt_proto::v3::Directive> v3 = &pbrt_proto::v3::Convert;
+
+  if (!RegisterScene(*runfiles, "V1/Bunny",
+                     "pbrt-v1-scenes/geometry/bunny.pbrt", v1) ||
+      !RegisterScene(*runfiles, "V1/Density",
+                     "pbrt-v1-scenes/geometry/density_render.60.1.pbrt", v1) ||
+      !RegisterScene(*runfiles, "V1/Killeroo",
+                     "pbrt-v1-scenes/killeroo-simple.pbrt", v1) ||
+      !RegisterScene(*runfiles, "V2/Bunny",
+                     "pbrt-v2-scenes/geometry/bunny.pbrt", v2) ||
+      !RegisterScene(*runfiles, "V2/Density",
+                     "pbrt-v2-scenes/geometry/density_render.60.pbrt", v2) ||
+      !RegisterScene(*runfiles, "V2/Killeroo",
+                     "pbrt-v2-scenes/killeroo-simple.pbrt", v2) ||
+      !RegisterScene(*runfiles, "V3/Leaves",
+                     "pbrt-v3-scenes/sanmiguel/geometry/hojas_b3-geom.pbrt",
+                     v3) ||
+      !RegisterScene(*runfiles, "V3/Hair",
+                     "pbrt-v3-scenes/hair/models/block.pbrt", v3) ||
+      !RegisterScene(
+          *runfiles, "V3/Smoke",
+          "pbrt-v3-scenes/cloud/geometry/density_render.70.smoke.pbrt", v3) ||
+      !RegisterScene(*runfiles, "V3/Sportscar",
+                     "pbrt-v3-scenes/sportscar/sportscar.pbrt", v3)) {
+    return EXIT_FAILURE;
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,111 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "pbrt_proto/shared/directives.h"
+#include "pbrt_proto/v3/convert.h"
+#include "pbrt_proto/v3/v3.pb.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+namespace {
+
+using ::bazel::tools::cpp::runfiles::Runfiles;
+using ::pbrt_proto::LookupDirective;
+using ::pbrt_proto::v3::Convert;
+using ::pbrt_proto::v3::PbrtProto;
+
+// A directive-dense scene with one short directive per line
+std::string MakeTransforms(size_t num_directives) {
+  static const absl::string_view kDirectives[] = {
+      "AttributeBegin\n", "Translate 1 2 3\n", "Scale 2 2 2\n",
+      "Rotate 90 0 0 1\n", "ReverseOrientation\n", "AttributeEnd\n",
+  };
+
+  std::string scene;
+  for (size_t i = 0; i < num_directives; i++) {
+    absl::string_view directive = kDirectives[i % std::size(kDirectives)];
+    scene.append(directive.data(), directive.size());
+  }
+  return scene;
+}
+
+void BM_LookupDirective(benchmark::State& state) {
+  static const absl::string_view kKeywords[] = {
+      "Shape",       "AttributeBegin", "Translate",      "AttributeEnd",
+      "Material",    "NamedMaterial",  "ConcatTransform", "LightSource",
+      "ObjectBegin", "ObjectEnd",      "ObjectInstance", "WorldEnd",
+  };
+
+  for (auto _ : state) {
+    for (absl::string_view keyword : kKeywords) {
+      benchmark::DoNotOptimize(LookupDirective(keyword));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * std::size(kKeywords));
+}
+
+void BM_Convert(benchmark::State& state, const std::string* scene) {
+  size_t num_directives = 0;
+  for (auto _ : state) {
+    PbrtProto output;
+    absl::Status status = Convert(*scene, output);
+    if (!status.ok()) {
+      state.SkipWithError(std::string(status.message()).c_str());
+      break;
+    }
+    num_directives = output.directives_size();
+    benchmark::DoNotOptimize(output);
+  }
+  state.SetBytesProcessed(state.iterations() * scene->size());
+  state.counters["directives"] = benchmark::Counter(
+      state.iterations() * num_directives, benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  std::string error;
+  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv[0], &error));
+  if (!runfiles) {
+    std::cerr << "ERROR: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream input(
+      runfiles->Rlocation(
+          "_main/tools/test_data/pbrt-v3-scenes/hair/models/block.pbrt"),
+      std::ios::in | std::ios::binary);
+  std::stringstream contents;
+  contents << input.rdbuf();
+
+  static const std::string block = std::move(contents).str();
+  if (block.empty()) {
+    std::cerr << "ERROR: Could not load block.pbrt" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  static const std::string empty_world = "WorldBegin\nWorldEnd\n";
+  static const std::string transforms = MakeTransforms(100000);
+
+  benchmark::RegisterBenchmark("BM_LookupDirective", BM_LookupDirective);
+  benchmark::RegisterBenchmark("BM_Convert/EmptyWorld", BM_Convert,
+                               &empty_world);
+  benchmark::RegisterBenchmark("BM_Convert/Transforms", BM_Convert,
+                               &transforms);
+  benchmark::RegisterBenchmark("BM_Convert/Block", BM_Convert, &block);
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return EXIT_SUCCESS;
+}
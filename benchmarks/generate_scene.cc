@@ -0,0 +1,97 @@
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "absl/status/statusor.h"
+#include "benchmarks/scene_generator.h"
+
+ABSL_FLAG(int, pbrt_version, 3,
+          "The version of PBRT to write the scene for, which must be 1, 2, or "
+          "3.");
+
+ABSL_FLAG(uint64_t, triangles, 0,
+          "The number of triangles in the scene, written as triangle meshes.");
+
+ABSL_FLAG(uint64_t, triangles_per_mesh, 0,
+          "The largest number of triangles in each triangle mesh. If zero, "
+          "every triangle is written to one mesh.");
+
+ABSL_FLAG(uint64_t, curves, 0,
+          "The number of curve shapes in the scene. Requires PBRT v3.");
+
+ABSL_FLAG(uint64_t, directives, 0,
+          "The number of short transform directives in the scene, rounded up "
+          "to a multiple of six.");
+
+ABSL_FLAG(uint64_t, textures, 0,
+          "The number of image textures in the scene, each of which has "
+          "several string parameters.");
+
+ABSL_FLAG(uint64_t, grid_resolution, 0,
+          "The number of voxels along each axis of a grid medium. If zero, the "
+          "scene has no grid medium.");
+
+ABSL_FLAG(uint64_t, depth, 0,
+          "The number of attribute blocks the contents of the world are nested "
+          "in.");
+
+ABSL_FLAG(uint64_t, includes, 0,
+          "If non-zero, the shapes of the world are split between this many "
+          "files included from the scene.");
+
+int main(int argc, char** argv) {
+  auto unparsed = absl::ParseCommandLine(argc, argv);
+  if (2 != unparsed.size()) {
+    std::cerr << "ERROR: Missing output directory argument" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  pbrt_proto::SceneOptions options;
+  options.version = absl::GetFlag(FLAGS_pbrt_version);
+  options.triangles = absl::GetFlag(FLAGS_triangles);
+  options.triangles_per_mesh = absl::GetFlag(FLAGS_triangles_per_mesh);
+  options.curves = absl::GetFlag(FLAGS_curves);
+  options.directives = absl::GetFlag(FLAGS_directives);
+  options.textures = absl::GetFlag(FLAGS_textures);
+  options.grid_resolution = absl::GetFlag(FLAGS_grid_resolution);
+  options.depth = absl::GetFlag(FLAGS_depth);
+  options.includes = absl::GetFlag(FLAGS_includes);
+
+  absl::StatusOr<std::vector<pbrt_proto::SceneFile>> files =
+      pbrt_proto::GenerateScene(options);
+  if (!files.ok()) {
+    std::cerr << "ERROR: " << files.status().message() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::filesystem::path directory(unparsed[1]);
+  std::error_code error;
+  std::filesystem::create_directories(directory, error);
+  if (error) {
+    std::cerr << "ERROR: Could not create " << directory << ": "
+              << error.message() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (const pbrt_proto::SceneFile& file : *files) {
+    std::ofstream output(directory / file.path,
+                         std::ios::out | std::ios::binary);
+    output << file.contents;
+    if (!output.flush()) {
+      std::cerr << "ERROR: Could not write " << (directory / file.path)
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::cout << (directory / (*files)[0].path).string() << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,77 @@
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "absl/status/status.h"
+#include "benchmark/benchmark.h"
+#include "pbrt_proto/v3/convert.h"
+#include "pbrt_proto/v3/v3.pb.h"
+
+namespace {
+
+using ::pbrt_proto::v3::Convert;
+using ::pbrt_proto::v3::PbrtProto;
+
+// Builds a scene of many small triangle meshes, which is dominated by numeric
+// parameter lists like the large scenes that benefit from parallel parsing.
+std::string MakeScene(size_t num_meshes, size_t vertices_per_mesh) {
+  std::string scene = "WorldBegin\n";
+  for (size_t i = 0; i < num_meshes; i++) {
+    scene += "AttributeBegin\n";
+    scene += "  Translate " + std::to_string(i) + " 0 0\n";
+    scene += "  Shape \"trianglemesh\"\n    \"integer indices\" [";
+    for (size_t j = 0; j + 2 < vertices_per_mesh; j++) {
+      scene += " 0 " + std::to_string(j + 1) + " " + std::to_string(j + 2);
+    }
+    scene += " ]\n    \"point P\" [\n";
+    for (size_t j = 0; j < vertices_per_mesh; j++) {
+      scene += "      " + std::to_string(j * 0.25) + " " +
+               std::to_string(i * 0.5) + " -1.0625\n";
+    }
+    scene += "    ]\n";
+    scene += "AttributeEnd\n";
+  }
+  scene += "WorldEnd\n";
+  return scene;
+}
+
+void BM_Convert(benchmark::State& state, const std::string* scene) {
+  size_t num_threads = static_cast<size_t>(state.range(0));
+  for (auto _ : state) {
+    PbrtProto output;
+    absl::Status status = Convert(*scene, num_threads, output);
+    if (!status.ok()) {
+      state.SkipWithError(std::string(status.message()).c_str());
+      break;
+    }
+    benchmark::DoNotOptimize(output);
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(scene->size()));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  static const std::string scene =
+      MakeScene(/*num_meshes=*/20000, /*vertices_per_mesh=*/64);
+
+  int64_t max_threads = std::thread::hardware_concurrency();
+  if (max_threads < 8) {
+    max_threads = 8;
+  }
+
+  benchmark::RegisterBenchmark("BM_Convert", BM_Convert, &scene)
+      ->RangeMultiplier(2)
+      ->Range(1, max_threads)
+      ->Unit(benchmark::kMillisecond)
+      ->UseRealTime();
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,347 @@
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "pbrt_proto/shared/parser.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+namespace {
+
+using ::bazel::tools::cpp::runfiles::Runfiles;
+using ::pbrt_proto::ActiveTransformation;
+using ::pbrt_proto::Parameter;
+using ::pbrt_proto::ParameterType;
+using ::pbrt_proto::Parser;
+using ::pbrt_proto::ParseStats;
+
+// The parameter types of PBRT v3, which accepts every parameter type used by
+// the scenes of earlier versions
+static const absl::flat_hash_map<absl::string_view, ParameterType>
+    kParameterTypeNames = {
+        {"blackbody", ParameterType::BLACKBODY_V1},
+        {"bool", ParameterType::BOOL},
+        {"color", ParameterType::RGB},
+        {"float", ParameterType::FLOAT},
+        {"integer", ParameterType::INTEGER},
+        {"normal", ParameterType::NORMAL3},
+        {"normal3", ParameterType::NORMAL3},
+        {"point", ParameterType::POINT3},
+        {"point2", ParameterType::POINT2},
+        {"point3", ParameterType::POINT3},
+        {"rgb", ParameterType::RGB},
+        {"spectrum", ParameterType::SPECTRUM},
+        {"string", ParameterType::STRING},
+        {"texture", ParameterType::TEXTURE},
+        {"vector", ParameterType::VECTOR3},
+        {"vector2", ParameterType::VECTOR2},
+        {"vector3", ParameterType::VECTOR3},
+        {"xyz", ParameterType::XYZ},
+};
+
+// A parser that discards every directive it reads, isolating the cost of
+// tokenizing and parsing an input from that of building its proto.
+class NullParser final : public Parser {
+ public:
+  NullParser() : Parser(kParameterTypeNames) {}
+
+  size_t num_directives() const { return num_directives_; }
+
+ private:
+  using Parameters = absl::flat_hash_map<absl::string_view, Parameter>;
+
+  // Consumes the parameters of a directive so that none are reported unused
+  static absl::Status Discard(Parameters& parameters) {
+    parameters.clear();
+    return absl::OkStatus();
+  }
+
+  absl::Status DirectiveEnd() override {
+    num_directives_ += 1;
+    return absl::OkStatus();
+  }
+
+  absl::Status Accelerator(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status ActiveTransform(ActiveTransformation) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status AreaLightSource(absl::string_view,
+                               Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status AttributeBegin() override { return absl::OkStatus(); }
+
+  absl::Status AttributeEnd() override { return absl::OkStatus(); }
+
+  absl::Status Camera(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status ConcatTransform(double, double, double, double, double, double,
+                               double, double, double, double, double, double,
+                               double, double, double, double) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status CoordinateSystem(absl::string_view) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status CoordSysTransform(absl::string_view) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status Film(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status FloatTexture(absl::string_view, absl::string_view,
+                            Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status Identity() override { return absl::OkStatus(); }
+
+  absl::Status Include(absl::string_view) override { return absl::OkStatus(); }
+
+  absl::Status Integrator(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status Import(absl::string_view) override { return absl::OkStatus(); }
+
+  absl::Status LightSource(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status LookAt(double, double, double, double, double, double, double,
+                      double, double) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status MakeNamedMaterial(absl::string_view,
+                                 Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status MakeNamedMedium(absl::string_view,
+                               Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status Material(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status MediumInterface(absl::string_view, absl::string_view) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status NamedMaterial(absl::string_view) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status ObjectBegin(absl::string_view) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status ObjectEnd() override { return absl::OkStatus(); }
+
+  absl::Status ObjectInstance(absl::string_view) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status PixelFilter(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status Renderer(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status ReverseOrientation() override { return absl::OkStatus(); }
+
+  absl::Status Rotate(double, double, double, double) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status Sampler(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status Scale(double, double, double) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status SearchPath(absl::string_view) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status Shape(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status SpectrumTexture(absl::string_view, absl::string_view,
+                               Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status SurfaceIntegrator(absl::string_view,
+                                 Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status Transform(double, double, double, double, double, double,
+                         double, double, double, double, double, double,
+                         double, double, double, double) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status TransformBegin() override { return absl::OkStatus(); }
+
+  absl::Status TransformEnd() override { return absl::OkStatus(); }
+
+  absl::Status TransformTimes(double, double) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status Translate(double, double, double) override {
+    return absl::OkStatus();
+  }
+
+  absl::Status Volume(absl::string_view, Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status VolumeIntegrator(absl::string_view,
+                                Parameters& parameters) override {
+    return Discard(parameters);
+  }
+
+  absl::Status WorldBegin() override { return absl::OkStatus(); }
+
+  absl::Status WorldEnd() override { return absl::OkStatus(); }
+
+  size_t num_directives_ = 0;
+};
+
+std::string LoadScene(const Runfiles& runfiles, const std::string& path) {
+  std::ifstream input(runfiles.Rlocation("_main/tools/test_data/" + path),
+                      std::ios::in | std::ios::binary);
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return std::move(contents).str();
+}
+
+void SetCounters(benchmark::State& state, const ParseStats& stats,
+                 size_t num_directives) {
+  state.SetBytesProcessed(state.iterations() * stats.bytes);
+  state.counters["directives"] = benchmark::Counter(
+      state.iterations() * num_directives, benchmark::Counter::kIsRate);
+  state.counters["tokens"] = benchmark::Counter(
+      state.iterations() * stats.tokens, benchmark::Counter::kIsRate);
+}
+
+void BM_ReadFromBuffer(benchmark::State& state, const std::string* scene) {
+  ParseStats stats;
+  size_t num_directives = 0;
+  for (auto _ : state) {
+    NullParser parser;
+    stats = ParseStats();
+    absl::Status status = parser.ReadFrom(*scene, &stats);
+    if (!status.ok()) {
+      state.SkipWithError(std::string(status.message()).c_str());
+      break;
+    }
+    num_directives = parser.num_directives();
+  }
+  SetCounters(state, stats, num_directives);
+}
+
+void BM_ReadFromStream(benchmark::State& state, const std::string* scene) {
+  ParseStats stats;
+  size_t num_directives = 0;
+  for (auto _ : state) {
+    std::istringstream stream(*scene);
+    NullParser parser;
+    stats = ParseStats();
+    absl::Status status = parser.ReadFrom(stream, &stats);
+    if (!status.ok()) {
+      state.SkipWithError(std::string(status.message()).c_str());
+      break;
+    }
+    num_directives = parser.num_directives();
+  }
+  SetCounters(state, stats, num_directives);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  std::string error;
+  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv[0], &error));
+  if (!runfiles) {
+    std::cerr << "ERROR: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  static const struct {
+    const char* name;
+    const char* path;
+  } kScenes[] = {
+      {"V1/Bunny", "pbrt-v1-scenes/geometry/bunny.pbrt"},
+      {"V1/Density", "pbrt-v1-scenes/geometry/density_render.60.1.pbrt"},
+      {"V1/Killeroo", "pbrt-v1-scenes/killeroo-simple.pbrt"},
+      {"V2/Bunny", "pbrt-v2-scenes/geometry/bunny.pbrt"},
+      {"V2/Density", "pbrt-v2-scenes/geometry/density_render.60.pbrt"},
+      {"V2/Killeroo", "pbrt-v2-scenes/killeroo-simple.pbrt"},
+      {"V3/Leaves", "pbrt-v3-scenes/sanmiguel/geometry/hojas_b3-geom.pbrt"},
+      {"V3/Hair", "pbrt-v3-scenes/hair/models/block.pbrt"},
+      {"V3/Smoke",
+       "pbrt-v3-scenes/cloud/geometry/density_render.70.smoke.pbrt"},
+      {"V3/Sportscar", "pbrt-v3-scenes/sportscar/sportscar.pbrt"},
+  };
+
+  static std::vector<std::string> scenes;
+  for (const auto& [name, path] : kScenes) {
+    scenes.push_back(LoadScene(*runfiles, path));
+    if (scenes.back().empty()) {
+      std::cerr << "ERROR: Could not load " << path << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  for (size_t i = 0; i < std::size(kScenes); i++) {
+    std::string buffer_name =
+        std::string("BM_ReadFromBuffer/") + kScenes[i].name;
+    benchmark::RegisterBenchmark(buffer_name.c_str(), BM_ReadFromBuffer,
+                                 &scenes[i]);
+
+    std::string stream_name =
+        std::string("BM_ReadFromStream/") + kScenes[i].name;
+    benchmark::RegisterBenchmark(stream_name.c_str(), BM_ReadFromStream,
+                                 &scenes[i]);
+  }
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return EXIT_SUCCESS;
+}
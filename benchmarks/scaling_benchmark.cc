@@ -0,0 +1,331 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "benchmarks/scene_generator.h"
+#include "pbrt_proto/v3/convert.h"
+#include "pbrt_proto/v3/v3.pb.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+namespace {
+
+// Every allocation made through operator new is prefixed with its size so that
+// the bytes allocated, and their peak, can be tracked.
+constexpr size_t kHeaderSize = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+std::atomic<size_t> g_allocated = 0;
+std::atomic<size_t> g_peak_allocated = 0;
+
+void* Allocate(size_t size) noexcept {
+  void* block = std::malloc(size + kHeaderSize);
+  if (block == nullptr) {
+    return nullptr;
+  }
+
+  *static_cast<size_t*>(block) = size;
+
+  size_t allocated =
+      g_allocated.fetch_add(size, std::memory_order_relaxed) + size;
+  size_t peak = g_peak_allocated.load(std::memory_order_relaxed);
+  while (allocated > peak &&
+         !g_peak_allocated.compare_exchange_weak(peak, allocated,
+                                                 std::memory_order_relaxed)) {
+  }
+
+  return static_cast<char*>(block) + kHeaderSize;
+}
+
+void Deallocate(void* ptr) noexcept {
+  if (ptr == nullptr) {
+    return;
+  }
+
+  void* block = static_cast<char*>(ptr) - kHeaderSize;
+  g_allocated.fetch_sub(*static_cast<size_t*>(block),
+                        std::memory_order_relaxed);
+  std::free(block);
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  if (void* ptr = Allocate(size); ptr != nullptr) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+  return Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept { Deallocate(ptr); }
+
+void operator delete[](void* ptr) noexcept { Deallocate(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { Deallocate(ptr); }
+
+void operator delete[](void* ptr, size_t) noexcept { Deallocate(ptr); }
+
+namespace {
+
+using ::bazel::tools::cpp::runfiles::Runfiles;
+using ::pbrt_proto::GenerateScene;
+using ::pbrt_proto::SceneFile;
+using ::pbrt_proto::SceneOptions;
+using ::pbrt_proto::v3::Convert;
+using ::pbrt_proto::v3::Directive;
+
+// Tracks the peak number of bytes allocated by operator new from its
+// construction, excluding those that were already allocated.
+class PeakAllocation {
+ public:
+  PeakAllocation()
+      : baseline_(g_allocated.load(std::memory_order_relaxed)) {
+    g_peak_allocated.store(baseline_, std::memory_order_relaxed);
+  }
+
+  size_t bytes() const {
+    return g_peak_allocated.load(std::memory_order_relaxed) - baseline_;
+  }
+
+ private:
+  size_t baseline_;
+};
+
+size_t TotalSize(const std::vector<SceneFile>& files) {
+  size_t size = 0;
+  for (const SceneFile& file : files) {
+    size += file.contents.size();
+  }
+  return size;
+}
+
+// Converts a scene whose size along `axis` is the benchmark's argument. The
+// complexity is computed against the size of the input so that each axis is
+// expected to scale linearly. As each directive is discarded once it has been
+// converted, peak memory should be bounded by the largest directive.
+void BM_Convert(benchmark::State& state, SceneOptions options,
+                size_t SceneOptions::* axis) {
+  options.*axis = static_cast<size_t>(state.range(0));
+
+  absl::StatusOr<std::vector<SceneFile>> files = GenerateScene(options);
+  if (!files.ok()) {
+    state.SkipWithError(std::string(files.status().message()).c_str());
+    return;
+  }
+
+  const std::string& scene = (*files)[0].contents;
+
+  size_t num_directives = 0;
+  PeakAllocation peak;
+  for (auto _ : state) {
+    num_directives = 0;
+    absl::Status status = Convert(scene, [&](Directive& directive) {
+      benchmark::DoNotOptimize(directive);
+      num_directives += 1;
+      return absl::OkStatus();
+    });
+    if (!status.ok()) {
+      state.SkipWithError(std::string(status.message()).c_str());
+      break;
+    }
+  }
+
+  state.SetComplexityN(static_cast<int64_t>(scene.size()));
+  state.SetBytesProcessed(state.iterations() * scene.size());
+  state.counters["directives"] = benchmark::Counter(
+      state.iterations() * num_directives, benchmark::Counter::kIsRate);
+  state.counters["peak_memory"] =
+      benchmark::Counter(peak.bytes(), benchmark::Counter::kDefaults,
+                         benchmark::Counter::kIs1024);
+}
+
+// Returns the peak resident memory reported by the converter in the stats
+// written to `path`, or zero if there is none.
+uint64_t ReadPeakResidentBytes(const std::filesystem::path& path) {
+  std::ifstream input(path);
+  std::stringstream stream;
+  stream << input.rdbuf();
+  std::string contents = std::move(stream).str();
+  absl::string_view stats = contents;
+
+  static constexpr absl::string_view kKey = "\"peak_resident_bytes\": ";
+  size_t start = stats.find(kKey);
+  if (start == absl::string_view::npos) {
+    return 0;
+  }
+
+  start += kKey.size();
+  size_t end = stats.find_first_not_of("0123456789", start);
+
+  uint64_t bytes = 0;
+  if (!absl::SimpleAtoi(stats.substr(start, end - start), &bytes)) {
+    return 0;
+  }
+
+  return bytes;
+}
+
+// Runs the converter over a scene whose size along `axis` is the benchmark's
+// argument, reporting the peak resident memory of the converter. As the input
+// is mapped into memory, this includes the pages of the input that were read.
+// No complexity is computed since the cost of starting the converter dominates
+// at smaller sizes.
+void BM_Converter(benchmark::State& state, const std::string* binary,
+                  SceneOptions options, size_t SceneOptions::* axis) {
+  options.*axis = static_cast<size_t>(state.range(0));
+
+  absl::StatusOr<std::vector<SceneFile>> files = GenerateScene(options);
+  if (!files.ok()) {
+    state.SkipWithError(std::string(files.status().message()).c_str());
+    return;
+  }
+
+  std::filesystem::path directory =
+      std::filesystem::temp_directory_path() /
+      absl::StrCat("scaling_benchmark_", state.range(0));
+  std::filesystem::create_directories(directory);
+  for (const SceneFile& file : *files) {
+    std::ofstream(directory / file.path, std::ios::out | std::ios::binary)
+        << file.contents;
+  }
+
+  std::filesystem::path input_file = directory / (*files)[0].path;
+  std::filesystem::path stats_file = directory / "stats.json";
+
+#ifdef _WIN32
+  std::string command = "\"\"" + *binary +
+                        "\" --pbrt_version=3 --validate_only --recursive "
+                        "--stats=\"" +
+                        stats_file.string() + "\" \"" + input_file.string() +
+                        "\"\"";
+#else
+  std::string command = "\"" + *binary +
+                        "\" --pbrt_version=3 --validate_only --recursive "
+                        "--stats=\"" +
+                        stats_file.string() + "\" \"" + input_file.string() +
+                        "\"";
+#endif
+
+  for (auto _ : state) {
+    if (std::system(command.c_str()) != 0) {
+      state.SkipWithError("The converter failed");
+      break;
+    }
+  }
+
+  size_t size = TotalSize(*files);
+  state.SetBytesProcessed(state.iterations() * size);
+  state.counters["peak_rss"] =
+      benchmark::Counter(ReadPeakResidentBytes(stats_file),
+                         benchmark::Counter::kDefaults,
+                         benchmark::Counter::kIs1024);
+
+  std::error_code error;
+  std::filesystem::remove_all(directory, error);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  std::string error;
+  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv[0], &error));
+  if (!runfiles) {
+    std::cerr << "ERROR: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::filesystem::path binary_name = "pbrt_proto_converter";
+
+#ifdef _WIN32
+  binary_name.replace_extension(".exe");
+#endif
+
+  static const std::string binary = runfiles->Rlocation(
+      (std::filesystem::path("_main/tools") / binary_name).generic_string());
+
+  SceneOptions meshes;
+  meshes.triangles_per_mesh = 1024;
+
+  SceneOptions includes;
+  includes.triangles = 1 << 14;
+  includes.triangles_per_mesh = 1024;
+
+  benchmark::RegisterBenchmark("BM_Convert/Triangles", BM_Convert,
+                               SceneOptions(), &SceneOptions::triangles)
+      ->RangeMultiplier(4)
+      ->Range(1 << 10, 1 << 18)
+      ->Complexity();
+  benchmark::RegisterBenchmark("BM_Convert/Meshes", BM_Convert, meshes,
+                               &SceneOptions::triangles)
+      ->RangeMultiplier(4)
+      ->Range(1 << 10, 1 << 18)
+      ->Complexity();
+  benchmark::RegisterBenchmark("BM_Convert/Curves", BM_Convert, SceneOptions(),
+                               &SceneOptions::curves)
+      ->RangeMultiplier(4)
+      ->Range(1 << 8, 1 << 16)
+      ->Complexity();
+  benchmark::RegisterBenchmark("BM_Convert/Directives", BM_Convert,
+                               SceneOptions(), &SceneOptions::directives)
+      ->RangeMultiplier(4)
+      ->Range(1 << 10, 1 << 20)
+      ->Complexity();
+  benchmark::RegisterBenchmark("BM_Convert/Textures", BM_Convert,
+                               SceneOptions(), &SceneOptions::textures)
+      ->RangeMultiplier(4)
+      ->Range(1 << 8, 1 << 16)
+      ->Complexity();
+  benchmark::RegisterBenchmark("BM_Convert/Grid", BM_Convert, SceneOptions(),
+                               &SceneOptions::grid_resolution)
+      ->RangeMultiplier(2)
+      ->Range(8, 128)
+      ->Complexity();
+  benchmark::RegisterBenchmark("BM_Convert/Depth", BM_Convert, SceneOptions(),
+                               &SceneOptions::depth)
+      ->RangeMultiplier(4)
+      ->Range(1 << 4, 1 << 14)
+      ->Complexity();
+
+  benchmark::RegisterBenchmark("BM_Converter/Meshes", BM_Converter, &binary,
+                               meshes, &SceneOptions::triangles)
+      ->RangeMultiplier(4)
+      ->Range(1 << 12, 1 << 20)
+      ->UseRealTime();
+  benchmark::RegisterBenchmark("BM_Converter/Includes", BM_Converter, &binary,
+                               includes, &SceneOptions::includes)
+      ->RangeMultiplier(2)
+      ->Range(1, 64)
+      ->UseRealTime();
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,208 @@
+#include "benchmarks/scene_generator.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+
+namespace pbrt_proto {
+namespace {
+
+void AppendTriangleMesh(size_t first_triangle, size_t num_triangles,
+                        std::string& output) {
+  size_t num_vertices = num_triangles + 2;
+
+  output += "Shape \"trianglemesh\"\n  \"integer indices\" [\n";
+  for (size_t i = 0; i < num_triangles; i++) {
+    absl::StrAppend(&output, "    ", i, " ", i + 1, " ", i + 2, "\n");
+  }
+
+  // Each mesh is a strip along x, offset along y from the meshes before it
+  double y = static_cast<double>(first_triangle) / 4096.0;
+
+  output += "  ]\n  \"point P\" [\n";
+  for (size_t i = 0; i < num_vertices; i++) {
+    absl::StrAppend(&output, "    ", (i / 2) * 0.125, " ", y + (i % 2) * 0.5,
+                    " ", (i % 7) * 0.015625, "\n");
+  }
+
+  output += "  ]\n  \"normal N\" [\n";
+  for (size_t i = 0; i < num_vertices; i++) {
+    output += "    0 0 1\n";
+  }
+
+  output += "  ]\n  \"float uv\" [\n";
+  for (size_t i = 0; i < num_vertices; i++) {
+    absl::StrAppend(&output, "    ",
+                    static_cast<double>(i / 2) / (num_vertices / 2), " ",
+                    i % 2, "\n");
+  }
+
+  output += "  ]\n";
+}
+
+void AppendCurve(size_t index, std::string& output) {
+  double x = static_cast<double>(index % 1024) * 0.0078125;
+  double z = static_cast<double>(index / 1024) * 0.0078125;
+
+  absl::StrAppend(&output,
+                  "Shape \"curve\" \"string type\" [ \"cylinder\" ] "
+                  "\"point P\" [ ",
+                  x, " 0 ", z, " ", x + 0.03125, " 0.25 ", z, " ", x,
+                  " 0.5 ", z + 0.03125, " ", x + 0.0625, " 1 ", z,
+                  " ] \"float width0\" [ 0.01 ] \"float width1\" [ 0.005 ]\n");
+}
+
+void AppendDirectives(size_t num_directives, std::string& output) {
+  for (size_t i = 0; i < num_directives; i += 6) {
+    output +=
+        "AttributeBegin\n"
+        "  Translate 1 2 3\n"
+        "  Scale 2 2 2\n"
+        "  Rotate 90 0 0 1\n"
+        "  ReverseOrientation\n"
+        "AttributeEnd\n";
+  }
+}
+
+void AppendTexture(size_t index, std::string& output) {
+  absl::StrAppend(&output, "Texture \"texture", index,
+                  "\" \"color\" \"imagemap\" \"string filename\" [ "
+                  "\"textures/texture",
+                  index,
+                  ".exr\" ] \"string wrap\" [ \"repeat\" ] "
+                  "\"string mapping\" [ \"uv\" ]\n");
+}
+
+void AppendGrid(int version, size_t resolution, std::string& output) {
+  if (version >= 3) {
+    output +=
+        "MakeNamedMedium \"smoke\" \"string type\" \"heterogeneous\"\n";
+  } else {
+    output += "Volume \"volumegrid\"\n";
+  }
+
+  absl::StrAppend(&output, "  \"integer nx\" ", resolution, " \"integer ny\" ",
+                  resolution, " \"integer nz\" ", resolution, "\n");
+  output +=
+      "  \"point p0\" [ 0 0 0 ] \"point p1\" [ 1 1 1 ]\n"
+      "  \"float density\" [\n";
+
+  for (size_t z = 0; z < resolution; z++) {
+    for (size_t y = 0; y < resolution; y++) {
+      output += "   ";
+      for (size_t x = 0; x < resolution; x++) {
+        absl::StrAppend(&output, " ", ((x * 7 + y * 13 + z * 29) % 64) / 64.0);
+      }
+      output += "\n";
+    }
+  }
+
+  output += "  ]\n";
+}
+
+size_t TrianglesPerMesh(const SceneOptions& options) {
+  return options.triangles_per_mesh != 0 ? options.triangles_per_mesh
+                                         : options.triangles;
+}
+
+// Every triangle mesh and curve is a shape
+size_t NumShapes(const SceneOptions& options) {
+  size_t triangles_per_mesh = TrianglesPerMesh(options);
+  size_t num_meshes =
+      triangles_per_mesh == 0
+          ? 0
+          : (options.triangles + triangles_per_mesh - 1) / triangles_per_mesh;
+  return num_meshes + options.curves;
+}
+
+// Appends the shapes from `first_shape` up to `end_shape`, which are the
+// triangle meshes followed by the curves
+void AppendShapes(const SceneOptions& options, size_t first_shape,
+                  size_t end_shape, std::string& output) {
+  size_t triangles_per_mesh = TrianglesPerMesh(options);
+  size_t num_meshes = NumShapes(options) - options.curves;
+  for (size_t i = first_shape; i < end_shape; i++) {
+    if (i < num_meshes) {
+      size_t first_triangle = i * triangles_per_mesh;
+      AppendTriangleMesh(
+          first_triangle,
+          std::min(triangles_per_mesh, options.triangles - first_triangle),
+          output);
+    } else {
+      AppendCurve(i - num_meshes, output);
+    }
+  }
+}
+
+// Appends the contents of the world that precede its shapes
+void AppendWorldBegin(const SceneOptions& options, std::string& output) {
+  for (size_t i = 0; i < options.depth; i++) {
+    output += "AttributeBegin\nTranslate 0 0 1\n";
+  }
+
+  AppendDirectives(options.directives, output);
+
+  for (size_t i = 0; i < options.textures; i++) {
+    AppendTexture(i, output);
+  }
+
+  if (options.grid_resolution != 0) {
+    AppendGrid(options.version, options.grid_resolution, output);
+  }
+}
+
+void AppendWorldEnd(const SceneOptions& options, std::string& output) {
+  for (size_t i = 0; i < options.depth; i++) {
+    output += "AttributeEnd\n";
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<SceneFile>> GenerateScene(
+    const SceneOptions& options) {
+  if (options.version < 1 || options.version > 3) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unsupported PBRT version: ", options.version));
+  }
+
+  if (options.curves != 0 && options.version < 3) {
+    return absl::InvalidArgumentError("Curves require PBRT v3");
+  }
+
+  std::vector<SceneFile> files(1);
+  files[0].path = "scene.pbrt";
+  files[0].contents =
+      "LookAt 0 0 -5  0 0 0  0 1 0\n"
+      "Camera \"perspective\" \"float fov\" [ 45 ]\n"
+      "Film \"image\" \"integer xresolution\" [ 64 ] "
+      "\"integer yresolution\" [ 64 ]\n"
+      "WorldBegin\n";
+
+  AppendWorldBegin(options, files[0].contents);
+
+  size_t num_shapes = NumShapes(options);
+  if (options.includes == 0) {
+    AppendShapes(options, 0, num_shapes, files[0].contents);
+  } else {
+    for (size_t i = 0; i < options.includes; i++) {
+      SceneFile& include = files.emplace_back();
+      include.path = absl::StrCat("include", i, ".pbrt");
+      AppendShapes(options, num_shapes * i / options.includes,
+                   num_shapes * (i + 1) / options.includes, include.contents);
+      absl::StrAppend(&files[0].contents, "Include \"", include.path, "\"\n");
+    }
+  }
+
+  AppendWorldEnd(options, files[0].contents);
+  files[0].contents += "WorldEnd\n";
+
+  return files;
+}
+
+}  // namespace pbrt_proto
@@ -0,0 +1,58 @@
+#ifndef _BENCHMARKS_SCENE_GENERATOR_
+#define _BENCHMARKS_SCENE_GENERATOR_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"
+
+namespace pbrt_proto {
+
+// Describes a synthetic scene whose size can be scaled along each axis
+// independently. Every part of the scene is omitted when its count is zero.
+struct SceneOptions {
+  // The PBRT version to write, which must be 1, 2, or 3
+  int version = 3;
+
+  // Triangles written as triangle strips with positions, normals, and texture
+  // coordinates, split into meshes of at most `triangles_per_mesh` triangles.
+  // If `triangles_per_mesh` is zero they are all written as one mesh.
+  size_t triangles = 0;
+  size_t triangles_per_mesh = 0;
+
+  // Cubic curves, each written as its own shape. Requires PBRT v3.
+  size_t curves = 0;
+
+  // Short transform directives, written in attribute blocks of six directives
+  // and rounded up to a whole number of blocks.
+  size_t directives = 0;
+
+  // Image textures, each with a list of string parameters
+  size_t textures = 0;
+
+  // The number of voxels along each axis of a single grid medium
+  size_t grid_resolution = 0;
+
+  // The number of attribute blocks the contents of the world are nested in
+  size_t depth = 0;
+
+  // If non-zero, the shapes of the world are split as evenly as possible
+  // between this many separate files that are each included from the scene.
+  size_t includes = 0;
+};
+
+struct SceneFile {
+  std::string path;
+  std::string contents;
+};
+
+// Generates a valid scene as described by `options`. The scene itself is the
+// first file returned and is named `scene.pbrt`. Any other files are included
+// from it, and their paths are relative to it.
+absl::StatusOr<std::vector<SceneFile>> GenerateScene(
+    const SceneOptions& options);
+
+}  // namespace pbrt_proto
+
+#endif  // _BENCHMARKS_SCENE_GENERATOR_
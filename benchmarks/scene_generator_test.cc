@@ -0,0 +1,158 @@
+#include "benchmarks/scene_generator.h"
+
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/status_matchers.h"
+#include "absl/status/statusor.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pbrt_proto/v1/convert.h"
+#include "pbrt_proto/v1/v1.pb.h"
+#include "pbrt_proto/v2/convert.h"
+#include "pbrt_proto/v2/v2.pb.h"
+#include "pbrt_proto/v3/convert.h"
+#include "pbrt_proto/v3/v3.pb.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::absl_testing::IsOk;
+using ::absl_testing::StatusIs;
+
+SceneOptions MakeOptions(int version) {
+  SceneOptions options;
+  options.version = version;
+  options.triangles = 100;
+  options.triangles_per_mesh = 30;
+  options.curves = version >= 3 ? 10 : 0;
+  options.directives = 10;
+  options.textures = 5;
+  options.grid_resolution = 4;
+  options.depth = 3;
+  return options;
+}
+
+// The five directives around the world, three for each level of nesting, and
+// two blocks of transforms along with each texture, grid, mesh, and curve
+int NumDirectives(const SceneOptions& options) {
+  return 5 + 3 * options.depth + 12 + options.textures + 1 + 4 +
+         options.curves;
+}
+
+TEST(GenerateScene, V1) {
+  SceneOptions options = MakeOptions(1);
+  absl::StatusOr<std::vector<SceneFile>> files = GenerateScene(options);
+  ASSERT_THAT(files, IsOk());
+  ASSERT_EQ(1u, files->size());
+
+  v1::PbrtProto output;
+  ASSERT_THAT(v1::Convert((*files)[0].contents, output), IsOk());
+  EXPECT_EQ(NumDirectives(options), output.directives_size());
+}
+
+TEST(GenerateScene, V2) {
+  SceneOptions options = MakeOptions(2);
+  absl::StatusOr<std::vector<SceneFile>> files = GenerateScene(options);
+  ASSERT_THAT(files, IsOk());
+  ASSERT_EQ(1u, files->size());
+
+  v2::PbrtProto output;
+  ASSERT_THAT(v2::Convert((*files)[0].contents, output), IsOk());
+  EXPECT_EQ(NumDirectives(options), output.directives_size());
+}
+
+TEST(GenerateScene, V3) {
+  SceneOptions options = MakeOptions(3);
+  absl::StatusOr<std::vector<SceneFile>> files = GenerateScene(options);
+  ASSERT_THAT(files, IsOk());
+  ASSERT_EQ(1u, files->size());
+
+  v3::PbrtProto output;
+  ASSERT_THAT(v3::Convert((*files)[0].contents, output), IsOk());
+  EXPECT_EQ(NumDirectives(options), output.directives_size());
+}
+
+int NumShapes(const v3::PbrtProto& proto) {
+  int num_shapes = 0;
+  for (const v3::Directive& directive : proto.directives()) {
+    num_shapes += directive.has_shape();
+  }
+  return num_shapes;
+}
+
+TEST(GenerateScene, Includes) {
+  SceneOptions options = MakeOptions(3);
+  options.includes = 2;
+
+  absl::StatusOr<std::vector<SceneFile>> files = GenerateScene(options);
+  ASSERT_THAT(files, IsOk());
+  ASSERT_EQ(3u, files->size());
+  EXPECT_EQ("scene.pbrt", (*files)[0].path);
+  EXPECT_EQ("include0.pbrt", (*files)[1].path);
+  EXPECT_EQ("include1.pbrt", (*files)[2].path);
+
+  // Only the shapes are moved to the included files
+  v3::PbrtProto scene;
+  ASSERT_THAT(v3::Convert((*files)[0].contents, scene), IsOk());
+  ASSERT_EQ(NumDirectives(options) - 4 - static_cast<int>(options.curves) + 2,
+            scene.directives_size());
+  EXPECT_EQ(0, NumShapes(scene));
+
+  int first_include =
+      scene.directives_size() - 2 - static_cast<int>(options.depth) - 1;
+  EXPECT_EQ("include0.pbrt", scene.directives(first_include).include().path());
+  EXPECT_EQ("include1.pbrt",
+            scene.directives(first_include + 1).include().path());
+
+  for (size_t i = 1; i < files->size(); i++) {
+    v3::PbrtProto include;
+    ASSERT_THAT(v3::Convert((*files)[i].contents, include), IsOk());
+    EXPECT_EQ(include.directives_size(), NumShapes(include));
+  }
+}
+
+TEST(GenerateScene, IncludesSplitShapes) {
+  SceneOptions options = MakeOptions(3);
+  for (size_t includes : {0, 1, 2, 3, 20}) {
+    SCOPED_TRACE(includes);
+    options.includes = includes;
+
+    absl::StatusOr<std::vector<SceneFile>> files = GenerateScene(options);
+    ASSERT_THAT(files, IsOk());
+    ASSERT_EQ(includes + 1, files->size());
+
+    int num_shapes = 0;
+    for (const SceneFile& file : *files) {
+      v3::PbrtProto output;
+      ASSERT_THAT(v3::Convert(file.contents, output), IsOk());
+      num_shapes += NumShapes(output);
+    }
+    EXPECT_EQ(4 + static_cast<int>(options.curves), num_shapes);
+  }
+}
+
+TEST(GenerateScene, Empty) {
+  absl::StatusOr<std::vector<SceneFile>> files = GenerateScene({});
+  ASSERT_THAT(files, IsOk());
+  ASSERT_EQ(1u, files->size());
+
+  v3::PbrtProto output;
+  ASSERT_THAT(v3::Convert((*files)[0].contents, output), IsOk());
+  EXPECT_EQ(5, output.directives_size());
+}
+
+TEST(GenerateScene, BadOptions) {
+  SceneOptions options;
+  options.version = 4;
+  EXPECT_THAT(GenerateScene(options),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  options.version = 2;
+  options.curves = 1;
+  EXPECT_THAT(GenerateScene(options),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace pbrt_proto
@@ -0,0 +1,153 @@
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "benchmark/benchmark.h"
+#include "pbrt_proto/shared/scanner.h"
+#include "pbrt_proto/shared/tokenizer.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+namespace {
+
+using ::bazel::tools::cpp::runfiles::Runfiles;
+using ::pbrt_proto::GetScanner;
+using ::pbrt_proto::kScannerBlockSize;
+using ::pbrt_proto::Scanner;
+using ::pbrt_proto::ScannerKernel;
+using ::pbrt_proto::Token;
+using ::pbrt_proto::TokenKind;
+using ::pbrt_proto::Tokenizer;
+
+std::vector<std::string> LoadCorpus(const std::filesystem::path& root) {
+  std::vector<std::string> corpus;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(root)) {
+    if (!entry.is_regular_file() || entry.path().extension() != ".pbrt") {
+      continue;
+    }
+
+    std::ifstream input(entry.path(), std::ios::in | std::ios::binary);
+    std::stringstream contents;
+    contents << input.rdbuf();
+    corpus.push_back(std::move(contents).str());
+  }
+  return corpus;
+}
+
+size_t CorpusSize(const std::vector<std::string>& corpus) {
+  size_t size = 0;
+  for (const std::string& file : corpus) {
+    size += file.size();
+  }
+  return size;
+}
+
+// Classifies each file block by block, isolating the cost of the Scanner
+// kernel from the rest of the Tokenizer.
+void BM_Classify(benchmark::State& state, const Scanner* scanner,
+                 const std::vector<std::string>* corpus) {
+  for (auto _ : state) {
+    for (const std::string& file : *corpus) {
+      for (size_t i = 0; i + kScannerBlockSize <= file.size();
+           i += kScannerBlockSize) {
+        benchmark::DoNotOptimize(scanner->classify(file.data() + i));
+      }
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * CorpusSize(*corpus));
+}
+
+void BM_TokenizeBuffer(benchmark::State& state, const Scanner* scanner,
+                       const std::vector<std::string>* corpus) {
+  uint64_t num_tokens = 0;
+  for (auto _ : state) {
+    num_tokens = 0;
+    for (const std::string& file : *corpus) {
+      Tokenizer tokenizer(file, *scanner);
+      for (const Token* token = &tokenizer.Next();
+           token->kind != TokenKind::END; token = &tokenizer.Next()) {
+        benchmark::DoNotOptimize(token->text);
+      }
+      num_tokens += tokenizer.tokens_read();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * CorpusSize(*corpus));
+  state.counters["tokens"] = benchmark::Counter(
+      state.iterations() * num_tokens, benchmark::Counter::kIsRate);
+}
+
+void BM_TokenizeStream(benchmark::State& state,
+                       const std::vector<std::string>* corpus) {
+  uint64_t num_tokens = 0;
+  for (auto _ : state) {
+    num_tokens = 0;
+    for (const std::string& file : *corpus) {
+      std::istringstream stream(file);
+      Tokenizer tokenizer(&stream);
+      for (const Token* token = &tokenizer.Next();
+           token->kind != TokenKind::END; token = &tokenizer.Next()) {
+        benchmark::DoNotOptimize(token->text);
+      }
+      num_tokens += tokenizer.tokens_read();
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * CorpusSize(*corpus));
+  state.counters["tokens"] = benchmark::Counter(
+      state.iterations() * num_tokens, benchmark::Counter::kIsRate);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+
+  std::string error;
+  std::unique_ptr<Runfiles> runfiles(Runfiles::Create(argv[0], &error));
+  if (!runfiles) {
+    std::cerr << "ERROR: " << error << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  static const std::vector<std::string> corpus =
+      LoadCorpus(runfiles->Rlocation("_main/tools/test_data"));
+  if (corpus.empty()) {
+    std::cerr << "ERROR: Could not load test_data corpus" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  struct {
+    const char* name;
+    ScannerKernel kernel;
+  } kernels[] = {
+      {"SWAR", ScannerKernel::SWAR},
+      {"SSE2", ScannerKernel::SSE2},
+      {"AVX2", ScannerKernel::AVX2},
+  };
+
+  for (const auto& [name, kernel] : kernels) {
+    if (const Scanner* scanner = GetScanner(kernel); scanner != nullptr) {
+      std::string classify_name = std::string("BM_Classify/") + name;
+      benchmark::RegisterBenchmark(classify_name.c_str(), BM_Classify, scanner,
+                                   &corpus);
+
+      std::string tokenize_name = std::string("BM_TokenizeBuffer/") + name;
+      benchmark::RegisterBenchmark(tokenize_name.c_str(), BM_TokenizeBuffer,
+                                   scanner, &corpus);
+    }
+  }
+
+  benchmark::RegisterBenchmark("BM_TokenizeStream", BM_TokenizeStream,
+                               &corpus);
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  return EXIT_SUCCESS;
+}
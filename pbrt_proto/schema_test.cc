@@ -15,6 +15,8 @@ namespace {
 using ::google::protobuf::Descriptor;
 using ::google::protobuf::FieldDescriptor;
 
+constexpr int kFirstAlternateFieldNumber = 1000;
+
 TEST(Shared, MutuallyCompatible) {
   for (const auto& [name, directives] : AllMessageGroups()) {
     for (const Descriptor* d0 : directives) {
@@ -29,6 +31,8 @@ TEST(Shared, FieldNumbersAreContiguous) {
   for (const auto& [name, directives] : AllMessageGroups()) {
     std::set<int> claimed_values;
     int max_field_number = 0;
+    std::set<int> alternate_values;
+    int max_alternate_field_number = kFirstAlternateFieldNumber - 1;
 
     // Marble only exists as a SpectrumTexture, but its numbers are unused in
     // order to allow Float and Spectum textures to have the same field numbers.
@@ -51,17 +55,35 @@ TEST(Shared, FieldNumbersAreContiguous) {
           const FieldDescriptor* field_descriptor = d0->field(f);
           ASSERT_TRUE(field_descriptor);
 
-          if (GetFieldSupportedVersions(field_descriptor->full_name())
-                  .Supported(pbrt_version)) {
-            max_field_number =
-                std::max(max_field_number, field_descriptor->number());
-            claimed_values.insert(field_descriptor->number());
+          if (!GetFieldSupportedVersions(field_descriptor->full_name())
+                   .Supported(pbrt_version)) {
+            continue;
+          }
+
+          // Alternate encodings of repeated fields (packed arrays, sidecar
+          // references, etc.) are numbered separately from the fields that
+          // correspond to PBRT parameters. Since they are not tied to any PBRT
+          // version, they are only required to be contiguous across all
+          // versions.
+          if (field_descriptor->number() >= kFirstAlternateFieldNumber) {
+            max_alternate_field_number = std::max(max_alternate_field_number,
+                                                  field_descriptor->number());
+            alternate_values.insert(field_descriptor->number());
+            continue;
           }
+
+          max_field_number =
+              std::max(max_field_number, field_descriptor->number());
+          claimed_values.insert(field_descriptor->number());
         }
       }
 
       EXPECT_EQ(max_field_number, static_cast<int>(claimed_values.size()));
     }
+
+    SCOPED_TRACE(name);
+    EXPECT_EQ(max_alternate_field_number - kFirstAlternateFieldNumber + 1,
+              static_cast<int>(alternate_values.size()));
   }
 }
 
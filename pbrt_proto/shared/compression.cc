@@ -0,0 +1,674 @@
+#include "pbrt_proto/shared/compression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "absl/base/nullability.h"
+#include "absl/types/span.h"
+#include "google/protobuf/repeated_field.h"
+#include "pbrt_proto/pbrt.pb.h"
+#include "pbrt_proto/shared/cpu.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PBRT_PROTO_COMPRESSION_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define PBRT_PROTO_TARGET_AVX2
+#else
+#define PBRT_PROTO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace pbrt_proto {
+namespace {
+
+constexpr size_t kDirectionComponents = 3;
+constexpr size_t kOctahedralComponents = 2;
+
+constexpr double kMaxFloat = std::numeric_limits<float>::max();
+
+// Returns the largest quantized value that fits in `bits` bits
+double MaxQuantized(uint32_t bits) { return std::ldexp(1.0, bits) - 1.0; }
+
+// Returns the quantized value representing an octahedral coordinate of zero,
+// which is also the number of steps from zero to one.
+double OctahedralZero(uint32_t bits) {
+  return std::ldexp(1.0, bits - 1) - 1.0;
+}
+
+double SignNotZero(double value) { return value < 0.0 ? -1.0 : 1.0; }
+
+template <typename T>
+T Narrow(double value) {
+  if constexpr (std::is_same_v<T, float>) {
+    // Clamp as `RoundToFloat` would; every decoded value is finite
+    return static_cast<float>(std::clamp(value, -kMaxFloat, kMaxFloat));
+  } else {
+    return value;
+  }
+}
+
+template <typename T>
+void ScalarDequantize(const uint32_t* values, size_t num_values,
+                      const double* mins, const double* steps,
+                      size_t tuple_size, T* out) {
+  for (size_t i = 0; i < num_values; i += tuple_size) {
+    for (size_t c = 0; c < tuple_size; c++) {
+      out[i + c] = Narrow<T>(mins[c] + values[i + c] * steps[c]);
+    }
+  }
+}
+
+// Unfolds the octahedral coordinates `x` and `y`, each in [-1, 1], into the
+// unit direction they encode.
+template <typename T>
+void Unfold(T x, T y, T* out) {
+  T z = T(1.0) - std::abs(x) - std::abs(y);
+
+  // Coordinates on the folded lower half of the octahedron are reflected back
+  // across the edges of the upper half. Where `x` or `y` is zero `t` is too, so
+  // the sign chosen for it does not matter.
+  T t = std::max(-z, T(0.0));
+  x -= std::copysign(t, x);
+  y -= std::copysign(t, y);
+
+  T inverse_length = T(1.0) / std::sqrt(x * x + y * y + z * z);
+  out[0] = x * inverse_length;
+  out[1] = y * inverse_length;
+  out[2] = z * inverse_length;
+}
+
+template <typename T>
+void ScalarDecodeOctahedral(const uint32_t* values, size_t num_directions,
+                            T zero, T scale, T* out) {
+  for (size_t i = 0; i < num_directions; i++) {
+    T x = std::clamp((static_cast<T>(values[2 * i]) - zero) * scale, T(-1.0),
+                     T(1.0));
+    T y = std::clamp((static_cast<T>(values[2 * i + 1]) - zero) * scale,
+                     T(-1.0), T(1.0));
+    Unfold(x, y, out + kDirectionComponents * i);
+  }
+}
+
+void ScalarDeltaDecode(const int32_t* deltas, size_t size, uint32_t* out) {
+  uint32_t value = 0;
+  for (size_t i = 0; i < size; i++) {
+    value += static_cast<uint32_t>(deltas[i]);
+    out[i] = value;
+  }
+}
+
+const MeshDecoder kScalarDecoder = {
+    ScalarDequantize<double>,       ScalarDequantize<float>,
+    ScalarDecodeOctahedral<double>, ScalarDecodeOctahedral<float>,
+    ScalarDeltaDecode,
+};
+
+#ifdef PBRT_PROTO_COMPRESSION_X86
+
+// Each vector kernel computes exactly what its scalar counterpart does, one
+// operation at a time, so that both decode to the same bits. None of them fuse
+// multiplies and adds, and the values left after the last whole vector are
+// decoded by the scalar kernel.
+
+// Converts each unsigned value exactly. Flipping the sign bit maps the values
+// onto the signed range, which is converted and then shifted back.
+PBRT_PROTO_TARGET_AVX2 __m256d Avx2ToDouble(__m128i values) {
+  __m128i flipped = _mm_xor_si128(values, _mm_set1_epi32(INT32_MIN));
+  return _mm256_add_pd(_mm256_cvtepi32_pd(flipped),
+                       _mm256_set1_pd(2147483648.0));
+}
+
+// Converts each unsigned value rounding to nearest, as a scalar conversion
+// does. The upper and lower halves are converted exactly and their sum is
+// rounded once.
+PBRT_PROTO_TARGET_AVX2 __m256 Avx2ToFloat(__m256i values) {
+  __m256 high = _mm256_cvtepi32_ps(_mm256_srli_epi32(values, 16));
+  __m256 low = _mm256_cvtepi32_ps(
+      _mm256_and_si256(values, _mm256_set1_epi32(0xFFFF)));
+  return _mm256_add_ps(_mm256_mul_ps(high, _mm256_set1_ps(65536.0f)), low);
+}
+
+// Four doubles at a time
+struct Avx2Double {
+  using Scalar = double;
+  using Vector = __m256d;
+  static constexpr size_t kWidth = 4;
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Set1(double value) {
+    return _mm256_set1_pd(value);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Add(Vector a, Vector b) {
+    return _mm256_add_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Sub(Vector a, Vector b) {
+    return _mm256_sub_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Mul(Vector a, Vector b) {
+    return _mm256_mul_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Div(Vector a, Vector b) {
+    return _mm256_div_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Sqrt(Vector a) {
+    return _mm256_sqrt_pd(a);
+  }
+
+  // Returns `b` where either is NaN
+  PBRT_PROTO_TARGET_AVX2 static Vector Min(Vector a, Vector b) {
+    return _mm256_min_pd(a, b);
+  }
+
+  // Returns `b` where either is NaN
+  PBRT_PROTO_TARGET_AVX2 static Vector Max(Vector a, Vector b) {
+    return _mm256_max_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector And(Vector a, Vector b) {
+    return _mm256_and_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector AndNot(Vector a, Vector b) {
+    return _mm256_andnot_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Or(Vector a, Vector b) {
+    return _mm256_or_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Xor(Vector a, Vector b) {
+    return _mm256_xor_pd(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static void Store(Vector values, double* out) {
+    _mm256_storeu_pd(out, values);
+  }
+
+  // Loads the octahedral coordinates of `kWidth` directions
+  PBRT_PROTO_TARGET_AVX2 static void LoadOctahedral(const uint32_t* values,
+                                                    Vector& x, Vector& y) {
+    __m256i pairs = _mm256_permutevar8x32_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)),
+        _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7));
+    x = Avx2ToDouble(_mm256_castsi256_si128(pairs));
+    y = Avx2ToDouble(_mm256_extracti128_si256(pairs, 1));
+  }
+};
+
+// Eight floats at a time
+struct Avx2Float {
+  using Scalar = float;
+  using Vector = __m256;
+  static constexpr size_t kWidth = 8;
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Set1(float value) {
+    return _mm256_set1_ps(value);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Add(Vector a, Vector b) {
+    return _mm256_add_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Sub(Vector a, Vector b) {
+    return _mm256_sub_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Mul(Vector a, Vector b) {
+    return _mm256_mul_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Div(Vector a, Vector b) {
+    return _mm256_div_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Sqrt(Vector a) {
+    return _mm256_sqrt_ps(a);
+  }
+
+  // Returns `b` where either is NaN
+  PBRT_PROTO_TARGET_AVX2 static Vector Min(Vector a, Vector b) {
+    return _mm256_min_ps(a, b);
+  }
+
+  // Returns `b` where either is NaN
+  PBRT_PROTO_TARGET_AVX2 static Vector Max(Vector a, Vector b) {
+    return _mm256_max_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector And(Vector a, Vector b) {
+    return _mm256_and_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector AndNot(Vector a, Vector b) {
+    return _mm256_andnot_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Or(Vector a, Vector b) {
+    return _mm256_or_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Xor(Vector a, Vector b) {
+    return _mm256_xor_ps(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static void Store(Vector values, float* out) {
+    _mm256_storeu_ps(out, values);
+  }
+
+  // Loads the octahedral coordinates of `kWidth` directions. Shuffling within
+  // each half leaves the directions of the halves interleaved, which is undone
+  // by permuting pairs of them.
+  PBRT_PROTO_TARGET_AVX2 static void LoadOctahedral(const uint32_t* values,
+                                                    Vector& x, Vector& y) {
+    __m256 first = Avx2ToFloat(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)));
+    __m256 second = Avx2ToFloat(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + 8)));
+    x = _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(
+            _mm256_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0))),
+        _MM_SHUFFLE(3, 1, 2, 0)));
+    y = _mm256_castpd_ps(_mm256_permute4x64_pd(
+        _mm256_castps_pd(
+            _mm256_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1))),
+        _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+};
+
+// Stores `values` to `out`, clamped as `Narrow` does for floats
+PBRT_PROTO_TARGET_AVX2 void Avx2Store(__m256d values, double* out) {
+  Avx2Double::Store(values, out);
+}
+
+PBRT_PROTO_TARGET_AVX2 void Avx2Store(__m256d values, float* out) {
+  __m256d clamped =
+      Avx2Double::Min(Avx2Double::Set1(kMaxFloat),
+                      Avx2Double::Max(Avx2Double::Set1(-kMaxFloat), values));
+  _mm_storeu_ps(out, _mm256_cvtpd_ps(clamped));
+}
+
+// Values are decoded four at a time in double precision, so the minimum and
+// step of each lane repeat every `tuple_size` vectors
+template <typename T>
+PBRT_PROTO_TARGET_AVX2 void Avx2Dequantize(const uint32_t* values,
+                                           size_t num_values,
+                                           const double* mins,
+                                           const double* steps,
+                                           size_t tuple_size, T* out) {
+  constexpr size_t kWidth = Avx2Double::kWidth;
+
+  size_t period = tuple_size * kWidth;
+  std::vector<double> lane_mins(period), lane_steps(period);
+  for (size_t i = 0; i < period; i++) {
+    lane_mins[i] = mins[i % tuple_size];
+    lane_steps[i] = steps[i % tuple_size];
+  }
+
+  size_t i = 0;
+  for (; num_values - i >= period; i += period) {
+    for (size_t j = 0; j < period; j += kWidth) {
+      __m256d decoded = Avx2ToDouble(_mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(values + i + j)));
+      decoded = Avx2Double::Add(
+          _mm256_loadu_pd(lane_mins.data() + j),
+          Avx2Double::Mul(decoded, _mm256_loadu_pd(lane_steps.data() + j)));
+      Avx2Store(decoded, out + i + j);
+    }
+  }
+
+  ScalarDequantize(values + i, num_values - i, mins, steps, tuple_size,
+                   out + i);
+}
+
+// Each step matches `ScalarDecodeOctahedral` and `Unfold`
+template <typename Ops>
+PBRT_PROTO_TARGET_AVX2 void Avx2DecodeOctahedral(
+    const uint32_t* values, size_t num_directions,
+    typename Ops::Scalar zero, typename Ops::Scalar scale,
+    typename Ops::Scalar* out) {
+  using Vector = typename Ops::Vector;
+  constexpr size_t kWidth = Ops::kWidth;
+
+  Vector zeros = Ops::Set1(zero);
+  Vector scales = Ops::Set1(scale);
+  Vector ones = Ops::Set1(1.0);
+  Vector minus_ones = Ops::Set1(-1.0);
+  Vector sign_bits = Ops::Set1(-0.0);
+  Vector positive_zeros = Ops::Set1(0.0);
+
+  size_t i = 0;
+  for (; num_directions - i >= kWidth; i += kWidth) {
+    Vector x, y;
+    Ops::LoadOctahedral(values + kOctahedralComponents * i, x, y);
+
+    // `std::clamp` returns its argument unless it is out of range
+    x = Ops::Min(ones,
+                 Ops::Max(minus_ones, Ops::Mul(Ops::Sub(x, zeros), scales)));
+    y = Ops::Min(ones,
+                 Ops::Max(minus_ones, Ops::Mul(Ops::Sub(y, zeros), scales)));
+
+    Vector z = Ops::Sub(Ops::Sub(ones, Ops::AndNot(sign_bits, x)),
+                        Ops::AndNot(sign_bits, y));
+
+    // `std::max(-z, 0)` returns `-z` unless it is less than zero, and `t` is
+    // never negative when its sign is copied
+    Vector t = Ops::Max(positive_zeros, Ops::Xor(z, sign_bits));
+    x = Ops::Sub(x, Ops::Or(t, Ops::And(x, sign_bits)));
+    y = Ops::Sub(y, Ops::Or(t, Ops::And(y, sign_bits)));
+
+    Vector inverse_length = Ops::Div(
+        ones, Ops::Sqrt(Ops::Add(Ops::Add(Ops::Mul(x, x), Ops::Mul(y, y)),
+                                 Ops::Mul(z, z))));
+
+    alignas(32) typename Ops::Scalar components[kDirectionComponents][kWidth];
+    Ops::Store(Ops::Mul(x, inverse_length), components[0]);
+    Ops::Store(Ops::Mul(y, inverse_length), components[1]);
+    Ops::Store(Ops::Mul(z, inverse_length), components[2]);
+
+    typename Ops::Scalar* direction = out + kDirectionComponents * i;
+    for (size_t j = 0; j < kWidth; j++) {
+      for (size_t c = 0; c < kDirectionComponents; c++) {
+        direction[kDirectionComponents * j + c] = components[c][j];
+      }
+    }
+  }
+
+  ScalarDecodeOctahedral(values + kOctahedralComponents * i,
+                         num_directions - i, zero, scale,
+                         out + kDirectionComponents * i);
+}
+
+// Sums each vector in place with two shifts within each half, then carries the
+// total of the lower half into the upper one and the total of every earlier
+// vector into both
+PBRT_PROTO_TARGET_AVX2 void Avx2DeltaDecode(const int32_t* deltas,
+                                            size_t size, uint32_t* out) {
+  constexpr size_t kWidth = 8;
+
+  __m256i carry = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; size - i >= kWidth; i += kWidth) {
+    __m256i sums =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(deltas + i));
+    sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 4));
+    sums = _mm256_add_epi32(sums, _mm256_slli_si256(sums, 8));
+
+    __m256i half_totals = _mm256_shuffle_epi32(sums, _MM_SHUFFLE(3, 3, 3, 3));
+    sums = _mm256_add_epi32(
+        sums, _mm256_permute2x128_si256(half_totals, half_totals, 0x08));
+    sums = _mm256_add_epi32(sums, carry);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), sums);
+    carry = _mm256_permutevar8x32_epi32(sums, _mm256_set1_epi32(7));
+  }
+
+  // The values left continue from the last sum
+  uint32_t value = i == 0 ? 0 : out[i - 1];
+  for (; i < size; i++) {
+    value += static_cast<uint32_t>(deltas[i]);
+    out[i] = value;
+  }
+}
+
+const MeshDecoder kAvx2Decoder = {
+    Avx2Dequantize<double>,
+    Avx2Dequantize<float>,
+    Avx2DecodeOctahedral<Avx2Double>,
+    Avx2DecodeOctahedral<Avx2Float>,
+    Avx2DeltaDecode,
+};
+
+#endif  // PBRT_PROTO_COMPRESSION_X86
+
+template <typename T>
+void DequantizeInto(const QuantizedArray& array, std::vector<T>& output) {
+  output.clear();
+
+  size_t tuple_size = array.min_size();
+  if (tuple_size == 0 || array.extent_size() != array.min_size() ||
+      array.bits() < 1 || array.bits() > 32) {
+    return;
+  }
+
+  double max_value = MaxQuantized(array.bits());
+  std::vector<double> steps(tuple_size);
+  for (size_t c = 0; c < tuple_size; c++) {
+    steps[c] = array.extent(c) / max_value;
+  }
+
+  size_t num_values = array.values_size() - array.values_size() % tuple_size;
+  output.resize(num_values);
+
+  const MeshDecoder& decoder = GetMeshDecoder();
+  if constexpr (std::is_same_v<T, float>) {
+    decoder.dequantize_float(array.values().data(), num_values,
+                             array.min().data(), steps.data(), tuple_size,
+                             output.data());
+  } else {
+    decoder.dequantize_double(array.values().data(), num_values,
+                              array.min().data(), steps.data(), tuple_size,
+                              output.data());
+  }
+}
+
+template <typename T>
+void DecodeOctahedralInto(const OctahedralArray& array,
+                          std::vector<T>& output) {
+  output.clear();
+
+  if (array.bits() < 2 || array.bits() > 32) {
+    return;
+  }
+
+  size_t num_directions = array.values_size() / kOctahedralComponents;
+  output.resize(num_directions * kDirectionComponents);
+
+  T zero = static_cast<T>(OctahedralZero(array.bits()));
+  T scale = T(1.0) / zero;
+
+  const MeshDecoder& decoder = GetMeshDecoder();
+  if constexpr (std::is_same_v<T, float>) {
+    decoder.decode_octahedral_float(array.values().data(), num_directions,
+                                    zero, scale, output.data());
+  } else {
+    decoder.decode_octahedral_double(array.values().data(), num_directions,
+                                     zero, scale, output.data());
+  }
+}
+
+// Returns the angle in radians between the unit vectors `a` and `b`
+double AngleBetween(const double* a, const double* b) {
+  double difference = 0.0, sum = 0.0;
+  for (size_t c = 0; c < kDirectionComponents; c++) {
+    difference += (a[c] - b[c]) * (a[c] - b[c]);
+    sum += (a[c] + b[c]) * (a[c] + b[c]);
+  }
+
+  return 2.0 * std::atan2(std::sqrt(difference), std::sqrt(sum));
+}
+
+}  // namespace
+
+bool Quantize(absl::Span<const double> values, size_t tuple_size,
+              uint32_t bits, QuantizedArray& output) {
+  if (values.empty() || tuple_size == 0 || values.size() % tuple_size != 0) {
+    return false;
+  }
+
+  std::vector<double> mins(values.begin(), values.begin() + tuple_size);
+  std::vector<double> maxes = mins;
+  for (size_t i = 0; i < values.size(); i++) {
+    if (!std::isfinite(values[i])) {
+      return false;
+    }
+
+    mins[i % tuple_size] = std::min(mins[i % tuple_size], values[i]);
+    maxes[i % tuple_size] = std::max(maxes[i % tuple_size], values[i]);
+  }
+
+  std::vector<double> extents(tuple_size);
+  for (size_t c = 0; c < tuple_size; c++) {
+    extents[c] = maxes[c] - mins[c];
+    if (!std::isfinite(extents[c])) {
+      return false;
+    }
+  }
+
+  output.Clear();
+  output.set_bits(bits);
+  output.mutable_min()->Add(mins.begin(), mins.end());
+  output.mutable_extent()->Add(extents.begin(), extents.end());
+  output.mutable_values()->Reserve(static_cast<int>(values.size()));
+
+  double max_value = MaxQuantized(bits);
+  double max_error = 0.0;
+  for (size_t i = 0; i < values.size(); i++) {
+    size_t c = i % tuple_size;
+
+    double quantized = 0.0;
+    if (extents[c] > 0.0) {
+      quantized = std::min(
+          std::round((values[i] - mins[c]) / extents[c] * max_value),
+          max_value);
+    }
+
+    // Measured against the value exactly as `Dequantize` decodes it
+    double decoded = mins[c] + quantized * (extents[c] / max_value);
+    max_error = std::max(max_error, std::abs(decoded - values[i]));
+
+    output.mutable_values()->AddAlreadyReserved(
+        static_cast<uint32_t>(quantized));
+  }
+
+  output.set_max_error(max_error);
+
+  return true;
+}
+
+bool EncodeOctahedral(absl::Span<const double> xyz, uint32_t bits,
+                      OctahedralArray& output) {
+  if (xyz.empty() || xyz.size() % kDirectionComponents != 0) {
+    return false;
+  }
+
+  std::vector<uint32_t> values;
+  values.reserve(xyz.size() / kDirectionComponents * kOctahedralComponents);
+
+  double zero = OctahedralZero(bits);
+  double max_error = 0.0;
+  for (size_t i = 0; i < xyz.size(); i += kDirectionComponents) {
+    double length = std::hypot(xyz[i], xyz[i + 1], xyz[i + 2]);
+    if (!(length > 0.0) || !std::isfinite(length)) {
+      return false;
+    }
+
+    double direction[kDirectionComponents] = {
+        xyz[i] / length, xyz[i + 1] / length, xyz[i + 2] / length};
+
+    double l1_norm = std::abs(direction[0]) + std::abs(direction[1]) +
+                     std::abs(direction[2]);
+    double x = direction[0] / l1_norm;
+    double y = direction[1] / l1_norm;
+    if (direction[2] < 0.0) {
+      double folded_x = (1.0 - std::abs(y)) * SignNotZero(x);
+      double folded_y = (1.0 - std::abs(x)) * SignNotZero(y);
+      x = folded_x;
+      y = folded_y;
+    }
+
+    double quantized_x = std::round(x * zero) + zero;
+    double quantized_y = std::round(y * zero) + zero;
+
+    double decoded[kDirectionComponents];
+    Unfold(std::clamp((quantized_x - zero) / zero, -1.0, 1.0),
+           std::clamp((quantized_y - zero) / zero, -1.0, 1.0), decoded);
+    max_error = std::max(max_error, AngleBetween(direction, decoded));
+
+    values.push_back(static_cast<uint32_t>(quantized_x));
+    values.push_back(static_cast<uint32_t>(quantized_y));
+  }
+
+  output.Clear();
+  output.set_bits(bits);
+  output.mutable_values()->Add(values.begin(), values.end());
+  output.set_max_error(max_error);
+
+  return true;
+}
+
+void DeltaEncode(absl::Span<const uint32_t> values,
+                 google::protobuf::RepeatedField<int32_t>& output) {
+  output.Reserve(output.size() + static_cast<int>(values.size()));
+
+  uint32_t previous = 0;
+  for (uint32_t value : values) {
+    output.AddAlreadyReserved(static_cast<int32_t>(value - previous));
+    previous = value;
+  }
+}
+
+void Dequantize(const QuantizedArray& array, std::vector<double>& output) {
+  DequantizeInto(array, output);
+}
+
+void Dequantize(const QuantizedArray& array, std::vector<float>& output) {
+  DequantizeInto(array, output);
+}
+
+void DecodeOctahedral(const OctahedralArray& array,
+                      std::vector<double>& output) {
+  DecodeOctahedralInto(array, output);
+}
+
+void DecodeOctahedral(const OctahedralArray& array,
+                      std::vector<float>& output) {
+  DecodeOctahedralInto(array, output);
+}
+
+void DeltaDecode(absl::Span<const int32_t> deltas,
+                 std::vector<uint32_t>& output) {
+  output.resize(deltas.size());
+  GetMeshDecoder().delta_decode(deltas.data(), deltas.size(), output.data());
+}
+
+const MeshDecoder* absl_nullable GetMeshDecoder(MeshDecoderKernel kernel) {
+  switch (kernel) {
+    case MeshDecoderKernel::SCALAR:
+      return &kScalarDecoder;
+#ifdef PBRT_PROTO_COMPRESSION_X86
+    case MeshDecoderKernel::AVX2: {
+      static const bool supports_avx2 = CpuSupportsAvx2();
+      return supports_avx2 ? &kAvx2Decoder : nullptr;
+    }
+#else
+    case MeshDecoderKernel::AVX2:
+      break;
+#endif
+  }
+
+  return nullptr;
+}
+
+const MeshDecoder& GetMeshDecoder() {
+  static const MeshDecoder* const decoder = []() {
+    if (const MeshDecoder* decoder = GetMeshDecoder(MeshDecoderKernel::AVX2);
+        decoder != nullptr) {
+      return decoder;
+    }
+    return &kScalarDecoder;
+  }();
+
+  return *decoder;
+}
+
+}  // namespace pbrt_proto
@@ -0,0 +1,104 @@
+#ifndef _PBRT_PROTO_SHARED_COMPRESSION_
+#define _PBRT_PROTO_SHARED_COMPRESSION_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/base/nullability.h"
+#include "absl/types/span.h"
+#include "google/protobuf/repeated_field.h"
+#include "pbrt_proto/pbrt.pb.h"
+
+namespace pbrt_proto {
+
+// The precision of the lossy encodings used to compress a mesh.
+struct MeshCompressionOptions {
+  // The number of bits each component of a position is quantized to, between
+  // 1 and 32.
+  uint32_t position_bits = 16;
+
+  // The number of bits each octahedral coordinate of a normal or tangent is
+  // quantized to, between 2 and 32.
+  uint32_t direction_bits = 12;
+
+  // The number of bits each texture coordinate is quantized to, between 1 and
+  // 32.
+  uint32_t uv_bits = 16;
+};
+
+// Quantizes `values`, which are consecutive tuples of `tuple_size` components,
+// into `output`. Returns false and leaves `output` unchanged if `values` is
+// empty, is not a whole number of tuples, or contains a value that is not
+// finite, or if the range of a component does not fit in a double. `bits` must
+// be between 1 and 32.
+bool Quantize(absl::Span<const double> values, size_t tuple_size,
+              uint32_t bits, QuantizedArray& output);
+
+// Encodes `xyz`, which are consecutive x, y, and z components of directions,
+// into `output`. Returns false and leaves `output` unchanged if `xyz` is empty,
+// is not a whole number of directions, or contains a direction that is zero or
+// not finite, none of which can be represented. `bits` must be between 2 and
+// 32.
+bool EncodeOctahedral(absl::Span<const double> xyz, uint32_t bits,
+                      OctahedralArray& output);
+
+// Appends the differences between consecutive `values` to `output` as
+// described for `TriangleMeshShape.indices_delta`.
+void DeltaEncode(absl::Span<const uint32_t> values,
+                 google::protobuf::RepeatedField<int32_t>& output);
+
+// Decoders that replace the contents of `output` with the decoded values using
+// the kernels of `GetMeshDecoder()`. If an array is malformed, `output` is left
+// empty.
+void Dequantize(const QuantizedArray& array, std::vector<double>& output);
+void Dequantize(const QuantizedArray& array, std::vector<float>& output);
+void DecodeOctahedral(const OctahedralArray& array,
+                      std::vector<double>& output);
+void DecodeOctahedral(const OctahedralArray& array,
+                      std::vector<float>& output);
+void DeltaDecode(absl::Span<const int32_t> deltas,
+                 std::vector<uint32_t>& output);
+
+// Kernels that decode the arrays of a mesh into `out`, which must have room for
+// every value decoded. Every kernel decodes exactly the same values.
+struct MeshDecoder {
+  // Decodes the first `num_values` of `values`, which are consecutive tuples of
+  // `tuple_size` components, as `mins[c] + values[i] * steps[c]` where `c` is
+  // the component of `values[i]`.
+  void (*dequantize_double)(const uint32_t* values, size_t num_values,
+                            const double* mins, const double* steps,
+                            size_t tuple_size, double* out);
+  void (*dequantize_float)(const uint32_t* values, size_t num_values,
+                           const double* mins, const double* steps,
+                           size_t tuple_size, float* out);
+
+  // Decodes the first `num_directions` pairs of octahedral coordinates in
+  // `values` into the x, y, and z components of unit directions. `zero` is the
+  // value of a coordinate of zero and `scale` is its reciprocal.
+  void (*decode_octahedral_double)(const uint32_t* values,
+                                   size_t num_directions, double zero,
+                                   double scale, double* out);
+  void (*decode_octahedral_float)(const uint32_t* values,
+                                  size_t num_directions, float zero,
+                                  float scale, float* out);
+
+  // Writes the running sums of the first `size` of `deltas`
+  void (*delta_decode)(const int32_t* deltas, size_t size, uint32_t* out);
+};
+
+enum class MeshDecoderKernel {
+  SCALAR,  // Portable
+  AVX2,
+};
+
+// Returns the implementation of `kernel` or nullptr if it is not supported by
+// either the current build or the current CPU.
+const MeshDecoder* absl_nullable GetMeshDecoder(MeshDecoderKernel kernel);
+
+// Returns the fastest implementation supported by the current CPU.
+const MeshDecoder& GetMeshDecoder();
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_COMPRESSION_
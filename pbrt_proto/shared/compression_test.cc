@@ -0,0 +1,343 @@
+#include "pbrt_proto/shared/compression.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/repeated_field.h"
+#include "gtest/gtest.h"
+#include "pbrt_proto/pbrt.pb.h"
+#include "pbrt_proto/testing/proto_matchers.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::google::protobuf::EqualsProto;
+using ::google::protobuf::ParseTextOrDie;
+using ::google::protobuf::RepeatedField;
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::FloatNear;
+using ::testing::IsEmpty;
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+constexpr double kMaxDouble = std::numeric_limits<double>::max();
+
+TEST(Quantize, Rejects) {
+  QuantizedArray output = ParseTextOrDie(R"pb(bits: 7)pb");
+  EXPECT_FALSE(Quantize({}, 1, 8, output));
+  EXPECT_FALSE(Quantize({1.0, 2.0, 3.0}, 2, 8, output));
+  EXPECT_FALSE(Quantize({1.0, kInfinity}, 1, 8, output));
+  EXPECT_FALSE(Quantize({1.0, std::nan("")}, 1, 8, output));
+  EXPECT_FALSE(Quantize({-kMaxDouble, kMaxDouble}, 1, 8, output));
+  EXPECT_THAT(output, EqualsProto(R"pb(bits: 7)pb"));
+}
+
+TEST(Quantize, Values) {
+  QuantizedArray output;
+  ASSERT_TRUE(Quantize({1.0, 5.0, 2.0, 5.0, 3.0, 5.0}, 2, 2, output));
+  EXPECT_EQ(2u, output.bits());
+  EXPECT_THAT(output.min(), ElementsAre(1.0, 5.0));
+  EXPECT_THAT(output.extent(), ElementsAre(2.0, 0.0));
+  EXPECT_THAT(output.values(), ElementsAre(0u, 0u, 2u, 0u, 3u, 0u));
+  EXPECT_NEAR(1.0 / 3.0, output.max_error(), 1e-15);
+
+  std::vector<double> decoded;
+  Dequantize(output, decoded);
+  EXPECT_THAT(decoded,
+              ElementsAre(1.0, 5.0, DoubleNear(2.0 + 1.0 / 3.0, 1e-15), 5.0,
+                          3.0, 5.0));
+
+  std::vector<float> decoded_f32;
+  Dequantize(output, decoded_f32);
+  EXPECT_THAT(decoded_f32,
+              ElementsAre(1.0f, 5.0f, FloatNear(2.3333333f, 1e-6f), 5.0f,
+                          3.0f, 5.0f));
+}
+
+TEST(Quantize, ErrorBound) {
+  std::vector<double> values;
+  for (int i = 0; i < 1000; i++) {
+    values.push_back(std::sin(i) * 100.0);
+  }
+
+  for (uint32_t bits : {1u, 8u, 16u, 32u}) {
+    QuantizedArray output;
+    ASSERT_TRUE(Quantize(values, 1, bits, output));
+
+    // Within half a step of the original
+    double step = output.extent(0) / (std::ldexp(1.0, bits) - 1.0);
+    EXPECT_LE(output.max_error(), step / 2.0 + 1e-12);
+
+    std::vector<double> decoded;
+    Dequantize(output, decoded);
+    ASSERT_EQ(values.size(), decoded.size());
+    for (size_t i = 0; i < values.size(); i++) {
+      EXPECT_LE(std::abs(decoded[i] - values[i]), output.max_error());
+    }
+  }
+}
+
+TEST(Dequantize, Malformed) {
+  std::vector<double> decoded = {1.0};
+  Dequantize(ParseTextOrDie(R"pb(bits: 8 values: [ 1, 2 ])pb"), decoded);
+  EXPECT_THAT(decoded, IsEmpty());
+
+  Dequantize(ParseTextOrDie(R"pb(
+               min: [ 0.0 ] extent: [ 1.0, 1.0 ] bits: 8 values: [ 1 ]
+             )pb"),
+             decoded);
+  EXPECT_THAT(decoded, IsEmpty());
+
+  Dequantize(ParseTextOrDie(R"pb(
+               min: [ 0.0 ] extent: [ 1.0 ] bits: 33 values: [ 1 ]
+             )pb"),
+             decoded);
+  EXPECT_THAT(decoded, IsEmpty());
+
+  // Trailing partial tuples are dropped
+  Dequantize(ParseTextOrDie(R"pb(
+               min: [ 0.0, 0.0 ]
+               extent: [ 3.0, 3.0 ]
+               bits: 2
+               values: [ 1, 2, 3 ]
+             )pb"),
+             decoded);
+  EXPECT_THAT(decoded, ElementsAre(1.0, 2.0));
+}
+
+TEST(EncodeOctahedral, Rejects) {
+  OctahedralArray output = ParseTextOrDie(R"pb(bits: 7)pb");
+  EXPECT_FALSE(EncodeOctahedral({}, 12, output));
+  EXPECT_FALSE(EncodeOctahedral({1.0, 0.0}, 12, output));
+  EXPECT_FALSE(EncodeOctahedral({0.0, 0.0, 0.0}, 12, output));
+  EXPECT_FALSE(EncodeOctahedral({kInfinity, 0.0, 0.0}, 12, output));
+  EXPECT_THAT(output, EqualsProto(R"pb(bits: 7)pb"));
+}
+
+TEST(EncodeOctahedral, Axes) {
+  std::vector<double> axes = {1.0,  0.0, 0.0, -2.0, 0.0, 0.0,
+                              0.0,  3.0, 0.0, 0.0,  -4.0, 0.0,
+                              0.0,  0.0, 5.0, 0.0,  0.0, -6.0};
+
+  OctahedralArray output;
+  ASSERT_TRUE(EncodeOctahedral(axes, 4, output));
+  EXPECT_EQ(4u, output.bits());
+  EXPECT_EQ(0.0, output.max_error());
+
+  std::vector<double> decoded;
+  DecodeOctahedral(output, decoded);
+  EXPECT_THAT(decoded, ElementsAre(1.0, 0.0, 0.0, -1.0, 0.0, 0.0,  //
+                                   0.0, 1.0, 0.0, 0.0, -1.0, 0.0,  //
+                                   0.0, 0.0, 1.0, 0.0, 0.0, -1.0));
+}
+
+TEST(EncodeOctahedral, ErrorBound) {
+  std::vector<double> directions;
+  for (int i = 0; i < 1000; i++) {
+    directions.push_back(std::sin(i));
+    directions.push_back(std::cos(i * 3));
+    directions.push_back(std::sin(i * 7 + 1));
+  }
+
+  OctahedralArray output;
+  ASSERT_TRUE(EncodeOctahedral(directions, 12, output));
+  EXPECT_LT(0.0, output.max_error());
+  EXPECT_GT(0.002, output.max_error());
+
+  std::vector<double> decoded;
+  DecodeOctahedral(output, decoded);
+  ASSERT_EQ(directions.size(), decoded.size());
+
+  std::vector<float> decoded_f32;
+  DecodeOctahedral(output, decoded_f32);
+  ASSERT_EQ(directions.size(), decoded_f32.size());
+
+  for (size_t i = 0; i < directions.size(); i += 3) {
+    double length = std::hypot(directions[i], directions[i + 1],
+                               directions[i + 2]);
+    double cosine = (directions[i] * decoded[i] +
+                     directions[i + 1] * decoded[i + 1] +
+                     directions[i + 2] * decoded[i + 2]) /
+                    length;
+    EXPECT_GE(cosine, std::cos(output.max_error()) - 1e-12);
+    EXPECT_NEAR(1.0, std::hypot(decoded[i], decoded[i + 1], decoded[i + 2]),
+                1e-12);
+    EXPECT_NEAR(decoded[i], decoded_f32[i], 1e-6);
+  }
+}
+
+TEST(DecodeOctahedral, Malformed) {
+  std::vector<double> decoded = {1.0};
+  DecodeOctahedral(ParseTextOrDie(R"pb(bits: 1 values: [ 0, 0 ])pb"),
+                   decoded);
+  EXPECT_THAT(decoded, IsEmpty());
+
+  // Out of range values are clamped
+  DecodeOctahedral(ParseTextOrDie(R"pb(bits: 2 values: [ 3, 1, 0 ])pb"),
+                   decoded);
+  EXPECT_THAT(decoded, ElementsAre(1.0, 0.0, 0.0));
+}
+
+TEST(DeltaEncode, RoundTrip) {
+  std::vector<uint32_t> values = {5u, 3u, 0xFFFFFFFFu, 0u, 0u};
+
+  RepeatedField<int32_t> deltas;
+  deltas.Add(7);
+  DeltaEncode(values, deltas);
+  EXPECT_THAT(deltas, ElementsAre(7, 5, -2, -4, 1, 0));
+
+  std::vector<uint32_t> decoded = {9u};
+  DeltaDecode(absl::MakeConstSpan(deltas.data() + 1, values.size()), decoded);
+  EXPECT_EQ(values, decoded);
+}
+
+std::vector<const MeshDecoder*> SupportedDecoders() {
+  std::vector<const MeshDecoder*> result;
+  for (MeshDecoderKernel kernel :
+       {MeshDecoderKernel::SCALAR, MeshDecoderKernel::AVX2}) {
+    if (const MeshDecoder* decoder = GetMeshDecoder(kernel);
+        decoder != nullptr) {
+      result.push_back(decoder);
+    }
+  }
+  return result;
+}
+
+// Compares the bits of the values, so that the sign of zero must match too
+template <typename T>
+bool SameBits(const std::vector<T>& a, const std::vector<T>& b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0;
+}
+
+TEST(MeshDecoder, DefaultIsSupported) {
+  const MeshDecoder& decoder = GetMeshDecoder();
+  EXPECT_TRUE(&decoder == GetMeshDecoder(MeshDecoderKernel::SCALAR) ||
+              &decoder == GetMeshDecoder(MeshDecoderKernel::AVX2));
+}
+
+TEST(MeshDecoder, ScalarIsAlwaysSupported) {
+  EXPECT_NE(nullptr, GetMeshDecoder(MeshDecoderKernel::SCALAR));
+}
+
+// Lengths in these tests run past several whole vectors so that the values left
+// after them are decoded too
+TEST(MeshDecoder, DequantizeMatchesScalar) {
+  const MeshDecoder& scalar = *GetMeshDecoder(MeshDecoderKernel::SCALAR);
+
+  std::mt19937 random(1);
+  std::uniform_int_distribution<uint32_t> value;
+  std::uniform_real_distribution<double> real(-1.0, 1.0);
+  for (size_t tuple_size = 1; tuple_size <= 4; tuple_size++) {
+    // The last component overflows a float, which must be clamped
+    std::vector<double> mins(tuple_size), steps(tuple_size);
+    for (size_t c = 0; c < tuple_size; c++) {
+      mins[c] = real(random) * 100.0;
+      steps[c] = real(random) / 1000.0;
+    }
+    steps.back() = 1e300;
+
+    for (size_t num_values = 0; num_values <= 64; num_values += tuple_size) {
+      std::vector<uint32_t> values(num_values);
+      for (uint32_t& v : values) {
+        v = value(random);
+      }
+
+      std::vector<double> expected_double(num_values);
+      std::vector<float> expected_float(num_values);
+      scalar.dequantize_double(values.data(), num_values, mins.data(),
+                               steps.data(), tuple_size,
+                               expected_double.data());
+      scalar.dequantize_float(values.data(), num_values, mins.data(),
+                              steps.data(), tuple_size, expected_float.data());
+
+      for (const MeshDecoder* decoder : SupportedDecoders()) {
+        std::vector<double> decoded_double(num_values);
+        std::vector<float> decoded_float(num_values);
+        decoder->dequantize_double(values.data(), num_values, mins.data(),
+                                   steps.data(), tuple_size,
+                                   decoded_double.data());
+        decoder->dequantize_float(values.data(), num_values, mins.data(),
+                                  steps.data(), tuple_size,
+                                  decoded_float.data());
+        EXPECT_TRUE(SameBits(expected_double, decoded_double))
+            << "tuple_size: " << tuple_size << " num_values: " << num_values;
+        EXPECT_TRUE(SameBits(expected_float, decoded_float))
+            << "tuple_size: " << tuple_size << " num_values: " << num_values;
+      }
+    }
+  }
+}
+
+TEST(MeshDecoder, DecodeOctahedralMatchesScalar) {
+  const MeshDecoder& scalar = *GetMeshDecoder(MeshDecoderKernel::SCALAR);
+
+  std::mt19937 random(2);
+  for (uint32_t bits : {2u, 3u, 12u, 24u, 25u, 32u}) {
+    // Values past the largest one encoded must be clamped
+    std::uniform_int_distribution<uint32_t> value(
+        0, bits == 32 ? 0xFFFFFFFFu : (1u << bits));
+    double zero = std::ldexp(1.0, bits - 1) - 1.0;
+
+    for (size_t num_directions = 0; num_directions <= 40; num_directions++) {
+      std::vector<uint32_t> values(2 * num_directions);
+      for (uint32_t& v : values) {
+        v = value(random);
+      }
+
+      std::vector<double> expected_double(3 * num_directions);
+      std::vector<float> expected_float(3 * num_directions);
+      scalar.decode_octahedral_double(values.data(), num_directions, zero,
+                                      1.0 / zero, expected_double.data());
+      scalar.decode_octahedral_float(
+          values.data(), num_directions, static_cast<float>(zero),
+          1.0f / static_cast<float>(zero), expected_float.data());
+
+      for (const MeshDecoder* decoder : SupportedDecoders()) {
+        std::vector<double> decoded_double(3 * num_directions);
+        std::vector<float> decoded_float(3 * num_directions);
+        decoder->decode_octahedral_double(values.data(), num_directions, zero,
+                                          1.0 / zero, decoded_double.data());
+        decoder->decode_octahedral_float(
+            values.data(), num_directions, static_cast<float>(zero),
+            1.0f / static_cast<float>(zero), decoded_float.data());
+        EXPECT_TRUE(SameBits(expected_double, decoded_double))
+            << "bits: " << bits << " num_directions: " << num_directions;
+        EXPECT_TRUE(SameBits(expected_float, decoded_float))
+            << "bits: " << bits << " num_directions: " << num_directions;
+      }
+    }
+  }
+}
+
+TEST(MeshDecoder, DeltaDecodeMatchesScalar) {
+  const MeshDecoder& scalar = *GetMeshDecoder(MeshDecoderKernel::SCALAR);
+
+  std::mt19937 random(3);
+  std::uniform_int_distribution<int32_t> delta(
+      std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::max());
+  for (size_t size = 0; size <= 40; size++) {
+    std::vector<int32_t> deltas(size);
+    for (int32_t& d : deltas) {
+      d = delta(random);
+    }
+
+    std::vector<uint32_t> expected(size);
+    scalar.delta_decode(deltas.data(), size, expected.data());
+
+    for (const MeshDecoder* decoder : SupportedDecoders()) {
+      std::vector<uint32_t> decoded(size);
+      decoder->delta_decode(deltas.data(), size, decoded.data());
+      EXPECT_EQ(expected, decoded) << "size: " << size;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace pbrt_proto
@@ -0,0 +1,33 @@
+#include "pbrt_proto/shared/cpu.h"
+
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace pbrt_proto {
+
+bool CpuSupportsAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__) && defined(_M_X64)
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+
+  __cpuid(info, 1);
+  bool os_saves_ymm = (info[2] & (1 << 27)) != 0;  // OSXSAVE
+  if (!os_saves_ymm || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#elif defined(__x86_64__)
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+}  // namespace pbrt_proto
@@ -0,0 +1,12 @@
+#ifndef _PBRT_PROTO_SHARED_CPU_
+#define _PBRT_PROTO_SHARED_CPU_
+
+namespace pbrt_proto {
+
+// Returns true if the current CPU and operating system support AVX2. Always
+// false on targets other than x86-64.
+bool CpuSupportsAvx2();
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_CPU_
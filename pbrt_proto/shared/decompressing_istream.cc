@@ -0,0 +1,298 @@
+#include "pbrt_proto/shared/decompressing_istream.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <memory>
+#include <streambuf>
+
+#include "absl/base/nullability.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "zlib.h"
+#include "zstd.h"
+
+namespace pbrt_proto {
+namespace {
+
+constexpr size_t kInputChunkSize = 1 << 18;
+constexpr size_t kOutputChunkSize = 1 << 18;
+
+constexpr absl::string_view kGzipMagic("\x1F\x8B", 2);
+constexpr absl::string_view kZstdMagic("\x28\xB5\x2F\xFD", 4);
+
+enum class Format {
+  UNKNOWN,
+  NONE,
+  GZIP,
+  ZSTD,
+};
+
+Format DetectFormat(absl::string_view prefix) {
+  if (prefix.substr(0, kGzipMagic.size()) == kGzipMagic) {
+    return Format::GZIP;
+  }
+
+  if (prefix.substr(0, kZstdMagic.size()) == kZstdMagic) {
+    return Format::ZSTD;
+  }
+
+  return Format::NONE;
+}
+
+}  // namespace
+
+bool IsCompressed(absl::string_view prefix) {
+  return DetectFormat(prefix) != Format::NONE;
+}
+
+class DecompressingIstream::Streambuf : public std::streambuf {
+ public:
+  explicit Streambuf(std::istream& input) : input_(&input) {}
+
+  explicit Streambuf(absl::string_view input)
+      : input_(nullptr),
+        in_pos_(input.data()),
+        in_end_(input.data() + input.size()),
+        input_done_(true) {}
+
+  ~Streambuf() override {
+    if (zlib_initialized_) {
+      inflateEnd(&zlib_);
+    }
+
+    if (zstd_ != nullptr) {
+      ZSTD_freeDStream(zstd_);
+    }
+  }
+
+  const absl::Status& status() const { return status_; }
+
+ protected:
+  int_type underflow() override;
+
+ private:
+  bool Start();
+  void FillInput();
+  size_t Inflate();
+  size_t DecompressZstd();
+
+  // Compressed input is either read from `input_` into `input_chunk_` or
+  // read directly from an in-memory buffer
+  std::istream* absl_nullable input_;  // Not owned
+  std::unique_ptr<char[]> input_chunk_;
+  const char* absl_nullable in_pos_ = nullptr;
+  const char* absl_nullable in_end_ = nullptr;
+  bool input_done_ = false;
+
+  Format format_ = Format::UNKNOWN;
+  z_stream zlib_;
+  bool zlib_initialized_ = false;
+  ZSTD_DStream* absl_nullable zstd_ = nullptr;
+
+  // Set when the most recent gzip member or zstd frame has been fully decoded
+  bool frame_complete_ = false;
+
+  std::unique_ptr<char[]> output_;
+  absl::Status status_;
+};
+
+void DecompressingIstream::Streambuf::FillInput() {
+  if (input_done_ || in_pos_ != in_end_) {
+    return;
+  }
+
+  if (!input_chunk_) {
+    input_chunk_ = std::make_unique<char[]>(kInputChunkSize);
+  }
+
+  input_->read(input_chunk_.get(), kInputChunkSize);
+  size_t read = static_cast<size_t>(input_->gcount());
+
+  in_pos_ = input_chunk_.get();
+  in_end_ = in_pos_ + read;
+
+  if (input_->bad()) {
+    status_ = absl::DataLossError("Could not read input");
+    input_done_ = true;
+  } else if (read < kInputChunkSize) {
+    input_done_ = true;
+  }
+}
+
+bool DecompressingIstream::Streambuf::Start() {
+  FillInput();
+  if (!status_.ok()) {
+    return false;
+  }
+
+  format_ = DetectFormat(absl::string_view(in_pos_, in_end_ - in_pos_));
+
+  switch (format_) {
+    case Format::UNKNOWN:
+    case Format::NONE:
+      break;
+    case Format::GZIP:
+      std::memset(&zlib_, 0, sizeof(zlib_));
+      if (inflateInit2(&zlib_, 16 + MAX_WBITS) != Z_OK) {
+        status_ = absl::InternalError("Could not initialize gzip decoder");
+        return false;
+      }
+      zlib_initialized_ = true;
+      output_ = std::make_unique<char[]>(kOutputChunkSize);
+      break;
+    case Format::ZSTD:
+      zstd_ = ZSTD_createDStream();
+      if (zstd_ == nullptr || ZSTD_isError(ZSTD_initDStream(zstd_))) {
+        status_ = absl::InternalError("Could not initialize zstd decoder");
+        return false;
+      }
+      output_ = std::make_unique<char[]>(kOutputChunkSize);
+      break;
+  }
+
+  return true;
+}
+
+size_t DecompressingIstream::Streambuf::Inflate() {
+  // Concatenated gzip members are decoded as a single stream. Anything else
+  // after a member, such as the zero padding left by some tools, is ignored
+  // as gzip itself does. If only the first byte of the next member is in the
+  // current chunk of input, the decoder checks the rest of its header.
+  if (frame_complete_) {
+    if (in_pos_ == in_end_) {
+      return 0;
+    }
+
+    absl::string_view rest(
+        in_pos_, std::min<size_t>(in_end_ - in_pos_, kGzipMagic.size()));
+    if (rest != kGzipMagic.substr(0, rest.size()) ||
+        (rest.size() < kGzipMagic.size() && input_done_)) {
+      in_pos_ = in_end_;
+      input_done_ = true;
+      return 0;
+    }
+
+    inflateReset(&zlib_);
+    frame_complete_ = false;
+  }
+
+  zlib_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in_pos_));
+  // zlib counts input in a uInt, so mapped input larger than that is fed to it
+  // over several calls
+  zlib_.avail_in = static_cast<uInt>(std::min<size_t>(
+      in_end_ - in_pos_, std::numeric_limits<uInt>::max()));
+  zlib_.next_out = reinterpret_cast<Bytef*>(output_.get());
+  zlib_.avail_out = static_cast<uInt>(kOutputChunkSize);
+
+  int result = inflate(&zlib_, Z_NO_FLUSH);
+  in_pos_ = reinterpret_cast<const char*>(zlib_.next_in);
+
+  if (result == Z_STREAM_END) {
+    frame_complete_ = true;
+  } else if (result != Z_OK && result != Z_BUF_ERROR) {
+    status_ = absl::DataLossError(
+        absl::StrCat("Invalid gzip input: ",
+                     zlib_.msg != nullptr ? zlib_.msg : "Unknown error"));
+    return 0;
+  }
+
+  return kOutputChunkSize - zlib_.avail_out;
+}
+
+size_t DecompressingIstream::Streambuf::DecompressZstd() {
+  // Concatenated frames are decoded as a single stream
+  if (frame_complete_ && in_pos_ == in_end_) {
+    return 0;
+  }
+
+  ZSTD_inBuffer in = {in_pos_, static_cast<size_t>(in_end_ - in_pos_), 0};
+  ZSTD_outBuffer out = {output_.get(), kOutputChunkSize, 0};
+
+  size_t result = ZSTD_decompressStream(zstd_, &out, &in);
+  in_pos_ += in.pos;
+
+  if (ZSTD_isError(result)) {
+    status_ = absl::DataLossError(
+        absl::StrCat("Invalid zstd input: ", ZSTD_getErrorName(result)));
+    return 0;
+  }
+
+  frame_complete_ = result == 0;
+
+  return out.pos;
+}
+
+DecompressingIstream::Streambuf::int_type
+DecompressingIstream::Streambuf::underflow() {
+  if (gptr() < egptr()) {
+    return traits_type::to_int_type(*gptr());
+  }
+
+  if (format_ == Format::UNKNOWN && !Start()) {
+    return traits_type::eof();
+  }
+
+  while (status_.ok()) {
+    FillInput();
+    if (!status_.ok()) {
+      break;
+    }
+
+    size_t produced = 0;
+    switch (format_) {
+      case Format::UNKNOWN:
+      case Format::NONE:
+        // Uncompressed input is returned directly from the input buffer
+        if (in_pos_ == in_end_) {
+          return traits_type::eof();
+        }
+
+        setg(const_cast<char*>(in_pos_), const_cast<char*>(in_pos_),
+             const_cast<char*>(in_end_));
+        in_pos_ = in_end_;
+        return traits_type::to_int_type(*gptr());
+      case Format::GZIP:
+        produced = Inflate();
+        break;
+      case Format::ZSTD:
+        produced = DecompressZstd();
+        break;
+    }
+
+    if (produced != 0) {
+      setg(output_.get(), output_.get(), output_.get() + produced);
+      return traits_type::to_int_type(*gptr());
+    }
+
+    if (status_.ok() && in_pos_ == in_end_ && input_done_) {
+      if (!frame_complete_) {
+        status_ = absl::DataLossError("Compressed input is truncated");
+      }
+      break;
+    }
+  }
+
+  return traits_type::eof();
+}
+
+DecompressingIstream::DecompressingIstream(std::istream& input)
+    : std::istream(nullptr), streambuf_(std::make_unique<Streambuf>(input)) {
+  rdbuf(streambuf_.get());
+}
+
+DecompressingIstream::DecompressingIstream(absl::string_view input)
+    : std::istream(nullptr), streambuf_(std::make_unique<Streambuf>(input)) {
+  rdbuf(streambuf_.get());
+}
+
+DecompressingIstream::~DecompressingIstream() = default;
+
+const absl::Status& DecompressingIstream::status() const {
+  return streambuf_->status();
+}
+
+}  // namespace pbrt_proto
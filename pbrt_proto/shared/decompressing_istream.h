@@ -0,0 +1,50 @@
+#ifndef _PBRT_PROTO_SHARED_DECOMPRESSING_ISTREAM_
+#define _PBRT_PROTO_SHARED_DECOMPRESSING_ISTREAM_
+
+#include <istream>
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+
+namespace pbrt_proto {
+
+// Returns true if `prefix`, the start of an input, begins with the magic number
+// of a compression format supported by `DecompressingIstream`.
+bool IsCompressed(absl::string_view prefix);
+
+// An input stream that transparently decompresses gzip or zstd compressed
+// input as it is read. The format is detected from the magic number at the
+// start of the input, and input in any other format is passed through
+// unchanged.
+//
+// Errors reading or decompressing the input end the stream early and are
+// reported by `status()`.
+class DecompressingIstream : public std::istream {
+ public:
+  // Reads compressed input from `input` incrementally.
+  //
+  // NOTE: `input` is not owned
+  explicit DecompressingIstream(std::istream& input);
+
+  // Reads compressed input from an in-memory buffer.
+  //
+  // NOTE: `input` is not owned and must outlive the stream
+  explicit DecompressingIstream(absl::string_view input);
+
+  ~DecompressingIstream() override;
+
+  DecompressingIstream(const DecompressingIstream&) = delete;
+  DecompressingIstream& operator=(const DecompressingIstream&) = delete;
+
+  const absl::Status& status() const;
+
+ private:
+  class Streambuf;
+
+  std::unique_ptr<Streambuf> streambuf_;
+};
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_DECOMPRESSING_ISTREAM_
@@ -0,0 +1,186 @@
+#include "pbrt_proto/shared/decompressing_istream.h"
+
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/status_matchers.h"
+#include "absl/strings/string_view.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "googletest/include/gtest/gtest.h"
+#include "zlib.h"
+#include "zstd.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::absl_testing::IsOk;
+using ::absl_testing::StatusIs;
+
+std::string MakeInput(size_t size) {
+  std::string result;
+  for (size_t i = 0; result.size() < size; i++) {
+    result += "Shape \"sphere\" \"float radius\" " + std::to_string(i) + "\n";
+  }
+  result.resize(size);
+  return result;
+}
+
+std::string Gzip(absl::string_view input) {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  EXPECT_EQ(Z_OK, deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                               16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY));
+
+  std::string output(deflateBound(&stream, input.size()), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = static_cast<uInt>(input.size());
+  stream.next_out = reinterpret_cast<Bytef*>(output.data());
+  stream.avail_out = static_cast<uInt>(output.size());
+  EXPECT_EQ(Z_STREAM_END, deflate(&stream, Z_FINISH));
+  output.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  return output;
+}
+
+std::string Zstd(absl::string_view input) {
+  std::string output(ZSTD_compressBound(input.size()), '\0');
+  size_t size = ZSTD_compress(output.data(), output.size(), input.data(),
+                              input.size(), /*compressionLevel=*/3);
+  EXPECT_FALSE(ZSTD_isError(size));
+  output.resize(size);
+  return output;
+}
+
+std::string ReadAll(std::istream& stream) {
+  std::ostringstream output;
+  output << stream.rdbuf();
+  return output.str();
+}
+
+TEST(IsCompressed, DetectsMagicNumbers) {
+  EXPECT_TRUE(IsCompressed(Gzip("abc")));
+  EXPECT_TRUE(IsCompressed(Zstd("abc")));
+  EXPECT_FALSE(IsCompressed(""));
+  EXPECT_FALSE(IsCompressed("\x1F"));
+  EXPECT_FALSE(IsCompressed("Shape \"sphere\""));
+}
+
+TEST(DecompressingIstream, Empty) {
+  std::stringstream input;
+  DecompressingIstream stream(input);
+  EXPECT_EQ("", ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, PassesThroughUncompressed) {
+  std::string expected = MakeInput(3 << 20);
+  std::stringstream input(expected);
+  DecompressingIstream stream(input);
+  EXPECT_EQ(expected, ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, Gzip) {
+  std::string expected = MakeInput(3 << 20);
+  std::stringstream input(Gzip(expected));
+  DecompressingIstream stream(input);
+  EXPECT_EQ(expected, ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, GzipFromBuffer) {
+  std::string expected = MakeInput(3 << 20);
+  std::string compressed = Gzip(expected);
+  DecompressingIstream stream{absl::string_view(compressed)};
+  EXPECT_EQ(expected, ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, GzipConcatenatedMembers) {
+  std::stringstream input(Gzip("abc ") + Gzip("def"));
+  DecompressingIstream stream(input);
+  EXPECT_EQ("abc def", ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, GzipZeroPadded) {
+  std::stringstream input(Gzip("abc ") + Gzip("def") + std::string(512, '\0'));
+  DecompressingIstream stream(input);
+  EXPECT_EQ("abc def", ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, GzipTrailingGarbage) {
+  for (std::string garbage : {"x", "\x1F", "\x1F\x8A", "trailing garbage"}) {
+    std::string compressed = Gzip("abc") + garbage;
+    DecompressingIstream stream(compressed);
+    EXPECT_EQ("abc", ReadAll(stream)) << garbage;
+    EXPECT_THAT(stream.status(), IsOk()) << garbage;
+  }
+}
+
+TEST(DecompressingIstream, GzipTruncated) {
+  std::string compressed = Gzip(MakeInput(1 << 20));
+  std::stringstream input(compressed.substr(0, compressed.size() / 2));
+  DecompressingIstream stream(input);
+  ReadAll(stream);
+  EXPECT_THAT(stream.status(), StatusIs(absl::StatusCode::kDataLoss,
+                                        "Compressed input is truncated"));
+}
+
+TEST(DecompressingIstream, GzipCorrupt) {
+  std::string compressed = Gzip(MakeInput(1 << 20));
+  compressed[20] ^= 0x55;
+  compressed[21] ^= 0x55;
+  std::stringstream input(compressed);
+  DecompressingIstream stream(input);
+  ReadAll(stream);
+  EXPECT_THAT(stream.status(), StatusIs(absl::StatusCode::kDataLoss));
+}
+
+TEST(DecompressingIstream, Zstd) {
+  std::string expected = MakeInput(3 << 20);
+  std::stringstream input(Zstd(expected));
+  DecompressingIstream stream(input);
+  EXPECT_EQ(expected, ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, ZstdFromBuffer) {
+  std::string expected = MakeInput(3 << 20);
+  std::string compressed = Zstd(expected);
+  DecompressingIstream stream{absl::string_view(compressed)};
+  EXPECT_EQ(expected, ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, ZstdConcatenatedFrames) {
+  std::stringstream input(Zstd("abc ") + Zstd("def"));
+  DecompressingIstream stream(input);
+  EXPECT_EQ("abc def", ReadAll(stream));
+  EXPECT_THAT(stream.status(), IsOk());
+}
+
+TEST(DecompressingIstream, ZstdTruncated) {
+  std::string compressed = Zstd(MakeInput(1 << 20));
+  std::stringstream input(compressed.substr(0, compressed.size() / 2));
+  DecompressingIstream stream(input);
+  ReadAll(stream);
+  EXPECT_THAT(stream.status(), StatusIs(absl::StatusCode::kDataLoss,
+                                        "Compressed input is truncated"));
+}
+
+TEST(DecompressingIstream, ZstdCorrupt) {
+  std::string compressed = Zstd(MakeInput(1 << 20));
+  compressed[4] ^= 0x55;
+  std::stringstream input(compressed);
+  DecompressingIstream stream(input);
+  ReadAll(stream);
+  EXPECT_THAT(stream.status(), StatusIs(absl::StatusCode::kDataLoss));
+}
+
+}  // namespace
+}  // namespace pbrt_proto
@@ -0,0 +1,120 @@
+#ifndef _PBRT_PROTO_SHARED_DIRECTIVE_STREAM_
+#define _PBRT_PROTO_SHARED_DIRECTIVE_STREAM_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream.h"
+
+namespace pbrt_proto {
+
+// The serialized form of a `PbrtProto` is a sequence of length-delimited
+// records, one for each element of its `directives` field. These classes write
+// and read those records one directive at a time, so a `PbrtProto` can be
+// produced or consumed without ever holding more than one directive in memory.
+// The output of `DirectiveWriter` can also be parsed as a whole `PbrtProto`,
+// and `DirectiveReader` can read any serialized `PbrtProto`.
+
+// The tag of each record: the field number of `directives` followed by the
+// wire type of a length-delimited field
+template <typename T>
+constexpr uint32_t kDirectiveTag = (T::kDirectivesFieldNumber << 3) | 2;
+
+template <typename T>
+using DirectiveOf =
+    std::remove_reference_t<decltype(*std::declval<T>().add_directives())>;
+
+// Writes directives as records of a serialized `T` to a stream.
+template <typename T>
+class DirectiveWriter {
+ public:
+  using Directive = DirectiveOf<T>;
+
+  explicit DirectiveWriter(google::protobuf::io::ZeroCopyOutputStream* output)
+      : output_(output) {}
+
+  absl::Status Write(const Directive& directive) {
+    return WriteWithCachedSize(directive, directive.ByteSizeLong());
+  }
+
+  // Like `Write`, but reuses the sizes computed by the last call to
+  // `directive.ByteSizeLong()`, which must have returned `byte_size` and been
+  // made since `directive` was last modified. This avoids computing the size of
+  // a directive twice when the caller also needs it.
+  absl::Status WriteWithCachedSize(const Directive& directive,
+                                   size_t byte_size) {
+    if (byte_size > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+      return absl::InvalidArgumentError(
+          "Directive is too large to be serialized");
+    }
+
+    output_.WriteVarint32(kDirectiveTag<T>);
+    output_.WriteVarint32(static_cast<uint32_t>(byte_size));
+    directive.SerializeWithCachedSizes(&output_);
+
+    if (output_.HadError()) {
+      return absl::InternalError("Could not write directive to output");
+    }
+
+    return absl::OkStatus();
+  }
+
+  // The number of bytes written so far
+  int64_t ByteCount() const { return output_.ByteCount(); }
+
+ private:
+  google::protobuf::io::CodedOutputStream output_;
+};
+
+// Reads the records of a serialized `T` from a stream one directive at a time.
+template <typename T>
+class DirectiveReader {
+ public:
+  using Directive = DirectiveOf<T>;
+
+  explicit DirectiveReader(google::protobuf::io::ZeroCopyInputStream* input)
+      : input_(input) {}
+
+  // Reads the next directive into `directive`. Returns false once the end of
+  // the input is reached.
+  absl::StatusOr<bool> Next(Directive& directive) {
+    // Each record is read with its own `CodedInputStream`, which returns any
+    // input it has buffered but not consumed to `input_` when destroyed. This
+    // keeps the total size of the input from being limited to 2GB.
+    google::protobuf::io::CodedInputStream input(input_);
+
+    uint32_t tag = input.ReadTag();
+    if (tag == 0 && input.ConsumedEntireMessage()) {
+      return false;
+    }
+
+    uint32_t size;
+    if (tag != kDirectiveTag<T> || !input.ReadVarint32(&size) ||
+        size > static_cast<uint32_t>(std::numeric_limits<int32_t>::max())) {
+      return absl::InvalidArgumentError("Input is not a serialized PbrtProto");
+    }
+
+    google::protobuf::io::CodedInputStream::Limit limit =
+        input.PushLimit(static_cast<int>(size));
+    if (!directive.ParseFromCodedStream(&input) ||
+        !input.ConsumedEntireMessage() || input.BytesUntilLimit() != 0) {
+      return absl::InvalidArgumentError("Could not parse directive");
+    }
+    input.PopLimit(limit);
+
+    return true;
+  }
+
+ private:
+  google::protobuf::io::ZeroCopyInputStream* input_;
+};
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_DIRECTIVE_STREAM_
@@ -0,0 +1,127 @@
+#include "pbrt_proto/shared/directive_stream.h"
+
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/status_matchers.h"
+#include "absl/status/statusor.h"
+#include "gmock/gmock.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "gtest/gtest.h"
+#include "pbrt_proto/shared/common_test.pb.h"
+#include "pbrt_proto/testing/proto_matchers.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::absl_testing::IsOk;
+using ::absl_testing::IsOkAndHolds;
+using ::absl_testing::StatusIs;
+using ::google::protobuf::EqualsProto;
+using ::google::protobuf::ParseTextOrDie;
+using ::google::protobuf::io::ArrayInputStream;
+using ::google::protobuf::io::StringOutputStream;
+
+constexpr char kDirectives[] = R"pb(
+  directives { float_parameter { float_value: 1.0 } }
+  directives {}
+  directives { spectrum_parameter { constant_spectrum: 2.0 } }
+)pb";
+
+TEST(DirectiveWriter, ParsesAsProto) {
+  TestDirectivesProto expected = ParseTextOrDie(kDirectives);
+
+  std::string serialized;
+  {
+    StringOutputStream output(&serialized);
+    DirectiveWriter<TestDirectivesProto> writer(&output);
+    for (const TestParameterProto& directive : expected.directives()) {
+      EXPECT_THAT(writer.Write(directive), IsOk());
+    }
+    EXPECT_EQ(static_cast<int64_t>(expected.ByteSizeLong()),
+              writer.ByteCount());
+  }
+
+  EXPECT_EQ(expected.SerializeAsString(), serialized);
+}
+
+TEST(DirectiveWriter, WriteWithCachedSize) {
+  TestDirectivesProto expected = ParseTextOrDie(kDirectives);
+
+  std::string serialized;
+  {
+    StringOutputStream output(&serialized);
+    DirectiveWriter<TestDirectivesProto> writer(&output);
+    for (const TestParameterProto& directive : expected.directives()) {
+      EXPECT_THAT(
+          writer.WriteWithCachedSize(directive, directive.ByteSizeLong()),
+          IsOk());
+    }
+  }
+
+  EXPECT_EQ(expected.SerializeAsString(), serialized);
+}
+
+TEST(DirectiveReader, ReadsProto) {
+  TestDirectivesProto expected = ParseTextOrDie(kDirectives);
+  std::string serialized = expected.SerializeAsString();
+
+  ArrayInputStream input(serialized.data(), serialized.size(),
+                         /*block_size=*/3);
+  DirectiveReader<TestDirectivesProto> reader(&input);
+
+  TestDirectivesProto actual;
+  TestParameterProto directive;
+  for (;;) {
+    absl::StatusOr<bool> read = reader.Next(directive);
+    ASSERT_THAT(read, IsOk());
+    if (!*read) {
+      break;
+    }
+    *actual.add_directives() = directive;
+  }
+
+  EXPECT_THAT(actual, EqualsProto(kDirectives));
+  EXPECT_THAT(reader.Next(directive), IsOkAndHolds(false));
+}
+
+TEST(DirectiveReader, Empty) {
+  ArrayInputStream input("", 0);
+  DirectiveReader<TestDirectivesProto> reader(&input);
+
+  TestParameterProto directive;
+  EXPECT_THAT(reader.Next(directive), IsOkAndHolds(false));
+}
+
+TEST(DirectiveReader, WrongField) {
+  TestDirectivesProto expected = ParseTextOrDie(kDirectives);
+  std::string serialized =
+      expected.directives(0).SerializeAsString();  // Field 2, not 1
+
+  ArrayInputStream input(serialized.data(), serialized.size());
+  DirectiveReader<TestDirectivesProto> reader(&input);
+
+  TestParameterProto directive;
+  EXPECT_THAT(reader.Next(directive),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       "Input is not a serialized PbrtProto"));
+}
+
+TEST(DirectiveReader, Truncated) {
+  TestDirectivesProto expected = ParseTextOrDie(kDirectives);
+  std::string serialized = expected.SerializeAsString();
+  serialized.pop_back();
+
+  ArrayInputStream input(serialized.data(), serialized.size());
+  DirectiveReader<TestDirectivesProto> reader(&input);
+
+  TestParameterProto directive;
+  EXPECT_THAT(reader.Next(directive), IsOkAndHolds(true));
+  EXPECT_THAT(reader.Next(directive), IsOkAndHolds(true));
+  EXPECT_THAT(reader.Next(directive),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       "Could not parse directive"));
+}
+
+}  // namespace
+}  // namespace pbrt_proto
@@ -0,0 +1,177 @@
+#include "pbrt_proto/shared/directives.h"
+
+#include <optional>
+
+#include "absl/strings/string_view.h"
+
+namespace pbrt_proto {
+
+std::optional<DirectiveKind> LookupDirective(absl::string_view keyword) {
+  // Switching on the length leaves at most five keywords to compare against,
+  // and each comparison is of a fixed size
+  switch (keyword.size()) {
+    case 4:
+      if (keyword == "Film") {
+        return DirectiveKind::FILM;
+      }
+      break;
+    case 5:
+      if (keyword == "Scale") {
+        return DirectiveKind::SCALE;
+      }
+      if (keyword == "Shape") {
+        return DirectiveKind::SHAPE;
+      }
+      break;
+    case 6:
+      if (keyword == "Camera") {
+        return DirectiveKind::CAMERA;
+      }
+      if (keyword == "Import") {
+        return DirectiveKind::IMPORT;
+      }
+      if (keyword == "LookAt") {
+        return DirectiveKind::LOOK_AT;
+      }
+      if (keyword == "Rotate") {
+        return DirectiveKind::ROTATE;
+      }
+      if (keyword == "Volume") {
+        return DirectiveKind::VOLUME;
+      }
+      break;
+    case 7:
+      if (keyword == "Include") {
+        return DirectiveKind::INCLUDE;
+      }
+      if (keyword == "Sampler") {
+        return DirectiveKind::SAMPLER;
+      }
+      if (keyword == "Texture") {
+        return DirectiveKind::TEXTURE;
+      }
+      break;
+    case 8:
+      if (keyword == "Identity") {
+        return DirectiveKind::IDENTITY;
+      }
+      if (keyword == "Material") {
+        return DirectiveKind::MATERIAL;
+      }
+      if (keyword == "Renderer") {
+        return DirectiveKind::RENDERER;
+      }
+      if (keyword == "WorldEnd") {
+        return DirectiveKind::WORLD_END;
+      }
+      break;
+    case 9:
+      if (keyword == "ObjectEnd") {
+        return DirectiveKind::OBJECT_END;
+      }
+      if (keyword == "Transform") {
+        return DirectiveKind::TRANSFORM;
+      }
+      if (keyword == "Translate") {
+        return DirectiveKind::TRANSLATE;
+      }
+      break;
+    case 10:
+      if (keyword == "Integrator") {
+        return DirectiveKind::INTEGRATOR;
+      }
+      if (keyword == "SearchPath") {
+        return DirectiveKind::SEARCH_PATH;
+      }
+      if (keyword == "WorldBegin") {
+        return DirectiveKind::WORLD_BEGIN;
+      }
+      break;
+    case 11:
+      if (keyword == "Accelerator") {
+        return DirectiveKind::ACCELERATOR;
+      }
+      if (keyword == "LightSource") {
+        return DirectiveKind::LIGHT_SOURCE;
+      }
+      if (keyword == "ObjectBegin") {
+        return DirectiveKind::OBJECT_BEGIN;
+      }
+      if (keyword == "PixelFilter") {
+        return DirectiveKind::PIXEL_FILTER;
+      }
+      break;
+    case 12:
+      if (keyword == "AttributeEnd") {
+        return DirectiveKind::ATTRIBUTE_END;
+      }
+      if (keyword == "TransformEnd") {
+        return DirectiveKind::TRANSFORM_END;
+      }
+      break;
+    case 13:
+      if (keyword == "NamedMaterial") {
+        return DirectiveKind::NAMED_MATERIAL;
+      }
+      break;
+    case 14:
+      if (keyword == "AttributeBegin") {
+        return DirectiveKind::ATTRIBUTE_BEGIN;
+      }
+      if (keyword == "ObjectInstance") {
+        return DirectiveKind::OBJECT_INSTANCE;
+      }
+      if (keyword == "TransformBegin") {
+        return DirectiveKind::TRANSFORM_BEGIN;
+      }
+      if (keyword == "TransformTimes") {
+        return DirectiveKind::TRANSFORM_TIMES;
+      }
+      break;
+    case 15:
+      if (keyword == "ActiveTransform") {
+        return DirectiveKind::ACTIVE_TRANSFORM;
+      }
+      if (keyword == "AreaLightSource") {
+        return DirectiveKind::AREA_LIGHT_SOURCE;
+      }
+      if (keyword == "ConcatTransform") {
+        return DirectiveKind::CONCAT_TRANSFORM;
+      }
+      if (keyword == "MakeNamedMedium") {
+        return DirectiveKind::MAKE_NAMED_MEDIUM;
+      }
+      if (keyword == "MediumInterface") {
+        return DirectiveKind::MEDIUM_INTERFACE;
+      }
+      break;
+    case 16:
+      if (keyword == "CoordinateSystem") {
+        return DirectiveKind::COORDINATE_SYSTEM;
+      }
+      if (keyword == "VolumeIntegrator") {
+        return DirectiveKind::VOLUME_INTEGRATOR;
+      }
+      break;
+    case 17:
+      if (keyword == "CoordSysTransform") {
+        return DirectiveKind::COORD_SYS_TRANSFORM;
+      }
+      if (keyword == "MakeNamedMaterial") {
+        return DirectiveKind::MAKE_NAMED_MATERIAL;
+      }
+      if (keyword == "SurfaceIntegrator") {
+        return DirectiveKind::SURFACE_INTEGRATOR;
+      }
+      break;
+    case 18:
+      if (keyword == "ReverseOrientation") {
+        return DirectiveKind::REVERSE_ORIENTATION;
+      }
+      break;
+  }
+
+  return std::nullopt;
+}
+
+}  // namespace pbrt_proto
@@ -0,0 +1,63 @@
+#ifndef _PBRT_PROTO_SHARED_DIRECTIVES_
+#define _PBRT_PROTO_SHARED_DIRECTIVES_
+
+#include <optional>
+
+#include "absl/strings/string_view.h"
+
+namespace pbrt_proto {
+
+// The directive keywords of every supported version of the pbrt format
+enum class DirectiveKind {
+  ACCELERATOR,
+  ACTIVE_TRANSFORM,
+  AREA_LIGHT_SOURCE,
+  ATTRIBUTE_BEGIN,
+  ATTRIBUTE_END,
+  CAMERA,
+  CONCAT_TRANSFORM,
+  COORDINATE_SYSTEM,
+  COORD_SYS_TRANSFORM,
+  FILM,
+  IDENTITY,
+  IMPORT,
+  INCLUDE,
+  INTEGRATOR,
+  LIGHT_SOURCE,
+  LOOK_AT,
+  MAKE_NAMED_MATERIAL,
+  MAKE_NAMED_MEDIUM,
+  MATERIAL,
+  MEDIUM_INTERFACE,
+  NAMED_MATERIAL,
+  OBJECT_BEGIN,
+  OBJECT_END,
+  OBJECT_INSTANCE,
+  PIXEL_FILTER,
+  RENDERER,
+  REVERSE_ORIENTATION,
+  ROTATE,
+  SAMPLER,
+  SCALE,
+  SEARCH_PATH,
+  SHAPE,
+  SURFACE_INTEGRATOR,
+  TEXTURE,
+  TRANSFORM,
+  TRANSFORM_BEGIN,
+  TRANSFORM_END,
+  TRANSFORM_TIMES,
+  TRANSLATE,
+  VOLUME,
+  VOLUME_INTEGRATOR,
+  WORLD_BEGIN,
+  WORLD_END,
+};
+
+// Returns the directive named by `keyword`, or `std::nullopt` if `keyword` is
+// not a directive keyword.
+std::optional<DirectiveKind> LookupDirective(absl::string_view keyword);
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_DIRECTIVES_
@@ -0,0 +1,74 @@
+#include "pbrt_proto/shared/directives.h"
+
+#include <optional>
+#include <utility>
+
+#include "absl/strings/string_view.h"
+#include "gtest/gtest.h"
+
+namespace pbrt_proto {
+namespace {
+
+TEST(LookupDirective, Directives) {
+  std::pair<absl::string_view, DirectiveKind> directives[] = {
+      {"Accelerator", DirectiveKind::ACCELERATOR},
+      {"ActiveTransform", DirectiveKind::ACTIVE_TRANSFORM},
+      {"AreaLightSource", DirectiveKind::AREA_LIGHT_SOURCE},
+      {"AttributeBegin", DirectiveKind::ATTRIBUTE_BEGIN},
+      {"AttributeEnd", DirectiveKind::ATTRIBUTE_END},
+      {"Camera", DirectiveKind::CAMERA},
+      {"ConcatTransform", DirectiveKind::CONCAT_TRANSFORM},
+      {"CoordinateSystem", DirectiveKind::COORDINATE_SYSTEM},
+      {"CoordSysTransform", DirectiveKind::COORD_SYS_TRANSFORM},
+      {"Film", DirectiveKind::FILM},
+      {"Identity", DirectiveKind::IDENTITY},
+      {"Import", DirectiveKind::IMPORT},
+      {"Include", DirectiveKind::INCLUDE},
+      {"Integrator", DirectiveKind::INTEGRATOR},
+      {"LightSource", DirectiveKind::LIGHT_SOURCE},
+      {"LookAt", DirectiveKind::LOOK_AT},
+      {"MakeNamedMaterial", DirectiveKind::MAKE_NAMED_MATERIAL},
+      {"MakeNamedMedium", DirectiveKind::MAKE_NAMED_MEDIUM},
+      {"Material", DirectiveKind::MATERIAL},
+      {"MediumInterface", DirectiveKind::MEDIUM_INTERFACE},
+      {"NamedMaterial", DirectiveKind::NAMED_MATERIAL},
+      {"ObjectBegin", DirectiveKind::OBJECT_BEGIN},
+      {"ObjectEnd", DirectiveKind::OBJECT_END},
+      {"ObjectInstance", DirectiveKind::OBJECT_INSTANCE},
+      {"PixelFilter", DirectiveKind::PIXEL_FILTER},
+      {"Renderer", DirectiveKind::RENDERER},
+      {"ReverseOrientation", DirectiveKind::REVERSE_ORIENTATION},
+      {"Rotate", DirectiveKind::ROTATE},
+      {"Sampler", DirectiveKind::SAMPLER},
+      {"Scale", DirectiveKind::SCALE},
+      {"SearchPath", DirectiveKind::SEARCH_PATH},
+      {"Shape", DirectiveKind::SHAPE},
+      {"SurfaceIntegrator", DirectiveKind::SURFACE_INTEGRATOR},
+      {"Texture", DirectiveKind::TEXTURE},
+      {"Transform", DirectiveKind::TRANSFORM},
+      {"TransformBegin", DirectiveKind::TRANSFORM_BEGIN},
+      {"TransformEnd", DirectiveKind::TRANSFORM_END},
+      {"TransformTimes", DirectiveKind::TRANSFORM_TIMES},
+      {"Translate", DirectiveKind::TRANSLATE},
+      {"Volume", DirectiveKind::VOLUME},
+      {"VolumeIntegrator", DirectiveKind::VOLUME_INTEGRATOR},
+      {"WorldBegin", DirectiveKind::WORLD_BEGIN},
+      {"WorldEnd", DirectiveKind::WORLD_END},
+  };
+
+  for (const auto& [keyword, directive] : directives) {
+    EXPECT_EQ(LookupDirective(keyword), directive) << keyword;
+  }
+}
+
+TEST(LookupDirective, NotDirectives) {
+  for (absl::string_view keyword :
+       {"", "F", "Shap", "shape", "SHAPE", "Shapes", "ShapeX", "XShape",
+        "Sphere", "\"Shape\"", "WorldBegin ", "Transforms", "TransformBeginX",
+        "1.0"}) {
+    EXPECT_EQ(LookupDirective(keyword), std::nullopt) << keyword;
+  }
+}
+
+}  // namespace
+}  // namespace pbrt_proto
@@ -0,0 +1,822 @@
+#include "pbrt_proto/shared/geometry.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "absl/base/nullability.h"
+#include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/repeated_field.h"
+#include "google/protobuf/repeated_ptr_field.h"
+#include "pbrt_proto/pbrt.pb.h"
+#include "pbrt_proto/shared/compression.h"
+#include "pbrt_proto/shared/numbers.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::google::protobuf::RepeatedField;
+using ::google::protobuf::RepeatedPtrField;
+using ::google::protobuf::io::CodedOutputStream;
+
+// The number of values each message is flattened into
+constexpr size_t kVector3Components = 3;
+constexpr size_t kUVComponents = 2;
+constexpr size_t kWeightedPointComponents = 4;
+constexpr size_t kRgbComponents = 3;
+constexpr size_t kSampleComponents = 2;
+
+// Clears `field` and releases its memory, which `Clear` alone would retain for
+// reuse.
+template <typename T>
+void Release(RepeatedPtrField<T>& field) {
+  RepeatedPtrField<T> empty;
+  field.Swap(&empty);
+}
+
+template <typename T>
+void Release(RepeatedField<T>& field) {
+  RepeatedField<T> empty;
+  field.Swap(&empty);
+}
+
+template <typename T>
+absl::Span<const T> AsSpan(const RepeatedField<T>& field) {
+  return absl::MakeConstSpan(field.data(), field.size());
+}
+
+template <typename T>
+void Add(RepeatedField<T>& output, T value) {
+  output.Add(value);
+}
+
+template <typename T>
+void Add(std::vector<T>& output, T value) {
+  output.push_back(value);
+}
+
+template <typename T>
+void Reserve(RepeatedField<T>& output, size_t size) {
+  output.Reserve(static_cast<int>(size));
+}
+
+template <typename T>
+void Reserve(std::vector<T>& output, size_t size) {
+  output.reserve(size);
+}
+
+template <typename T>
+T ConvertTo(double value);
+
+template <>
+double ConvertTo(double value) {
+  return value;
+}
+
+template <>
+float ConvertTo(double value) {
+  return RoundToFloat(value);
+}
+
+template <typename Output>
+void AppendComponents(const Point& point, Output& output) {
+  using T = typename Output::value_type;
+  Add(output, ConvertTo<T>(point.x()));
+  Add(output, ConvertTo<T>(point.y()));
+  Add(output, ConvertTo<T>(point.z()));
+}
+
+template <typename Output>
+void AppendComponents(const Vector& vector, Output& output) {
+  using T = typename Output::value_type;
+  Add(output, ConvertTo<T>(vector.x()));
+  Add(output, ConvertTo<T>(vector.y()));
+  Add(output, ConvertTo<T>(vector.z()));
+}
+
+template <typename Output>
+void AppendComponents(const TriangleMeshShape::UVCoordinate& uv,
+                      Output& output) {
+  using T = typename Output::value_type;
+  Add(output, ConvertTo<T>(uv.u()));
+  Add(output, ConvertTo<T>(uv.v()));
+}
+
+template <typename Output>
+void AppendComponents(const NurbsShape::PointWithWeight& point,
+                      Output& output) {
+  using T = typename Output::value_type;
+  AppendComponents(point.p(), output);
+  Add(output, ConvertTo<T>(point.weight()));
+}
+
+template <typename Output>
+void AppendComponents(const RgbSpectrum& rgb, Output& output) {
+  Add(output, rgb.r());
+  Add(output, rgb.g());
+  Add(output, rgb.b());
+}
+
+template <typename Output>
+void AppendComponents(const SampledSpectrum::Sample& sample, Output& output) {
+  Add(output, sample.wavelength());
+  Add(output, sample.intensity());
+}
+
+template <typename Output>
+void AppendComponents(const VertexIndices& triangle, Output& output) {
+  Add(output, triangle.v0());
+  Add(output, triangle.v1());
+  Add(output, triangle.v2());
+}
+
+template <typename Message, typename Output>
+void Flatten(const RepeatedPtrField<Message>& messages, size_t components,
+             Output& output) {
+  Reserve(output, output.size() + components * messages.size());
+  for (const Message& message : messages) {
+    AppendComponents(message, output);
+  }
+}
+
+template <typename U, typename Output>
+void ConvertAll(absl::Span<const U> values, Output& output) {
+  using T = typename Output::value_type;
+  Reserve(output, output.size() + values.size());
+  for (U value : values) {
+    Add(output, ConvertTo<T>(value));
+  }
+}
+
+template <typename Message, typename T>
+void Pack(RepeatedPtrField<Message>& messages, size_t components,
+          RepeatedField<T>& packed) {
+  if (messages.empty() || !packed.empty()) {
+    return;
+  }
+
+  Flatten(messages, components, packed);
+  Release(messages);
+}
+
+template <typename Message>
+void PackFloat32(RepeatedPtrField<Message>& messages, size_t components,
+                 RepeatedField<double>* absl_nullable packed,
+                 RepeatedField<float>& packed_f32) {
+  if (!packed_f32.empty()) {
+    return;
+  }
+
+  if (!messages.empty()) {
+    Flatten(messages, components, packed_f32);
+    Release(messages);
+  } else if (packed && !packed->empty()) {
+    ConvertAll(AsSpan(*packed), packed_f32);
+    Release(*packed);
+  }
+}
+
+void PackFloat32(RepeatedField<double>& values,
+                 RepeatedField<float>& values_f32) {
+  if (values.empty() || !values_f32.empty()) {
+    return;
+  }
+
+  ConvertAll(AsSpan(values), values_f32);
+  Release(values);
+}
+
+// Returns the values from whichever of `values` and `values_f32` is populated
+// at the precision of `T`.
+template <typename T>
+absl::Span<const T> Get(absl::Span<const double> values,
+                        absl::Span<const float> values_f32,
+                        std::vector<T>& storage) {
+  if constexpr (std::is_same_v<T, double>) {
+    if (!values.empty() || values_f32.empty()) {
+      return values;
+    }
+  } else {
+    if (!values_f32.empty() || values.empty()) {
+      return values_f32;
+    }
+  }
+
+  storage.clear();
+  if (values.empty()) {
+    ConvertAll(values_f32, storage);
+  } else {
+    ConvertAll(values, storage);
+  }
+
+  return storage;
+}
+
+// Returns the values from whichever of `messages`, `packed`, and `packed_f32`
+// is populated at the precision of `T`.
+template <typename T, typename Message>
+absl::Span<const T> Get(const RepeatedPtrField<Message>& messages,
+                        size_t components, absl::Span<const double> packed,
+                        absl::Span<const float> packed_f32,
+                        std::vector<T>& storage) {
+  absl::Span<const T> native;
+  if constexpr (std::is_same_v<T, double>) {
+    native = packed;
+  } else {
+    native = packed_f32;
+  }
+
+  if (!native.empty()) {
+    return native;
+  }
+
+  storage.clear();
+  if (!messages.empty()) {
+    Flatten(messages, components, storage);
+  } else if (!packed.empty()) {
+    ConvertAll(packed, storage);
+  } else {
+    ConvertAll(packed_f32, storage);
+  }
+
+  return storage;
+}
+
+template <typename T, typename Shape>
+absl::Span<const T> GetShapePositions(const Shape& shape,
+                                      std::vector<T>& storage) {
+  return Get(shape.p(), kVector3Components, AsSpan(shape.p_xyz()),
+             AsSpan(shape.p_xyz_f32()), storage);
+}
+
+template <typename T, typename Shape>
+absl::Span<const T> GetShapeNormals(const Shape& shape,
+                                    std::vector<T>& storage) {
+  return Get(shape.n(), kVector3Components, AsSpan(shape.n_xyz()),
+             AsSpan(shape.n_xyz_f32()), storage);
+}
+
+template <typename Shape>
+absl::Span<const uint32_t> GetShapeIndices(const Shape& shape,
+                                           std::vector<uint32_t>& storage) {
+  if (shape.indices().empty() || !shape.indices_flat().empty()) {
+    return AsSpan(shape.indices_flat());
+  }
+
+  storage.clear();
+  Flatten(shape.indices(), kVector3Components, storage);
+
+  return storage;
+}
+
+// Returns the number of bytes an element of the repeated message field
+// `field_number` that serializes to `size` bytes adds to its parent
+size_t MessageElementSize(int field_number, size_t size) {
+  return CodedOutputStream::VarintSize32(
+             static_cast<uint32_t>(field_number) << 3) +
+         CodedOutputStream::VarintSize64(size) + size;
+}
+
+// Returns the number of bytes an element of the repeated int32 field
+// `field_number` with the value `value` adds to its parent
+size_t Int32ElementSize(int field_number, int32_t value) {
+  return CodedOutputStream::VarintSize32(static_cast<uint32_t>(field_number)
+                                         << 3) +
+         CodedOutputStream::VarintSize32SignExtended(value);
+}
+
+bool HasAlternateEncoding(const TriangleMeshShape& shape) {
+  return !shape.p_xyz().empty() || !shape.indices_flat().empty() ||
+         !shape.n_xyz().empty() || !shape.s_xyz().empty() ||
+         !shape.uv_flat().empty() || !shape.faceindices_flat().empty() ||
+         !shape.p_xyz_f32().empty() || !shape.n_xyz_f32().empty() ||
+         !shape.s_xyz_f32().empty() || !shape.uv_flat_f32().empty() ||
+         shape.has_p_ref() || shape.has_indices_ref() || shape.has_n_ref() ||
+         shape.has_s_ref() || shape.has_uv_ref() ||
+         shape.has_faceindices_ref() || !shape.indices_delta().empty() ||
+         shape.has_p_quantized() || shape.has_n_octahedral() ||
+         shape.has_s_octahedral() || shape.has_uv_quantized();
+}
+
+// Returns the number of bytes the per-vertex values of `vertex` add to a mesh
+size_t VertexSize(const TriangleMeshShape& shape, uint32_t vertex) {
+  size_t size = MessageElementSize(TriangleMeshShape::kPFieldNumber,
+                                   shape.p(vertex).ByteSizeLong());
+  if (!shape.n().empty()) {
+    size += MessageElementSize(TriangleMeshShape::kNFieldNumber,
+                               shape.n(vertex).ByteSizeLong());
+  }
+  if (!shape.s().empty()) {
+    size += MessageElementSize(TriangleMeshShape::kSFieldNumber,
+                               shape.s(vertex).ByteSizeLong());
+  }
+  if (!shape.uv().empty()) {
+    size += MessageElementSize(TriangleMeshShape::kUvFieldNumber,
+                               shape.uv(vertex).ByteSizeLong());
+  }
+  return size;
+}
+
+}  // namespace
+
+void PackGeometry(CurveShape& shape) {
+  Pack(*shape.mutable_p(), kVector3Components, *shape.mutable_p_xyz());
+  Pack(*shape.mutable_n(), kVector3Components, *shape.mutable_n_xyz());
+}
+
+void PackGeometry(LoopSubdivShape& shape) {
+  Pack(*shape.mutable_p(), kVector3Components, *shape.mutable_p_xyz());
+  Pack(*shape.mutable_indices(), kVector3Components,
+       *shape.mutable_indices_flat());
+}
+
+void PackGeometry(TriangleMeshShape& shape) {
+  Pack(*shape.mutable_p(), kVector3Components, *shape.mutable_p_xyz());
+  Pack(*shape.mutable_indices(), kVector3Components,
+       *shape.mutable_indices_flat());
+  Pack(*shape.mutable_n(), kVector3Components, *shape.mutable_n_xyz());
+  Pack(*shape.mutable_s(), kVector3Components, *shape.mutable_s_xyz());
+  Pack(*shape.mutable_uv(), kUVComponents, *shape.mutable_uv_flat());
+
+  if (!shape.faceindices().empty() && shape.faceindices_flat().empty()) {
+    shape.mutable_faceindices()->Swap(shape.mutable_faceindices_flat());
+  }
+}
+
+void PackGeometryFloat32(CurveShape& shape) {
+  PackFloat32(*shape.mutable_p(), kVector3Components, shape.mutable_p_xyz(),
+              *shape.mutable_p_xyz_f32());
+  PackFloat32(*shape.mutable_n(), kVector3Components, shape.mutable_n_xyz(),
+              *shape.mutable_n_xyz_f32());
+}
+
+void PackGeometryFloat32(LoopSubdivShape& shape) {
+  PackFloat32(*shape.mutable_p(), kVector3Components, shape.mutable_p_xyz(),
+              *shape.mutable_p_xyz_f32());
+  Pack(*shape.mutable_indices(), kVector3Components,
+       *shape.mutable_indices_flat());
+}
+
+void PackGeometryFloat32(NurbsShape& shape) {
+  PackFloat32(*shape.mutable_p(), kVector3Components, /*packed=*/nullptr,
+              *shape.mutable_p_xyz_f32());
+  PackFloat32(*shape.mutable_pw(), kWeightedPointComponents,
+              /*packed=*/nullptr, *shape.mutable_pw_xyzw_f32());
+}
+
+void PackGeometryFloat32(TriangleMeshShape& shape) {
+  PackFloat32(*shape.mutable_p(), kVector3Components, shape.mutable_p_xyz(),
+              *shape.mutable_p_xyz_f32());
+  Pack(*shape.mutable_indices(), kVector3Components,
+       *shape.mutable_indices_flat());
+  PackFloat32(*shape.mutable_n(), kVector3Components, shape.mutable_n_xyz(),
+              *shape.mutable_n_xyz_f32());
+  PackFloat32(*shape.mutable_s(), kVector3Components, shape.mutable_s_xyz(),
+              *shape.mutable_s_xyz_f32());
+  PackFloat32(*shape.mutable_uv(), kUVComponents, shape.mutable_uv_flat(),
+              *shape.mutable_uv_flat_f32());
+
+  if (!shape.faceindices().empty() && shape.faceindices_flat().empty()) {
+    shape.mutable_faceindices()->Swap(shape.mutable_faceindices_flat());
+  }
+}
+
+void CompressGeometry(TriangleMeshShape& shape,
+                      const MeshCompressionOptions& options) {
+  if (shape.indices_delta().empty()) {
+    std::vector<uint32_t> storage;
+    DeltaEncode(GetIndices(shape, storage), *shape.mutable_indices_delta());
+    Release(*shape.mutable_indices());
+    Release(*shape.mutable_indices_flat());
+  }
+
+  std::vector<double> storage;
+  QuantizedArray quantized;
+  if (!shape.has_p_quantized() &&
+      Quantize(GetPositions(shape, storage), kVector3Components,
+               options.position_bits, quantized)) {
+    shape.mutable_p_quantized()->Swap(&quantized);
+    Release(*shape.mutable_p());
+    Release(*shape.mutable_p_xyz());
+    Release(*shape.mutable_p_xyz_f32());
+  }
+
+  OctahedralArray octahedral;
+  if (!shape.has_n_octahedral() &&
+      EncodeOctahedral(GetNormals(shape, storage), options.direction_bits,
+                       octahedral)) {
+    shape.mutable_n_octahedral()->Swap(&octahedral);
+    Release(*shape.mutable_n());
+    Release(*shape.mutable_n_xyz());
+    Release(*shape.mutable_n_xyz_f32());
+  }
+
+  if (!shape.has_s_octahedral() &&
+      EncodeOctahedral(GetTangents(shape, storage), options.direction_bits,
+                       octahedral)) {
+    shape.mutable_s_octahedral()->Swap(&octahedral);
+    Release(*shape.mutable_s());
+    Release(*shape.mutable_s_xyz());
+    Release(*shape.mutable_s_xyz_f32());
+  }
+
+  if (!shape.has_uv_quantized() &&
+      Quantize(GetUVs(shape, storage), kUVComponents, options.uv_bits,
+               quantized)) {
+    shape.mutable_uv_quantized()->Swap(&quantized);
+    Release(*shape.mutable_uv());
+    Release(*shape.mutable_uv_flat());
+    Release(*shape.mutable_uv_flat_f32());
+  }
+}
+
+bool SplitGeometry(const TriangleMeshShape& shape, size_t max_size,
+                   absl::FunctionRef<void(TriangleMeshShape&)> output) {
+  if (shape.indices().empty() || HasAlternateEncoding(shape)) {
+    return false;
+  }
+
+  int num_vertices = shape.p_size();
+  if ((!shape.n().empty() && shape.n_size() != num_vertices) ||
+      (!shape.s().empty() && shape.s_size() != num_vertices) ||
+      (!shape.uv().empty() && shape.uv_size() != num_vertices) ||
+      (!shape.faceindices().empty() &&
+       shape.faceindices_size() != shape.indices_size())) {
+    return false;
+  }
+
+  // Every part shares the fields that are not per vertex or per triangle
+  TriangleMeshShape base;
+  if (shape.has_discarddegenerateuvs()) {
+    base.set_discarddegenerateuvs(shape.discarddegenerateuvs());
+  }
+  if (shape.has_alpha()) {
+    *base.mutable_alpha() = shape.alpha();
+  }
+  if (shape.has_shadowalpha()) {
+    *base.mutable_shadowalpha() = shape.shadowalpha();
+  }
+  size_t base_size = base.ByteSizeLong();
+
+  // Checks that every index refers to a vertex and that any one triangle fits
+  // in a part on its own, so that nothing is output unless the whole mesh can
+  // be split
+  VertexIndices alone;  // A triangle alone in a part is numbered 0, 1, 2
+  alone.set_v0(0);
+  alone.set_v1(1);
+  alone.set_v2(2);
+  size_t indices_size = MessageElementSize(
+      TriangleMeshShape::kIndicesFieldNumber, alone.ByteSizeLong());
+  for (int i = 0; i < shape.indices_size(); i++) {
+    const VertexIndices& triangle = shape.indices(i);
+    uint32_t vertices[3] = {triangle.v0(), triangle.v1(), triangle.v2()};
+
+    size_t triangle_size = indices_size;
+    for (uint32_t vertex : vertices) {
+      if (vertex >= static_cast<uint32_t>(num_vertices)) {
+        return false;
+      }
+      triangle_size += VertexSize(shape, vertex);
+    }
+
+    if (!shape.faceindices().empty()) {
+      triangle_size += Int32ElementSize(
+          TriangleMeshShape::kFaceIndicesFieldNumber, shape.faceindices(i));
+    }
+
+    if (base_size + triangle_size > max_size) {
+      return false;
+    }
+  }
+
+  // The index of each vertex within the current part, which is only valid if
+  // the vertex was last added to the current part
+  std::vector<uint32_t> part_vertex(num_vertices);
+  std::vector<size_t> last_part(num_vertices,
+                                std::numeric_limits<size_t>::max());
+
+  size_t part_index = 0;
+  TriangleMeshShape part = base;
+  size_t part_size = base_size;
+  for (int i = 0; i < shape.indices_size(); i++) {
+    const VertexIndices& triangle = shape.indices(i);
+    uint32_t vertices[3] = {triangle.v0(), triangle.v1(), triangle.v2()};
+
+    // Numbers the vertices of the triangle within the current part, giving the
+    // next unused numbers to any the part does not yet contain, and returns the
+    // number of bytes the triangle and those vertices add to the part
+    VertexIndices remapped;
+    auto measure = [&]() {
+      size_t size = 0;
+      uint32_t next_vertex = static_cast<uint32_t>(part.p_size());
+      uint32_t indices[3];
+      for (size_t c = 0; c < 3; c++) {
+        if (last_part[vertices[c]] == part_index) {
+          indices[c] = part_vertex[vertices[c]];
+          continue;
+        }
+
+        bool repeated = false;
+        for (size_t prior = 0; prior < c; prior++) {
+          if (vertices[prior] == vertices[c]) {
+            indices[c] = indices[prior];
+            repeated = true;
+          }
+        }
+
+        if (!repeated) {
+          indices[c] = next_vertex++;
+          size += VertexSize(shape, vertices[c]);
+        }
+      }
+
+      remapped.set_v0(indices[0]);
+      remapped.set_v1(indices[1]);
+      remapped.set_v2(indices[2]);
+      size += MessageElementSize(TriangleMeshShape::kIndicesFieldNumber,
+                                 remapped.ByteSizeLong());
+
+      if (!shape.faceindices().empty()) {
+        size += Int32ElementSize(TriangleMeshShape::kFaceIndicesFieldNumber,
+                                 shape.faceindices(i));
+      }
+
+      return size;
+    };
+
+    size_t triangle_size = measure();
+    if (part_size + triangle_size > max_size) {
+      output(part);
+
+      part_index += 1;
+      part = base;
+      part_size = base_size;
+      triangle_size = measure();
+    }
+
+    uint32_t indices[3] = {remapped.v0(), remapped.v1(), remapped.v2()};
+    for (size_t c = 0; c < 3; c++) {
+      if (indices[c] != static_cast<uint32_t>(part.p_size())) {
+        continue;
+      }
+
+      uint32_t vertex = vertices[c];
+      last_part[vertex] = part_index;
+      part_vertex[vertex] = indices[c];
+
+      *part.add_p() = shape.p(vertex);
+      if (!shape.n().empty()) {
+        *part.add_n() = shape.n(vertex);
+      }
+      if (!shape.s().empty()) {
+        *part.add_s() = shape.s(vertex);
+      }
+      if (!shape.uv().empty()) {
+        *part.add_uv() = shape.uv(vertex);
+      }
+    }
+
+    *part.add_indices() = remapped;
+    if (!shape.faceindices().empty()) {
+      part.add_faceindices(shape.faceindices(i));
+    }
+
+    part_size += triangle_size;
+  }
+
+  output(part);
+
+  return true;
+}
+
+void PackGridFloat32(UniformGridMedium& medium) {
+  PackFloat32(*medium.mutable_density(), *medium.mutable_density_f32());
+  PackFloat32(*medium.mutable_temperature(), *medium.mutable_temperature_f32());
+}
+
+void PackEmission(RgbGridMedium& medium) {
+  Pack(*medium.mutable_le(), kRgbComponents, *medium.mutable_le_rgb());
+}
+
+void PackSamples(SampledSpectrum& spectrum) {
+  Pack(*spectrum.mutable_samples(), kSampleComponents,
+       *spectrum.mutable_samples_flat());
+}
+
+bool HasSidecarReferences(const CurveShape& shape) {
+  return shape.has_p_ref() || shape.has_n_ref();
+}
+
+bool HasSidecarReferences(const LoopSubdivShape& shape) {
+  return shape.has_p_ref() || shape.has_indices_ref();
+}
+
+bool HasSidecarReferences(const TriangleMeshShape& shape) {
+  return shape.has_p_ref() || shape.has_indices_ref() || shape.has_n_ref() ||
+         shape.has_s_ref() || shape.has_uv_ref() || shape.has_faceindices_ref();
+}
+
+bool HasSidecarReferences(const UniformGridMedium& medium) {
+  return medium.has_density_ref() || medium.has_temperature_ref();
+}
+
+absl::Span<const double> GetPositions(const CurveShape& shape,
+                                      std::vector<double>& storage) {
+  return GetShapePositions(shape, storage);
+}
+
+absl::Span<const double> GetPositions(const LoopSubdivShape& shape,
+                                      std::vector<double>& storage) {
+  return GetShapePositions(shape, storage);
+}
+
+absl::Span<const double> GetPositions(const NurbsShape& shape,
+                                      std::vector<double>& storage) {
+  return Get(shape.p(), kVector3Components, /*packed=*/{},
+             AsSpan(shape.p_xyz_f32()), storage);
+}
+
+absl::Span<const double> GetPositions(const TriangleMeshShape& shape,
+                                      std::vector<double>& storage) {
+  if (shape.has_p_quantized()) {
+    Dequantize(shape.p_quantized(), storage);
+    return storage;
+  }
+
+  return GetShapePositions(shape, storage);
+}
+
+absl::Span<const float> GetPositions(const CurveShape& shape,
+                                     std::vector<float>& storage) {
+  return GetShapePositions(shape, storage);
+}
+
+absl::Span<const float> GetPositions(const LoopSubdivShape& shape,
+                                     std::vector<float>& storage) {
+  return GetShapePositions(shape, storage);
+}
+
+absl::Span<const float> GetPositions(const NurbsShape& shape,
+                                     std::vector<float>& storage) {
+  return Get(shape.p(), kVector3Components, /*packed=*/{},
+             AsSpan(shape.p_xyz_f32()), storage);
+}
+
+absl::Span<const float> GetPositions(const TriangleMeshShape& shape,
+                                     std::vector<float>& storage) {
+  if (shape.has_p_quantized()) {
+    Dequantize(shape.p_quantized(), storage);
+    return storage;
+  }
+
+  return GetShapePositions(shape, storage);
+}
+
+absl::Span<const double> GetWeightedPositions(const NurbsShape& shape,
+                                              std::vector<double>& storage) {
+  return Get(shape.pw(), kWeightedPointComponents, /*packed=*/{},
+             AsSpan(shape.pw_xyzw_f32()), storage);
+}
+
+absl::Span<const float> GetWeightedPositions(const NurbsShape& shape,
+                                             std::vector<float>& storage) {
+  return Get(shape.pw(), kWeightedPointComponents, /*packed=*/{},
+             AsSpan(shape.pw_xyzw_f32()), storage);
+}
+
+absl::Span<const double> GetNormals(const CurveShape& shape,
+                                    std::vector<double>& storage) {
+  return GetShapeNormals(shape, storage);
+}
+
+absl::Span<const double> GetNormals(const TriangleMeshShape& shape,
+                                    std::vector<double>& storage) {
+  if (shape.has_n_octahedral()) {
+    DecodeOctahedral(shape.n_octahedral(), storage);
+    return storage;
+  }
+
+  return GetShapeNormals(shape, storage);
+}
+
+absl::Span<const float> GetNormals(const CurveShape& shape,
+                                   std::vector<float>& storage) {
+  return GetShapeNormals(shape, storage);
+}
+
+absl::Span<const float> GetNormals(const TriangleMeshShape& shape,
+                                   std::vector<float>& storage) {
+  if (shape.has_n_octahedral()) {
+    DecodeOctahedral(shape.n_octahedral(), storage);
+    return storage;
+  }
+
+  return GetShapeNormals(shape, storage);
+}
+
+absl::Span<const double> GetTangents(const TriangleMeshShape& shape,
+                                     std::vector<double>& storage) {
+  if (shape.has_s_octahedral()) {
+    DecodeOctahedral(shape.s_octahedral(), storage);
+    return storage;
+  }
+
+  return Get(shape.s(), kVector3Components, AsSpan(shape.s_xyz()),
+             AsSpan(shape.s_xyz_f32()), storage);
+}
+
+absl::Span<const float> GetTangents(const TriangleMeshShape& shape,
+                                    std::vector<float>& storage) {
+  if (shape.has_s_octahedral()) {
+    DecodeOctahedral(shape.s_octahedral(), storage);
+    return storage;
+  }
+
+  return Get(shape.s(), kVector3Components, AsSpan(shape.s_xyz()),
+             AsSpan(shape.s_xyz_f32()), storage);
+}
+
+absl::Span<const double> GetUVs(const TriangleMeshShape& shape,
+                                std::vector<double>& storage) {
+  if (shape.has_uv_quantized()) {
+    Dequantize(shape.uv_quantized(), storage);
+    return storage;
+  }
+
+  return Get(shape.uv(), kUVComponents, AsSpan(shape.uv_flat()),
+             AsSpan(shape.uv_flat_f32()), storage);
+}
+
+absl::Span<const float> GetUVs(const TriangleMeshShape& shape,
+                               std::vector<float>& storage) {
+  if (shape.has_uv_quantized()) {
+    Dequantize(shape.uv_quantized(), storage);
+    return storage;
+  }
+
+  return Get(shape.uv(), kUVComponents, AsSpan(shape.uv_flat()),
+             AsSpan(shape.uv_flat_f32()), storage);
+}
+
+absl::Span<const uint32_t> GetIndices(const LoopSubdivShape& shape,
+                                      std::vector<uint32_t>& storage) {
+  return GetShapeIndices(shape, storage);
+}
+
+absl::Span<const uint32_t> GetIndices(const TriangleMeshShape& shape,
+                                      std::vector<uint32_t>& storage) {
+  if (!shape.indices_delta().empty()) {
+    DeltaDecode(AsSpan(shape.indices_delta()), storage);
+    return storage;
+  }
+
+  return GetShapeIndices(shape, storage);
+}
+
+absl::Span<const int32_t> GetFaceIndices(const TriangleMeshShape& shape) {
+  if (shape.faceindices().empty() || !shape.faceindices_flat().empty()) {
+    return AsSpan(shape.faceindices_flat());
+  }
+
+  return AsSpan(shape.faceindices());
+}
+
+absl::Span<const double> GetDensity(const UniformGridMedium& medium,
+                                    std::vector<double>& storage) {
+  return Get(AsSpan(medium.density()), AsSpan(medium.density_f32()), storage);
+}
+
+absl::Span<const float> GetDensity(const UniformGridMedium& medium,
+                                   std::vector<float>& storage) {
+  return Get(AsSpan(medium.density()), AsSpan(medium.density_f32()), storage);
+}
+
+absl::Span<const double> GetTemperature(const UniformGridMedium& medium,
+                                        std::vector<double>& storage) {
+  return Get(AsSpan(medium.temperature()), AsSpan(medium.temperature_f32()),
+             storage);
+}
+
+absl::Span<const float> GetTemperature(const UniformGridMedium& medium,
+                                       std::vector<float>& storage) {
+  return Get(AsSpan(medium.temperature()), AsSpan(medium.temperature_f32()),
+             storage);
+}
+
+absl::Span<const double> GetEmission(const RgbGridMedium& medium,
+                                     std::vector<double>& storage) {
+  return Get(medium.le(), kRgbComponents, AsSpan(medium.le_rgb()),
+             /*packed_f32=*/{}, storage);
+}
+
+absl::Span<const double> GetSamples(const SampledSpectrum& spectrum,
+                                    std::vector<double>& storage) {
+  return Get(spectrum.samples(), kSampleComponents,
+             AsSpan(spectrum.samples_flat()), /*packed_f32=*/{}, storage);
+}
+
+}  // namespace pbrt_proto
@@ -0,0 +1,161 @@
+#ifndef _PBRT_PROTO_SHARED_GEOMETRY_
+#define _PBRT_PROTO_SHARED_GEOMETRY_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "absl/functional/function_ref.h"
+#include "absl/types/span.h"
+#include "pbrt_proto/pbrt.pb.h"
+#include "pbrt_proto/shared/compression.h"
+
+namespace pbrt_proto {
+
+// Moves the per-vertex and per-face geometry of a shape from its repeated
+// message fields into the equivalent packed fields (`P_xyz`, `indices_flat`,
+// etc.), which are considerably smaller when serialized and faster to parse.
+// Fields that are already packed are left unchanged.
+void PackGeometry(CurveShape& shape);
+void PackGeometry(LoopSubdivShape& shape);
+void PackGeometry(TriangleMeshShape& shape);
+
+// Like `PackGeometry`, but stores vertex data in the single precision fields
+// (`P_xyz_f32`, etc.), halving its size. Values in either the repeated message
+// fields or the packed double precision fields are rounded as described by
+// `RoundToFloat`. Indices are stored exactly as by `PackGeometry`.
+void PackGeometryFloat32(CurveShape& shape);
+void PackGeometryFloat32(LoopSubdivShape& shape);
+void PackGeometryFloat32(NurbsShape& shape);
+void PackGeometryFloat32(TriangleMeshShape& shape);
+
+// Replaces the geometry of a mesh with the compressed encodings described in
+// `pbrt.proto` (`indices_delta`, `P_quantized`, etc.) at the precision given by
+// `options`. The indices are encoded losslessly. Arrays that cannot be
+// represented by their lossy encoding, such as positions that are not finite
+// or normals of zero length, are left as they are. The largest error
+// introduced in each array is recorded in its `max_error` field.
+void CompressGeometry(TriangleMeshShape& shape,
+                      const MeshCompressionOptions& options);
+
+// Splits a mesh into parts that each serialize to at most `max_size` bytes and
+// passes them to `output` in order. Each part holds a run of consecutive
+// triangles, their face indices, and only the vertices they reference,
+// renumbered in the order they are first referenced. `alpha`, `shadowalpha`,
+// and `discarddegenerateUVs` are copied to every part. Rendering the parts
+// produces the same image as rendering the mesh.
+//
+// Returns false without calling `output` if the mesh cannot be split without
+// changing its meaning: if it has no triangles, uses any of the alternate
+// encodings, has an index that does not refer to a vertex, or has normals,
+// tangents, texture coordinates, or face indices that do not match the
+// number of vertices or triangles. Also returns false if a single triangle
+// does not fit in `max_size` bytes.
+bool SplitGeometry(const TriangleMeshShape& shape, size_t max_size,
+                   absl::FunctionRef<void(TriangleMeshShape&)> output);
+
+// Moves the voxel values of a grid medium into its single precision fields
+// (`density_f32`, etc.), rounding as described by `RoundToFloat`.
+void PackGridFloat32(UniformGridMedium& medium);
+
+// Moves the emission of an RGB grid medium into `Le_rgb`.
+void PackEmission(RgbGridMedium& medium);
+
+// Moves the samples of a spectrum into `samples_flat`.
+void PackSamples(SampledSpectrum& spectrum);
+
+// Returns true if any of the arrays of a shape or medium are stored in a
+// geometry sidecar (`P_ref`, `density_ref`, etc.) rather than in the proto.
+bool HasSidecarReferences(const CurveShape& shape);
+bool HasSidecarReferences(const LoopSubdivShape& shape);
+bool HasSidecarReferences(const TriangleMeshShape& shape);
+bool HasSidecarReferences(const UniformGridMedium& medium);
+
+// Accessors that return the geometry of a shape or the voxels of a medium as
+// flat arrays regardless of which of its fields they are stored in. If the
+// values are stored in a packed field of the requested precision the returned
+// span refers to it directly; otherwise, the values are converted or decoded
+// into `storage` and the returned span refers to `storage`.
+//
+// The `*_ref` fields are not resolved: an array stored in a sidecar is returned
+// as empty. Use `HasSidecarReferences` to tell such an array from an empty one
+// and `SidecarReader` to read it.
+
+// Returns consecutive x, y, and z coordinates of `P`.
+absl::Span<const double> GetPositions(const CurveShape& shape,
+                                      std::vector<double>& storage);
+absl::Span<const double> GetPositions(const LoopSubdivShape& shape,
+                                      std::vector<double>& storage);
+absl::Span<const double> GetPositions(const NurbsShape& shape,
+                                      std::vector<double>& storage);
+absl::Span<const double> GetPositions(const TriangleMeshShape& shape,
+                                      std::vector<double>& storage);
+absl::Span<const float> GetPositions(const CurveShape& shape,
+                                     std::vector<float>& storage);
+absl::Span<const float> GetPositions(const LoopSubdivShape& shape,
+                                     std::vector<float>& storage);
+absl::Span<const float> GetPositions(const NurbsShape& shape,
+                                     std::vector<float>& storage);
+absl::Span<const float> GetPositions(const TriangleMeshShape& shape,
+                                     std::vector<float>& storage);
+
+// Returns consecutive x, y, z, and weight values of `Pw`.
+absl::Span<const double> GetWeightedPositions(const NurbsShape& shape,
+                                              std::vector<double>& storage);
+absl::Span<const float> GetWeightedPositions(const NurbsShape& shape,
+                                             std::vector<float>& storage);
+
+// Returns consecutive x, y, and z components of `N`.
+absl::Span<const double> GetNormals(const CurveShape& shape,
+                                    std::vector<double>& storage);
+absl::Span<const double> GetNormals(const TriangleMeshShape& shape,
+                                    std::vector<double>& storage);
+absl::Span<const float> GetNormals(const CurveShape& shape,
+                                   std::vector<float>& storage);
+absl::Span<const float> GetNormals(const TriangleMeshShape& shape,
+                                   std::vector<float>& storage);
+
+// Returns consecutive x, y, and z components of `S`.
+absl::Span<const double> GetTangents(const TriangleMeshShape& shape,
+                                     std::vector<double>& storage);
+absl::Span<const float> GetTangents(const TriangleMeshShape& shape,
+                                    std::vector<float>& storage);
+
+// Returns consecutive u and v coordinates of `uv`.
+absl::Span<const double> GetUVs(const TriangleMeshShape& shape,
+                                std::vector<double>& storage);
+absl::Span<const float> GetUVs(const TriangleMeshShape& shape,
+                               std::vector<float>& storage);
+
+// Returns consecutive v0, v1, and v2 indices of `indices`.
+absl::Span<const uint32_t> GetIndices(const LoopSubdivShape& shape,
+                                      std::vector<uint32_t>& storage);
+absl::Span<const uint32_t> GetIndices(const TriangleMeshShape& shape,
+                                      std::vector<uint32_t>& storage);
+
+// Returns the values of `faceIndices`. No copy is required for either form.
+absl::Span<const int32_t> GetFaceIndices(const TriangleMeshShape& shape);
+
+// Returns the values of `density` in row-major order.
+absl::Span<const double> GetDensity(const UniformGridMedium& medium,
+                                    std::vector<double>& storage);
+absl::Span<const float> GetDensity(const UniformGridMedium& medium,
+                                   std::vector<float>& storage);
+
+// Returns the values of `temperature` in row-major order.
+absl::Span<const double> GetTemperature(const UniformGridMedium& medium,
+                                        std::vector<double>& storage);
+absl::Span<const float> GetTemperature(const UniformGridMedium& medium,
+                                       std::vector<float>& storage);
+
+// Returns consecutive r, g, and b values of `Le` in row-major order.
+absl::Span<const double> GetEmission(const RgbGridMedium& medium,
+                                     std::vector<double>& storage);
+
+// Returns consecutive wavelength and intensity values of `samples`.
+absl::Span<const double> GetSamples(const SampledSpectrum& spectrum,
+                                    std::vector<double>& storage);
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_GEOMETRY_
@@ -0,0 +1,558 @@
+#include "pbrt_proto/shared/geometry.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pbrt_proto/pbrt.pb.h"
+#include "pbrt_proto/testing/proto_matchers.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::google::protobuf::EqualsProto;
+using ::google::protobuf::ParseTextOrDie;
+using ::testing::DoubleNear;
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::Pointwise;
+
+TriangleMeshShape MakeTriangleMesh() {
+  return ParseTextOrDie(R"pb(
+    P { x: 1.0 y: 2.0 z: 3.0 }
+    P { x: 4.0 y: 5.0 z: 6.0 }
+    P { x: 7.0 y: 8.0 z: 9.0 }
+    indices { v0: 0 v1: 1 v2: 2 }
+    N { x: 0.0 y: 0.0 z: 1.0 }
+    S { x: 1.0 y: 0.0 z: 0.0 }
+    uv { u: 0.25 v: 0.75 }
+    faceIndices: 7
+    discarddegenerateUVs: true
+  )pb");
+}
+
+TEST(PackGeometry, Empty) {
+  TriangleMeshShape shape;
+  PackGeometry(shape);
+  EXPECT_THAT(shape, EqualsProto(R"pb()pb"));
+}
+
+TEST(PackGeometry, Curve) {
+  CurveShape shape = ParseTextOrDie(R"pb(
+    P { x: 1.0 y: 2.0 z: 3.0 }
+    N { x: 4.0 y: 5.0 z: 6.0 }
+    width: 2.0
+  )pb");
+
+  PackGeometry(shape);
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                width: 2.0
+                P_xyz: [ 1.0, 2.0, 3.0 ]
+                N_xyz: [ 4.0, 5.0, 6.0 ]
+              )pb"));
+}
+
+TEST(PackGeometry, LoopSubdiv) {
+  LoopSubdivShape shape = ParseTextOrDie(R"pb(
+    P { x: 1.0 y: 2.0 z: 3.0 }
+    indices { v0: 0 v1: 0 v2: 0 }
+    levels: 2
+  )pb");
+
+  PackGeometry(shape);
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                levels: 2
+                P_xyz: [ 1.0, 2.0, 3.0 ]
+                indices_flat: [ 0, 0, 0 ]
+              )pb"));
+}
+
+TEST(PackGeometry, TriangleMesh) {
+  TriangleMeshShape shape = MakeTriangleMesh();
+  PackGeometry(shape);
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                discarddegenerateUVs: true
+                P_xyz: [ 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0 ]
+                indices_flat: [ 0, 1, 2 ]
+                N_xyz: [ 0.0, 0.0, 1.0 ]
+                S_xyz: [ 1.0, 0.0, 0.0 ]
+                uv_flat: [ 0.25, 0.75 ]
+                faceIndices_flat: [ 7 ]
+              )pb"));
+}
+
+TEST(PackGeometry, AlreadyPacked) {
+  TriangleMeshShape shape = MakeTriangleMesh();
+  PackGeometry(shape);
+
+  TriangleMeshShape packed = shape;
+  PackGeometry(packed);
+  EXPECT_EQ(packed.DebugString(), shape.DebugString());
+}
+
+TEST(PackGeometryFloat32, TriangleMesh) {
+  TriangleMeshShape shape = MakeTriangleMesh();
+  shape.mutable_p(0)->set_x(0.1);
+
+  PackGeometryFloat32(shape);
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                discarddegenerateUVs: true
+                indices_flat: [ 0, 1, 2 ]
+                faceIndices_flat: [ 7 ]
+                P_xyz_f32: [ 0.1, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0 ]
+                N_xyz_f32: [ 0.0, 0.0, 1.0 ]
+                S_xyz_f32: [ 1.0, 0.0, 0.0 ]
+                uv_flat_f32: [ 0.25, 0.75 ]
+              )pb"));
+}
+
+TEST(PackGeometryFloat32, FromPacked) {
+  TriangleMeshShape unpacked = MakeTriangleMesh();
+  PackGeometryFloat32(unpacked);
+
+  TriangleMeshShape packed = MakeTriangleMesh();
+  PackGeometry(packed);
+  PackGeometryFloat32(packed);
+
+  EXPECT_EQ(packed.DebugString(), unpacked.DebugString());
+}
+
+TEST(PackGeometryFloat32, Curve) {
+  CurveShape shape = ParseTextOrDie(R"pb(
+    P { x: 1.0 y: 2.0 z: 3.0 }
+    N { x: 4.0 y: 5.0 z: 6.0 }
+  )pb");
+
+  PackGeometryFloat32(shape);
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                P_xyz_f32: [ 1.0, 2.0, 3.0 ]
+                N_xyz_f32: [ 4.0, 5.0, 6.0 ]
+              )pb"));
+}
+
+TEST(PackGeometryFloat32, LoopSubdiv) {
+  LoopSubdivShape shape = ParseTextOrDie(R"pb(
+    P { x: 1.0 y: 2.0 z: 3.0 }
+    indices { v0: 0 v1: 0 v2: 0 }
+  )pb");
+
+  PackGeometryFloat32(shape);
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                indices_flat: [ 0, 0, 0 ]
+                P_xyz_f32: [ 1.0, 2.0, 3.0 ]
+              )pb"));
+}
+
+TEST(PackGeometryFloat32, Nurbs) {
+  NurbsShape shape = ParseTextOrDie(R"pb(
+    nu: 1
+    P { x: 1.0 y: 2.0 z: 3.0 }
+    Pw {
+      p { x: 4.0 y: 5.0 z: 6.0 }
+      weight: 0.5
+    }
+  )pb");
+
+  PackGeometryFloat32(shape);
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                nu: 1
+                P_xyz_f32: [ 1.0, 2.0, 3.0 ]
+                Pw_xyzw_f32: [ 4.0, 5.0, 6.0, 0.5 ]
+              )pb"));
+
+  std::vector<double> positions;
+  EXPECT_THAT(GetPositions(shape, positions), ElementsAre(1.0, 2.0, 3.0));
+
+  std::vector<double> weighted_positions;
+  EXPECT_THAT(GetWeightedPositions(shape, weighted_positions),
+              ElementsAre(4.0, 5.0, 6.0, 0.5));
+}
+
+TEST(CompressGeometry, TriangleMesh) {
+  TriangleMeshShape shape = MakeTriangleMesh();
+  CompressGeometry(shape, MeshCompressionOptions());
+
+  EXPECT_THAT(shape.p(), IsEmpty());
+  EXPECT_THAT(shape.indices(), IsEmpty());
+  EXPECT_THAT(shape.n(), IsEmpty());
+  EXPECT_THAT(shape.s(), IsEmpty());
+  EXPECT_THAT(shape.uv(), IsEmpty());
+  EXPECT_THAT(shape.faceindices(), ElementsAre(7));
+  EXPECT_TRUE(shape.discarddegenerateuvs());
+
+  EXPECT_THAT(shape.indices_delta(), ElementsAre(0, 1, 1));
+  EXPECT_EQ(16u, shape.p_quantized().bits());
+  EXPECT_EQ(12u, shape.n_octahedral().bits());
+  EXPECT_EQ(12u, shape.s_octahedral().bits());
+  EXPECT_EQ(16u, shape.uv_quantized().bits());
+
+  std::vector<double> storage;
+  EXPECT_THAT(GetPositions(shape, storage),
+              Pointwise(DoubleNear(shape.p_quantized().max_error()),
+                        {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0}));
+  EXPECT_LT(0.0, shape.p_quantized().max_error());
+  EXPECT_GT(1e-4, shape.p_quantized().max_error());
+  EXPECT_THAT(GetNormals(shape, storage), ElementsAre(0.0, 0.0, 1.0));
+  EXPECT_THAT(GetTangents(shape, storage), ElementsAre(1.0, 0.0, 0.0));
+  EXPECT_THAT(GetUVs(shape, storage), ElementsAre(0.25, 0.75));
+
+  std::vector<float> storage_f32;
+  EXPECT_THAT(GetNormals(shape, storage_f32), ElementsAre(0.0f, 0.0f, 1.0f));
+
+  std::vector<uint32_t> index_storage;
+  EXPECT_THAT(GetIndices(shape, index_storage), ElementsAre(0u, 1u, 2u));
+}
+
+TEST(CompressGeometry, Unrepresentable) {
+  TriangleMeshShape shape = ParseTextOrDie(R"pb(
+    P_xyz: [ 1.0, 2.0, inf ]
+    N_xyz: [ 0.0, 0.0, 0.0 ]
+  )pb");
+  CompressGeometry(shape, MeshCompressionOptions());
+
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                P_xyz: [ 1.0, 2.0, inf ]
+                N_xyz: [ 0.0, 0.0, 0.0 ]
+              )pb"));
+}
+
+TEST(SplitGeometry, TriangleMesh) {
+  TriangleMeshShape shape = ParseTextOrDie(R"pb(
+    alpha { float_texture_name: "cutout" }
+    discarddegenerateUVs: true
+  )pb");
+  for (int i = 0; i < 12; i++) {
+    Point& p = *shape.add_p();
+    p.set_x(i);
+    p.set_y(i * 2.0);
+    p.set_z(i * 3.0);
+    shape.add_uv()->set_u(i / 16.0);
+    shape.mutable_uv(i)->set_v(0.5);
+  }
+  for (uint32_t i = 0; i < 10; i++) {
+    VertexIndices& triangle = *shape.add_indices();
+    triangle.set_v0(11 - i);
+    triangle.set_v1(11 - i - 1);
+    triangle.set_v2(11 - i - 2 + (i % 3 == 0 ? 1 : 0));
+    shape.add_faceindices(static_cast<int32_t>(i) - 5);
+  }
+
+  const size_t max_size = 250;
+  std::vector<TriangleMeshShape> parts;
+  ASSERT_TRUE(SplitGeometry(shape, max_size, [&](TriangleMeshShape& part) {
+    parts.emplace_back().Swap(&part);
+  }));
+  ASSERT_LT(1u, parts.size());
+
+  std::vector<double> expected, actual;
+  for (const VertexIndices& triangle : shape.indices()) {
+    for (uint32_t vertex : {triangle.v0(), triangle.v1(), triangle.v2()}) {
+      expected.push_back(shape.p(vertex).x());
+      expected.push_back(shape.uv(vertex).u());
+    }
+  }
+
+  std::vector<int32_t> face_indices;
+  for (const TriangleMeshShape& part : parts) {
+    EXPECT_GE(max_size, part.ByteSizeLong());
+    EXPECT_THAT(part.alpha(),
+                EqualsProto(R"pb(float_texture_name: "cutout")pb"));
+    EXPECT_TRUE(part.discarddegenerateuvs());
+    EXPECT_FALSE(part.has_shadowalpha());
+    EXPECT_EQ(part.p_size(), part.uv_size());
+    EXPECT_THAT(part.n(), IsEmpty());
+    EXPECT_THAT(part.s(), IsEmpty());
+
+    // Every vertex of a part is referenced, in order of first reference
+    uint32_t next_vertex = 0;
+    for (const VertexIndices& triangle : part.indices()) {
+      for (uint32_t vertex : {triangle.v0(), triangle.v1(), triangle.v2()}) {
+        ASSERT_GE(next_vertex, vertex);
+        if (vertex == next_vertex) {
+          next_vertex++;
+        }
+        actual.push_back(part.p(vertex).x());
+        actual.push_back(part.uv(vertex).u());
+      }
+    }
+    EXPECT_EQ(static_cast<uint32_t>(part.p_size()), next_vertex);
+
+    face_indices.insert(face_indices.end(), part.faceindices().begin(),
+                        part.faceindices().end());
+  }
+
+  EXPECT_EQ(expected, actual);
+  EXPECT_THAT(face_indices, ElementsAre(-5, -4, -3, -2, -1, 0, 1, 2, 3, 4));
+}
+
+// A mesh without the single normal, tangent, and texture coordinate of
+// `MakeTriangleMesh`, which do not match its three points
+TriangleMeshShape MakeSplittableMesh() {
+  TriangleMeshShape shape = MakeTriangleMesh();
+  shape.clear_n();
+  shape.clear_s();
+  shape.clear_uv();
+  return shape;
+}
+
+TEST(SplitGeometry, Fits) {
+  TriangleMeshShape shape = MakeSplittableMesh();
+
+  std::vector<TriangleMeshShape> parts;
+  ASSERT_TRUE(SplitGeometry(shape, shape.ByteSizeLong(),
+                            [&](TriangleMeshShape& part) {
+                              parts.emplace_back().Swap(&part);
+                            }));
+  ASSERT_EQ(1u, parts.size());
+  EXPECT_EQ(parts[0].DebugString(), shape.DebugString());
+}
+
+TEST(SplitGeometry, Rejects) {
+  size_t num_parts = 0;
+  auto count = [&](TriangleMeshShape& part) { num_parts++; };
+
+  TriangleMeshShape shape = MakeSplittableMesh();
+  EXPECT_FALSE(SplitGeometry(shape, shape.ByteSizeLong() / 2, count));
+
+  shape = MakeSplittableMesh();
+  shape.mutable_indices(0)->set_v2(3);
+  EXPECT_FALSE(SplitGeometry(shape, 1000, count));
+
+  shape = MakeSplittableMesh();
+  shape.add_n();
+  EXPECT_FALSE(SplitGeometry(shape, 1000, count));
+
+  shape = MakeSplittableMesh();
+  shape.add_faceindices(8);
+  EXPECT_FALSE(SplitGeometry(shape, 1000, count));
+
+  shape = MakeSplittableMesh();
+  PackGeometry(shape);
+  EXPECT_FALSE(SplitGeometry(shape, 1000, count));
+
+  shape = MakeSplittableMesh();
+  shape.clear_indices();
+  EXPECT_FALSE(SplitGeometry(shape, 1000, count));
+
+  EXPECT_EQ(0u, num_parts);
+}
+
+TEST(PackGridFloat32, UniformGrid) {
+  UniformGridMedium medium = ParseTextOrDie(R"pb(
+    nx: 2
+    density: [ 0.5, 1e300 ]
+    temperature: [ 1000.0, 2000.0 ]
+  )pb");
+
+  PackGridFloat32(medium);
+  EXPECT_THAT(medium, EqualsProto(R"pb(
+                nx: 2
+                density_f32: [ 0.5, 3.4028234663852886e+38 ]
+                temperature_f32: [ 1000.0, 2000.0 ]
+              )pb"));
+
+  std::vector<double> density;
+  EXPECT_THAT(GetDensity(medium, density),
+              ElementsAre(0.5, std::numeric_limits<float>::max()));
+
+  std::vector<float> temperature;
+  EXPECT_THAT(GetTemperature(medium, temperature),
+              ElementsAre(1000.0f, 2000.0f));
+  EXPECT_THAT(temperature, IsEmpty());
+}
+
+TEST(PackSamples, SampledSpectrum) {
+  SampledSpectrum spectrum = ParseTextOrDie(R"pb(
+    samples { wavelength: 400.0 intensity: 0.25 }
+    samples { wavelength: 500.0 intensity: 0.5 }
+  )pb");
+
+  std::vector<double> unpacked;
+  EXPECT_THAT(GetSamples(spectrum, unpacked),
+              ElementsAre(400.0, 0.25, 500.0, 0.5));
+
+  PackSamples(spectrum);
+  EXPECT_THAT(spectrum, EqualsProto(R"pb(
+                samples_flat: [ 400.0, 0.25, 500.0, 0.5 ]
+              )pb"));
+
+  std::vector<double> packed;
+  EXPECT_THAT(GetSamples(spectrum, packed),
+              ElementsAre(400.0, 0.25, 500.0, 0.5));
+  EXPECT_THAT(packed, IsEmpty());
+}
+
+TEST(PackEmission, RgbGrid) {
+  RgbGridMedium medium = ParseTextOrDie(R"pb(
+    nx: 1
+    ny: 1
+    nz: 2
+    Le { r: 1.0 g: 2.0 b: 3.0 }
+    Le { r: 4.0 g: 5.0 b: 6.0 }
+  )pb");
+
+  PackEmission(medium);
+  EXPECT_THAT(medium, EqualsProto(R"pb(
+                nx: 1
+                ny: 1
+                nz: 2
+                Le_rgb: [ 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 ]
+              )pb"));
+}
+
+TEST(GetEmission, RgbGrid) {
+  RgbGridMedium unpacked = ParseTextOrDie(R"pb(
+    Le { r: 1.0 g: 2.0 b: 3.0 }
+    Le { r: 4.0 g: 5.0 b: 6.0 }
+  )pb");
+
+  std::vector<double> storage;
+  EXPECT_THAT(GetEmission(unpacked, storage),
+              ElementsAre(1.0, 2.0, 3.0, 4.0, 5.0, 6.0));
+
+  RgbGridMedium packed = ParseTextOrDie(R"pb(
+    Le_rgb: [ 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 ]
+  )pb");
+
+  std::vector<double> unused;
+  EXPECT_THAT(GetEmission(packed, unused),
+              ElementsAre(1.0, 2.0, 3.0, 4.0, 5.0, 6.0));
+  EXPECT_THAT(unused, IsEmpty());
+}
+
+TEST(GetGeometry, Unpacked) {
+  TriangleMeshShape shape = MakeTriangleMesh();
+
+  std::vector<double> positions;
+  EXPECT_THAT(GetPositions(shape, positions),
+              ElementsAre(1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0));
+  EXPECT_EQ(positions.size(), 9u);
+
+  std::vector<double> normals;
+  EXPECT_THAT(GetNormals(shape, normals), ElementsAre(0.0, 0.0, 1.0));
+
+  std::vector<double> tangents;
+  EXPECT_THAT(GetTangents(shape, tangents), ElementsAre(1.0, 0.0, 0.0));
+
+  std::vector<double> uvs;
+  EXPECT_THAT(GetUVs(shape, uvs), ElementsAre(0.25, 0.75));
+
+  std::vector<uint32_t> indices;
+  EXPECT_THAT(GetIndices(shape, indices), ElementsAre(0u, 1u, 2u));
+
+  EXPECT_THAT(GetFaceIndices(shape), ElementsAre(7));
+}
+
+TEST(GetGeometry, Packed) {
+  TriangleMeshShape shape = MakeTriangleMesh();
+  PackGeometry(shape);
+
+  std::vector<double> positions;
+  EXPECT_THAT(GetPositions(shape, positions),
+              ElementsAre(1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0));
+  EXPECT_THAT(positions, IsEmpty());
+
+  std::vector<double> normals;
+  EXPECT_THAT(GetNormals(shape, normals), ElementsAre(0.0, 0.0, 1.0));
+  EXPECT_THAT(normals, IsEmpty());
+
+  std::vector<double> tangents;
+  EXPECT_THAT(GetTangents(shape, tangents), ElementsAre(1.0, 0.0, 0.0));
+  EXPECT_THAT(tangents, IsEmpty());
+
+  std::vector<double> uvs;
+  EXPECT_THAT(GetUVs(shape, uvs), ElementsAre(0.25, 0.75));
+  EXPECT_THAT(uvs, IsEmpty());
+
+  std::vector<uint32_t> indices;
+  EXPECT_THAT(GetIndices(shape, indices), ElementsAre(0u, 1u, 2u));
+  EXPECT_THAT(indices, IsEmpty());
+
+  EXPECT_THAT(GetFaceIndices(shape), ElementsAre(7));
+}
+
+TEST(GetGeometry, Float32) {
+  TriangleMeshShape shape = MakeTriangleMesh();
+  shape.mutable_p(0)->set_x(0.1);
+
+  std::vector<float> from_unpacked;
+  EXPECT_THAT(GetPositions(shape, from_unpacked),
+              ElementsAre(0.1f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f,
+                          9.0f));
+
+  PackGeometry(shape);
+
+  std::vector<float> from_packed;
+  EXPECT_THAT(GetPositions(shape, from_packed),
+              ElementsAre(0.1f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f,
+                          9.0f));
+
+  PackGeometryFloat32(shape);
+
+  std::vector<float> direct;
+  EXPECT_THAT(GetPositions(shape, direct),
+              ElementsAre(0.1f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f,
+                          9.0f));
+  EXPECT_THAT(direct, IsEmpty());
+
+  std::vector<double> widened;
+  EXPECT_THAT(GetPositions(shape, widened),
+              ElementsAre(static_cast<double>(0.1f), 2.0, 3.0, 4.0, 5.0, 6.0,
+                          7.0, 8.0, 9.0));
+
+  std::vector<float> normals;
+  EXPECT_THAT(GetNormals(shape, normals), ElementsAre(0.0f, 0.0f, 1.0f));
+
+  std::vector<float> tangents;
+  EXPECT_THAT(GetTangents(shape, tangents), ElementsAre(1.0f, 0.0f, 0.0f));
+
+  std::vector<float> uvs;
+  EXPECT_THAT(GetUVs(shape, uvs), ElementsAre(0.25f, 0.75f));
+}
+
+TEST(GetGeometry, Empty) {
+  CurveShape curve;
+  LoopSubdivShape loop_subdiv;
+
+  std::vector<double> values;
+  EXPECT_THAT(GetPositions(curve, values), IsEmpty());
+  EXPECT_THAT(GetNormals(curve, values), IsEmpty());
+  EXPECT_THAT(GetPositions(loop_subdiv, values), IsEmpty());
+
+  std::vector<uint32_t> indices;
+  EXPECT_THAT(GetIndices(loop_subdiv, indices), IsEmpty());
+}
+
+
+TEST(HasSidecarReferences, Shapes) {
+  CurveShape curve;
+  EXPECT_FALSE(HasSidecarReferences(curve));
+  curve.mutable_n_ref();
+  EXPECT_TRUE(HasSidecarReferences(curve));
+
+  LoopSubdivShape loop_subdiv;
+  EXPECT_FALSE(HasSidecarReferences(loop_subdiv));
+  loop_subdiv.mutable_indices_ref();
+  EXPECT_TRUE(HasSidecarReferences(loop_subdiv));
+
+  TriangleMeshShape mesh;
+  mesh.add_p_xyz(1.0);
+  EXPECT_FALSE(HasSidecarReferences(mesh));
+  mesh.mutable_uv_ref();
+  EXPECT_TRUE(HasSidecarReferences(mesh));
+
+  std::vector<double> values;
+  EXPECT_THAT(GetUVs(mesh, values), IsEmpty());
+}
+
+TEST(HasSidecarReferences, UniformGrid) {
+  UniformGridMedium medium;
+  medium.add_density(1.0);
+  EXPECT_FALSE(HasSidecarReferences(medium));
+  medium.mutable_temperature_ref();
+  EXPECT_TRUE(HasSidecarReferences(medium));
+}
+}  // namespace
+}  // namespace pbrt_proto
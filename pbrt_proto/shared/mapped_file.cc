@@ -0,0 +1,231 @@
+#include "pbrt_proto/shared/mapped_file.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "pbrt_proto/shared/trace.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pbrt_proto {
+namespace {
+
+absl::Status OpenError(const std::filesystem::path& path) {
+  return absl::NotFoundError(
+      absl::StrCat("Could not open file: ", path.string()));
+}
+
+absl::Status MapError(const std::filesystem::path& path) {
+  return absl::InternalError(
+      absl::StrCat("Could not map file into memory: ", path.string()));
+}
+
+absl::Status ReadError(const std::filesystem::path& path) {
+  return absl::InternalError(
+      absl::StrCat("Could not read file: ", path.string()));
+}
+
+// The size of each read from a file that cannot be mapped
+constexpr size_t kReadSize = 1 << 16;
+
+}  // namespace
+
+absl::StatusOr<MappedFile> MappedFile::Open(
+    const std::filesystem::path& path) {
+  TraceScope trace("map", path);
+
+  std::error_code error_code;
+  if (std::filesystem::is_directory(path, error_code)) {
+    return OpenError(path);
+  }
+
+#ifdef _WIN32
+  HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return OpenError(path);
+  }
+
+  if (GetFileType(file) != FILE_TYPE_DISK) {
+    std::string contents;
+    for (;;) {
+      size_t size = contents.size();
+      contents.resize(size + kReadSize);
+      DWORD bytes_read;
+      if (!ReadFile(file, contents.data() + size, kReadSize, &bytes_read,
+                    nullptr)) {
+        contents.resize(size);
+        if (GetLastError() == ERROR_BROKEN_PIPE) {
+          break;
+        }
+        CloseHandle(file);
+        return ReadError(path);
+      }
+      contents.resize(size + bytes_read);
+      if (bytes_read == 0) {
+        break;
+      }
+    }
+    CloseHandle(file);
+    return MappedFile(std::move(contents));
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    return MapError(path);
+  }
+
+  if (file_size.QuadPart == 0) {
+    CloseHandle(file);
+    return MappedFile(nullptr, 0);
+  }
+
+  HANDLE mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  CloseHandle(file);
+  if (mapping == nullptr) {
+    return MapError(path);
+  }
+
+  const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (data == nullptr) {
+    return MapError(path);
+  }
+
+  return MappedFile(data, static_cast<size_t>(file_size.QuadPart));
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return OpenError(path);
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return MapError(path);
+  }
+
+  if (!S_ISREG(file_stat.st_mode)) {
+    std::string contents;
+    for (;;) {
+      size_t size = contents.size();
+      contents.resize(size + kReadSize);
+      ssize_t bytes_read = read(fd, contents.data() + size, kReadSize);
+      if (bytes_read < 0) {
+        contents.resize(size);
+        if (errno == EINTR) {
+          continue;
+        }
+        close(fd);
+        return ReadError(path);
+      }
+      contents.resize(size + static_cast<size_t>(bytes_read));
+      if (bytes_read == 0) {
+        break;
+      }
+    }
+    close(fd);
+    return MappedFile(std::move(contents));
+  }
+
+  if (file_stat.st_size == 0) {
+    close(fd);
+    return MappedFile(nullptr, 0);
+  }
+
+  size_t size = static_cast<size_t>(file_stat.st_size);
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return MapError(path);
+  }
+
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  return MappedFile(data, size);
+#endif
+}
+
+bool IsUnmappable(const std::filesystem::path& path) {
+  std::error_code error_code;
+  std::filesystem::file_status status =
+      std::filesystem::status(path, error_code);
+  return !error_code && std::filesystem::exists(status) &&
+         !std::filesystem::is_regular_file(status) &&
+         !std::filesystem::is_directory(status);
+}
+
+absl::StatusOr<std::ifstream> OpenStream(const std::filesystem::path& path) {
+  std::error_code error_code;
+  if (std::filesystem::is_directory(path, error_code)) {
+    return OpenError(path);
+  }
+
+  std::ifstream input(path, std::ios::binary | std::ios::in);
+  if (!input) {
+    return OpenError(path);
+  }
+
+  return input;
+}
+
+MappedFile::MappedFile(MappedFile&& moved_from) noexcept
+    : data_(moved_from.data_),
+      size_(moved_from.size_),
+      read_(std::move(moved_from.read_)) {
+  moved_from.data_ = nullptr;
+  moved_from.size_ = 0;
+  moved_from.read_.clear();
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& moved_from) noexcept {
+  if (this != &moved_from) {
+    Unmap();
+    data_ = moved_from.data_;
+    size_ = moved_from.size_;
+    read_ = std::move(moved_from.read_);
+    moved_from.data_ = nullptr;
+    moved_from.size_ = 0;
+    moved_from.read_.clear();
+  }
+  return *this;
+}
+
+MappedFile::~MappedFile() { Unmap(); }
+
+void MappedFile::Unmap() noexcept {
+  if (data_ == nullptr) {
+    return;
+  }
+
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+#else
+  munmap(const_cast<void*>(data_), size_);
+#endif
+
+  data_ = nullptr;
+  size_ = 0;
+}
+
+}  // namespace pbrt_proto
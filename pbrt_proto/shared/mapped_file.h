@@ -0,0 +1,63 @@
+#ifndef _PBRT_PROTO_SHARED_MAPPED_FILE_
+#define _PBRT_PROTO_SHARED_MAPPED_FILE_
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "absl/base/nullability.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+
+namespace pbrt_proto {
+
+// A read-only view of the contents of a file that has been mapped into memory.
+// Files that cannot be mapped, such as pipes and character devices, are read
+// into memory instead.
+class MappedFile {
+ public:
+  static absl::StatusOr<MappedFile> Open(const std::filesystem::path& path);
+
+  MappedFile(MappedFile&& moved_from) noexcept;
+  MappedFile& operator=(MappedFile&& moved_from) noexcept;
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  ~MappedFile();
+
+  absl::string_view contents() const {
+    if (data_ == nullptr) {
+      return read_;
+    }
+    return absl::string_view(static_cast<const char*>(data_), size_);
+  }
+
+ private:
+  MappedFile(const void* absl_nullable data, size_t size) noexcept
+      : data_(data), size_(size) {}
+
+  explicit MappedFile(std::string read) noexcept
+      : data_(nullptr), size_(0), read_(std::move(read)) {}
+
+  void Unmap() noexcept;
+
+  const void* absl_nullable data_;
+  size_t size_;
+  std::string read_;
+};
+
+// Returns true if `path` is a file that cannot be mapped into memory, such as a
+// pipe or character device. `MappedFile::Open` reads such files into memory in
+// full, so callers that can read their input in chunks should open them with
+// `OpenStream` instead.
+bool IsUnmappable(const std::filesystem::path& path);
+
+// Opens the file at `path` for reading as a binary stream.
+absl::StatusOr<std::ifstream> OpenStream(const std::filesystem::path& path);
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_MAPPED_FILE_
@@ -0,0 +1,143 @@
+#include "pbrt_proto/shared/mapped_file.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/status_matchers.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace pbrt_proto {
+namespace {
+
+using ::absl_testing::StatusIs;
+
+std::filesystem::path MakeFile(const char* name, const char* contents) {
+  std::filesystem::path path = std::filesystem::path(testing::TempDir()) / name;
+  std::ofstream(path, std::ios::binary) << contents;
+  return path;
+}
+
+TEST(MappedFile, Missing) {
+  EXPECT_THAT(MappedFile::Open(std::filesystem::path(testing::TempDir()) /
+                               "mapped_file_missing"),
+              StatusIs(absl::StatusCode::kNotFound,
+                       testing::HasSubstr("Could not open file")));
+}
+
+TEST(MappedFile, Directory) {
+  EXPECT_THAT(MappedFile::Open(testing::TempDir()),
+              StatusIs(absl::StatusCode::kNotFound,
+                       testing::HasSubstr("Could not open file")));
+}
+
+TEST(MappedFile, Empty) {
+  absl::StatusOr<MappedFile> file =
+      MappedFile::Open(MakeFile("mapped_file_empty", ""));
+  ASSERT_TRUE(file.ok());
+  EXPECT_EQ("", file->contents());
+}
+
+TEST(MappedFile, Contents) {
+  absl::StatusOr<MappedFile> file =
+      MappedFile::Open(MakeFile("mapped_file_contents", "Hello\nWorld"));
+  ASSERT_TRUE(file.ok());
+  EXPECT_EQ("Hello\nWorld", file->contents());
+}
+
+#ifndef _WIN32
+TEST(MappedFile, Fifo) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "mapped_file_fifo";
+  std::filesystem::remove(path);
+  ASSERT_EQ(0, mkfifo(path.c_str(), 0600));
+
+  // Larger than a single read so that the stream is read in pieces
+  std::string contents(200000, 'x');
+  std::thread writer(
+      [&]() { std::ofstream(path, std::ios::binary) << contents; });
+
+  absl::StatusOr<MappedFile> file = MappedFile::Open(path);
+  writer.join();
+  std::filesystem::remove(path);
+
+  ASSERT_TRUE(file.ok());
+  EXPECT_EQ(contents, file->contents());
+
+  MappedFile moved(std::move(*file));
+  EXPECT_EQ("", file->contents());
+  EXPECT_EQ(contents, moved.contents());
+}
+#endif
+
+TEST(IsUnmappable, Files) {
+  EXPECT_FALSE(IsUnmappable(MakeFile("unmappable_regular", "Hello")));
+  EXPECT_FALSE(IsUnmappable(testing::TempDir()));
+  EXPECT_FALSE(IsUnmappable(std::filesystem::path(testing::TempDir()) /
+                            "unmappable_missing"));
+#ifndef _WIN32
+  EXPECT_TRUE(IsUnmappable("/dev/null"));
+#endif
+}
+
+TEST(OpenStream, Missing) {
+  EXPECT_THAT(OpenStream(std::filesystem::path(testing::TempDir()) /
+                         "open_stream_missing"),
+              StatusIs(absl::StatusCode::kNotFound,
+                       testing::HasSubstr("Could not open file")));
+  EXPECT_THAT(OpenStream(testing::TempDir()),
+              StatusIs(absl::StatusCode::kNotFound,
+                       testing::HasSubstr("Could not open file")));
+}
+
+#ifndef _WIN32
+TEST(OpenStream, Fifo) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "open_stream_fifo";
+  std::filesystem::remove(path);
+  ASSERT_EQ(0, mkfifo(path.c_str(), 0600));
+  EXPECT_TRUE(IsUnmappable(path));
+
+  std::string contents(200000, 'x');
+  std::thread writer(
+      [&]() { std::ofstream(path, std::ios::binary) << contents; });
+
+  absl::StatusOr<std::ifstream> input = OpenStream(path);
+  ASSERT_TRUE(input.ok());
+  std::string read(std::istreambuf_iterator<char>(*input), {});
+  writer.join();
+  std::filesystem::remove(path);
+
+  EXPECT_EQ(contents, read);
+}
+#endif
+
+TEST(MappedFile, Move) {
+  absl::StatusOr<MappedFile> file0 =
+      MappedFile::Open(MakeFile("mapped_file_move0", "Hello"));
+  ASSERT_TRUE(file0.ok());
+
+  MappedFile file1(std::move(*file0));
+  EXPECT_EQ("", file0->contents());
+  EXPECT_EQ("Hello", file1.contents());
+
+  absl::StatusOr<MappedFile> file2 =
+      MappedFile::Open(MakeFile("mapped_file_move2", "World"));
+  ASSERT_TRUE(file2.ok());
+
+  *file2 = std::move(file1);
+  EXPECT_EQ("", file1.contents());
+  EXPECT_EQ("Hello", file2->contents());
+}
+
+}  // namespace
+}  // namespace pbrt_proto
@@ -0,0 +1,229 @@
+#include "pbrt_proto/shared/numbers.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/base/nullability.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+
+namespace pbrt_proto {
+namespace {
+
+// Numbers with at most this many significant digits fit in a uint64_t
+constexpr size_t kMaxMantissaDigits = 19;
+
+// Integers up to 2^53 and powers of ten up to 10^22 are exactly representable
+// as doubles, so a single multiplication or division of the two produces a
+// correctly rounded result.
+constexpr uint64_t kMaxExactMantissa = uint64_t(1) << 53;
+constexpr int kMaxExactPowerOfTen = 22;
+
+constexpr double kPowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// The direct decoding path relies on double arithmetic being performed at
+// double precision
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+constexpr bool kExactDoubleArithmetic = false;
+#else
+constexpr bool kExactDoubleArithmetic = true;
+#endif
+
+bool IsDigit(char ch) { return ch >= '0' && ch <= '9'; }
+
+// Returns true if `ch` can begin a string accepted by `absl::SimpleAtod`
+bool MayBeginNumber(char ch) {
+  switch (ch) {
+    case '+':
+    case '-':
+    case '.':
+    case 'i':
+    case 'I':
+    case 'n':
+    case 'N':
+      return true;
+  }
+
+  return IsDigit(ch) || absl::ascii_isspace(static_cast<unsigned char>(ch));
+}
+
+// Compilers recognize this as a single load on little endian targets
+uint64_t LoadEightBytes(const char* absl_nonnull ptr) {
+  uint64_t word = 0;
+  for (size_t i = 0; i < 8; i++) {
+    word |= static_cast<uint64_t>(static_cast<unsigned char>(ptr[i]))
+            << (8 * i);
+  }
+  return word;
+}
+
+bool IsEightDigits(uint64_t word) {
+  return (((word + 0x4646464646464646u) | (word - 0x3030303030303030u)) &
+          0x8080808080808080u) == 0;
+}
+
+// Decodes eight ASCII digits with the first digit in the low byte
+uint32_t DecodeEightDigits(uint64_t word) {
+  constexpr uint64_t kMask = 0x000000FF000000FFu;
+  constexpr uint64_t kMultiplier1 = 100 + (uint64_t(1000000) << 32);
+  constexpr uint64_t kMultiplier2 = 1 + (uint64_t(10000) << 32);
+
+  word -= 0x3030303030303030u;
+  word = (word * 10) + (word >> 8);
+  word = (((word & kMask) * kMultiplier1) +
+          (((word >> 16) & kMask) * kMultiplier2)) >>
+         32;
+  return static_cast<uint32_t>(word);
+}
+
+// Accumulates the run of digits starting at `ptr` into `mantissa` and returns
+// a pointer to the first non-digit. `mantissa` wraps if there are too many
+// digits for it to hold.
+const char* absl_nonnull ReadDigits(const char* absl_nonnull ptr,
+                                    const char* absl_nonnull end,
+                                    uint64_t& mantissa) {
+  while (end - ptr >= 8) {
+    uint64_t word = LoadEightBytes(ptr);
+    if (!IsEightDigits(word)) {
+      break;
+    }
+
+    mantissa = mantissa * 100000000 + DecodeEightDigits(word);
+    ptr += 8;
+  }
+
+  for (; ptr != end && IsDigit(*ptr); ptr++) {
+    mantissa = mantissa * 10 + static_cast<uint64_t>(*ptr - '0');
+  }
+
+  return ptr;
+}
+
+bool IsInteger(absl::string_view text) {
+  if (!text.empty() && (text[0] == '+' || text[0] == '-')) {
+    text.remove_prefix(1);
+  }
+
+  if (text.empty()) {
+    return false;
+  }
+
+  for (char ch : text) {
+    if (!IsDigit(ch)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool ParseNumberSlow(absl::string_view text, double& value, bool& integer) {
+  if (text.empty() || !MayBeginNumber(text[0]) ||
+      !absl::SimpleAtod(text, &value)) {
+    return false;
+  }
+
+  integer = IsInteger(text);
+
+  return true;
+}
+
+}  // namespace
+
+bool ParseNumber(absl::string_view text, double& value, bool& integer) {
+  if (!kExactDoubleArithmetic || text.empty()) {
+    return ParseNumberSlow(text, value, integer);
+  }
+
+  const char* ptr = text.data();
+  const char* end = ptr + text.size();
+
+  bool negative = *ptr == '-';
+  if (*ptr == '-' || *ptr == '+') {
+    ptr++;
+  }
+
+  uint64_t mantissa = 0;
+  const char* integer_start = ptr;
+  ptr = ReadDigits(ptr, end, mantissa);
+  size_t num_digits = ptr - integer_start;
+
+  int exponent = 0;
+  bool is_integer = true;
+  if (ptr != end && *ptr == '.') {
+    const char* fraction_start = ++ptr;
+    ptr = ReadDigits(ptr, end, mantissa);
+    num_digits += ptr - fraction_start;
+    exponent = -static_cast<int>(ptr - fraction_start);
+    is_integer = false;
+  }
+
+  if (num_digits == 0 || num_digits > kMaxMantissaDigits) {
+    return ParseNumberSlow(text, value, integer);
+  }
+
+  if (ptr != end && (*ptr == 'e' || *ptr == 'E')) {
+    ptr++;
+
+    bool negative_exponent = ptr != end && *ptr == '-';
+    if (ptr != end && (*ptr == '-' || *ptr == '+')) {
+      ptr++;
+    }
+
+    // Longer exponents are left to the slow path
+    int explicit_exponent = 0;
+    const char* exponent_start = ptr;
+    for (; ptr != end && IsDigit(*ptr) && ptr - exponent_start < 4; ptr++) {
+      explicit_exponent = explicit_exponent * 10 + (*ptr - '0');
+    }
+
+    if (ptr == exponent_start) {
+      return ParseNumberSlow(text, value, integer);
+    }
+
+    exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+    is_integer = false;
+  }
+
+  if (ptr != end || mantissa > kMaxExactMantissa ||
+      exponent < -kMaxExactPowerOfTen || exponent > kMaxExactPowerOfTen) {
+    return ParseNumberSlow(text, value, integer);
+  }
+
+  value = static_cast<double>(mantissa);
+  if (exponent < 0) {
+    value /= kPowersOfTen[-exponent];
+  } else {
+    value *= kPowersOfTen[exponent];
+  }
+
+  if (negative) {
+    value = -value;
+  }
+
+  integer = is_integer;
+
+  return true;
+}
+
+float RoundToFloat(double value) {
+  if (std::isfinite(value)) {
+    if (value > FLT_MAX) {
+      return FLT_MAX;
+    }
+
+    if (value < -FLT_MAX) {
+      return -FLT_MAX;
+    }
+  }
+
+  return static_cast<float>(value);
+}
+
+}  // namespace pbrt_proto
@@ -0,0 +1,30 @@
+#ifndef _PBRT_PROTO_SHARED_NUMBERS_
+#define _PBRT_PROTO_SHARED_NUMBERS_
+
+#include "absl/strings/string_view.h"
+
+namespace pbrt_proto {
+
+// Parses `text` as a number, returning false if it is not one.
+//
+// The set of strings accepted and the values produced are exactly those of
+// `absl::SimpleAtod`. Decimal numbers with at most 19 significant digits and
+// small exponents, which covers nearly all of the numbers found in pbrt files,
+// are decoded directly; everything else falls back to `absl::SimpleAtod`.
+//
+// On success `integer` is set if `text` is an optionally signed string of
+// decimal digits.
+bool ParseNumber(absl::string_view text, double& value, bool& integer);
+
+// Rounds `value` to single precision for the `*_f32` output fields.
+//
+// Values are rounded to the nearest representable float, with ties rounded to
+// the value with an even mantissa. Finite values whose magnitude exceeds the
+// largest finite float are clamped to that float rather than overflowing to
+// infinity, since a finite input would otherwise become unusable. Infinities
+// and NaNs are preserved.
+float RoundToFloat(double value);
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_NUMBERS_
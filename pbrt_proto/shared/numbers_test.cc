@@ -0,0 +1,159 @@
+#include "pbrt_proto/shared/numbers.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
+#include "gtest/gtest.h"
+#include "pbrt_proto/shared/mapped_file.h"
+#include "pbrt_proto/shared/tokenizer.h"
+#include "tools/cpp/runfiles/runfiles.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::bazel::tools::cpp::runfiles::Runfiles;
+
+uint64_t Bits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+bool IsInteger(absl::string_view text) {
+  if (!text.empty() && (text[0] == '+' || text[0] == '-')) {
+    text.remove_prefix(1);
+  }
+
+  return !text.empty() &&
+         text.find_first_not_of("0123456789") == absl::string_view::npos;
+}
+
+// Checks that `ParseNumber` accepts exactly the same strings as
+// `absl::SimpleAtod` and decodes them to exactly the same values
+void ExpectMatchesSimpleAtod(absl::string_view text) {
+  double expected = 0.0;
+  bool expected_ok = absl::SimpleAtod(text, &expected);
+
+  double actual = 0.0;
+  bool integer = false;
+  ASSERT_EQ(ParseNumber(text, actual, integer), expected_ok) << text;
+  if (expected_ok) {
+    EXPECT_EQ(Bits(actual), Bits(expected)) << text;
+    EXPECT_EQ(integer, IsInteger(text)) << text;
+  }
+}
+
+TEST(ParseNumber, Integers) {
+  for (absl::string_view text :
+       {"0", "-0", "+0", "1", "-1", "+1", "007", "12345678", "123456789",
+        "-1234567890123456", "9007199254740992", "9007199254740993",
+        "1234567890123456789", "12345678901234567890",
+        "123456789012345678901234567890"}) {
+    ExpectMatchesSimpleAtod(text);
+  }
+}
+
+TEST(ParseNumber, Decimals) {
+  for (absl::string_view text :
+       {"0.1", "-0.1", "0.0", "-0.0", "1.", ".5", "-.5", "+.5", "3.14159265",
+        "0.30000000000000004", "123.456789012345678", "0.12345678901234567890",
+        "1.7976931348623157", "4.9406564584124654", "00000000.00000001"}) {
+    ExpectMatchesSimpleAtod(text);
+  }
+}
+
+TEST(ParseNumber, Exponents) {
+  for (absl::string_view text :
+       {"1e0", "1e22", "1e23", "1E-22", "1e-23", "-2.5e+3", "1e308", "1e309",
+        "-1e309", "1e-400", "1.7976931348623157e308", "4.9e-324", "1e0000",
+        "1e00005", "9007199254740993e-5"}) {
+    ExpectMatchesSimpleAtod(text);
+  }
+}
+
+TEST(ParseNumber, Special) {
+  for (absl::string_view text :
+       {"inf", "-inf", "+inf", "Infinity", "nan", "-nan", "NaN", "nan(1)"}) {
+    ExpectMatchesSimpleAtod(text);
+  }
+}
+
+TEST(ParseNumber, Invalid) {
+  for (absl::string_view text :
+       {"", "+", "-", ".", "+-1", "-+1", "--1", "1e", "1e+", "1e-", "e5",
+        ".e5", "1.f", "1.0.0", "1x", "0x10", "abc", "Shape", "1,2"}) {
+    ExpectMatchesSimpleAtod(text);
+  }
+}
+
+// Every unquoted token in the test scenes must decode exactly as it would with
+// `absl::SimpleAtod`.
+TEST(ParseNumber, MatchesSimpleAtodForTestScenes) {
+  std::unique_ptr<Runfiles> runfiles(Runfiles::CreateForTest());
+  std::filesystem::path test_data =
+      runfiles->Rlocation("_main/tools/test_data");
+
+  size_t num_numbers = 0;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(test_data)) {
+    if (!entry.is_regular_file() || entry.path().extension() != ".pbrt") {
+      continue;
+    }
+
+    absl::StatusOr<MappedFile> file = MappedFile::Open(entry.path());
+    ASSERT_TRUE(file.ok()) << file.status();
+
+    Tokenizer tokenizer(file->contents());
+    for (const Token* token = &tokenizer.Next(); token->kind != TokenKind::END;
+         token = &tokenizer.Next()) {
+      if (token->kind != TokenKind::NUMBER &&
+          token->kind != TokenKind::BARE_WORD) {
+        continue;
+      }
+
+      ExpectMatchesSimpleAtod(token->text);
+      if (testing::Test::HasFailure()) {
+        FAIL() << "In " << entry.path();
+      }
+
+      num_numbers += token->kind == TokenKind::NUMBER;
+    }
+  }
+
+  EXPECT_NE(num_numbers, 0u);
+}
+
+TEST(RoundToFloat, Exact) {
+  EXPECT_EQ(RoundToFloat(0.0), 0.0f);
+  EXPECT_EQ(RoundToFloat(-1.5), -1.5f);
+  EXPECT_EQ(RoundToFloat(16777216.0), 16777216.0f);
+}
+
+TEST(RoundToFloat, NearestEven) {
+  EXPECT_EQ(RoundToFloat(0.1), 0.1f);
+  EXPECT_EQ(RoundToFloat(16777217.0), 16777216.0f);
+  EXPECT_EQ(RoundToFloat(16777219.0), 16777220.0f);
+}
+
+TEST(RoundToFloat, Clamps) {
+  EXPECT_EQ(RoundToFloat(1e300), std::numeric_limits<float>::max());
+  EXPECT_EQ(RoundToFloat(-1e300), -std::numeric_limits<float>::max());
+}
+
+TEST(RoundToFloat, Special) {
+  EXPECT_EQ(RoundToFloat(std::numeric_limits<double>::infinity()),
+            std::numeric_limits<float>::infinity());
+  EXPECT_EQ(RoundToFloat(-std::numeric_limits<double>::infinity()),
+            -std::numeric_limits<float>::infinity());
+  EXPECT_TRUE(std::isnan(RoundToFloat(std::nan(""))));
+}
+
+}  // namespace
+}  // namespace pbrt_proto
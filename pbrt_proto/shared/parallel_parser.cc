@@ -0,0 +1,69 @@
+#include "pbrt_proto/shared/parallel_parser.h"
+
+#include <cstddef>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "pbrt_proto/shared/directives.h"
+
+namespace pbrt_proto {
+namespace {
+
+// Returns the offset of the start of the first line after the one containing
+// `offset` whose first token is a directive keyword, or `npos` if there is no
+// such line.
+size_t FindDirectiveLine(absl::string_view buffer, size_t offset) {
+  while (offset < buffer.size()) {
+    size_t newline = buffer.find('\n', offset);
+    if (newline == absl::string_view::npos) {
+      break;
+    }
+
+    offset = newline + 1;
+
+    size_t word_start = buffer.find_first_not_of(" \t\r", offset);
+    if (word_start == absl::string_view::npos) {
+      break;
+    }
+
+    size_t word_end = buffer.find_first_of(" \t\r\n\"[]#", word_start);
+    if (word_end == absl::string_view::npos) {
+      word_end = buffer.size();
+    }
+
+    if (LookupDirective(buffer.substr(word_start, word_end - word_start))) {
+      return offset;
+    }
+  }
+
+  return absl::string_view::npos;
+}
+
+}  // namespace
+
+std::vector<absl::string_view> SplitAtDirectives(absl::string_view buffer,
+                                                 size_t max_chunks) {
+  std::vector<absl::string_view> chunks;
+
+  size_t chunk_start = 0;
+  for (size_t i = 1; i < max_chunks; i++) {
+    size_t target = buffer.size() / max_chunks * i;
+    if (target < chunk_start) {
+      target = chunk_start;
+    }
+
+    size_t chunk_end = FindDirectiveLine(buffer, target);
+    if (chunk_end == absl::string_view::npos) {
+      break;
+    }
+
+    chunks.push_back(buffer.substr(chunk_start, chunk_end - chunk_start));
+    chunk_start = chunk_end;
+  }
+
+  chunks.push_back(buffer.substr(chunk_start));
+
+  return chunks;
+}
+
+}  // namespace pbrt_proto
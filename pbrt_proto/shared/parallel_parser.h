@@ -0,0 +1,96 @@
+#ifndef _PBRT_PROTO_SHARED_PARALLEL_PARSER_
+#define _PBRT_PROTO_SHARED_PARALLEL_PARSER_
+
+#include <cstddef>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "pbrt_proto/shared/decompressing_istream.h"
+#include "pbrt_proto/shared/warnings.h"
+
+namespace pbrt_proto {
+
+// Splits `buffer` into at most `max_chunks` contiguous chunks of roughly equal
+// size. Every chunk after the first begins on a line whose first token is a
+// directive keyword.
+//
+// Quoted strings and comments cannot span lines, so the start of a line is
+// never inside either one. As long as the input is well formed, each chunk
+// therefore holds a sequence of complete directives and can be parsed
+// independently of the others.
+std::vector<absl::string_view> SplitAtDirectives(absl::string_view buffer,
+                                                 size_t max_chunks);
+
+// Reads `buffer` with a separate parser of type `P` for each chunk returned by
+// `SplitAtDirectives`, using up to `num_threads` threads, and appends the
+// directives from each chunk to `output` in source order.
+//
+// The split is speculative. If any chunk fails to parse, `buffer` is read again
+// on the calling thread so that both the output and any error are identical
+// to those of `P(output).ReadFrom(buffer)`. The warnings of each chunk are
+// collected as it is read and only written, in source order, once every chunk
+// has parsed, so the warnings are identical to those of that read as well.
+template <typename P, typename T>
+absl::Status ReadInParallel(absl::string_view buffer, size_t num_threads,
+                            T& output) {
+  std::vector<absl::string_view> chunks;
+  if (num_threads > 1 && !IsCompressed(buffer)) {
+    chunks = SplitAtDirectives(buffer, num_threads);
+  }
+
+  if (chunks.size() <= 1) {
+    return P(output).ReadFrom(buffer);
+  }
+
+  std::vector<T> outputs(chunks.size());
+  std::vector<absl::Status> statuses(chunks.size());
+  std::vector<std::string> warnings(chunks.size());
+  auto read_chunk = [&](size_t i) {
+    WarningCollector collector;
+    statuses[i] = P(outputs[i]).ReadFrom(chunks[i]);
+    warnings[i] = collector.Collected();
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(chunks.size() - 1);
+  for (size_t i = 1; i < chunks.size(); i++) {
+    threads.emplace_back(read_chunk, i);
+  }
+
+  read_chunk(0);
+
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  int num_directives = output.directives_size();
+  for (size_t i = 0; i < chunks.size(); i++) {
+    if (!statuses[i].ok()) {
+      return P(output).ReadFrom(buffer);
+    }
+
+    num_directives += outputs[i].directives_size();
+  }
+
+  for (const std::string& chunk_warnings : warnings) {
+    Warnings() << chunk_warnings;
+  }
+  Warnings().flush();
+
+  output.mutable_directives()->Reserve(num_directives);
+  for (T& chunk_output : outputs) {
+    for (auto& directive : *chunk_output.mutable_directives()) {
+      *output.add_directives() = std::move(directive);
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_PARALLEL_PARSER_
@@ -0,0 +1,89 @@
+#include "pbrt_proto/shared/parallel_parser.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_join.h"
+#include "absl/strings/string_view.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::testing::ElementsAre;
+
+TEST(SplitAtDirectives, Empty) {
+  EXPECT_THAT(SplitAtDirectives("", 4), ElementsAre(""));
+}
+
+TEST(SplitAtDirectives, SingleChunk) {
+  EXPECT_THAT(SplitAtDirectives("WorldBegin\nWorldEnd\n", 1),
+              ElementsAre("WorldBegin\nWorldEnd\n"));
+}
+
+TEST(SplitAtDirectives, SingleLine) {
+  EXPECT_THAT(SplitAtDirectives("WorldBegin WorldEnd", 4),
+              ElementsAre("WorldBegin WorldEnd"));
+}
+
+TEST(SplitAtDirectives, TwoLines) {
+  EXPECT_THAT(SplitAtDirectives("WorldBegin\nWorldEnd\n", 2),
+              ElementsAre("WorldBegin\n", "WorldEnd\n"));
+}
+
+TEST(SplitAtDirectives, SkipsLinesWithoutDirectives) {
+  EXPECT_THAT(SplitAtDirectives("Shape \"trianglemesh\"\n"
+                                "  \"point3 P\" [ 0 0 0\n"
+                                "  1 1 1 ]\n"
+                                "# Shape \"sphere\"\n"
+                                "\"Shape\"\n"
+                                "ShapeX\n"
+                                "  Shape \"sphere\"\n",
+                                2),
+              ElementsAre("Shape \"trianglemesh\"\n"
+                          "  \"point3 P\" [ 0 0 0\n"
+                          "  1 1 1 ]\n"
+                          "# Shape \"sphere\"\n"
+                          "\"Shape\"\n"
+                          "ShapeX\n",
+                          "  Shape \"sphere\"\n"));
+}
+
+TEST(SplitAtDirectives, DirectiveFollowedByDelimiter) {
+  EXPECT_THAT(SplitAtDirectives("WorldBegin  # Padding padding padding\n"
+                                "Shape\"sphere\"\n",
+                                2),
+              ElementsAre("WorldBegin  # Padding padding padding\n",
+                          "Shape\"sphere\"\n"));
+  EXPECT_THAT(SplitAtDirectives("WorldBegin  # Padding padding padding\r\n"
+                                "WorldEnd#\r\n",
+                                2),
+              ElementsAre("WorldBegin  # Padding padding padding\r\n",
+                          "WorldEnd#\r\n"));
+}
+
+TEST(SplitAtDirectives, CoversInput) {
+  std::string input;
+  for (int i = 0; i < 1000; i++) {
+    input += "AttributeBegin\n  Translate " + std::to_string(i) +
+             " 0 0\n  Shape \"sphere\"\n  # Shape\n    \"float radius\" 1\n"
+             "AttributeEnd\n";
+  }
+
+  for (size_t max_chunks = 1; max_chunks <= 64; max_chunks++) {
+    std::vector<absl::string_view> chunks =
+        SplitAtDirectives(input, max_chunks);
+    EXPECT_EQ(chunks.size(), max_chunks);
+    EXPECT_EQ(absl::StrJoin(chunks, ""), input);
+
+    for (size_t i = 1; i < chunks.size(); i++) {
+      EXPECT_FALSE(chunks[i].empty());
+      EXPECT_EQ(chunks[i - 1].back(), '\n');
+      EXPECT_EQ(chunks[i - 1].data() + chunks[i - 1].size(), chunks[i].data());
+    }
+  }
+}
+
+}  // namespace
+}  // namespace pbrt_proto
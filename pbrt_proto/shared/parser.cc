@@ -1,160 +1,225 @@
 #include "pbrt_proto/shared/parser.h"
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
-#include <functional>
-#include <iostream>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
 #include <istream>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
+#include "absl/base/nullability.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/container/inlined_vector.h"
 #include "absl/status/status.h"
-#include "absl/strings/numbers.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
+#include "pbrt_proto/shared/decompressing_istream.h"
+#include "pbrt_proto/shared/directives.h"
 #include "pbrt_proto/shared/tokenizer.h"
+#include "pbrt_proto/shared/trace.h"
+#include "pbrt_proto/shared/warnings.h"
 
 namespace pbrt_proto {
 namespace {
 
+// Storage for the parameter values of a single directive. Strings and arrays
+// of values are bump allocated from a single block of memory and are all
+// released at once by `Clear`.
+//
+// Allocations that do not fit in the block are satisfied separately until the
+// next `Clear`, which then replaces the block with one large enough to hold
+// all of them. The memory retained between directives is therefore bounded by
+// the high-water mark of a single directive, and once that has been reached
+// parsing a directive performs no allocations at all.
+//
+// Arrays may instead be backed by a `ParameterSink`, in which case they never
+// grow past a single fixed size batch. Each full batch is passed to the sink
+// and the array is then reused for the next.
 class ParameterStorage {
  public:
-  absl::string_view Add(absl::string_view to_add);
-
-  absl::InlinedVector<std::array<double, 3>, 16>& NextFloat3();
-  absl::InlinedVector<std::array<double, 2>, 16>& NextFloat2();
-  absl::InlinedVector<double, 16>& NextFloat();
-  absl::InlinedVector<int, 16>& NextInt();
-  absl::InlinedVector<bool, 16>& NextBool();
-  absl::InlinedVector<absl::string_view, 16>& NextString();
-
-  void Clear();
+  template <typename T>
+  static constexpr bool kIsStreamable =
+      std::is_same_v<T, double> || std::is_same_v<T, int32_t> ||
+      std::is_same_v<T, std::array<double, 3>>;
+
+  // A growable array of values allocated from a `ParameterStorage`. An array
+  // only remains valid until its storage is cleared.
+  template <typename T>
+  class Array {
+   public:
+    T* data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    T& emplace_back() {
+      if (size_ == capacity_) {
+        storage_->Grow(*this);
+      }
 
- private:
-  std::vector<std::vector<char>> chars_;
-  size_t chars_size_ = 0;
+      return data_[size_++] = T();
+    }
 
-  std::vector<std::unique_ptr<absl::InlinedVector<std::array<double, 3>, 16>>>
-      float3_;
-  size_t float3_size_ = 0;
+    void push_back(const T& value) { emplace_back() = value; }
 
-  std::vector<std::unique_ptr<absl::InlinedVector<std::array<double, 2>, 16>>>
-      float2_;
-  size_t float2_size_ = 0;
+    // Passes any values not yet passed to the sink backing this array, if
+    // there is one
+    void Flush() {
+      if constexpr (kIsStreamable<T>) {
+        if (sink_ != nullptr && size_ != 0) {
+          sink_->Append(absl::Span<const T>(data_, size_));
+          size_ = 0;
+        }
+      }
+    }
 
-  std::vector<std::unique_ptr<absl::InlinedVector<double, 16>>> float_;
-  size_t float_size_ = 0;
+   private:
+    friend class ParameterStorage;
 
-  std::vector<std::unique_ptr<absl::InlinedVector<int32_t, 16>>> int_;
-  size_t int_size_ = 0;
+    Array(ParameterStorage& storage, ParameterSink* absl_nullable sink)
+        : storage_(&storage), sink_(sink) {}
 
-  std::vector<std::unique_ptr<absl::InlinedVector<absl::string_view, 16>>>
-      strings_;
-  size_t string_size_ = 0;
+    ParameterStorage* storage_;
+    ParameterSink* absl_nullable sink_;
+    T* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+  };
 
-  std::vector<std::unique_ptr<absl::InlinedVector<bool, 16>>> bool_;
-  size_t bool_size_ = 0;
-};
+  absl::string_view Add(absl::string_view to_add);
 
-absl::string_view ParameterStorage::Add(absl::string_view to_add) {
-  if (chars_size_ == chars_.size()) {
-    chars_.emplace_back();
+  template <typename T>
+  Array<T> NewArray() {
+    static_assert(std::is_trivially_copyable_v<T> &&
+                  std::is_trivially_destructible_v<T>);
+    return Array<T>(*this, nullptr);
   }
 
-  auto& result = chars_[chars_size_++];
-  result.clear();
-
-  for (char c : to_add) {
-    result.emplace_back(c);
+  template <typename T>
+  Array<T> NewArray(ParameterSink& sink) {
+    static_assert(kIsStreamable<T>);
+    return Array<T>(*this, &sink);
   }
 
-  return absl::string_view(result.data(), result.size());
-}
+  void Clear();
 
-absl::InlinedVector<std::array<double, 3>, 16>& ParameterStorage::NextFloat3() {
-  if (float3_size_ == float3_.size()) {
-    float3_.emplace_back(
-        std::make_unique<absl::InlinedVector<std::array<double, 3>, 16>>());
-  }
+ private:
+  static constexpr size_t kMinBlockSize = 1 << 12;
+  static constexpr size_t kMinArrayCapacity = 16;
+  static constexpr size_t kSinkBatchSize = 1 << 10;
 
-  auto& result = float3_[float3_size_++];
-  result->clear();
+  char* Allocate(size_t size, size_t alignment);
+  void ReplaceBlock(size_t size);
 
-  return *result;
-}
+  template <typename T>
+  void Grow(Array<T>& array);
 
-absl::InlinedVector<std::array<double, 2>, 16>& ParameterStorage::NextFloat2() {
-  if (float2_size_ == float2_.size()) {
-    float2_.emplace_back(
-        std::make_unique<absl::InlinedVector<std::array<double, 2>, 16>>());
-  }
+  std::unique_ptr<std::max_align_t[]> block_;
+  size_t block_size_ = 0;
+  size_t block_used_ = 0;
 
-  auto& result = float2_[float2_size_++];
-  result->clear();
+  // The most recent allocation from `block_`, which is the only one that can
+  // be extended in place
+  char* absl_nullable last_allocation_ = nullptr;
 
-  return *result;
-}
+  std::vector<std::unique_ptr<std::max_align_t[]>> overflow_;
+  size_t overflow_size_ = 0;
+};
 
-absl::InlinedVector<double, 16>& ParameterStorage::NextFloat() {
-  if (float_size_ == float_.size()) {
-    float_.emplace_back(std::make_unique<absl::InlinedVector<double, 16>>());
+char* ParameterStorage::Allocate(size_t size, size_t alignment) {
+  // The block is allocated on first use, so that inputs whose directives have
+  // no parameters allocate nothing
+  if (block_size_ == 0) {
+    ReplaceBlock(size);
   }
 
-  auto& result = float_[float_size_++];
-  result->clear();
+  size_t offset = (block_used_ + alignment - 1) & ~(alignment - 1);
+  if (offset <= block_size_ && size <= block_size_ - offset) {
+    block_used_ = offset + size;
+    last_allocation_ = reinterpret_cast<char*>(block_.get()) + offset;
+    return last_allocation_;
+  }
 
-  return *result;
+  last_allocation_ = nullptr;
+
+  size_t num_elements =
+      (size + sizeof(std::max_align_t) - 1) / sizeof(std::max_align_t);
+  overflow_.emplace_back(
+      new std::max_align_t[std::max<size_t>(num_elements, 1)]);
+  overflow_size_ += num_elements * sizeof(std::max_align_t);
+
+  return reinterpret_cast<char*>(overflow_.back().get());
 }
 
-absl::InlinedVector<int, 16>& ParameterStorage::NextInt() {
-  if (int_size_ == int_.size()) {
-    int_.emplace_back(std::make_unique<absl::InlinedVector<int32_t, 16>>());
+template <typename T>
+void ParameterStorage::Grow(Array<T>& array) {
+  if (array.sink_ != nullptr && array.capacity_ != 0) {
+    array.Flush();
+    return;
   }
 
-  auto& result = int_[int_size_++];
-  result->clear();
+  size_t capacity = array.sink_ != nullptr
+                        ? kSinkBatchSize
+                        : std::max(2 * array.capacity_, kMinArrayCapacity);
 
-  return *result;
-}
-
-absl::InlinedVector<bool, 16>& ParameterStorage::NextBool() {
-  if (bool_size_ == bool_.size()) {
-    bool_.emplace_back(std::make_unique<absl::InlinedVector<bool, 16>>());
+  size_t extra = (capacity - array.capacity_) * sizeof(T);
+  if (array.data_ != nullptr &&
+      reinterpret_cast<char*>(array.data_) == last_allocation_ &&
+      extra <= block_size_ - block_used_) {
+    block_used_ += extra;
+    array.capacity_ = capacity;
+    return;
   }
 
-  auto& result = bool_[bool_size_++];
-  result->clear();
+  T* data = reinterpret_cast<T*>(Allocate(capacity * sizeof(T), alignof(T)));
+  if (array.size_ != 0) {
+    std::memcpy(data, array.data_, array.size_ * sizeof(T));
+  }
 
-  return *result;
+  array.data_ = data;
+  array.capacity_ = capacity;
 }
 
-absl::InlinedVector<absl::string_view, 16>& ParameterStorage::NextString() {
-  if (string_size_ == strings_.size()) {
-    strings_.emplace_back(
-        std::make_unique<absl::InlinedVector<absl::string_view, 16>>());
+absl::string_view ParameterStorage::Add(absl::string_view to_add) {
+  char* data = Allocate(to_add.size(), 1);
+  if (!to_add.empty()) {
+    std::memcpy(data, to_add.data(), to_add.size());
   }
 
-  auto& result = strings_[string_size_++];
-  result->clear();
+  return absl::string_view(data, to_add.size());
+}
+
+void ParameterStorage::ReplaceBlock(size_t size) {
+  size_t num_elements = (std::max(size, kMinBlockSize) +
+                         sizeof(std::max_align_t) - 1) /
+                        sizeof(std::max_align_t);
 
-  return *result;
+  block_.reset(new std::max_align_t[num_elements]);
+  block_size_ = num_elements * sizeof(std::max_align_t);
+  block_used_ = 0;
+  last_allocation_ = nullptr;
 }
 
 void ParameterStorage::Clear() {
-  chars_size_ = 0;
-  float3_size_ = 0;
-  float2_size_ = 0;
-  float_size_ = 0;
-  int_size_ = 0;
-  bool_size_ = 0;
-  string_size_ = 0;
+  if (!overflow_.empty()) {
+    ReplaceBlock(block_used_ + overflow_size_);
+    overflow_.clear();
+    overflow_size_ = 0;
+  }
+
+  block_used_ = 0;
+  last_allocation_ = nullptr;
 }
 
 absl::Status MissingValueError(absl::string_view directive,
@@ -199,108 +264,83 @@ absl::Status InvalidParameterCount(absl::string_view directive,
 absl::Status CheckForNextValue(Tokenizer& tokenizer,
                                absl::string_view directive,
                                absl::string_view type, absl::string_view name) {
-  absl::StatusOr<const std::string*> next = tokenizer.Peek();
-  if (!next.ok()) {
-    return next.status();
-  }
-
-  if (!*next) {
+  if (tokenizer.Peek().kind == TokenKind::END) {
     return MissingValueError(directive, type, name);
   }
 
   return absl::OkStatus();
 }
 
-absl::Status ParseValue(absl::string_view directive, absl::string_view type,
-                        absl::string_view name, ParameterType parameter_type,
-                        ParameterStorage& storage, Tokenizer& tokenizer,
-                        double& out) {
-  assert(CheckForNextValue(tokenizer, directive, type, name).ok());
-
-  if (const std::string* next = *tokenizer.Next();
-      !absl::SimpleAtod(*next, &out)) {
-    return InvalidTokenError(directive, type, name, *next);
+// Integral values are exact in a double, so for integer tokens this matches
+// the behavior of `absl::SimpleAtoi`
+bool ToInt32(const Token& token, ParameterType parameter_type, int32_t& out) {
+  if (token.kind != TokenKind::NUMBER ||
+      (!token.integer && parameter_type != ParameterType::INTEGER) ||
+      !std::isfinite(token.number) ||
+      token.number > std::numeric_limits<int>::max() ||
+      token.number < std::numeric_limits<int>::min()) {
+    return false;
   }
 
-  return absl::OkStatus();
+  out = static_cast<int>(token.number);
+  return true;
 }
 
 absl::Status ParseValue(absl::string_view directive, absl::string_view type,
                         absl::string_view name, ParameterType parameter_type,
                         ParameterStorage& storage, Tokenizer& tokenizer,
-                        std::array<double, 2>& out) {
+                        double& out) {
   assert(CheckForNextValue(tokenizer, directive, type, name).ok());
 
-  if (absl::Status status = ParseValue(directive, type, name, parameter_type,
-                                       storage, tokenizer, out[0]);
-      !status.ok()) {
-    return status;
+  const Token& next = tokenizer.Next();
+  if (next.kind != TokenKind::NUMBER) {
+    return InvalidTokenError(directive, type, name, next.text);
   }
 
-  if (absl::Status status = CheckForNextValue(tokenizer, directive, type, name);
-      !status.ok()) {
-    return status;
-  }
+  out = next.number;
 
-  if (**tokenizer.Peek() == "]") {
-    // TODO: Make this compatible with all PBRT versions
-    return MissingValueError(directive, type, name);
-  }
+  return absl::OkStatus();
+}
 
-  if (absl::Status status = ParseValue(directive, type, name, parameter_type,
-                                       storage, tokenizer, out[1]);
-      !status.ok()) {
-    return status;
+// Parses the components of `out` starting from component `first`
+template <size_t N>
+absl::Status ParseComponents(absl::string_view directive,
+                             absl::string_view type, absl::string_view name,
+                             ParameterType parameter_type,
+                             ParameterStorage& storage, Tokenizer& tokenizer,
+                             std::array<double, N>& out, size_t first) {
+  for (size_t i = first; i < N; i++) {
+    if (i != 0) {
+      if (absl::Status status =
+              CheckForNextValue(tokenizer, directive, type, name);
+          !status.ok()) {
+        return status;
+      }
+
+      if (tokenizer.Peek().kind == TokenKind::CLOSE_BRACKET) {
+        // TODO: Make this compatible with all PBRT versions
+        return MissingValueError(directive, type, name);
+      }
+    }
+
+    if (absl::Status status = ParseValue(directive, type, name, parameter_type,
+                                         storage, tokenizer, out[i]);
+        !status.ok()) {
+      return status;
+    }
   }
 
   return absl::OkStatus();
 }
 
+template <size_t N>
 absl::Status ParseValue(absl::string_view directive, absl::string_view type,
                         absl::string_view name, ParameterType parameter_type,
                         ParameterStorage& storage, Tokenizer& tokenizer,
-                        std::array<double, 3>& out) {
+                        std::array<double, N>& out) {
   assert(CheckForNextValue(tokenizer, directive, type, name).ok());
-
-  if (absl::Status status = ParseValue(directive, type, name, parameter_type,
-                                       storage, tokenizer, out[0]);
-      !status.ok()) {
-    return status;
-  }
-
-  if (absl::Status status = CheckForNextValue(tokenizer, directive, type, name);
-      !status.ok()) {
-    return status;
-  }
-
-  if (**tokenizer.Peek() == "]") {
-    // TODO: Make this compatible with all PBRT versions
-    return MissingValueError(directive, type, name);
-  }
-
-  if (absl::Status status = ParseValue(directive, type, name, parameter_type,
-                                       storage, tokenizer, out[1]);
-      !status.ok()) {
-    return status;
-  }
-
-  if (absl::Status status = CheckForNextValue(tokenizer, directive, type, name);
-      !status.ok()) {
-    return status;
-  }
-
-  if (**tokenizer.Peek() == "]") {
-    // TODO: Make this compatible with all PBRT versions
-    return MissingValueError(directive, type, name);
-  }
-
-  if (absl::Status status = ParseValue(directive, type, name, parameter_type,
-                                       storage, tokenizer, out[2]);
-      !status.ok()) {
-    return status;
-  }
-
-  return absl::OkStatus();
+  return ParseComponents(directive, type, name, parameter_type, storage,
+                         tokenizer, out, 0);
 }
 
 absl::Status ParseValue(absl::string_view directive, absl::string_view type,
@@ -309,21 +349,12 @@ absl::Status ParseValue(absl::string_view directive, absl::string_view type,
                         int32_t& out) {
   assert(CheckForNextValue(tokenizer, directive, type, name).ok());
 
-  const std::string* next = *tokenizer.Next();
-  if (absl::SimpleAtoi(*next, &out)) {
-    return absl::OkStatus();
-  }
-
-  double as_double;
-  if (parameter_type == ParameterType::INTEGER &&
-      absl::SimpleAtod(*next, &as_double) && std::isfinite(as_double) &&
-      as_double <= std::numeric_limits<int>::max() &&
-      as_double >= std::numeric_limits<int>::min()) {
-    out = static_cast<int>(as_double);
-    return absl::OkStatus();
+  const Token& next = tokenizer.Next();
+  if (!ToInt32(next, parameter_type, out)) {
+    return InvalidTokenError(directive, type, name, next.text);
   }
 
-  return InvalidTokenError(directive, type, name, *next);
+  return absl::OkStatus();
 }
 
 absl::Status ParseValue(absl::string_view directive, absl::string_view type,
@@ -332,20 +363,20 @@ absl::Status ParseValue(absl::string_view directive, absl::string_view type,
                         bool& out) {
   assert(CheckForNextValue(tokenizer, directive, type, name).ok());
 
-  const std::string* next = *tokenizer.Next();
+  absl::string_view next = tokenizer.Next().text;
 
-  if (*next == "\"true\"") {
+  if (next == "\"true\"") {
     out = true;
     return absl::OkStatus();
   }
 
-  if (*next == "\"false\"") {
+  if (next == "\"false\"") {
     out = false;
     return absl::OkStatus();
   }
 
   // TODO: Make this compatible with all PBRT versions
-  return InvalidTokenError(directive, type, name, *next);
+  return InvalidTokenError(directive, type, name, next);
 }
 
 absl::Status ParseValue(absl::string_view directive, absl::string_view type,
@@ -354,43 +385,107 @@ absl::Status ParseValue(absl::string_view directive, absl::string_view type,
                         absl::string_view& out) {
   assert(CheckForNextValue(tokenizer, directive, type, name).ok());
 
-  const std::string* next = *tokenizer.Next();
+  const Token& next = tokenizer.Next();
 
-  if ((*next)[0] != '"') {
+  if (next.kind != TokenKind::QUOTED_STRING) {
     return absl::InvalidArgumentError(
         absl::StrCat("Unquoted ", type, " value for ", directive, " parameter ",
-                     name, ": '", *next, "'"));
+                     name, ": '", next.text, "'"));
   }
 
-  out = storage.Add(*next);
+  out = storage.Add(next.text);
   out.remove_prefix(1);
   out.remove_suffix(1);
 
   return absl::OkStatus();
 }
 
+// Fast paths for reading the contents of numeric arrays. Each reads values
+// for as long as the tokenizer can supply numbers directly, leaving anything
+// else, including errors, to be handled by `ParseValue`.
+absl::Status ReadNumbers(absl::string_view directive, absl::string_view type,
+                         absl::string_view name, ParameterType parameter_type,
+                         ParameterStorage& storage, Tokenizer& tokenizer,
+                         ParameterStorage::Array<double>& output) {
+  for (Token token; tokenizer.NextNumber(token);) {
+    output.push_back(token.number);
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status ReadNumbers(absl::string_view directive, absl::string_view type,
+                         absl::string_view name, ParameterType parameter_type,
+                         ParameterStorage& storage, Tokenizer& tokenizer,
+                         ParameterStorage::Array<int32_t>& output) {
+  for (Token token; tokenizer.NextNumber(token);) {
+    if (!ToInt32(token, parameter_type, output.emplace_back())) {
+      return InvalidTokenError(directive, type, name, token.text);
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+template <size_t N>
+absl::Status ReadNumbers(
+    absl::string_view directive, absl::string_view type, absl::string_view name,
+    ParameterType parameter_type, ParameterStorage& storage,
+    Tokenizer& tokenizer,
+    ParameterStorage::Array<std::array<double, N>>& output) {
+  for (Token token; tokenizer.NextNumber(token);) {
+    std::array<double, N>& value = output.emplace_back();
+    value[0] = token.number;
+
+    size_t i = 1;
+    for (; i < N && tokenizer.NextNumber(token); i++) {
+      value[i] = token.number;
+    }
+
+    if (i != N) {
+      return ParseComponents(directive, type, name, parameter_type, storage,
+                             tokenizer, value, i);
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+template <typename T>
+absl::Status ReadNumbers(absl::string_view directive, absl::string_view type,
+                         absl::string_view name, ParameterType parameter_type,
+                         ParameterStorage& storage, Tokenizer& tokenizer,
+                         ParameterStorage::Array<T>& output) {
+  return absl::OkStatus();
+}
+
 template <typename T>
 absl::Status ParseParameterListImpl(
     absl::string_view directive, absl::string_view type, absl::string_view name,
     ParameterType parameter_type, ParameterStorage& storage,
-    Tokenizer& tokenizer, absl::InlinedVector<T, 16>& output, bool loop) {
+    Tokenizer& tokenizer, ParameterStorage::Array<T>& output, bool loop) {
   for (;;) {
-    absl::StatusOr<const std::string*> next = tokenizer.Peek();
-    if (!next.ok()) {
-      return next.status();
+    if (loop) {
+      if (absl::Status status =
+              ReadNumbers(directive, type, name, parameter_type, storage,
+                          tokenizer, output);
+          !status.ok()) {
+        return status;
+      }
     }
 
-    if (!*next) {
+    TokenKind next = tokenizer.Peek().kind;
+    if (next == TokenKind::END) {
       if (!loop) {
-        tokenizer.Next().IgnoreError();
+        tokenizer.Next();
         break;
       }
 
       return UnterminatedArrayError(directive, type, name);
     }
 
-    if (loop && **next == "]") {
-      tokenizer.Next().IgnoreError();
+    if (loop && next == TokenKind::CLOSE_BRACKET) {
+      tokenizer.Next();
       break;
     }
 
@@ -416,20 +511,16 @@ absl::Status ParseParameterList(absl::string_view directive,
                                 absl::string_view type, absl::string_view name,
                                 ParameterType parameter_type,
                                 ParameterStorage& storage, Tokenizer& tokenizer,
-                                absl::InlinedVector<T, 16>& output,
+                                ParameterStorage::Array<T>& output,
                                 bool must_loop) {
-  absl::StatusOr<const std::string*> next = tokenizer.Peek();
-  if (!next.ok()) {
-    return next.status();
-  }
-
-  if (!*next) {
+  TokenKind next = tokenizer.Peek().kind;
+  if (next == TokenKind::END) {
     return MissingValueError(directive, type, name);
   }
 
   bool loop;
-  if ((**next == "[")) {
-    tokenizer.Next().IgnoreError();
+  if (next == TokenKind::OPEN_BRACKET) {
+    tokenizer.Next();
     loop = true;
   } else {
     if (must_loop) {
@@ -443,26 +534,45 @@ absl::Status ParseParameterList(absl::string_view directive,
                                 tokenizer, output, loop);
 }
 
+// Reads the values of a numeric parameter into `sink` if it accepts them,
+// returning false without reading anything if it does not.
+template <typename T>
+bool TryStreamParameterList(absl::string_view directive, absl::string_view type,
+                            absl::string_view name,
+                            ParameterType parameter_type,
+                            ParameterStorage& storage, Tokenizer& tokenizer,
+                            ParameterSink* absl_nullable sink, bool must_loop,
+                            absl::Status& status) {
+  if (sink == nullptr || !sink->Begin(name, parameter_type)) {
+    return false;
+  }
+
+  auto output = storage.NewArray<T>(*sink);
+  status = ParseParameterList(directive, type, name, parameter_type, storage,
+                              tokenizer, output, must_loop);
+  if (status.ok()) {
+    output.Flush();
+  }
+
+  return true;
+}
+
 absl::Status ParseSingleStringParameter(
     absl::string_view directive, absl::string_view type, absl::string_view name,
     ParameterType parameter_type, ParameterStorage& storage,
-    Tokenizer& tokenizer, absl::InlinedVector<absl::string_view, 16>& output) {
-  absl::StatusOr<const std::string*> next = tokenizer.Peek();
-  if (!next.ok()) {
-    return next.status();
-  }
-
-  if ((**next)[0] != '"') {
+    Tokenizer& tokenizer, ParameterStorage::Array<absl::string_view>& output) {
+  if (tokenizer.Peek().kind != TokenKind::QUOTED_STRING) {
     return absl::OkStatus();
   }
 
-  std::cerr << "WARNING: Implicitly converted string value specified as type '"
-            << type << "' to type 'texture' for " << directive
-            << " parameter: '" << name << "'" << std::endl;
+  Warnings() << "WARNING: Implicitly converted string value specified as type '"
+             << type << "' to type 'texture' for " << directive
+             << " parameter: '" << name << "'" << std::endl;
 
-  absl::string_view& out = output.emplace_back(storage.Add(**tokenizer.Next()));
+  absl::string_view out = storage.Add(tokenizer.Next().text);
   out.remove_prefix(1);
   out.remove_suffix(1);
+  output.push_back(out);
 
   return absl::OkStatus();
 }
@@ -470,48 +580,40 @@ absl::Status ParseSingleStringParameter(
 absl::Status ParseSpectrumParameter(
     absl::string_view directive, absl::string_view type, absl::string_view name,
     ParameterStorage& storage, Tokenizer& tokenizer, ParameterValues& output) {
-  absl::StatusOr<const std::string*> next = tokenizer.Peek();
-  if (!next.ok()) {
-    return next.status();
-  }
-
-  if (!*next) {
+  const Token* next = &tokenizer.Peek();
+  if (next->kind == TokenKind::END) {
     return MissingValueError(directive, type, name);
   }
 
   bool loop;
-  if ((**next == "[")) {
-    tokenizer.Next().IgnoreError();
-
-    next = tokenizer.Peek();
-    if (!next.ok()) {
-      return next.status();
-    }
+  if (next->kind == TokenKind::OPEN_BRACKET) {
+    tokenizer.Next();
 
-    if (!*next) {
+    next = &tokenizer.Peek();
+    if (next->kind == TokenKind::END) {
       return UnterminatedArrayError(directive, type, name);
     }
 
     loop = true;
   } else {
-    if ((**next)[0] != '"') {
+    if (next->kind != TokenKind::QUOTED_STRING) {
       // TODO: Make this compatible with all PBRT versions
       return absl::InvalidArgumentError(absl::StrCat(
           "Non-array ", type, " value for ", directive, " parameter ", name,
-          " was not a string: '", **next, "'"));
+          " was not a string: '", next->text, "'"));
     }
     loop = false;
   }
 
   absl::Status status;
-  if ((**next)[0] == '"') {
-    auto& output_storage = storage.NextString();
+  if (next->kind == TokenKind::QUOTED_STRING) {
+    auto output_storage = storage.NewArray<absl::string_view>();
     status =
         ParseParameterListImpl(directive, type, name, ParameterType::SPECTRUM,
                                storage, tokenizer, output_storage, loop);
     output = absl::MakeSpan(output_storage);
   } else {
-    auto& output_storage = storage.NextFloat2();
+    auto output_storage = storage.NewArray<std::array<double, 2>>();
     status =
         ParseParameterListImpl(directive, type, name, ParameterType::SPECTRUM,
                                storage, tokenizer, output_storage, loop);
@@ -523,22 +625,18 @@ absl::Status ParseSpectrumParameter(
 
 absl::StatusOr<absl::string_view> ReadQuotedString(absl::string_view directive,
                                                    Tokenizer& tokenizer) {
-  absl::StatusOr<const std::string*> next = tokenizer.Next();
-  if (!next.ok()) {
-    return next.status();
-  }
-
-  if (!*next) {
+  const Token& next = tokenizer.Next();
+  if (next.kind == TokenKind::END) {
     return absl::InvalidArgumentError(
         absl::StrCat("Missing parameter to directive ", directive));
   }
 
-  if ((**next)[0] != '"') {
+  if (next.kind != TokenKind::QUOTED_STRING) {
     return absl::InvalidArgumentError(absl::StrCat(
-        "Invalid parameter to directive ", directive, ": '", **next, "'"));
+        "Invalid parameter to directive ", directive, ": '", next.text, "'"));
   }
 
-  absl::string_view view(**next);
+  absl::string_view view = next.text;
   view.remove_prefix(1);
   view.remove_suffix(1);
 
@@ -548,54 +646,28 @@ absl::StatusOr<absl::string_view> ReadQuotedString(absl::string_view directive,
 absl::StatusOr<absl::InlinedVector<double, 16>> ReadFloatParameters(
     absl::string_view directive, ParameterStorage& storage,
     Tokenizer& tokenizer, size_t num_to_read, bool is_array) {
-  if (is_array) {
-    absl::StatusOr<const std::string*> next = tokenizer.Next();
-    if (!next.ok()) {
-      return next.status();
-    }
-
-    if (!*next) {
-      return InvalidParameterCount(directive, num_to_read, is_array);
-    }
-
-    if (**next != "[") {
-      return InvalidParameterCount(directive, num_to_read, is_array);
-    }
+  if (is_array && tokenizer.Next().kind != TokenKind::OPEN_BRACKET) {
+    return InvalidParameterCount(directive, num_to_read, is_array);
   }
 
   absl::InlinedVector<double, 16> results;
   for (size_t i = 0; i < num_to_read; i++) {
-    absl::StatusOr<const std::string*> next = tokenizer.Next();
-    if (!next.ok()) {
-      return next.status();
-    }
-
-    if (!*next || (is_array && **next == "]")) {
-      return InvalidParameterCount(directive, num_to_read, is_array);
-    }
+    const Token& next = tokenizer.Next();
+    if (next.kind != TokenKind::NUMBER) {
+      if (next.kind == TokenKind::END ||
+          (is_array && next.kind == TokenKind::CLOSE_BRACKET)) {
+        return InvalidParameterCount(directive, num_to_read, is_array);
+      }
 
-    double value;
-    if (!absl::SimpleAtod(**next, &value)) {
       return absl::InvalidArgumentError(absl::StrCat(
-          "Invalid parameter to directive ", directive, ": '", **next, "'"));
+          "Invalid parameter to directive ", directive, ": '", next.text, "'"));
     }
 
-    results.push_back(value);
+    results.push_back(next.number);
   }
 
-  if (is_array) {
-    absl::StatusOr<const std::string*> next = tokenizer.Next();
-    if (!next.ok()) {
-      return next.status();
-    }
-
-    if (!*next) {
-      return InvalidParameterCount(directive, num_to_read, is_array);
-    }
-
-    if (**next != "]") {
-      return InvalidParameterCount(directive, num_to_read, is_array);
-    }
+  if (is_array && tokenizer.Next().kind != TokenKind::CLOSE_BRACKET) {
+    return InvalidParameterCount(directive, num_to_read, is_array);
   }
 
   return results;
@@ -604,24 +676,20 @@ absl::StatusOr<absl::InlinedVector<double, 16>> ReadFloatParameters(
 absl::StatusOr<absl::string_view> ReadTypeName(
     absl::string_view directive, ParameterStorage& storage,
     Tokenizer& tokenizer, absl::string_view first_parameter_name) {
-  absl::StatusOr<const std::string*> next = tokenizer.Next();
-  if (!next.ok()) {
-    return next.status();
-  }
-
-  if (!*next) {
+  const Token& next = tokenizer.Next();
+  if (next.kind == TokenKind::END) {
     return absl::InvalidArgumentError(
         absl::StrCat("Missing ", first_parameter_name,
                      " parameter to directive ", directive));
   }
 
-  if ((**next)[0] != '"') {
+  if (next.kind != TokenKind::QUOTED_STRING) {
     return absl::InvalidArgumentError(absl::StrCat(
         "Unquoted ", first_parameter_name, " parameter to directive ",
-        directive, ": '", **next, "'"));
+        directive, ": '", next.text, "'"));
   }
 
-  absl::string_view type_name = **next;
+  absl::string_view type_name = next.text;
   type_name.remove_prefix(1);
   type_name.remove_suffix(1);
 
@@ -635,16 +703,11 @@ ReadParameterTypeAndName(
     const absl::flat_hash_map<absl::string_view, ParameterType>&
         parameter_type_names,
     ParameterStorage& storage, Tokenizer& tokenizer) {
-  absl::StatusOr<const std::string*> next = tokenizer.Peek();
-  if (!next.ok()) {
-    return next.status();
-  }
-
-  if (!*next || (**next)[0] != '"') {
+  if (tokenizer.Peek().kind != TokenKind::QUOTED_STRING) {
     return std::nullopt;
   }
 
-  absl::string_view token = storage.Add(**tokenizer.Next());
+  absl::string_view token = storage.Add(tokenizer.Next().text);
   absl::string_view unquoted_token = token;
   unquoted_token.remove_prefix(1);
   unquoted_token.remove_suffix(1);
@@ -668,20 +731,20 @@ ReadParameterTypeAndName(
   return std::make_tuple(type_iter->second, tokens[0], tokens[1]);
 }
 
-absl::StatusOr<absl::string_view> ReadParameters(
+absl::Status ReadParameterList(
     absl::string_view directive,
     const absl::flat_hash_map<absl::string_view, ParameterType>&
         parameter_type_names,
     ParameterStorage& storage, Tokenizer& tokenizer,
     absl::flat_hash_map<absl::string_view, Parameter>& parameters,
-    absl::string_view first_parameter_name = "type") {
-  absl::StatusOr<absl::string_view> type_name =
-      ReadTypeName(directive, storage, tokenizer, first_parameter_name);
-  if (!type_name.ok()) {
-    return type_name.status();
+    ParameterSink* absl_nullable sink,
+    absl::flat_hash_map<absl::string_view, Parameter>* absl_nullable
+        streamed_parameters) {
+  parameters.clear();
+  if (streamed_parameters != nullptr) {
+    streamed_parameters->clear();
   }
 
-  parameters.clear();
   for (;;) {
     absl::StatusOr<std::optional<
         std::tuple<ParameterType, absl::string_view, absl::string_view>>>
@@ -701,9 +764,10 @@ absl::StatusOr<absl::string_view> ReadParameters(
 
     absl::Status status;
     ParameterValues values;
+    bool streamed = false;
     switch (parameter_type) {
       case ParameterType::BLACKBODY_V1: {
-        auto& output = storage.NextFloat2();
+        auto output = storage.NewArray<std::array<double, 2>>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/true);
@@ -711,7 +775,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::BLACKBODY_V2: {
-        auto& output = storage.NextFloat();
+        auto output = storage.NewArray<double>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/false);
@@ -719,7 +783,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::BOOL_OR_TEXTURE: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseSingleStringParameter(directive, type, parameter_name,
                                             parameter_type, storage, tokenizer,
                                             output);
@@ -733,7 +797,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         ABSL_FALLTHROUGH_INTENDED;
       }
       case ParameterType::BOOL: {
-        auto& output = storage.NextBool();
+        auto output = storage.NewArray<bool>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/false);
@@ -741,7 +805,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::FLOAT_OR_TEXTURE: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseSingleStringParameter(directive, type, parameter_name,
                                             parameter_type, storage, tokenizer,
                                             output);
@@ -755,7 +819,14 @@ absl::StatusOr<absl::string_view> ReadParameters(
         ABSL_FALLTHROUGH_INTENDED;
       }
       case ParameterType::FLOAT: {
-        auto& output = storage.NextFloat();
+        streamed = TryStreamParameterList<double>(
+            directive, type, parameter_name, parameter_type, storage,
+            tokenizer, sink, /*must_loop=*/false, status);
+        if (streamed) {
+          break;
+        }
+
+        auto output = storage.NewArray<double>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/false);
@@ -763,7 +834,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::INTEGER_OR_TEXTURE: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseSingleStringParameter(directive, type, parameter_name,
                                             parameter_type, storage, tokenizer,
                                             output);
@@ -777,7 +848,14 @@ absl::StatusOr<absl::string_view> ReadParameters(
         ABSL_FALLTHROUGH_INTENDED;
       }
       case ParameterType::INTEGER: {
-        auto& output = storage.NextInt();
+        streamed = TryStreamParameterList<int32_t>(
+            directive, type, parameter_name, parameter_type, storage,
+            tokenizer, sink, /*must_loop=*/false, status);
+        if (streamed) {
+          break;
+        }
+
+        auto output = storage.NewArray<int32_t>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/false);
@@ -785,7 +863,14 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::INTEGER_STRICT: {
-        auto& output = storage.NextInt();
+        streamed = TryStreamParameterList<int32_t>(
+            directive, type, parameter_name, parameter_type, storage,
+            tokenizer, sink, /*must_loop=*/false, status);
+        if (streamed) {
+          break;
+        }
+
+        auto output = storage.NewArray<int32_t>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/false);
@@ -794,7 +879,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::NORMAL3_OR_TEXTURE: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseSingleStringParameter(directive, type, parameter_name,
                                             parameter_type, storage, tokenizer,
                                             output);
@@ -808,7 +893,14 @@ absl::StatusOr<absl::string_view> ReadParameters(
         ABSL_FALLTHROUGH_INTENDED;
       }
       case ParameterType::NORMAL3: {
-        auto& output = storage.NextFloat3();
+        streamed = TryStreamParameterList<std::array<double, 3>>(
+            directive, type, parameter_name, parameter_type, storage,
+            tokenizer, sink, /*must_loop=*/true, status);
+        if (streamed) {
+          break;
+        }
+
+        auto output = storage.NewArray<std::array<double, 3>>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/true);
@@ -816,7 +908,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::POINT2: {
-        auto& output = storage.NextFloat2();
+        auto output = storage.NewArray<std::array<double, 2>>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/true);
@@ -824,7 +916,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::POINT3_OR_TEXTURE: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseSingleStringParameter(directive, type, parameter_name,
                                             parameter_type, storage, tokenizer,
                                             output);
@@ -838,7 +930,14 @@ absl::StatusOr<absl::string_view> ReadParameters(
         ABSL_FALLTHROUGH_INTENDED;
       }
       case ParameterType::POINT3: {
-        auto& output = storage.NextFloat3();
+        streamed = TryStreamParameterList<std::array<double, 3>>(
+            directive, type, parameter_name, parameter_type, storage,
+            tokenizer, sink, /*must_loop=*/true, status);
+        if (streamed) {
+          break;
+        }
+
+        auto output = storage.NewArray<std::array<double, 3>>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/true);
@@ -846,7 +945,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::RGB_OR_TEXTURE: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseSingleStringParameter(directive, type, parameter_name,
                                             parameter_type, storage, tokenizer,
                                             output);
@@ -860,7 +959,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         ABSL_FALLTHROUGH_INTENDED;
       }
       case ParameterType::RGB: {
-        auto& output = storage.NextFloat3();
+        auto output = storage.NewArray<std::array<double, 3>>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/true);
@@ -873,7 +972,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::STRING: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/false);
@@ -881,7 +980,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::TEXTURE: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/false);
@@ -889,7 +988,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::VECTOR2: {
-        auto& output = storage.NextFloat2();
+        auto output = storage.NewArray<std::array<double, 2>>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/true);
@@ -897,7 +996,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::VECTOR3_OR_TEXTURE: {
-        auto& output = storage.NextString();
+        auto output = storage.NewArray<absl::string_view>();
         status = ParseSingleStringParameter(directive, type, parameter_name,
                                             parameter_type, storage, tokenizer,
                                             output);
@@ -911,7 +1010,14 @@ absl::StatusOr<absl::string_view> ReadParameters(
         ABSL_FALLTHROUGH_INTENDED;
       }
       case ParameterType::VECTOR3: {
-        auto& output = storage.NextFloat3();
+        streamed = TryStreamParameterList<std::array<double, 3>>(
+            directive, type, parameter_name, parameter_type, storage,
+            tokenizer, sink, /*must_loop=*/true, status);
+        if (streamed) {
+          break;
+        }
+
+        auto output = storage.NewArray<std::array<double, 3>>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/true);
@@ -919,7 +1025,7 @@ absl::StatusOr<absl::string_view> ReadParameters(
         break;
       }
       case ParameterType::XYZ: {
-        auto& output = storage.NextFloat3();
+        auto output = storage.NewArray<std::array<double, 3>>();
         status = ParseParameterList(directive, type, parameter_name,
                                     parameter_type, storage, tokenizer, output,
                                     /*must_loop=*/true);
@@ -932,6 +1038,25 @@ absl::StatusOr<absl::string_view> ReadParameters(
       return status;
     }
 
+    if (streamed) {
+      parameters.erase(parameter_name);
+      if (streamed_parameters != nullptr) {
+        Parameter& parameter = (*streamed_parameters)[parameter_name];
+        parameter.directive = directive;
+        parameter.type = parameter_type;
+        parameter.type_name = type;
+      }
+      continue;
+    }
+
+    if (sink != nullptr) {
+      sink->Discard(parameter_name);
+    }
+
+    if (streamed_parameters != nullptr) {
+      streamed_parameters->erase(parameter_name);
+    }
+
     Parameter& parameter = parameters[parameter_name];
     parameter.directive = directive;
     parameter.type = parameter_type;
@@ -939,6 +1064,30 @@ absl::StatusOr<absl::string_view> ReadParameters(
     parameter.values = std::move(values);
   }
 
+  return absl::OkStatus();
+}
+
+absl::StatusOr<absl::string_view> ReadParameters(
+    absl::string_view directive,
+    const absl::flat_hash_map<absl::string_view, ParameterType>&
+        parameter_type_names,
+    ParameterStorage& storage, Tokenizer& tokenizer,
+    absl::flat_hash_map<absl::string_view, Parameter>& parameters,
+    absl::string_view first_parameter_name = "type") {
+  absl::StatusOr<absl::string_view> type_name =
+      ReadTypeName(directive, storage, tokenizer, first_parameter_name);
+  if (!type_name.ok()) {
+    return type_name.status();
+  }
+
+  if (absl::Status status =
+          ReadParameterList(directive, parameter_type_names, storage,
+                            tokenizer, parameters, /*sink=*/nullptr,
+                            /*streamed_parameters=*/nullptr);
+      !status.ok()) {
+    return status;
+  }
+
   return *type_name;
 }
 
@@ -1016,462 +1165,510 @@ absl::Status TryRemoveValue(
   return absl::OkStatus();
 }
 
+void AddStats(const Tokenizer& tokenizer, ParseStats* absl_nullable stats) {
+  if (stats != nullptr) {
+    stats->bytes += tokenizer.bytes_read();
+    stats->tokens += tokenizer.tokens_read();
+  }
+}
+
 }  // namespace
 
-absl::Status Parser::ReadFrom(std::istream& stream) {
-  Tokenizer tokenizer(&stream);
+absl::Status Parser::ReadFrom(std::istream& stream,
+                              ParseStats* absl_nullable stats) {
+  TraceScope trace("parse");
+  DecompressingIstream decompressed(stream);
+  Tokenizer tokenizer(&decompressed);
+  absl::Status status = ReadFrom(tokenizer);
+  AddStats(tokenizer, stats);
+
+  // Truncated or corrupt input may also surface as a parsing error
+  if (!decompressed.status().ok()) {
+    return decompressed.status();
+  }
+
+  return status;
+}
+
+absl::Status Parser::ReadFrom(absl::string_view buffer,
+                              ParseStats* absl_nullable stats) {
+  TraceScope trace("parse");
+  if (!IsCompressed(buffer)) {
+    Tokenizer tokenizer(buffer);
+    absl::Status status = ReadFrom(tokenizer);
+    AddStats(tokenizer, stats);
+    return status;
+  }
+
+  DecompressingIstream decompressed(buffer);
+  Tokenizer tokenizer(&decompressed);
+  absl::Status status = ReadFrom(tokenizer);
+  AddStats(tokenizer, stats);
+
+  if (!decompressed.status().ok()) {
+    return decompressed.status();
+  }
+
+  return status;
+}
 
+absl::Status Parser::ReadFrom(Tokenizer& tokenizer) {
   ParameterStorage storage;
   absl::flat_hash_map<absl::string_view, Parameter> parameters;
-  absl::flat_hash_map<absl::string_view, std::function<absl::Status()>>
-      directives = {
-          {"Accelerator",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Accelerator", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Accelerator(*type_name, parameters);
-           }},
-          {"ActiveTransform",
-           [&]() {
-             absl::StatusOr<const std::string*> next = tokenizer.Next();
-             if (!next.ok()) {
-               return next.status();
-             }
-
-             if (!*next) {
-               return absl::InvalidArgumentError(
-                   "Missing parameter to directive ActiveTransform");
-             }
-
-             ActiveTransformation transformation;
-             if (**next == "All") {
-               transformation = ActiveTransformation::ALL;
-             } else if (**next == "StartTime") {
-               transformation = ActiveTransformation::START_TIME;
-             } else if (**next == "EndTime") {
-               transformation = ActiveTransformation::END_TIME;
-             } else {
-               return absl::InvalidArgumentError(
-                   "Invalid parameter to directive ActiveTransforms: '" +
-                   **next + "'");
-             }
-
-             return ActiveTransform(transformation);
-           }},
-          {"AreaLightSource",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("AreaLightSource", parameter_type_names_,
-                                storage, tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return AreaLightSource(*type_name, parameters);
-           }},
-          {"AttributeBegin", [&]() { return AttributeBegin(); }},
-          {"AttributeEnd", [&]() { return AttributeEnd(); }},
-          {"Camera",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Camera", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Camera(*type_name, parameters);
-           }},
-          {"ConcatTransform",
-           [&]() {
-             auto values = ReadFloatParameters("ConcatTransform", storage,
-                                               tokenizer, 16, true);
-             if (!values.ok()) {
-               return values.status();
-             }
-
-             return ConcatTransform(
-                 (*values)[0], (*values)[1], (*values)[2], (*values)[3],
-                 (*values)[4], (*values)[5], (*values)[6], (*values)[7],
-                 (*values)[8], (*values)[9], (*values)[10], (*values)[11],
-                 (*values)[12], (*values)[13], (*values)[14], (*values)[15]);
-           }},
-          {"CoordinateSystem",
-           [&]() {
-             auto name = ReadQuotedString("CoordinateSystem", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             return CoordinateSystem(*name);
-           }},
-          {"CoordSysTransform",
-           [&]() {
-             auto name = ReadQuotedString("CoordSysTransform", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             return CoordSysTransform(*name);
-           }},
-          {"Film",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name = ReadParameters(
-                 "Film", parameter_type_names_, storage, tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Film(*type_name, parameters);
-           }},
-          {"Identity", [&]() { return Identity(); }},
-          {"Include",
-           [&]() {
-             auto name = ReadQuotedString("Include", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             return Include(*name);
-           }},
-          {"Integrator",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Integrator", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Integrator(*type_name, parameters);
-           }},
-          {"Import",
-           [&]() {
-             auto name = ReadQuotedString("Import", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             return Import(*name);
-           }},
-          {"LightSource",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("LightSource", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return LightSource(*type_name, parameters);
-           }},
-          {"LookAt",
-           [&]() {
-             auto values =
-                 ReadFloatParameters("LookAt", storage, tokenizer, 9, false);
-             if (!values.ok()) {
-               return values.status();
-             }
-
-             return LookAt((*values)[0], (*values)[1], (*values)[2],
-                           (*values)[3], (*values)[4], (*values)[5],
-                           (*values)[6], (*values)[7], (*values)[8]);
-           }},
-          {"MakeNamedMaterial",
-           [&]() {
-             absl::StatusOr<absl::string_view> material_name =
-                 ReadParameters("MakeNamedMaterial", parameter_type_names_,
-                                storage, tokenizer, parameters, "name");
-             if (!material_name.ok()) {
-               return material_name.status();
-             }
-
-             return MakeNamedMaterial(*material_name, parameters);
-           }},
-          {"MakeNamedMedium",
-           [&]() {
-             absl::StatusOr<absl::string_view> medium_name =
-                 ReadParameters("MakeNamedMedium", parameter_type_names_,
-                                storage, tokenizer, parameters, "name");
-             if (!medium_name.ok()) {
-               return medium_name.status();
-             }
-
-             return MakeNamedMedium(*medium_name, parameters);
-           }},
-          {"Material",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Material", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Material(*type_name, parameters);
-           }},
-          {"MediumInterface",
-           [&]() {
-             auto inside = ReadQuotedString("MediumInterface", tokenizer);
-             if (!inside.ok()) {
-               return inside.status();
-             }
-
-             absl::string_view persisted_inside = storage.Add(*inside);
-
-             auto outside = ReadQuotedString("MediumInterface", tokenizer);
-             if (!outside.ok()) {
-               return outside.status();
-             }
-
-             return MediumInterface(persisted_inside, *outside);
-           }},
-          {"NamedMaterial",
-           [&]() {
-             auto name = ReadQuotedString("NamedMaterial", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             return NamedMaterial(*name);
-           }},
-          {"ObjectBegin",
-           [&]() {
-             auto name = ReadQuotedString("ObjectBegin", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             return ObjectBegin(*name);
-           }},
-          {"ObjectEnd", [&]() { return ObjectEnd(); }},
-          {"ObjectInstance",
-           [&]() {
-             auto name = ReadQuotedString("ObjectInstance", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             return ObjectInstance(*name);
-           }},
-          {"PixelFilter",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("PixelFilter", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return PixelFilter(*type_name, parameters);
-           }},
-          {"Renderer",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Renderer", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Renderer(*type_name, parameters);
-           }},
-          {"ReverseOrientation", [&]() { return ReverseOrientation(); }},
-          {"Rotate",
-           [&]() {
-             auto values =
-                 ReadFloatParameters("Rotate", storage, tokenizer, 4, false);
-             if (!values.ok()) {
-               return values.status();
-             }
-
-             return Rotate((*values)[0], (*values)[1], (*values)[2],
-                           (*values)[3]);
-           }},
-          {"Sampler",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Sampler", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Sampler(*type_name, parameters);
-           }},
-          {"Scale",
-           [&]() {
-             auto values =
-                 ReadFloatParameters("Scale", storage, tokenizer, 3, false);
-             if (!values.ok()) {
-               return values.status();
-             }
-
-             return Scale((*values)[0], (*values)[1], (*values)[2]);
-           }},
-          {"SearchPath",
-           [&]() {
-             auto name = ReadQuotedString("SearchPath", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             return SearchPath(*name);
-           }},
-          {"Shape",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Shape", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Shape(*type_name, parameters);
-           }},
-          {"SurfaceIntegrator",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("SurfaceIntegrator", parameter_type_names_,
-                                storage, tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return SurfaceIntegrator(*type_name, parameters);
-           }},
-          {"Texture",
-           [&]() {
-             auto name = ReadQuotedString("Texture", tokenizer);
-             if (!name.ok()) {
-               return name.status();
-             }
-
-             absl::string_view texture_name = storage.Add(*name);
-
-             auto type = ReadQuotedString("Texture", tokenizer);
-             if (!type.ok()) {
-               return type.status();
-             }
-
-             absl::Status (Parser::*impl)(
-                 absl::string_view, absl::string_view,
-                 absl::flat_hash_map<absl::string_view, Parameter>&);
-             if (*type == "color" || *type == "spectrum") {
-               impl = &Parser::SpectrumTexture;
-             } else if (*type == "float") {
-               impl = &Parser::FloatTexture;
-             } else {
-               return absl::InvalidArgumentError(
-                   absl::StrCat("Unrecgonized Texture type: \"", *type, "\""));
-             }
-
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Texture", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return (this->*impl)(texture_name, *type_name, parameters);
-           }},
-          {"Transform",
-           [&]() {
-             auto values =
-                 ReadFloatParameters("Transform", storage, tokenizer, 16, true);
-             if (!values.ok()) {
-               return values.status();
-             }
-
-             return Transform(
-                 (*values)[0], (*values)[1], (*values)[2], (*values)[3],
-                 (*values)[4], (*values)[5], (*values)[6], (*values)[7],
-                 (*values)[8], (*values)[9], (*values)[10], (*values)[11],
-                 (*values)[12], (*values)[13], (*values)[14], (*values)[15]);
-           }},
-          {"TransformBegin", [&]() { return TransformBegin(); }},
-          {"TransformEnd", [&]() { return TransformEnd(); }},
-          {"TransformTimes",
-           [&]() {
-             auto values = ReadFloatParameters("TransformTimes", storage,
-                                               tokenizer, 2, false);
-             if (!values.ok()) {
-               return values.status();
-             }
-
-             return TransformTimes((*values)[0], (*values)[1]);
-           }},
-          {"Translate",
-           [&]() {
-             auto values =
-                 ReadFloatParameters("Translate", storage, tokenizer, 3, false);
-             if (!values.ok()) {
-               return values.status();
-             }
-
-             return Translate((*values)[0], (*values)[1], (*values)[2]);
-           }},
-          {"Volume",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("Volume", parameter_type_names_, storage,
-                                tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return Volume(*type_name, parameters);
-           }},
-          {"VolumeIntegrator",
-           [&]() {
-             absl::StatusOr<absl::string_view> type_name =
-                 ReadParameters("VolumeIntegrator", parameter_type_names_,
-                                storage, tokenizer, parameters);
-             if (!type_name.ok()) {
-               return type_name.status();
-             }
-
-             return VolumeIntegrator(*type_name, parameters);
-           }},
-          {"WorldBegin", [&]() { return WorldBegin(); }},
-          {"WorldEnd", [&]() { return WorldEnd(); }}};
 
-  for (;;) {
-    absl::StatusOr<const std::string*> next = tokenizer.Next();
-    if (!next.ok()) {
-      return next.status();
+  // The parameters of the current directive whose values were passed to `sink`
+  // rather than included in `parameters`
+  ParameterSink* sink = nullptr;
+  absl::flat_hash_map<absl::string_view, Parameter> streamed_parameters;
+
+  // Directives are dispatched with a switch over their keywords rather than a
+  // table of callbacks, so nothing needs to be built for each call
+  auto read_directive = [&](DirectiveKind directive) -> absl::Status {
+    switch (directive) {
+      case DirectiveKind::ACCELERATOR: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("Accelerator", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return Accelerator(*type_name, parameters);
+      }
+      case DirectiveKind::ACTIVE_TRANSFORM: {
+        const Token& next = tokenizer.Next();
+        if (next.kind == TokenKind::END) {
+          return absl::InvalidArgumentError(
+              "Missing parameter to directive ActiveTransform");
+        }
+
+        ActiveTransformation transformation;
+        if (next.text == "All") {
+          transformation = ActiveTransformation::ALL;
+        } else if (next.text == "StartTime") {
+          transformation = ActiveTransformation::START_TIME;
+        } else if (next.text == "EndTime") {
+          transformation = ActiveTransformation::END_TIME;
+        } else {
+          return absl::InvalidArgumentError(
+              absl::StrCat("Invalid parameter to directive "
+                           "ActiveTransforms: '",
+                           next.text, "'"));
+        }
+
+        return ActiveTransform(transformation);
+      }
+      case DirectiveKind::AREA_LIGHT_SOURCE: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("AreaLightSource", parameter_type_names_,
+                           storage, tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return AreaLightSource(*type_name, parameters);
+      }
+      case DirectiveKind::ATTRIBUTE_BEGIN:
+        return AttributeBegin();
+      case DirectiveKind::ATTRIBUTE_END:
+        return AttributeEnd();
+      case DirectiveKind::CAMERA: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("Camera", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return Camera(*type_name, parameters);
+      }
+      case DirectiveKind::CONCAT_TRANSFORM: {
+        auto values = ReadFloatParameters("ConcatTransform", storage,
+                                          tokenizer, 16, true);
+        if (!values.ok()) {
+          return values.status();
+        }
+
+        return ConcatTransform(
+            (*values)[0], (*values)[1], (*values)[2], (*values)[3],
+            (*values)[4], (*values)[5], (*values)[6], (*values)[7],
+            (*values)[8], (*values)[9], (*values)[10], (*values)[11],
+            (*values)[12], (*values)[13], (*values)[14], (*values)[15]);
+      }
+      case DirectiveKind::COORDINATE_SYSTEM: {
+        auto name = ReadQuotedString("CoordinateSystem", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        return CoordinateSystem(*name);
+      }
+      case DirectiveKind::COORD_SYS_TRANSFORM: {
+        auto name = ReadQuotedString("CoordSysTransform", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        return CoordSysTransform(*name);
+      }
+      case DirectiveKind::FILM: {
+        absl::StatusOr<absl::string_view> type_name = ReadParameters(
+            "Film", parameter_type_names_, storage, tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return Film(*type_name, parameters);
+      }
+      case DirectiveKind::IDENTITY:
+        return Identity();
+      case DirectiveKind::INCLUDE: {
+        auto name = ReadQuotedString("Include", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        return Include(*name);
+      }
+      case DirectiveKind::INTEGRATOR: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("Integrator", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return Integrator(*type_name, parameters);
+      }
+      case DirectiveKind::IMPORT: {
+        auto name = ReadQuotedString("Import", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        return Import(*name);
+      }
+      case DirectiveKind::LIGHT_SOURCE: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("LightSource", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return LightSource(*type_name, parameters);
+      }
+      case DirectiveKind::LOOK_AT: {
+        auto values =
+            ReadFloatParameters("LookAt", storage, tokenizer, 9, false);
+        if (!values.ok()) {
+          return values.status();
+        }
+
+        return LookAt((*values)[0], (*values)[1], (*values)[2],
+                      (*values)[3], (*values)[4], (*values)[5],
+                      (*values)[6], (*values)[7], (*values)[8]);
+      }
+      case DirectiveKind::MAKE_NAMED_MATERIAL: {
+        absl::StatusOr<absl::string_view> material_name =
+            ReadParameters("MakeNamedMaterial", parameter_type_names_,
+                           storage, tokenizer, parameters, "name");
+        if (!material_name.ok()) {
+          return material_name.status();
+        }
+
+        return MakeNamedMaterial(*material_name, parameters);
+      }
+      case DirectiveKind::MAKE_NAMED_MEDIUM: {
+        absl::StatusOr<absl::string_view> medium_name =
+            ReadParameters("MakeNamedMedium", parameter_type_names_,
+                           storage, tokenizer, parameters, "name");
+        if (!medium_name.ok()) {
+          return medium_name.status();
+        }
+
+        return MakeNamedMedium(*medium_name, parameters);
+      }
+      case DirectiveKind::MATERIAL: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("Material", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return Material(*type_name, parameters);
+      }
+      case DirectiveKind::MEDIUM_INTERFACE: {
+        auto inside = ReadQuotedString("MediumInterface", tokenizer);
+        if (!inside.ok()) {
+          return inside.status();
+        }
+
+        absl::string_view persisted_inside = storage.Add(*inside);
+
+        auto outside = ReadQuotedString("MediumInterface", tokenizer);
+        if (!outside.ok()) {
+          return outside.status();
+        }
+
+        return MediumInterface(persisted_inside, *outside);
+      }
+      case DirectiveKind::NAMED_MATERIAL: {
+        auto name = ReadQuotedString("NamedMaterial", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        return NamedMaterial(*name);
+      }
+      case DirectiveKind::OBJECT_BEGIN: {
+        auto name = ReadQuotedString("ObjectBegin", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        return ObjectBegin(*name);
+      }
+      case DirectiveKind::OBJECT_END:
+        return ObjectEnd();
+      case DirectiveKind::OBJECT_INSTANCE: {
+        auto name = ReadQuotedString("ObjectInstance", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        return ObjectInstance(*name);
+      }
+      case DirectiveKind::PIXEL_FILTER: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("PixelFilter", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return PixelFilter(*type_name, parameters);
+      }
+      case DirectiveKind::RENDERER: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("Renderer", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return Renderer(*type_name, parameters);
+      }
+      case DirectiveKind::REVERSE_ORIENTATION:
+        return ReverseOrientation();
+      case DirectiveKind::ROTATE: {
+        auto values =
+            ReadFloatParameters("Rotate", storage, tokenizer, 4, false);
+        if (!values.ok()) {
+          return values.status();
+        }
+
+        return Rotate((*values)[0], (*values)[1], (*values)[2],
+                      (*values)[3]);
+      }
+      case DirectiveKind::SAMPLER: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("Sampler", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return Sampler(*type_name, parameters);
+      }
+      case DirectiveKind::SCALE: {
+        auto values =
+            ReadFloatParameters("Scale", storage, tokenizer, 3, false);
+        if (!values.ok()) {
+          return values.status();
+        }
+
+        return Scale((*values)[0], (*values)[1], (*values)[2]);
+      }
+      case DirectiveKind::SEARCH_PATH: {
+        auto name = ReadQuotedString("SearchPath", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        return SearchPath(*name);
+      }
+      case DirectiveKind::SHAPE: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadTypeName("Shape", storage, tokenizer, "type");
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        sink = ShapeParameterSink(*type_name);
+        if (absl::Status status = ReadParameterList(
+                "Shape", parameter_type_names_, storage, tokenizer,
+                parameters, sink, &streamed_parameters);
+            !status.ok()) {
+          return status;
+        }
+
+        return Shape(*type_name, parameters);
+      }
+      case DirectiveKind::SURFACE_INTEGRATOR: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("SurfaceIntegrator", parameter_type_names_,
+                           storage, tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return SurfaceIntegrator(*type_name, parameters);
+      }
+      case DirectiveKind::TEXTURE: {
+        auto name = ReadQuotedString("Texture", tokenizer);
+        if (!name.ok()) {
+          return name.status();
+        }
+
+        absl::string_view texture_name = storage.Add(*name);
+
+        auto type = ReadQuotedString("Texture", tokenizer);
+        if (!type.ok()) {
+          return type.status();
+        }
+
+        absl::Status (Parser::*impl)(
+            absl::string_view, absl::string_view,
+            absl::flat_hash_map<absl::string_view, Parameter>&);
+        if (*type == "color" || *type == "spectrum") {
+          impl = &Parser::SpectrumTexture;
+        } else if (*type == "float") {
+          impl = &Parser::FloatTexture;
+        } else {
+          return absl::InvalidArgumentError(
+              absl::StrCat("Unrecgonized Texture type: \"", *type, "\""));
+        }
+
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("Texture", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return (this->*impl)(texture_name, *type_name, parameters);
+      }
+      case DirectiveKind::TRANSFORM: {
+        auto values =
+            ReadFloatParameters("Transform", storage, tokenizer, 16, true);
+        if (!values.ok()) {
+          return values.status();
+        }
+
+        return Transform(
+            (*values)[0], (*values)[1], (*values)[2], (*values)[3],
+            (*values)[4], (*values)[5], (*values)[6], (*values)[7],
+            (*values)[8], (*values)[9], (*values)[10], (*values)[11],
+            (*values)[12], (*values)[13], (*values)[14], (*values)[15]);
+      }
+      case DirectiveKind::TRANSFORM_BEGIN:
+        return TransformBegin();
+      case DirectiveKind::TRANSFORM_END:
+        return TransformEnd();
+      case DirectiveKind::TRANSFORM_TIMES: {
+        auto values = ReadFloatParameters("TransformTimes", storage,
+                                          tokenizer, 2, false);
+        if (!values.ok()) {
+          return values.status();
+        }
+
+        return TransformTimes((*values)[0], (*values)[1]);
+      }
+      case DirectiveKind::TRANSLATE: {
+        auto values =
+            ReadFloatParameters("Translate", storage, tokenizer, 3, false);
+        if (!values.ok()) {
+          return values.status();
+        }
+
+        return Translate((*values)[0], (*values)[1], (*values)[2]);
+      }
+      case DirectiveKind::VOLUME: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("Volume", parameter_type_names_, storage,
+                           tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return Volume(*type_name, parameters);
+      }
+      case DirectiveKind::VOLUME_INTEGRATOR: {
+        absl::StatusOr<absl::string_view> type_name =
+            ReadParameters("VolumeIntegrator", parameter_type_names_,
+                           storage, tokenizer, parameters);
+        if (!type_name.ok()) {
+          return type_name.status();
+        }
+
+        return VolumeIntegrator(*type_name, parameters);
+      }
+      case DirectiveKind::WORLD_BEGIN:
+        return WorldBegin();
+      case DirectiveKind::WORLD_END:
+        return WorldEnd();
     }
 
-    if (!*next) {
+    return absl::InternalError("Unhandled directive");
+  };
+
+  for (;;) {
+    const Token& next = tokenizer.Next();
+    if (next.kind == TokenKind::END) {
       break;
     }
 
-    auto iter = directives.find(**next);
-    if (iter == directives.end()) {
+    std::optional<DirectiveKind> directive = LookupDirective(next.text);
+    if (!directive) {
       return absl::InvalidArgumentError(
-          absl::StrCat("Unrecognized directive: '", **next, "'"));
+          absl::StrCat("Unrecognized directive: '", next.text, "'"));
     }
 
-    if (absl::Status status = iter->second(); !status.ok()) {
+    // Tokenizer errors end the input early, so they take precedence over
+    // any error that the truncated input caused
+    if (absl::Status status = read_directive(*directive); !status.ok()) {
+      if (!tokenizer.status().ok()) {
+        return tokenizer.status();
+      }
+
       return status;
     }
 
+    for (const auto& [name, parameter] : streamed_parameters) {
+      if (sink != nullptr && !sink->Used(name)) {
+        parameters[name] = parameter;
+      }
+    }
+
     for (const auto& [name, parameter] : parameters) {
-      std::cerr << "WARNING: Unused " << parameter.directive << " "
-                << parameter.type_name << " parameter: '" << name << "'"
-                << std::endl;
+      Warnings() << "WARNING: Unused " << parameter.directive << " "
+                 << parameter.type_name << " parameter: '" << name << "'"
+                 << std::endl;
     }
 
     parameters.clear();
+    sink = nullptr;
+    streamed_parameters.clear();
     storage.Clear();
+
+    if (absl::Status status = DirectiveEnd(); !status.ok()) {
+      return status;
+    }
   }
 
-  return absl::OkStatus();
+  return tokenizer.status();
 }
 
 absl::Status TryRemoveFloats(
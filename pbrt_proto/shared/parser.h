@@ -7,6 +7,7 @@
 #include <optional>
 #include <variant>
 
+#include "absl/base/nullability.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
@@ -53,15 +54,64 @@ struct Parameter {
   ParameterValues values;
 };
 
+// Receives the values of large numeric parameters in batches as they are read,
+// so that they can be written directly to their final destination instead of
+// first being stored in full and passed to the directive.
+class ParameterSink {
+ public:
+  virtual ~ParameterSink() = default;
+
+  // Called before the values of a numeric parameter are read. Returns true if
+  // the values should be passed to `Append` instead of being included in the
+  // parameters passed to the directive.
+  virtual bool Begin(absl::string_view name, ParameterType type) = 0;
+
+  // Called with consecutive runs of values of the parameter most recently
+  // accepted by `Begin`. Only the overload matching its type is called.
+  virtual void Append(absl::Span<const double> values) {}
+  virtual void Append(absl::Span<const int32_t> values) {}
+  virtual void Append(absl::Span<const std::array<double, 3>> values) {}
+
+  // Called for each parameter that is passed to the directive as usual. As
+  // later parameters replace earlier ones of the same name, any values
+  // previously received for a parameter named `name` should be discarded.
+  virtual void Discard(absl::string_view name) = 0;
+
+  // Called after the directive for each parameter whose values were passed to
+  // `Append`. Returns false if the directive did not use them, in which case
+  // the parameter is reported as unused like any other.
+  virtual bool Used(absl::string_view name) const { return true; }
+};
+
 enum class ActiveTransformation {
   ALL,
   START_TIME,
   END_TIME,
 };
 
+class Tokenizer;
+
+// Counts of the input read by a `Parser`. Bytes are counted after any
+// decompression.
+struct ParseStats {
+  uint64_t bytes = 0;
+  uint64_t tokens = 0;
+};
+
 class Parser {
  public:
-  absl::Status ReadFrom(std::istream& stream);
+  // Reads directives from `stream`. Input that is gzip or zstd compressed is
+  // decompressed as it is read. If `stats` is not null, the input read is added
+  // to it.
+  absl::Status ReadFrom(std::istream& stream,
+                        ParseStats* absl_nullable stats = nullptr);
+
+  // Reads directives from an in-memory buffer such as a memory mapped file.
+  // As above, compressed input is decompressed as it is read.
+  //
+  // NOTE: `buffer` must remain valid for the duration of the call
+  absl::Status ReadFrom(absl::string_view buffer,
+                        ParseStats* absl_nullable stats = nullptr);
 
  protected:
   Parser(const absl::flat_hash_map<absl::string_view, ParameterType>&
@@ -69,6 +119,11 @@ class Parser {
       : parameter_type_names_(parameter_type_names) {}
 
  private:
+  absl::Status ReadFrom(Tokenizer& tokenizer);
+
+  // Called after each directive has been read and passed to its callback
+  virtual absl::Status DirectiveEnd() { return absl::OkStatus(); }
+
   virtual absl::Status Accelerator(
       absl::string_view accelerator_type,
       absl::flat_hash_map<absl::string_view, Parameter>& parameters) = 0;
@@ -172,6 +227,13 @@ class Parser {
       absl::string_view shape_type,
       absl::flat_hash_map<absl::string_view, Parameter>& parameters) = 0;
 
+  // Returns the sink that receives the numeric parameters of a Shape directive
+  // of type `shape_type`, or null if they should all be passed to `Shape`.
+  virtual ParameterSink* absl_nullable ShapeParameterSink(
+      absl::string_view shape_type) {
+    return nullptr;
+  }
+
   virtual absl::Status SpectrumTexture(
       absl::string_view spectrum_texture_name,
       absl::string_view spectrum_texture_type,
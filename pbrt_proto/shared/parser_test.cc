@@ -3,11 +3,14 @@
 #include <array>
 #include <cstdint>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include "absl/container/inlined_vector.h"
 #include "absl/status/status_matchers.h"
 #include "googlemock/include/gmock/gmock.h"
 #include "googletest/include/gtest/gtest.h"
+#include "pbrt_proto/shared/trace.h"
 
 namespace pbrt_proto {
 namespace {
@@ -16,14 +19,17 @@ using ::absl_testing::IsOk;
 using ::absl_testing::StatusIs;
 using ::testing::Contains;
 using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
 using ::testing::Eq;
 using ::testing::FieldsAre;
+using ::testing::HasSubstr;
 using ::testing::IsEmpty;
 using ::testing::Key;
 using ::testing::Not;
 using ::testing::Optional;
 using ::testing::Pair;
 using ::testing::Return;
+using ::testing::UnorderedElementsAre;
 using ::testing::VariantWith;
 
 static const absl::flat_hash_map<absl::string_view, ParameterType>
@@ -54,6 +60,48 @@ static const absl::flat_hash_map<absl::string_view, ParameterType>
         {"zzz", ParameterType::FLOAT},
 };
 
+// Accepts parameters named "aaa" and records everything passed to it
+class RecordingParameterSink final : public ParameterSink {
+ public:
+  bool Begin(absl::string_view name, ParameterType type) override {
+    if (name != "aaa") {
+      return false;
+    }
+
+    begun.push_back(type);
+    return true;
+  }
+
+  void Append(absl::Span<const double> values) override {
+    floats.insert(floats.end(), values.begin(), values.end());
+    num_appends += 1;
+  }
+
+  void Append(absl::Span<const int32_t> values) override {
+    integers.insert(integers.end(), values.begin(), values.end());
+    num_appends += 1;
+  }
+
+  void Append(absl::Span<const std::array<double, 3>> values) override {
+    float3s.insert(float3s.end(), values.begin(), values.end());
+    num_appends += 1;
+  }
+
+  void Discard(absl::string_view name) override {
+    discarded.emplace_back(name);
+  }
+
+  bool Used(absl::string_view name) const override { return used; }
+
+  std::vector<ParameterType> begun;
+  std::vector<double> floats;
+  std::vector<int32_t> integers;
+  std::vector<std::array<double, 3>> float3s;
+  size_t num_appends = 0;
+  std::vector<std::string> discarded;
+  bool used = true;
+};
+
 class MockParser final : public Parser {
  public:
   MockParser() : Parser(parameter_type_names) {}
@@ -165,7 +213,13 @@ class MockParser final : public Parser {
   MOCK_METHOD(absl::Status, WorldBegin, (), (override));
   MOCK_METHOD(absl::Status, WorldEnd, (), (override));
 
+  ParameterSink* shape_parameter_sink = nullptr;
+
  private:
+  ParameterSink* ShapeParameterSink(absl::string_view shape_type) override {
+    return shape_parameter_sink;
+  }
+
   absl::Status ConcatTransform(double m00, double m01, double m02, double m03,
                                double m10, double m11, double m12, double m13,
                                double m20, double m21, double m22, double m23,
@@ -204,6 +258,66 @@ TEST(Parser, UnparsableNumber) {
                        "Invalid parameter to directive Translate: '1a'"));
 }
 
+TEST(Parser, TokenizerErrorTakesPrecedence) {
+  std::stringstream stream("Translate 1 2 \"\\!\"");
+  EXPECT_THAT(MockParser().ReadFrom(stream),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       "Illegal escape character"));
+}
+
+TEST(Parser, TruncatedCompressedInput) {
+  std::stringstream stream("\x1F\x8B");
+  EXPECT_THAT(MockParser().ReadFrom(stream),
+              StatusIs(absl::StatusCode::kDataLoss,
+                       "Compressed input is truncated"));
+  EXPECT_THAT(MockParser().ReadFrom(absl::string_view("\x1F\x8B")),
+              StatusIs(absl::StatusCode::kDataLoss,
+                       "Compressed input is truncated"));
+}
+
+TEST(Parser, CountsInput) {
+  std::stringstream stream("WorldBegin WorldBegin");
+  MockParser parser;
+  EXPECT_CALL(parser, WorldBegin())
+      .Times(2)
+      .WillRepeatedly(Return(absl::OkStatus()));
+
+  ParseStats stats;
+  EXPECT_THAT(parser.ReadFrom(stream, &stats), IsOk());
+  EXPECT_EQ(21u, stats.bytes);
+  EXPECT_EQ(2u, stats.tokens);
+
+  EXPECT_CALL(parser, WorldBegin()).WillOnce(Return(absl::OkStatus()));
+  EXPECT_THAT(parser.ReadFrom(absl::string_view("WorldBegin"), &stats),
+              IsOk());
+  EXPECT_EQ(31u, stats.bytes);
+  EXPECT_EQ(3u, stats.tokens);
+}
+
+class SpanTracer final : public Tracer {
+ public:
+  void BeginSpan(absl::string_view name, absl::string_view detail) override {
+    spans.emplace_back(name);
+  }
+
+  void EndSpan() override { ended += 1; }
+
+  std::vector<std::string> spans;
+  int ended = 0;
+};
+
+TEST(Parser, TracesParse) {
+  SpanTracer tracer;
+  SetTracer(&tracer);
+  std::stringstream stream;
+  EXPECT_THAT(MockParser().ReadFrom(stream), IsOk());
+  EXPECT_THAT(MockParser().ReadFrom(absl::string_view()), IsOk());
+  SetTracer(nullptr);
+
+  EXPECT_THAT(tracer.spans, ElementsAre("parse", "parse"));
+  EXPECT_EQ(2, tracer.ended);
+}
+
 TEST(Parser, NoArray) {
   std::stringstream stream("Transform");
   EXPECT_THAT(
@@ -1375,6 +1489,219 @@ TEST(Parser, Point3Multiple) {
   EXPECT_THAT(parser.ReadFrom(stream), IsOk());
 }
 
+TEST(Parser, BufferPoint3Multiple) {
+  MockParser parser;
+  EXPECT_CALL(
+      parser,
+      Accelerator(
+          "typename",
+          ElementsAre(Pair(
+              "aaa", FieldsAre("Accelerator", ParameterType::POINT3, "point3",
+                               VariantWith<absl::Span<std::array<double, 3>>>(
+                                   ElementsAre(ElementsAre(1.0, 2.0, 3.0),
+                                               ElementsAre(4.0, 5.0, 6.0))))))))
+      .WillOnce(Return(absl::OkStatus()));
+  EXPECT_THAT(parser.ReadFrom("Accelerator \"typename\" \"point3 aaa\" "
+                              "[1.0 2.0 # comment\n3.0 4.0 5.0 6.0]"),
+              IsOk());
+}
+
+// Parameter lists larger than the storage retained between directives must
+// survive being grown, interleaved with strings, and reused by later
+// directives
+TEST(Parser, LargeParameterLists) {
+  std::string strings;
+  std::vector<std::string> expected_strings;
+  for (int i = 0; i < 1000; i++) {
+    expected_strings.push_back("s" + std::to_string(i));
+    strings += " \"" + expected_strings.back() + "\"";
+  }
+
+  std::string floats;
+  std::vector<double> expected_floats;
+  for (int i = 0; i < 10000; i++) {
+    expected_floats.push_back(i);
+    floats += " " + std::to_string(i);
+  }
+
+  std::string directive = "Shape \"typename\" \"string aaa\" [" + strings +
+                          "] \"float bbb\" [" + floats + "]\n";
+
+  MockParser parser;
+  EXPECT_CALL(
+      parser,
+      Shape("typename",
+            UnorderedElementsAre(
+                Pair("aaa",
+                     FieldsAre("Shape", ParameterType::STRING, "string",
+                               VariantWith<absl::Span<absl::string_view>>(
+                                   ElementsAreArray(expected_strings)))),
+                Pair("bbb",
+                     FieldsAre("Shape", ParameterType::FLOAT, "float",
+                               VariantWith<absl::Span<double>>(
+                                   ElementsAreArray(expected_floats)))))))
+      .Times(3)
+      .WillRepeatedly(Return(absl::OkStatus()));
+  EXPECT_THAT(parser.ReadFrom(directive + directive + directive), IsOk());
+}
+
+TEST(Parser, ShapeParameterSink) {
+  RecordingParameterSink sink;
+
+  MockParser parser;
+  parser.shape_parameter_sink = &sink;
+  EXPECT_CALL(parser,
+              Shape("typename",
+                    ElementsAre(Pair(
+                        "bbb", FieldsAre("Shape", ParameterType::FLOAT, "float",
+                                         VariantWith<absl::Span<double>>(
+                                             ElementsAre(7.0)))))))
+      .WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(parser, Accelerator("typename", ElementsAre(Key("aaa"))))
+      .WillOnce(Return(absl::OkStatus()));
+  EXPECT_THAT(
+      parser.ReadFrom("Shape \"typename\" \"float bbb\" 7 "
+                      "\"point3 aaa\" [1 2 3 4 5 6] "
+                      "Accelerator \"typename\" \"point3 aaa\" [1 2 3]"),
+      IsOk());
+
+  EXPECT_THAT(sink.begun, ElementsAre(ParameterType::POINT3));
+  EXPECT_THAT(sink.float3s, ElementsAre(ElementsAre(1.0, 2.0, 3.0),
+                                        ElementsAre(4.0, 5.0, 6.0)));
+  EXPECT_THAT(sink.discarded, ElementsAre("bbb"));
+}
+
+TEST(Parser, ShapeParameterSinkBatches) {
+  std::string integers;
+  std::vector<int32_t> expected_integers;
+  for (int i = 0; i < 10000; i++) {
+    expected_integers.push_back(i);
+    integers += " " + std::to_string(i);
+  }
+
+  RecordingParameterSink sink;
+
+  MockParser parser;
+  parser.shape_parameter_sink = &sink;
+  EXPECT_CALL(parser, Shape("typename", IsEmpty()))
+      .WillOnce(Return(absl::OkStatus()));
+  EXPECT_THAT(parser.ReadFrom("Shape \"typename\" \"integer aaa\" [" +
+                              integers + "]"),
+              IsOk());
+
+  EXPECT_THAT(sink.begun, ElementsAre(ParameterType::INTEGER_STRICT));
+  EXPECT_THAT(sink.integers, ElementsAreArray(expected_integers));
+  EXPECT_GT(sink.num_appends, 1u);
+}
+
+TEST(Parser, ShapeParameterSinkReplacesEarlierParameters) {
+  RecordingParameterSink sink;
+
+  MockParser parser;
+  parser.shape_parameter_sink = &sink;
+  EXPECT_CALL(parser, Shape("typename", IsEmpty()))
+      .WillOnce(Return(absl::OkStatus()));
+  EXPECT_THAT(parser.ReadFrom("Shape \"typename\" \"string aaa\" \"a\" "
+                              "\"float aaa\" [1 2]"),
+              IsOk());
+
+  EXPECT_THAT(sink.begun, ElementsAre(ParameterType::FLOAT));
+  EXPECT_THAT(sink.floats, ElementsAre(1.0, 2.0));
+  EXPECT_THAT(sink.discarded, ElementsAre("aaa"));
+}
+
+TEST(Parser, ShapeParameterSinkTextureFallback) {
+  RecordingParameterSink sink;
+
+  MockParser parser;
+  parser.shape_parameter_sink = &sink;
+  EXPECT_CALL(
+      parser,
+      Shape("typename",
+            ElementsAre(Pair(
+                "aaa", FieldsAre("Shape", ParameterType::TEXTURE,
+                                 "point3_or_tex",
+                                 VariantWith<absl::Span<absl::string_view>>(
+                                     ElementsAre("tex")))))))
+      .WillOnce(Return(absl::OkStatus()));
+  EXPECT_CALL(parser, Shape("typename", IsEmpty()))
+      .WillOnce(Return(absl::OkStatus()))
+      .RetiresOnSaturation();
+  EXPECT_THAT(
+      parser.ReadFrom("Shape \"typename\" \"point3_or_tex aaa\" [1 2 3] "
+                      "Shape \"typename\" \"point3_or_tex aaa\" \"tex\""),
+      IsOk());
+
+  EXPECT_THAT(sink.begun, ElementsAre(ParameterType::POINT3));
+  EXPECT_THAT(sink.float3s, ElementsAre(ElementsAre(1.0, 2.0, 3.0)));
+  EXPECT_THAT(sink.discarded, ElementsAre("aaa"));
+}
+
+TEST(Parser, ShapeParameterSinkUnusedParameters) {
+  RecordingParameterSink sink;
+
+  MockParser parser;
+  parser.shape_parameter_sink = &sink;
+  EXPECT_CALL(parser, Shape("typename", ElementsAre(Key("bbb"))))
+      .WillRepeatedly(Return(absl::OkStatus()));
+
+  testing::internal::CaptureStderr();
+  EXPECT_THAT(parser.ReadFrom("Shape \"typename\" \"point3 aaa\" [1 2 3] "
+                              "\"float bbb\" 7"),
+              IsOk());
+  std::string warnings = testing::internal::GetCapturedStderr();
+  EXPECT_THAT(warnings,
+              HasSubstr("WARNING: Unused Shape float parameter: 'bbb'"));
+  EXPECT_THAT(warnings, Not(HasSubstr("'aaa'")));
+
+  sink.used = false;
+  testing::internal::CaptureStderr();
+  EXPECT_THAT(parser.ReadFrom("Shape \"typename\" \"point3 aaa\" [1 2 3] "
+                              "\"float bbb\" 7"),
+              IsOk());
+  warnings = testing::internal::GetCapturedStderr();
+  EXPECT_THAT(warnings,
+              HasSubstr("WARNING: Unused Shape point3 parameter: 'aaa'"));
+  EXPECT_THAT(warnings,
+              HasSubstr("WARNING: Unused Shape float parameter: 'bbb'"));
+}
+
+TEST(Parser, ShapeParameterSinkError) {
+  RecordingParameterSink sink;
+
+  MockParser parser;
+  parser.shape_parameter_sink = &sink;
+  EXPECT_THAT(
+      parser.ReadFrom("Shape \"typename\" \"point3 aaa\" [1.0 2.0 3.0 4.0]"),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               "Missing value for Shape point3 parameter: 'aaa'"));
+}
+
+TEST(Parser, BufferPoint3FirstCompleteSecondIncomplete) {
+  EXPECT_THAT(
+      MockParser().ReadFrom(
+          "Accelerator \"typename\" \"point3 aaa\" [1.0 2.0 3.0 4.0]"),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               "Missing value for Accelerator point3 parameter: 'aaa'"));
+}
+
+TEST(Parser, BufferInvalidFloat) {
+  EXPECT_THAT(
+      MockParser().ReadFrom(
+          "Accelerator \"typename\" \"float aaa\" [1.0 2.0 1.f]"),
+      StatusIs(
+          absl::StatusCode::kInvalidArgument,
+          "Failed to parse float value for Accelerator parameter aaa: '1.f'"));
+}
+
+TEST(Parser, BufferInvalidInteger) {
+  EXPECT_THAT(
+      MockParser().ReadFrom("Accelerator \"typename\" \"integer aaa\" [1 2.5]"),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               "Failed to parse integer value for Accelerator "
+               "parameter aaa: '2.5'"));
+}
+
 TEST(Parser, Point3OrTexEmpty) {
   std::stringstream stream("Accelerator \"typename\" \"point3_or_tex aaa\" []");
   MockParser parser;
@@ -1,8 +1,11 @@
 #ifndef _PBRT_PROTO_SHARED_PROTO_PARSER_
 
+#include <optional>
 #include <string>
+#include <type_traits>
 #include <utility>
 
+#include "absl/base/nullability.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
@@ -10,16 +13,27 @@
 #include "absl/strings/string_view.h"
 #include "pbrt_proto/pbrt.pb.h"
 #include "pbrt_proto/shared/parser.h"
+#include "pbrt_proto/shared/shapes.h"
 
 namespace pbrt_proto {
 
 template <typename T, int PbrtVersion>
 class ProtoParser : public Parser {
+ public:
+  using Directive =
+      std::remove_reference_t<decltype(*std::declval<T>().add_directives())>;
+
+  // Receives each directive as soon as it is complete. The sink may modify or
+  // take the contents of the directive it is passed.
+  using DirectiveSink = absl::FunctionRef<absl::Status(Directive&)>;
+
  protected:
+  // If `sink` is set, each directive is passed to it once complete and then
+  // removed from `output`, so `output` never holds more than one directive.
   ProtoParser(const absl::flat_hash_map<absl::string_view, ParameterType>&
                   parameter_type_names,
-              T& output)
-      : Parser(parameter_type_names), output_(output) {}
+              T& output, std::optional<DirectiveSink> sink = std::nullopt)
+      : Parser(parameter_type_names), output_(output), sink_(sink) {}
 
   template <typename U>
   using TypeMap = absl::flat_hash_map<
@@ -72,7 +86,15 @@ class ProtoParser : public Parser {
 
   T& output_;
 
+  // Receives the arrays of trianglemesh shapes, which must be moved into the
+  // shape by `Shape`
+  TriangleMeshSink triangle_mesh_sink_;
+
  private:
+  std::optional<DirectiveSink> sink_;
+
+  absl::Status DirectiveEnd() final;
+
   absl::Status ActiveTransform(ActiveTransformation active) final;
 
   absl::Status AttributeBegin() final;
@@ -138,6 +160,9 @@ class ProtoParser : public Parser {
 
   absl::Status SearchPath(absl::string_view path) final;
 
+  ParameterSink* absl_nullable ShapeParameterSink(
+      absl::string_view shape_type) final;
+
   absl::Status SurfaceIntegrator(
       absl::string_view integrator_type,
       absl::flat_hash_map<absl::string_view, Parameter>& parameters) override;
@@ -197,6 +222,25 @@ absl::Status ProtoParser<T, PbrtVersion>::Parse(
                *(*output_.add_directives().*Func)());
 }
 
+template <typename T, int PbrtVersion>
+absl::Status ProtoParser<T, PbrtVersion>::DirectiveEnd() {
+  if (!sink_) {
+    return absl::OkStatus();
+  }
+
+  for (Directive& directive : *output_.mutable_directives()) {
+    if (absl::Status status = (*sink_)(directive); !status.ok()) {
+      return status;
+    }
+  }
+
+  // Cleared directives are kept for reuse, so memory stays bounded by the
+  // largest directive rather than growing with the input
+  output_.mutable_directives()->Clear();
+
+  return absl::OkStatus();
+}
+
 template <typename T, int PbrtVersion>
 absl::Status ProtoParser<T, PbrtVersion>::ActiveTransform(
     ActiveTransformation active) {
@@ -449,6 +493,17 @@ absl::Status ProtoParser<T, PbrtVersion>::SearchPath(absl::string_view path) {
   return UnsupportedDirectiveError("SearchPath");
 }
 
+template <typename T, int PbrtVersion>
+ParameterSink* absl_nullable ProtoParser<T, PbrtVersion>::ShapeParameterSink(
+    absl::string_view shape_type) {
+  if (shape_type != "trianglemesh") {
+    return nullptr;
+  }
+
+  triangle_mesh_sink_.Clear();
+  return &triangle_mesh_sink_;
+}
+
 template <typename T, int PbrtVersion>
 absl::Status ProtoParser<T, PbrtVersion>::SurfaceIntegrator(
     absl::string_view integrator_type,
@@ -1,13 +1,14 @@
 #include "pbrt_proto/shared/renderers.h"
 
 #include <algorithm>
-#include <iostream>
+#include <ostream>
 #include <optional>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/strings/string_view.h"
 #include "pbrt_proto/pbrt.pb.h"
 #include "pbrt_proto/shared/parser.h"
+#include "pbrt_proto/shared/warnings.h"
 
 namespace pbrt_proto {
 
@@ -28,7 +29,7 @@ absl::Status RemoveCreateProbesRenderer(
   std::optional<absl::Span<double>> bounds;
   if (absl::Status status = TryRemoveFloats(parameters, "bounds", 6, bounds);
       !status.ok()) {
-    std::cerr << "WARNING: " << status.message() << std::endl;
+    Warnings() << "WARNING: " << status.message() << std::endl;
   } else if (bounds.has_value()) {
     auto& p0 = *output.mutable_bounds()->mutable_p0();
     p0.set_x((*bounds)[0]);
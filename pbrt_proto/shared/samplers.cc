@@ -6,6 +6,7 @@
 #include "pbrt_proto/pbrt.pb.h"
 #include "pbrt_proto/shared/enums.h"
 #include "pbrt_proto/shared/parser.h"
+#include "pbrt_proto/shared/warnings.h"
 
 namespace pbrt_proto {
 namespace {
@@ -93,9 +94,9 @@ absl::Status RemoveAdaptiveSampler(
     } else if (*method == "shapeid") {
       output.set_method(AdaptiveSampler::SHAPEID);
     } else {
-      std::cerr << "WARNING: Unsupported value for 'adaptive' Sampler "
-                   "parameter 'method': \""
-                << *method << "\"" << std::endl;
+      Warnings() << "WARNING: Unsupported value for 'adaptive' Sampler "
+                    "parameter 'method': \""
+                 << *method << "\"" << std::endl;
       output.set_method(AdaptiveSampler::CONTRAST);
     }
   }
@@ -0,0 +1,305 @@
+#include "pbrt_proto/shared/scanner.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+#include "absl/base/nullability.h"
+#include "absl/numeric/bits.h"
+#include "pbrt_proto/shared/cpu.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PBRT_PROTO_SCANNER_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define PBRT_PROTO_TARGET_AVX2
+#else
+#define PBRT_PROTO_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace pbrt_proto {
+namespace {
+
+constexpr bool IsWhitespace(char ch) {
+  return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+constexpr bool IsDelimiter(char ch) {
+  return IsWhitespace(ch) || ch == '"' || ch == '[' || ch == ']';
+}
+
+bool IsLineEnd(char ch) { return ch == '\r' || ch == '\n'; }
+
+bool IsQuoteEnd(char ch) { return ch == '"' || ch == '\\' || ch == '\n'; }
+
+template <bool (*Matches)(char)>
+const char* absl_nonnull ScalarFind(const char* absl_nonnull begin,
+                                    const char* absl_nonnull end) {
+  while (begin != end && !Matches(*begin)) {
+    begin++;
+  }
+  return begin;
+}
+
+// Portable kernels that process eight bytes at a time within a uint64_t. Each
+// classifier returns a word with the high bit of each matching byte set.
+struct Swar {
+  static constexpr size_t kWidth = 8;
+  static constexpr uint64_t kOnes = 0x0101010101010101u;
+  static constexpr uint64_t kLowBits = 0x7F7F7F7F7F7F7F7Fu;
+  static constexpr uint64_t kHighBits = 0x8080808080808080u;
+
+  // Compilers recognize this as a single load on little endian targets
+  static uint64_t Load(const char* absl_nonnull ptr) {
+    uint64_t word = 0;
+    for (size_t i = 0; i < kWidth; i++) {
+      word |= static_cast<uint64_t>(static_cast<unsigned char>(ptr[i]))
+              << (8 * i);
+    }
+    return word;
+  }
+
+  static uint64_t Equal(uint64_t word, char ch) {
+    uint64_t diff = word ^ (kOnes * static_cast<unsigned char>(ch));
+    return ~(((diff & kLowBits) + kLowBits) | diff | kLowBits);
+  }
+
+  // Matches bytes in the range [0, 0x7F] that are at least `threshold`
+  static uint64_t AtLeast(uint64_t word, unsigned char threshold) {
+    return ((word & kLowBits) + kOnes * (0x80 - threshold)) & ~word &
+           kHighBits;
+  }
+
+  static uint64_t Whitespace(uint64_t word) {
+    return Equal(word, ' ') |
+           (AtLeast(word, '\t') & ~AtLeast(word, '\r' + 1));
+  }
+
+  // Gathers the high bit of each byte into the low eight bits
+  static uint64_t Mask(uint64_t matches) {
+    return ((matches >> 7) * 0x0102040810204080u) >> 56;
+  }
+
+  static uint64_t LineEnd(uint64_t word) {
+    return Equal(word, '\r') | Equal(word, '\n');
+  }
+
+  static uint64_t QuoteEnd(uint64_t word) {
+    return Equal(word, '"') | Equal(word, '\\') | Equal(word, '\n');
+  }
+};
+
+ScannerBlock SwarClassify(const char* absl_nonnull block) {
+  ScannerBlock result = {0, 0};
+  for (size_t i = 0; i < kScannerBlockSize; i += Swar::kWidth) {
+    uint64_t word = Swar::Load(block + i);
+    uint64_t whitespace = Swar::Whitespace(word);
+    uint64_t delimiters = whitespace | Swar::Equal(word, '"') |
+                          Swar::Equal(word, '[') | Swar::Equal(word, ']');
+    result.whitespace |= Swar::Mask(whitespace) << i;
+    result.delimiters |= Swar::Mask(delimiters) << i;
+  }
+  return result;
+}
+
+template <uint64_t (*Classify)(uint64_t), bool (*Matches)(char)>
+const char* absl_nonnull SwarFind(const char* absl_nonnull begin,
+                                  const char* absl_nonnull end) {
+  for (; static_cast<size_t>(end - begin) >= Swar::kWidth;
+       begin += Swar::kWidth) {
+    if (uint64_t mask = Classify(Swar::Load(begin)); mask != 0) {
+      return begin + absl::countr_zero(mask) / 8;
+    }
+  }
+  return ScalarFind<Matches>(begin, end);
+}
+
+const Scanner kSwarScanner = {
+    SwarClassify,
+    SwarFind<Swar::LineEnd, IsLineEnd>,
+    SwarFind<Swar::QuoteEnd, IsQuoteEnd>,
+};
+
+#ifdef PBRT_PROTO_SCANNER_X86
+
+// Bytes above 0x7F compare as negative and are therefore never matched by the
+// whitespace range check.
+
+struct Sse2 {
+  using Vector = __m128i;
+  static constexpr size_t kWidth = 16;
+
+  static Vector Load(const char* absl_nonnull ptr) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+  }
+
+  static Vector Equal(Vector chars, char ch) {
+    return _mm_cmpeq_epi8(chars, _mm_set1_epi8(ch));
+  }
+
+  static Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+
+  static uint64_t Mask(Vector matches) {
+    return static_cast<uint32_t>(_mm_movemask_epi8(matches));
+  }
+
+  static Vector Whitespace(Vector chars) {
+    Vector in_range =
+        _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('\t' - 1)),
+                      _mm_cmplt_epi8(chars, _mm_set1_epi8('\r' + 1)));
+    return Or(Equal(chars, ' '), in_range);
+  }
+
+  static uint64_t LineEnd(Vector chars) {
+    return Mask(Or(Equal(chars, '\r'), Equal(chars, '\n')));
+  }
+
+  static uint64_t QuoteEnd(Vector chars) {
+    return Mask(
+        Or(Or(Equal(chars, '"'), Equal(chars, '\\')), Equal(chars, '\n')));
+  }
+};
+
+ScannerBlock Sse2Classify(const char* absl_nonnull block) {
+  ScannerBlock result = {0, 0};
+  for (size_t i = 0; i < kScannerBlockSize; i += Sse2::kWidth) {
+    Sse2::Vector chars = Sse2::Load(block + i);
+    Sse2::Vector whitespace = Sse2::Whitespace(chars);
+    Sse2::Vector delimiters = Sse2::Or(
+        Sse2::Or(whitespace, Sse2::Equal(chars, '"')),
+        Sse2::Or(Sse2::Equal(chars, '['), Sse2::Equal(chars, ']')));
+    result.whitespace |= Sse2::Mask(whitespace) << i;
+    result.delimiters |= Sse2::Mask(delimiters) << i;
+  }
+  return result;
+}
+
+template <uint64_t (*Classify)(Sse2::Vector), bool (*Matches)(char)>
+const char* absl_nonnull Sse2Find(const char* absl_nonnull begin,
+                                  const char* absl_nonnull end) {
+  for (; static_cast<size_t>(end - begin) >= Sse2::kWidth;
+       begin += Sse2::kWidth) {
+    if (uint64_t mask = Classify(Sse2::Load(begin)); mask != 0) {
+      return begin + absl::countr_zero(mask);
+    }
+  }
+  return ScalarFind<Matches>(begin, end);
+}
+
+const Scanner kSse2Scanner = {
+    Sse2Classify,
+    Sse2Find<Sse2::LineEnd, IsLineEnd>,
+    Sse2Find<Sse2::QuoteEnd, IsQuoteEnd>,
+};
+
+struct Avx2 {
+  using Vector = __m256i;
+  static constexpr size_t kWidth = 32;
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Load(const char* absl_nonnull ptr) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Equal(Vector chars, char ch) {
+    return _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(ch));
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Or(Vector a, Vector b) {
+    return _mm256_or_si256(a, b);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static uint64_t Mask(Vector matches) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static Vector Whitespace(Vector chars) {
+    Vector above_end = _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('\r'));
+    Vector above_start = _mm256_cmpgt_epi8(chars, _mm256_set1_epi8('\t' - 1));
+    Vector in_range = _mm256_andnot_si256(above_end, above_start);
+    return Or(Equal(chars, ' '), in_range);
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static uint64_t LineEnd(Vector chars) {
+    return Mask(Or(Equal(chars, '\r'), Equal(chars, '\n')));
+  }
+
+  PBRT_PROTO_TARGET_AVX2 static uint64_t QuoteEnd(Vector chars) {
+    return Mask(
+        Or(Or(Equal(chars, '"'), Equal(chars, '\\')), Equal(chars, '\n')));
+  }
+};
+
+PBRT_PROTO_TARGET_AVX2 ScannerBlock
+Avx2Classify(const char* absl_nonnull block) {
+  ScannerBlock result = {0, 0};
+  for (size_t i = 0; i < kScannerBlockSize; i += Avx2::kWidth) {
+    Avx2::Vector chars = Avx2::Load(block + i);
+    Avx2::Vector whitespace = Avx2::Whitespace(chars);
+    Avx2::Vector delimiters = Avx2::Or(
+        Avx2::Or(whitespace, Avx2::Equal(chars, '"')),
+        Avx2::Or(Avx2::Equal(chars, '['), Avx2::Equal(chars, ']')));
+    result.whitespace |= Avx2::Mask(whitespace) << i;
+    result.delimiters |= Avx2::Mask(delimiters) << i;
+  }
+  return result;
+}
+
+template <uint64_t (*Classify)(Avx2::Vector),
+          uint64_t (*ClassifyTail)(Sse2::Vector), bool (*Matches)(char)>
+PBRT_PROTO_TARGET_AVX2 const char* absl_nonnull
+Avx2Find(const char* absl_nonnull begin, const char* absl_nonnull end) {
+  for (; static_cast<size_t>(end - begin) >= Avx2::kWidth;
+       begin += Avx2::kWidth) {
+    if (uint64_t mask = Classify(Avx2::Load(begin)); mask != 0) {
+      return begin + absl::countr_zero(mask);
+    }
+  }
+  return Sse2Find<ClassifyTail, Matches>(begin, end);
+}
+
+const Scanner kAvx2Scanner = {
+    Avx2Classify,
+    Avx2Find<Avx2::LineEnd, Sse2::LineEnd, IsLineEnd>,
+    Avx2Find<Avx2::QuoteEnd, Sse2::QuoteEnd, IsQuoteEnd>,
+};
+
+#endif  // PBRT_PROTO_SCANNER_X86
+
+}  // namespace
+
+const Scanner* absl_nullable GetScanner(ScannerKernel kernel) {
+  switch (kernel) {
+    case ScannerKernel::SWAR:
+      return &kSwarScanner;
+#ifdef PBRT_PROTO_SCANNER_X86
+    case ScannerKernel::SSE2:
+      return &kSse2Scanner;
+    case ScannerKernel::AVX2: {
+      static const bool supports_avx2 = CpuSupportsAvx2();
+      return supports_avx2 ? &kAvx2Scanner : nullptr;
+    }
+#else
+    case ScannerKernel::SSE2:
+    case ScannerKernel::AVX2:
+      break;
+#endif
+  }
+
+  return nullptr;
+}
+
+const Scanner& GetScanner() {
+  static const Scanner* const scanner = []() {
+    for (ScannerKernel kernel : {ScannerKernel::AVX2, ScannerKernel::SSE2}) {
+      if (const Scanner* scanner = GetScanner(kernel); scanner != nullptr) {
+        return scanner;
+      }
+    }
+    return &kSwarScanner;
+  }();
+
+  return *scanner;
+}
+
+}  // namespace pbrt_proto
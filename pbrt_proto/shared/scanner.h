@@ -0,0 +1,60 @@
+#ifndef _PBRT_PROTO_SHARED_SCANNER_
+#define _PBRT_PROTO_SHARED_SCANNER_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/base/nullability.h"
+
+namespace pbrt_proto {
+
+inline constexpr size_t kScannerBlockSize = 64;
+
+// Bitmasks classifying each of the bytes in a block of `kScannerBlockSize`
+// bytes. Bit N of each mask is set if byte N of the block belongs to the class.
+struct ScannerBlock {
+  uint64_t whitespace;
+  uint64_t delimiters;  // Whitespace, '"', '[', or ']'
+};
+
+// Character classification kernels used to locate token boundaries in an
+// in-memory buffer.
+//
+// Tokens in pbrt files are mostly short runs of digits, so rather than
+// scanning for each boundary individually, whitespace and delimiters are
+// classified a whole block at a time and boundaries are then found by bit
+// manipulation. Comments and quoted strings are long and rare enough that they
+// are instead scanned for directly.
+//
+// NOTE: Whitespace is classified using the "C" locale
+struct Scanner {
+  // Classifies the `kScannerBlockSize` bytes starting at `block`
+  ScannerBlock (*classify)(const char* absl_nonnull block);
+
+  // Returns a pointer to the first '\r' or '\n' character in [begin, end) or
+  // `end` if there is no such character
+  const char* absl_nonnull (*find_line_end)(const char* absl_nonnull begin,
+                                            const char* absl_nonnull end);
+
+  // Returns a pointer to the first '"', '\\', or '\n' character in
+  // [begin, end) or `end` if there is no such character
+  const char* absl_nonnull (*find_quote_end)(const char* absl_nonnull begin,
+                                             const char* absl_nonnull end);
+};
+
+enum class ScannerKernel {
+  SWAR,  // Portable, processes eight bytes at a time in a general register
+  SSE2,
+  AVX2,
+};
+
+// Returns the implementation of `kernel` or nullptr if it is not supported by
+// either the current build or the current CPU.
+const Scanner* absl_nullable GetScanner(ScannerKernel kernel);
+
+// Returns the fastest implementation supported by the current CPU.
+const Scanner& GetScanner();
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_SCANNER_
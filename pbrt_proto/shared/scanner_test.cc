@@ -0,0 +1,134 @@
+#include "pbrt_proto/shared/scanner.h"
+
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace pbrt_proto {
+namespace {
+
+bool IsWhitespace(char ch) { return ch == ' ' || (ch >= '\t' && ch <= '\r'); }
+
+bool IsDelimiter(char ch) {
+  return IsWhitespace(ch) || ch == '"' || ch == '[' || ch == ']';
+}
+
+bool IsLineEnd(char ch) { return ch == '\r' || ch == '\n'; }
+
+bool IsQuoteEnd(char ch) { return ch == '"' || ch == '\\' || ch == '\n'; }
+
+std::vector<const Scanner*> SupportedScanners() {
+  std::vector<const Scanner*> result;
+  for (ScannerKernel kernel :
+       {ScannerKernel::SWAR, ScannerKernel::SSE2, ScannerKernel::AVX2}) {
+    if (const Scanner* scanner = GetScanner(kernel); scanner != nullptr) {
+      result.push_back(scanner);
+    }
+  }
+  return result;
+}
+
+// Places every possible byte at every position of buffers of increasing
+// length, filled otherwise with `background`, and checks that `find` stops at
+// exactly the position of that byte when it matches and at the end otherwise.
+void ExpectFindsAllBytes(const char* (*find)(const char*, const char*),
+                         bool (*matches)(char), char background) {
+  ASSERT_FALSE(matches(background));
+  for (size_t length = 1; length <= 80; length++) {
+    std::string buffer(length, background);
+    const char* begin = buffer.data();
+    const char* end = buffer.data() + buffer.size();
+    EXPECT_EQ(end, find(begin, end));
+
+    for (size_t position = 0; position < length; position++) {
+      for (int value = 0; value < 256; value++) {
+        char ch = static_cast<char>(value);
+        buffer[position] = ch;
+        ASSERT_EQ(matches(ch) ? begin + position : end, find(begin, end))
+            << "length: " << length << " position: " << position
+            << " value: " << value;
+      }
+      buffer[position] = background;
+    }
+  }
+}
+
+TEST(Scanner, DefaultIsSupported) {
+  const Scanner& scanner = GetScanner();
+  EXPECT_TRUE(&scanner == GetScanner(ScannerKernel::SWAR) ||
+              &scanner == GetScanner(ScannerKernel::SSE2) ||
+              &scanner == GetScanner(ScannerKernel::AVX2));
+}
+
+TEST(Scanner, SwarIsAlwaysSupported) {
+  EXPECT_NE(nullptr, GetScanner(ScannerKernel::SWAR));
+}
+
+TEST(Scanner, Classify) {
+  for (const Scanner* scanner : SupportedScanners()) {
+    std::string block(kScannerBlockSize, 'a');
+    ScannerBlock empty = scanner->classify(block.data());
+    EXPECT_EQ(0u, empty.whitespace);
+    EXPECT_EQ(0u, empty.delimiters);
+
+    for (size_t position = 0; position < kScannerBlockSize; position++) {
+      for (int value = 0; value < 256; value++) {
+        char ch = static_cast<char>(value);
+        block[position] = ch;
+
+        ScannerBlock actual = scanner->classify(block.data());
+        uint64_t bit = uint64_t{1} << position;
+        ASSERT_EQ(IsWhitespace(ch) ? bit : 0u, actual.whitespace)
+            << "position: " << position << " value: " << value;
+        ASSERT_EQ(IsDelimiter(ch) ? bit : 0u, actual.delimiters)
+            << "position: " << position << " value: " << value;
+      }
+      block[position] = 'a';
+    }
+  }
+}
+
+TEST(Scanner, ClassifyMultiple) {
+  std::string block =
+      "Shape \"trianglemesh\" \"point P\" [0 0 0\t1 1 1\n2 2 2]";
+  block.resize(kScannerBlockSize, ' ');
+
+  uint64_t whitespace = 0;
+  uint64_t delimiters = 0;
+  for (size_t i = 0; i < kScannerBlockSize; i++) {
+    whitespace |= static_cast<uint64_t>(IsWhitespace(block[i])) << i;
+    delimiters |= static_cast<uint64_t>(IsDelimiter(block[i])) << i;
+  }
+
+  for (const Scanner* scanner : SupportedScanners()) {
+    ScannerBlock actual = scanner->classify(block.data());
+    EXPECT_EQ(whitespace, actual.whitespace);
+    EXPECT_EQ(delimiters, actual.delimiters);
+  }
+}
+
+TEST(Scanner, FindEmptyRange) {
+  for (const Scanner* scanner : SupportedScanners()) {
+    const char* empty = "";
+    EXPECT_EQ(empty, scanner->find_line_end(empty, empty));
+    EXPECT_EQ(empty, scanner->find_quote_end(empty, empty));
+  }
+}
+
+TEST(Scanner, FindLineEnd) {
+  for (const Scanner* scanner : SupportedScanners()) {
+    ExpectFindsAllBytes(scanner->find_line_end, IsLineEnd, ' ');
+  }
+}
+
+TEST(Scanner, FindQuoteEnd) {
+  for (const Scanner* scanner : SupportedScanners()) {
+    ExpectFindsAllBytes(scanner->find_quote_end, IsQuoteEnd, 'a');
+  }
+}
+
+}  // namespace
+}  // namespace pbrt_proto
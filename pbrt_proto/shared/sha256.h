@@ -0,0 +1,36 @@
+#ifndef _PBRT_PROTO_SHARED_SHA256_
+#define _PBRT_PROTO_SHARED_SHA256_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/strings/string_view.h"
+
+namespace pbrt_proto {
+
+// Computes the SHA-256 digest of a sequence of bytes, which unlike `absl::Hash`
+// is the same in every process and on every platform.
+class Sha256 {
+ public:
+  Sha256();
+
+  void Update(absl::string_view data);
+
+  // Returns the digest of everything passed to `Update` as 64 lowercase
+  // hexadecimal digits. No more data may be added afterwards.
+  std::string Finish();
+
+ private:
+  void Compress(const unsigned char* block);
+
+  std::array<uint32_t, 8> state_;
+  std::array<unsigned char, 64> buffer_;
+  size_t buffered_ = 0;
+  uint64_t length_ = 0;
+};
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_SHA256_
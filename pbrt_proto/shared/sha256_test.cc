@@ -0,0 +1,52 @@
+#include "pbrt_proto/shared/sha256.h"
+
+#include <algorithm>
+#include <string>
+
+#include "absl/strings/string_view.h"
+#include "gtest/gtest.h"
+
+namespace pbrt_proto {
+namespace {
+
+std::string Digest(const std::string& data) {
+  Sha256 sha256;
+  sha256.Update(data);
+  return sha256.Finish();
+}
+
+TEST(Sha256, Empty) {
+  EXPECT_EQ("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855",
+            Sha256().Finish());
+}
+
+TEST(Sha256, OneBlock) {
+  EXPECT_EQ("ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+            Digest("abc"));
+}
+
+TEST(Sha256, TwoBlocks) {
+  EXPECT_EQ("248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+            Digest("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"));
+}
+
+TEST(Sha256, Split) {
+  std::string data(1000000, 'a');
+
+  // Pieces of every size from 0 to 99 bytes, some crossing block boundaries
+  Sha256 sha256;
+  size_t offset = 0;
+  for (size_t size = 0; offset < data.size(); size = (size + 1) % 100) {
+    size = std::min(size, data.size() - offset);
+    sha256.Update(absl::string_view(data).substr(offset, size));
+    offset += size;
+  }
+
+  EXPECT_EQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+            sha256.Finish());
+  EXPECT_EQ("cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0",
+            Digest(data));
+}
+
+}  // namespace
+}  // namespace pbrt_proto
@@ -1,16 +1,22 @@
 #include "pbrt_proto/shared/shapes.h"
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <utility>
 
 #include "absl/container/flat_hash_map.h"
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "pbrt_proto/pbrt.pb.h"
 #include "pbrt_proto/shared/common.h"
 #include "pbrt_proto/shared/enums.h"
 #include "pbrt_proto/shared/parser.h"
+#include "pbrt_proto/shared/warnings.h"
 
 namespace pbrt_proto {
 
@@ -47,9 +53,9 @@ absl::Status TryRemoveCurveShape(
     } else if (*degree == 2) {
       output.set_degree(CurveShape::TWO);
     } else {
-      std::cerr << "WARNING: Unsupported value for 'curve' Shape parameter "
-                   "'degree': \""
-                << *degree << "\"" << std::endl;
+      Warnings() << "WARNING: Unsupported value for 'curve' Shape parameter "
+                    "'degree': \""
+                 << *degree << "\"" << std::endl;
       unmatched_value = true;
     }
   }
@@ -647,4 +653,200 @@ absl::Status RemoveTriangleMeshShape(
   return absl::OkStatus();
 }
 
+namespace {
+
+absl::Status TooManyValuesError(absl::string_view values) {
+  return absl::ResourceExhaustedError(
+      absl::StrCat("Trianglemesh shape has too many ", values,
+                   " to be stored in a 1D proto array"));
+}
+
+bool IsFull(int size) { return size == std::numeric_limits<int32_t>::max(); }
+
+}  // namespace
+
+bool TriangleMeshSink::Begin(absl::string_view name, ParameterType type) {
+  field_ = Field::NONE;
+  num_partial_ = 0;
+
+  if (name == "P" && type == ParameterType::POINT3) {
+    mesh_.clear_p();
+    has_p_ = true;
+    field_ = Field::P;
+  } else if (name == "N" && type == ParameterType::NORMAL3) {
+    mesh_.clear_n();
+    has_n_ = true;
+    field_ = Field::N;
+  } else if (name == "S" && type == ParameterType::VECTOR3) {
+    mesh_.clear_s();
+    has_s_ = true;
+    field_ = Field::S;
+  } else if (name == "indices" && (type == ParameterType::INTEGER ||
+                                   type == ParameterType::INTEGER_STRICT)) {
+    mesh_.clear_indices();
+    has_indices_ = true;
+    field_ = Field::INDICES;
+  } else if (name == "uv" && type == ParameterType::FLOAT) {
+    mesh_.clear_uv();
+    has_uv_ = true;
+    field_ = Field::UV;
+  } else if (name == "st" && type == ParameterType::FLOAT) {
+    st_.clear_uv();
+    has_st_ = true;
+    field_ = Field::ST;
+  }
+
+  return field_ != Field::NONE;
+}
+
+void TriangleMeshSink::Append(absl::Span<const double> values) {
+  auto& uv = field_ == Field::UV ? *mesh_.mutable_uv() : *st_.mutable_uv();
+  for (double value : values) {
+    partial_uv_[num_partial_++] = value;
+    if (num_partial_ != partial_uv_.size()) {
+      continue;
+    }
+
+    num_partial_ = 0;
+
+    if (IsFull(uv.size())) {
+      status_ = TooManyValuesError("texture coordinates");
+      return;
+    }
+
+    TriangleMeshShape::UVCoordinate& dest = *uv.Add();
+    dest.set_u(partial_uv_[0]);
+    dest.set_v(partial_uv_[1]);
+  }
+}
+
+void TriangleMeshSink::Append(absl::Span<const int32_t> values) {
+  for (int32_t value : values) {
+    partial_indices_[num_partial_++] = value;
+    if (num_partial_ != partial_indices_.size()) {
+      continue;
+    }
+
+    num_partial_ = 0;
+
+    if (IsFull(mesh_.indices().size())) {
+      status_ = TooManyValuesError("indices");
+      return;
+    }
+
+    VertexIndices& dest = *mesh_.add_indices();
+    dest.set_v0(std::max(0, partial_indices_[0]));
+    dest.set_v1(std::max(0, partial_indices_[1]));
+    dest.set_v2(std::max(0, partial_indices_[2]));
+  }
+}
+
+void TriangleMeshSink::Append(absl::Span<const std::array<double, 3>> values) {
+  if (field_ == Field::P) {
+    for (const auto& src : values) {
+      if (IsFull(mesh_.p().size())) {
+        status_ = TooManyValuesError("points");
+        return;
+      }
+
+      Point& dest = *mesh_.add_p();
+      dest.set_x(src[0]);
+      dest.set_y(src[1]);
+      dest.set_z(src[2]);
+    }
+
+    return;
+  }
+
+  auto& vectors = field_ == Field::N ? *mesh_.mutable_n() : *mesh_.mutable_s();
+  for (const auto& src : values) {
+    if (IsFull(vectors.size())) {
+      status_ = TooManyValuesError(field_ == Field::N ? "normals" : "tangents");
+      return;
+    }
+
+    Vector& dest = *vectors.Add();
+    dest.set_x(src[0]);
+    dest.set_y(src[1]);
+    dest.set_z(src[2]);
+  }
+}
+
+void TriangleMeshSink::Discard(absl::string_view name) {
+  if (name == "P") {
+    mesh_.clear_p();
+    has_p_ = false;
+  } else if (name == "N") {
+    mesh_.clear_n();
+    has_n_ = false;
+  } else if (name == "S") {
+    mesh_.clear_s();
+    has_s_ = false;
+  } else if (name == "indices") {
+    mesh_.clear_indices();
+    has_indices_ = false;
+  } else if (name == "uv") {
+    mesh_.clear_uv();
+    has_uv_ = false;
+  } else if (name == "st") {
+    st_.clear_uv();
+    has_st_ = false;
+  }
+}
+
+absl::Status TriangleMeshSink::MoveTo(TriangleMeshShape& output) {
+  if (!status_.ok()) {
+    return status_;
+  }
+
+  if (has_p_) {
+    output.mutable_p()->Swap(mesh_.mutable_p());
+  }
+
+  if (has_indices_) {
+    output.mutable_indices()->Swap(mesh_.mutable_indices());
+  }
+
+  if (has_n_) {
+    output.mutable_n()->Swap(mesh_.mutable_n());
+  }
+
+  if (has_s_) {
+    output.mutable_s()->Swap(mesh_.mutable_s());
+  }
+
+  // Texture coordinates given as floats precede any that were read from other
+  // parameters by `RemoveTriangleMeshShape`
+  if (TriangleMeshShape* uv = has_uv_ ? &mesh_ : (has_st_ ? &st_ : nullptr);
+      uv != nullptr) {
+    output.mutable_uv()->Swap(uv->mutable_uv());
+    output.mutable_uv()->MergeFrom(uv->uv());
+  }
+
+  bool st_unused = has_uv_ && has_st_;
+  Clear();
+  st_unused_ = st_unused;
+
+  return absl::OkStatus();
+}
+
+bool TriangleMeshSink::Used(absl::string_view name) const {
+  return name != "st" || !st_unused_;
+}
+
+void TriangleMeshSink::Clear() {
+  field_ = Field::NONE;
+  status_ = absl::OkStatus();
+  num_partial_ = 0;
+  mesh_.Clear();
+  st_.Clear();
+  has_p_ = false;
+  has_n_ = false;
+  has_s_ = false;
+  has_indices_ = false;
+  has_uv_ = false;
+  has_st_ = false;
+  st_unused_ = false;
+}
+
 }  // namespace pbrt_proto
@@ -1,10 +1,15 @@
 #ifndef _PBRT_PROTO_SHARED_SHAPES_
 #define _PBRT_PROTO_SHARED_SHAPES_
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "pbrt_proto/pbrt.pb.h"
 #include "pbrt_proto/shared/parser.h"
 
@@ -58,6 +63,54 @@ absl::Status RemoveTriangleMeshShape(
     absl::flat_hash_map<absl::string_view, Parameter>& parameters,
     int pbrt_version, TriangleMeshShape& output);
 
+// Receives the per-vertex arrays and indices of a trianglemesh shape as they
+// are read and stores them directly in their final form, so that large meshes
+// are never also held in full as parameters.
+class TriangleMeshSink final : public ParameterSink {
+ public:
+  bool Begin(absl::string_view name, ParameterType type) override;
+
+  void Append(absl::Span<const double> values) override;
+  void Append(absl::Span<const int32_t> values) override;
+  void Append(absl::Span<const std::array<double, 3>> values) override;
+
+  void Discard(absl::string_view name) override;
+
+  // Returns false for `st` if `uv` replaced it in the last call to `MoveTo`
+  bool Used(absl::string_view name) const override;
+
+  // Moves the values received since the last call to `Clear` into `output`,
+  // which must already have been populated by `RemoveTriangleMeshShape`.
+  absl::Status MoveTo(TriangleMeshShape& output);
+
+  void Clear();
+
+ private:
+  enum class Field { NONE, P, N, S, INDICES, UV, ST };
+
+  Field field_ = Field::NONE;
+  absl::Status status_;
+
+  // Values that do not yet form a complete triangle or UV coordinate
+  std::array<int32_t, 3> partial_indices_;
+  std::array<double, 2> partial_uv_;
+  size_t num_partial_ = 0;
+
+  // The values received for each parameter, with `st` kept separately so that
+  // it can be ignored when `uv` is also present
+  TriangleMeshShape mesh_;
+  TriangleMeshShape st_;
+  bool has_p_ = false;
+  bool has_n_ = false;
+  bool has_s_ = false;
+  bool has_indices_ = false;
+  bool has_uv_ = false;
+  bool has_st_ = false;
+
+  // Whether `st` was received but ignored by the last call to `MoveTo`
+  bool st_unused_ = false;
+};
+
 }  // namespace pbrt_proto
 
 #endif  // _PBRT_PROTO_SHARED_SHAPES_
@@ -1162,5 +1162,152 @@ TEST(RemoveTriangleMeshShapeV3, WithData) {
               )pb"));
 }
 
+TEST(TriangleMeshSink, Empty) {
+  TriangleMeshSink sink;
+
+  TriangleMeshShape actual;
+  EXPECT_TRUE(sink.MoveTo(actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb()pb"));
+}
+
+TEST(TriangleMeshSink, WithData) {
+  std::vector<std::array<double, 3>> p = {{1.0, 2.0, 3.0}};
+  std::vector<int32_t> indices = {4, 5, 6};
+  std::vector<std::array<double, 3>> n = {{7.0, 8.0, 9.0}};
+  std::vector<std::array<double, 3>> s = {{10.0, 11.0, 12.0}};
+  std::vector<double> uv = {13.0, 14.0};
+
+  TriangleMeshSink sink;
+  ASSERT_TRUE(sink.Begin("P", ParameterType::POINT3));
+  sink.Append(absl::MakeConstSpan(p));
+  ASSERT_TRUE(sink.Begin("indices", ParameterType::INTEGER));
+  sink.Append(absl::MakeConstSpan(indices));
+  ASSERT_TRUE(sink.Begin("N", ParameterType::NORMAL3));
+  sink.Append(absl::MakeConstSpan(n));
+  ASSERT_TRUE(sink.Begin("S", ParameterType::VECTOR3));
+  sink.Append(absl::MakeConstSpan(s));
+  ASSERT_TRUE(sink.Begin("uv", ParameterType::FLOAT));
+  sink.Append(absl::MakeConstSpan(uv));
+
+  TriangleMeshShape actual;
+  EXPECT_TRUE(sink.MoveTo(actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(
+                P { x: 1.0 y: 2.0 z: 3.0 }
+                indices { v0: 4 v1: 5 v2: 6 }
+                N { x: 7.0 y: 8.0 z: 9.0 }
+                S { x: 10.0 y: 11.0 z: 12.0 }
+                uv { u: 13.0 v: 14.0 }
+              )pb"));
+
+  TriangleMeshShape empty;
+  EXPECT_TRUE(sink.MoveTo(empty).ok());
+  EXPECT_THAT(empty, EqualsProto(R"pb()pb"));
+}
+
+TEST(TriangleMeshSink, RejectsOtherParameters) {
+  TriangleMeshSink sink;
+  EXPECT_FALSE(sink.Begin("P", ParameterType::VECTOR3));
+  EXPECT_FALSE(sink.Begin("indices", ParameterType::FLOAT));
+  EXPECT_FALSE(sink.Begin("uv", ParameterType::POINT2));
+  EXPECT_FALSE(sink.Begin("faceIndices", ParameterType::INTEGER));
+}
+
+TEST(TriangleMeshSink, ValuesSplitAcrossAppends) {
+  std::vector<int32_t> indices = {-1, 2, 3, 4, 5, 6, 7};
+  std::vector<double> st = {1.0, 2.0, 3.0};
+
+  TriangleMeshSink sink;
+  ASSERT_TRUE(sink.Begin("indices", ParameterType::INTEGER_STRICT));
+  sink.Append(absl::MakeConstSpan(indices).subspan(0, 2));
+  sink.Append(absl::MakeConstSpan(indices).subspan(2, 3));
+  sink.Append(absl::MakeConstSpan(indices).subspan(5));
+  ASSERT_TRUE(sink.Begin("st", ParameterType::FLOAT));
+  sink.Append(absl::MakeConstSpan(st).subspan(0, 1));
+  sink.Append(absl::MakeConstSpan(st).subspan(1));
+
+  TriangleMeshShape actual;
+  EXPECT_TRUE(sink.MoveTo(actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(
+                indices { v0: 0 v1: 2 v2: 3 }
+                indices { v0: 4 v1: 5 v2: 6 }
+                uv { u: 1.0 v: 2.0 }
+              )pb"));
+}
+
+TEST(TriangleMeshSink, Discard) {
+  std::vector<std::array<double, 3>> p = {{1.0, 2.0, 3.0}};
+  std::vector<double> uv = {4.0, 5.0};
+
+  TriangleMeshSink sink;
+  ASSERT_TRUE(sink.Begin("P", ParameterType::POINT3));
+  sink.Append(absl::MakeConstSpan(p));
+  ASSERT_TRUE(sink.Begin("uv", ParameterType::FLOAT));
+  sink.Append(absl::MakeConstSpan(uv));
+  ASSERT_TRUE(sink.Begin("st", ParameterType::FLOAT));
+  sink.Append(absl::MakeConstSpan(uv));
+  sink.Discard("P");
+  sink.Discard("uv");
+
+  TriangleMeshShape actual;
+  EXPECT_TRUE(sink.MoveTo(actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(
+                uv { u: 4.0 v: 5.0 }
+              )pb"));
+}
+
+TEST(TriangleMeshSink, UvReplacesSt) {
+  std::vector<double> uv = {1.0, 2.0};
+  std::vector<double> st = {3.0, 4.0};
+
+  TriangleMeshSink sink;
+  ASSERT_TRUE(sink.Begin("st", ParameterType::FLOAT));
+  sink.Append(absl::MakeConstSpan(st));
+  ASSERT_TRUE(sink.Begin("uv", ParameterType::FLOAT));
+  sink.Append(absl::MakeConstSpan(uv));
+
+  TriangleMeshShape actual;
+  EXPECT_TRUE(sink.MoveTo(actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(
+                uv { u: 1.0 v: 2.0 }
+              )pb"));
+  EXPECT_TRUE(sink.Used("uv"));
+  EXPECT_FALSE(sink.Used("st"));
+
+  ASSERT_TRUE(sink.Begin("st", ParameterType::FLOAT));
+  sink.Append(absl::MakeConstSpan(st));
+
+  TriangleMeshShape st_only;
+  EXPECT_TRUE(sink.MoveTo(st_only).ok());
+  EXPECT_THAT(st_only, EqualsProto(R"pb(
+                uv { u: 3.0 v: 4.0 }
+              )pb"));
+  EXPECT_TRUE(sink.Used("st"));
+}
+
+TEST(TriangleMeshSink, FloatsPrecedePoint2s) {
+  std::vector<double> uv = {1.0, 2.0};
+  std::vector<std::array<double, 2>> st = {{3.0, 4.0}};
+  Parameter st_parameter{/*directive=*/"",
+                         /*type=*/ParameterType::POINT2,
+                         /*type_name=*/"",
+                         /*values=*/absl::MakeSpan(st)};
+
+  absl::flat_hash_map<absl::string_view, Parameter> parameters = {
+      {"st", st_parameter}};
+
+  TriangleMeshSink sink;
+  ASSERT_TRUE(sink.Begin("uv", ParameterType::FLOAT));
+  sink.Append(absl::MakeConstSpan(uv));
+
+  TriangleMeshShape actual;
+  ASSERT_TRUE(
+      RemoveTriangleMeshShape(parameters, /*pbrt_version=*/3, actual).ok());
+  EXPECT_TRUE(sink.MoveTo(actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(
+                uv { u: 1.0 v: 2.0 }
+                uv { u: 3.0 v: 4.0 }
+              )pb"));
+}
+
 }  // namespace
 }  // namespace pbrt_proto
@@ -0,0 +1,389 @@
+#include "pbrt_proto/shared/sidecar.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <ios>
+#include <utility>
+#include <vector>
+
+#include "absl/base/config.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "pbrt_proto/pbrt.pb.h"
+#include "pbrt_proto/shared/geometry.h"
+#include "pbrt_proto/shared/mapped_file.h"
+
+namespace pbrt_proto {
+namespace {
+
+constexpr char kMagic[8] = {'P', 'B', 'R', 'T', 'G', 'E', 'O', 'M'};
+constexpr uint32_t kVersion = 1;
+constexpr uint64_t kHeaderSize = 64;
+constexpr uint64_t kAlignment = 64;
+
+#ifdef ABSL_IS_LITTLE_ENDIAN
+constexpr bool kIsLittleEndian = true;
+#else
+constexpr bool kIsLittleEndian = false;
+#endif
+
+template <typename T>
+absl::Span<const T> AsSpan(const google::protobuf::RepeatedField<T>& field) {
+  return absl::MakeConstSpan(field.data(), field.size());
+}
+
+// Writes whichever of `values_f32` and `values` is populated to `writer`,
+// recording its location in the `ArrayRef` returned by `get_ref`.
+absl::Status WriteEither(absl::Span<const float> values_f32,
+                         absl::Span<const double> values,
+                         SidecarWriter& writer,
+                         absl::FunctionRef<ArrayRef*()> get_ref) {
+  if (!values_f32.empty()) {
+    return writer.Write(values_f32, *get_ref());
+  }
+
+  if (!values.empty()) {
+    return writer.Write(values, *get_ref());
+  }
+
+  return absl::OkStatus();
+}
+
+template <typename Shape>
+absl::Status MovePositions(Shape& shape, SidecarWriter& writer) {
+  std::vector<double> storage;
+  absl::Span<const double> values;
+  if (shape.p_xyz_f32().empty()) {
+    values = GetPositions(shape, storage);
+  }
+
+  if (absl::Status status =
+          WriteEither(AsSpan(shape.p_xyz_f32()), values, writer,
+                      [&] { return shape.mutable_p_ref(); });
+      !status.ok()) {
+    return status;
+  }
+
+  shape.clear_p();
+  shape.clear_p_xyz();
+  shape.clear_p_xyz_f32();
+
+  return absl::OkStatus();
+}
+
+template <typename Shape>
+absl::Status MoveNormals(Shape& shape, SidecarWriter& writer) {
+  std::vector<double> storage;
+  absl::Span<const double> values;
+  if (shape.n_xyz_f32().empty()) {
+    values = GetNormals(shape, storage);
+  }
+
+  if (absl::Status status =
+          WriteEither(AsSpan(shape.n_xyz_f32()), values, writer,
+                      [&] { return shape.mutable_n_ref(); });
+      !status.ok()) {
+    return status;
+  }
+
+  shape.clear_n();
+  shape.clear_n_xyz();
+  shape.clear_n_xyz_f32();
+
+  return absl::OkStatus();
+}
+
+template <typename Shape>
+absl::Status MoveIndices(Shape& shape, SidecarWriter& writer) {
+  std::vector<uint32_t> storage;
+  absl::Span<const uint32_t> values = GetIndices(shape, storage);
+  if (values.empty()) {
+    return absl::OkStatus();
+  }
+
+  if (absl::Status status = writer.Write(values, *shape.mutable_indices_ref());
+      !status.ok()) {
+    return status;
+  }
+
+  shape.clear_indices();
+  shape.clear_indices_flat();
+
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::Status SidecarWriter::Write(absl::Span<const double> values,
+                                  ArrayRef& ref) {
+  return WriteArray(values, ArrayRef::FLOAT64, ref);
+}
+
+absl::Status SidecarWriter::Write(absl::Span<const float> values,
+                                  ArrayRef& ref) {
+  return WriteArray(values, ArrayRef::FLOAT32, ref);
+}
+
+absl::Status SidecarWriter::Write(absl::Span<const uint32_t> values,
+                                  ArrayRef& ref) {
+  return WriteArray(values, ArrayRef::UINT32, ref);
+}
+
+absl::Status SidecarWriter::Write(absl::Span<const int32_t> values,
+                                  ArrayRef& ref) {
+  return WriteArray(values, ArrayRef::INT32, ref);
+}
+
+absl::Status SidecarWriter::Finish() {
+  output_.flush();
+  if (!output_) {
+    return absl::InternalError("Could not write to geometry sidecar");
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status SidecarWriter::WriteBytes(const void* data, uint64_t size) {
+  output_.write(static_cast<const char*>(data),
+                static_cast<std::streamsize>(size));
+  if (!output_) {
+    return absl::InternalError("Could not write to geometry sidecar");
+  }
+
+  offset_ += size;
+
+  return absl::OkStatus();
+}
+
+absl::Status SidecarWriter::Align() {
+  static constexpr char kPadding[kAlignment] = {};
+
+  uint64_t remainder = offset_ % kAlignment;
+  if (remainder == 0) {
+    return absl::OkStatus();
+  }
+
+  return WriteBytes(kPadding, kAlignment - remainder);
+}
+
+template <typename T>
+absl::Status SidecarWriter::WriteArray(absl::Span<const T> values,
+                                       ArrayRef::Type type, ArrayRef& ref) {
+  if (!kIsLittleEndian) {
+    return absl::UnimplementedError(
+        "Geometry sidecars can only be written on little-endian systems");
+  }
+
+  if (offset_ == 0) {
+    char header[kHeaderSize] = {};
+    std::memcpy(header, kMagic, sizeof(kMagic));
+    std::memcpy(header + sizeof(kMagic), &kVersion, sizeof(kVersion));
+    if (absl::Status status = WriteBytes(header, sizeof(header));
+        !status.ok()) {
+      return status;
+    }
+  }
+
+  if (absl::Status status = Align(); !status.ok()) {
+    return status;
+  }
+
+  ref.set_file(file_);
+  ref.set_offset(offset_);
+  ref.set_count(values.size());
+  ref.set_type(type);
+
+  return WriteBytes(values.data(), values.size() * sizeof(T));
+}
+
+absl::StatusOr<SidecarReader> SidecarReader::Open(
+    const std::filesystem::path& path) {
+  if (!kIsLittleEndian) {
+    return absl::UnimplementedError(
+        "Geometry sidecars can only be read on little-endian systems");
+  }
+
+  absl::StatusOr<MappedFile> file = MappedFile::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  absl::string_view contents = file->contents();
+  uint32_t version = 0;
+  if (contents.size() >= kHeaderSize) {
+    std::memcpy(&version, contents.data() + sizeof(kMagic), sizeof(version));
+  }
+
+  if (contents.size() < kHeaderSize ||
+      contents.substr(0, sizeof(kMagic)) !=
+          absl::string_view(kMagic, sizeof(kMagic)) ||
+      version != kVersion) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Not a geometry sidecar file: ", path.string()));
+  }
+
+  return SidecarReader(std::move(*file));
+}
+
+absl::StatusOr<absl::Span<const double>> SidecarReader::GetFloat64s(
+    const ArrayRef& ref) const {
+  return GetArray<double>(ref, ArrayRef::FLOAT64);
+}
+
+absl::StatusOr<absl::Span<const float>> SidecarReader::GetFloat32s(
+    const ArrayRef& ref) const {
+  return GetArray<float>(ref, ArrayRef::FLOAT32);
+}
+
+absl::StatusOr<absl::Span<const uint32_t>> SidecarReader::GetUint32s(
+    const ArrayRef& ref) const {
+  return GetArray<uint32_t>(ref, ArrayRef::UINT32);
+}
+
+absl::StatusOr<absl::Span<const int32_t>> SidecarReader::GetInt32s(
+    const ArrayRef& ref) const {
+  return GetArray<int32_t>(ref, ArrayRef::INT32);
+}
+
+template <typename T>
+absl::StatusOr<absl::Span<const T>> SidecarReader::GetArray(
+    const ArrayRef& ref, ArrayRef::Type type) const {
+  if (ref.type() != type) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Sidecar array has type ", ArrayRef::Type_Name(ref.type()),
+                     " but ", ArrayRef::Type_Name(type), " was requested"));
+  }
+
+  if (ref.offset() < kHeaderSize || ref.offset() % kAlignment != 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid sidecar array offset: ", ref.offset()));
+  }
+
+  absl::string_view contents = file_.contents();
+  if (ref.offset() > contents.size() ||
+      ref.count() > (contents.size() - ref.offset()) / sizeof(T)) {
+    return absl::OutOfRangeError(
+        "Sidecar array extends past the end of the file");
+  }
+
+  return absl::MakeConstSpan(
+      reinterpret_cast<const T*>(contents.data() + ref.offset()),
+      static_cast<size_t>(ref.count()));
+}
+
+absl::Status MoveToSidecar(CurveShape& shape, SidecarWriter& writer) {
+  if (absl::Status status = MovePositions(shape, writer); !status.ok()) {
+    return status;
+  }
+
+  return MoveNormals(shape, writer);
+}
+
+absl::Status MoveToSidecar(LoopSubdivShape& shape, SidecarWriter& writer) {
+  if (absl::Status status = MovePositions(shape, writer); !status.ok()) {
+    return status;
+  }
+
+  return MoveIndices(shape, writer);
+}
+
+absl::Status MoveToSidecar(TriangleMeshShape& shape, SidecarWriter& writer) {
+  if (absl::Status status = MovePositions(shape, writer); !status.ok()) {
+    return status;
+  }
+
+  shape.clear_p_quantized();
+
+  if (absl::Status status = MoveIndices(shape, writer); !status.ok()) {
+    return status;
+  }
+
+  shape.clear_indices_delta();
+
+  if (absl::Status status = MoveNormals(shape, writer); !status.ok()) {
+    return status;
+  }
+
+  shape.clear_n_octahedral();
+
+  std::vector<double> storage;
+  absl::Span<const double> tangents;
+  if (shape.s_xyz_f32().empty()) {
+    tangents = GetTangents(shape, storage);
+  }
+
+  if (absl::Status status =
+          WriteEither(AsSpan(shape.s_xyz_f32()), tangents, writer,
+                      [&] { return shape.mutable_s_ref(); });
+      !status.ok()) {
+    return status;
+  }
+
+  shape.clear_s();
+  shape.clear_s_xyz();
+  shape.clear_s_xyz_f32();
+  shape.clear_s_octahedral();
+
+  absl::Span<const double> uvs;
+  if (shape.uv_flat_f32().empty()) {
+    uvs = GetUVs(shape, storage);
+  }
+
+  if (absl::Status status =
+          WriteEither(AsSpan(shape.uv_flat_f32()), uvs, writer,
+                      [&] { return shape.mutable_uv_ref(); });
+      !status.ok()) {
+    return status;
+  }
+
+  shape.clear_uv();
+  shape.clear_uv_flat();
+  shape.clear_uv_flat_f32();
+  shape.clear_uv_quantized();
+
+  absl::Span<const int32_t> face_indices = GetFaceIndices(shape);
+  if (!face_indices.empty()) {
+    if (absl::Status status =
+            writer.Write(face_indices, *shape.mutable_faceindices_ref());
+        !status.ok()) {
+      return status;
+    }
+
+    shape.clear_faceindices();
+    shape.clear_faceindices_flat();
+  }
+
+  return absl::OkStatus();
+}
+
+absl::Status MoveToSidecar(UniformGridMedium& medium, SidecarWriter& writer) {
+  if (absl::Status status =
+          WriteEither(AsSpan(medium.density_f32()), AsSpan(medium.density()),
+                      writer, [&] { return medium.mutable_density_ref(); });
+      !status.ok()) {
+    return status;
+  }
+
+  medium.clear_density();
+  medium.clear_density_f32();
+
+  if (absl::Status status = WriteEither(
+          AsSpan(medium.temperature_f32()), AsSpan(medium.temperature()),
+          writer, [&] { return medium.mutable_temperature_ref(); });
+      !status.ok()) {
+    return status;
+  }
+
+  medium.clear_temperature();
+  medium.clear_temperature_f32();
+
+  return absl::OkStatus();
+}
+
+}  // namespace pbrt_proto
@@ -0,0 +1,93 @@
+#ifndef _PBRT_PROTO_SHARED_SIDECAR_
+#define _PBRT_PROTO_SHARED_SIDECAR_
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "pbrt_proto/pbrt.pb.h"
+#include "pbrt_proto/shared/mapped_file.h"
+
+namespace pbrt_proto {
+
+// A geometry sidecar file holds the large arrays of a converted scene outside
+// of its protos so that they can be mapped into memory and used without any
+// parsing or copying. It consists of a 64 byte header, the first 8 bytes of
+// which are "PBRTGEOM" followed by a little-endian uint32 version number,
+// followed by arrays of raw little-endian values that each start at a multiple
+// of 64 bytes. Each array is described by an `ArrayRef`.
+
+// Appends arrays to a geometry sidecar file.
+class SidecarWriter {
+ public:
+  // `file` is the path of the sidecar relative to the directory containing the
+  // protos that will reference it, and is recorded in each `ArrayRef`.
+  SidecarWriter(std::ostream& output, std::string file)
+      : output_(output), file_(std::move(file)) {}
+
+  absl::Status Write(absl::Span<const double> values, ArrayRef& ref);
+  absl::Status Write(absl::Span<const float> values, ArrayRef& ref);
+  absl::Status Write(absl::Span<const uint32_t> values, ArrayRef& ref);
+  absl::Status Write(absl::Span<const int32_t> values, ArrayRef& ref);
+
+  // Flushes the output and reports whether every write succeeded.
+  absl::Status Finish();
+
+  // Returns true if nothing has been written, not even the header.
+  bool empty() const { return offset_ == 0; }
+
+ private:
+  absl::Status WriteBytes(const void* data, uint64_t size);
+  absl::Status Align();
+
+  template <typename T>
+  absl::Status WriteArray(absl::Span<const T> values, ArrayRef::Type type,
+                          ArrayRef& ref);
+
+  std::ostream& output_;
+  std::string file_;
+  uint64_t offset_ = 0;
+};
+
+// Provides access to the arrays in a geometry sidecar file that has been
+// mapped into memory. The spans returned remain valid for the lifetime of the
+// reader.
+class SidecarReader {
+ public:
+  static absl::StatusOr<SidecarReader> Open(const std::filesystem::path& path);
+
+  absl::StatusOr<absl::Span<const double>> GetFloat64s(
+      const ArrayRef& ref) const;
+  absl::StatusOr<absl::Span<const float>> GetFloat32s(
+      const ArrayRef& ref) const;
+  absl::StatusOr<absl::Span<const uint32_t>> GetUint32s(
+      const ArrayRef& ref) const;
+  absl::StatusOr<absl::Span<const int32_t>> GetInt32s(
+      const ArrayRef& ref) const;
+
+ private:
+  explicit SidecarReader(MappedFile file) : file_(std::move(file)) {}
+
+  template <typename T>
+  absl::StatusOr<absl::Span<const T>> GetArray(const ArrayRef& ref,
+                                               ArrayRef::Type type) const;
+
+  MappedFile file_;
+};
+
+// Moves the vertex, index, and voxel arrays of a shape or medium into a
+// sidecar, replacing every other encoding of them with `*_ref` fields. Arrays
+// stored in single precision remain in single precision.
+absl::Status MoveToSidecar(CurveShape& shape, SidecarWriter& writer);
+absl::Status MoveToSidecar(LoopSubdivShape& shape, SidecarWriter& writer);
+absl::Status MoveToSidecar(TriangleMeshShape& shape, SidecarWriter& writer);
+absl::Status MoveToSidecar(UniformGridMedium& medium, SidecarWriter& writer);
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_SIDECAR_
@@ -0,0 +1,304 @@
+#include "pbrt_proto/shared/sidecar.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <sstream>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/status_matchers.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "pbrt_proto/pbrt.pb.h"
+#include "pbrt_proto/testing/proto_matchers.h"
+
+namespace pbrt_proto {
+namespace {
+
+using ::absl_testing::IsOk;
+using ::absl_testing::StatusIs;
+using ::google::protobuf::EqualsProto;
+using ::google::protobuf::ParseTextOrDie;
+using ::testing::ElementsAre;
+
+std::filesystem::path MakeFile(const char* name, const std::string& contents) {
+  std::filesystem::path path = std::filesystem::path(testing::TempDir()) / name;
+  std::ofstream(path, std::ios::binary) << contents;
+  return path;
+}
+
+TEST(SidecarWriter, Empty) {
+  std::stringstream output;
+  SidecarWriter writer(output, "empty.geom");
+  EXPECT_THAT(writer.Finish(), IsOk());
+  EXPECT_TRUE(writer.empty());
+  EXPECT_EQ("", output.str());
+}
+
+TEST(SidecarWriter, Fails) {
+  std::stringstream output;
+  output.setstate(std::ios::badbit);
+
+  SidecarWriter writer(output, "fails.geom");
+
+  ArrayRef ref;
+  double values[] = {1.0};
+  EXPECT_THAT(writer.Write(values, ref),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(writer.Finish(), StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(Sidecar, RoundTrip) {
+  std::stringstream output;
+  SidecarWriter writer(output, "round_trip.geom");
+
+  double float64s[] = {1.0, 2.0, 3.0};
+  float float32s[] = {4.0f, 5.0f};
+  uint32_t uint32s[] = {6u};
+  int32_t int32s[] = {-7, 8, -9, 10};
+
+  ArrayRef float64_ref, float32_ref, uint32_ref, int32_ref;
+  ASSERT_THAT(writer.Write(float64s, float64_ref), IsOk());
+  ASSERT_THAT(writer.Write(float32s, float32_ref), IsOk());
+  ASSERT_THAT(writer.Write(uint32s, uint32_ref), IsOk());
+  ASSERT_THAT(writer.Write(int32s, int32_ref), IsOk());
+  ASSERT_THAT(writer.Finish(), IsOk());
+
+  EXPECT_THAT(float64_ref, EqualsProto(R"pb(
+                file: "round_trip.geom" offset: 64 count: 3 type: FLOAT64
+              )pb"));
+  EXPECT_THAT(float32_ref, EqualsProto(R"pb(
+                file: "round_trip.geom" offset: 128 count: 2 type: FLOAT32
+              )pb"));
+  EXPECT_THAT(uint32_ref, EqualsProto(R"pb(
+                file: "round_trip.geom" offset: 192 count: 1 type: UINT32
+              )pb"));
+  EXPECT_THAT(int32_ref, EqualsProto(R"pb(
+                file: "round_trip.geom" offset: 256 count: 4 type: INT32
+              )pb"));
+
+  absl::StatusOr<SidecarReader> reader =
+      SidecarReader::Open(MakeFile("sidecar_round_trip", output.str()));
+  ASSERT_THAT(reader, IsOk());
+
+  absl::StatusOr<absl::Span<const double>> read_float64s =
+      reader->GetFloat64s(float64_ref);
+  ASSERT_THAT(read_float64s, IsOk());
+  EXPECT_THAT(*read_float64s, ElementsAre(1.0, 2.0, 3.0));
+  EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(read_float64s->data()) % 64u);
+
+  absl::StatusOr<absl::Span<const float>> read_float32s =
+      reader->GetFloat32s(float32_ref);
+  ASSERT_THAT(read_float32s, IsOk());
+  EXPECT_THAT(*read_float32s, ElementsAre(4.0f, 5.0f));
+
+  absl::StatusOr<absl::Span<const uint32_t>> read_uint32s =
+      reader->GetUint32s(uint32_ref);
+  ASSERT_THAT(read_uint32s, IsOk());
+  EXPECT_THAT(*read_uint32s, ElementsAre(6u));
+
+  absl::StatusOr<absl::Span<const int32_t>> read_int32s =
+      reader->GetInt32s(int32_ref);
+  ASSERT_THAT(read_int32s, IsOk());
+  EXPECT_THAT(*read_int32s, ElementsAre(-7, 8, -9, 10));
+}
+
+TEST(SidecarReader, NotASidecar) {
+  EXPECT_THAT(
+      SidecarReader::Open(MakeFile("sidecar_short", "PBRTGEOM")),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               testing::HasSubstr("Not a geometry sidecar file")));
+  EXPECT_THAT(
+      SidecarReader::Open(MakeFile("sidecar_magic", std::string(64, 'a'))),
+      StatusIs(absl::StatusCode::kInvalidArgument,
+               testing::HasSubstr("Not a geometry sidecar file")));
+}
+
+TEST(SidecarReader, InvalidRefs) {
+  std::stringstream output;
+  SidecarWriter writer(output, "invalid.geom");
+
+  ArrayRef ref;
+  double values[] = {1.0, 2.0};
+  ASSERT_THAT(writer.Write(values, ref), IsOk());
+  ASSERT_THAT(writer.Finish(), IsOk());
+
+  absl::StatusOr<SidecarReader> reader =
+      SidecarReader::Open(MakeFile("sidecar_invalid", output.str()));
+  ASSERT_THAT(reader, IsOk());
+
+  EXPECT_THAT(reader->GetFloat32s(ref),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       testing::HasSubstr("has type FLOAT64")));
+
+  ArrayRef header = ref;
+  header.set_offset(0);
+  EXPECT_THAT(reader->GetFloat64s(header),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  ArrayRef unaligned = ref;
+  unaligned.set_offset(72);
+  EXPECT_THAT(reader->GetFloat64s(unaligned),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  ArrayRef too_long = ref;
+  too_long.set_count(3);
+  EXPECT_THAT(reader->GetFloat64s(too_long),
+              StatusIs(absl::StatusCode::kOutOfRange));
+
+  ArrayRef past_end = ref;
+  past_end.set_offset(128);
+  past_end.set_count(0);
+  EXPECT_THAT(reader->GetFloat64s(past_end),
+              StatusIs(absl::StatusCode::kOutOfRange));
+
+  ArrayRef overflow = ref;
+  overflow.set_count(UINT64_MAX);
+  EXPECT_THAT(reader->GetFloat64s(overflow),
+              StatusIs(absl::StatusCode::kOutOfRange));
+}
+
+TEST(MoveToSidecar, TriangleMesh) {
+  TriangleMeshShape shape = ParseTextOrDie(R"pb(
+    P { x: 1.0 y: 2.0 z: 3.0 }
+    P { x: 4.0 y: 5.0 z: 6.0 }
+    P { x: 7.0 y: 8.0 z: 9.0 }
+    indices { v0: 0 v1: 1 v2: 2 }
+    N { x: 0.0 y: 0.0 z: 1.0 }
+    uv_flat_f32: [ 0.25, 0.75 ]
+    faceIndices: 7
+    discarddegenerateUVs: true
+  )pb");
+
+  std::stringstream output;
+  SidecarWriter writer(output, "mesh.geom");
+  ASSERT_THAT(MoveToSidecar(shape, writer), IsOk());
+  ASSERT_THAT(writer.Finish(), IsOk());
+
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                discarddegenerateUVs: true
+                P_ref { file: "mesh.geom" offset: 64 count: 9 type: FLOAT64 }
+                indices_ref {
+                  file: "mesh.geom"
+                  offset: 192
+                  count: 3
+                  type: UINT32
+                }
+                N_ref { file: "mesh.geom" offset: 256 count: 3 type: FLOAT64 }
+                uv_ref { file: "mesh.geom" offset: 320 count: 2 type: FLOAT32 }
+                faceIndices_ref {
+                  file: "mesh.geom"
+                  offset: 384
+                  count: 1
+                  type: INT32
+                }
+              )pb"));
+
+  absl::StatusOr<SidecarReader> reader =
+      SidecarReader::Open(MakeFile("sidecar_mesh", output.str()));
+  ASSERT_THAT(reader, IsOk());
+
+  absl::StatusOr<absl::Span<const double>> positions =
+      reader->GetFloat64s(shape.p_ref());
+  ASSERT_THAT(positions, IsOk());
+  EXPECT_THAT(*positions,
+              ElementsAre(1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0));
+
+  absl::StatusOr<absl::Span<const uint32_t>> indices =
+      reader->GetUint32s(shape.indices_ref());
+  ASSERT_THAT(indices, IsOk());
+  EXPECT_THAT(*indices, ElementsAre(0u, 1u, 2u));
+
+  absl::StatusOr<absl::Span<const float>> uvs =
+      reader->GetFloat32s(shape.uv_ref());
+  ASSERT_THAT(uvs, IsOk());
+  EXPECT_THAT(*uvs, ElementsAre(0.25f, 0.75f));
+}
+
+TEST(MoveToSidecar, Curve) {
+  CurveShape shape = ParseTextOrDie(R"pb(
+    P_xyz_f32: [ 1.0, 2.0, 3.0 ]
+    width: 2.0
+  )pb");
+
+  std::stringstream output;
+  SidecarWriter writer(output, "curve.geom");
+  ASSERT_THAT(MoveToSidecar(shape, writer), IsOk());
+
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                width: 2.0
+                P_ref { file: "curve.geom" offset: 64 count: 3 type: FLOAT32 }
+              )pb"));
+}
+
+TEST(MoveToSidecar, LoopSubdiv) {
+  LoopSubdivShape shape = ParseTextOrDie(R"pb(
+    P_xyz: [ 1.0, 2.0, 3.0 ]
+    indices_flat: [ 0, 0, 0 ]
+    levels: 2
+  )pb");
+
+  std::stringstream output;
+  SidecarWriter writer(output, "loop.geom");
+  ASSERT_THAT(MoveToSidecar(shape, writer), IsOk());
+
+  EXPECT_THAT(shape, EqualsProto(R"pb(
+                levels: 2
+                P_ref { file: "loop.geom" offset: 64 count: 3 type: FLOAT64 }
+                indices_ref {
+                  file: "loop.geom"
+                  offset: 128
+                  count: 3
+                  type: UINT32
+                }
+              )pb"));
+}
+
+TEST(MoveToSidecar, UniformGridMedium) {
+  UniformGridMedium medium = ParseTextOrDie(R"pb(
+    density: [ 1.0, 2.0 ]
+    temperature_f32: [ 3.0, 4.0 ]
+    nx: 2
+  )pb");
+
+  std::stringstream output;
+  SidecarWriter writer(output, "grid.geom");
+  ASSERT_THAT(MoveToSidecar(medium, writer), IsOk());
+
+  EXPECT_THAT(medium, EqualsProto(R"pb(
+                nx: 2
+                density_ref {
+                  file: "grid.geom"
+                  offset: 64
+                  count: 2
+                  type: FLOAT64
+                }
+                temperature_ref {
+                  file: "grid.geom"
+                  offset: 128
+                  count: 2
+                  type: FLOAT32
+                }
+              )pb"));
+}
+
+TEST(MoveToSidecar, Fails) {
+  TriangleMeshShape shape = ParseTextOrDie(R"pb(
+    P { x: 1.0 y: 2.0 z: 3.0 }
+    indices { v0: 0 v1: 0 v2: 0 }
+  )pb");
+
+  std::stringstream output;
+  output.setstate(std::ios::badbit);
+
+  SidecarWriter writer(output, "fails.geom");
+  EXPECT_THAT(MoveToSidecar(shape, writer),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+}  // namespace
+}  // namespace pbrt_proto
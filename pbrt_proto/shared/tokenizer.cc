@@ -1,193 +1,407 @@
 #include "pbrt_proto/shared/tokenizer.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <istream>
-#include <optional>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "absl/base/nullability.h"
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "pbrt_proto/shared/numbers.h"
+#include "pbrt_proto/shared/scanner.h"
 
 namespace pbrt_proto {
+namespace {
+
+constexpr size_t kStreamChunkSize = 1 << 20;
+
+absl::StatusOr<char> Unescape(char ch) {
+  switch (ch) {
+    case 'b':
+      return '\b';
+    case 'f':
+      return '\f';
+    case 'n':
+      return '\n';
+    case 'r':
+      return '\r';
+    case 't':
+      return '\t';
+    case '\\':
+      return '\\';
+    case '\'':
+      return '\'';
+    case '"':
+      return '"';
+  }
 
-Tokenizer::Tokenizer(Tokenizer&& moved_from) noexcept
-    : stream_(moved_from.stream_),
-      next_(moved_from.next_),
-      peeked_(moved_from.peeked_),
-      peeked_valid_(moved_from.peeked_valid_) {
-  moved_from.stream_ = nullptr;
-  moved_from.next_.clear();
-  moved_from.peeked_.clear();
-  moved_from.peeked_valid_.reset();
+  return absl::InvalidArgumentError("Illegal escape character");
 }
 
+// Classifies an unquoted, non-bracket token as either a NUMBER or a BARE_WORD
+void ClassifyUnquoted(Token& token) {
+  if (ParseNumber(token.text, token.number, token.integer)) {
+    token.kind = TokenKind::NUMBER;
+  } else {
+    token.kind = TokenKind::BARE_WORD;
+    token.integer = false;
+  }
+}
+
+}  // namespace
+
+Tokenizer::Tokenizer(absl::string_view buffer, const Scanner& scanner) noexcept
+    : stream_(nullptr),
+      cursor_(buffer.empty() ? "" : buffer.data()),
+      end_(cursor_ + buffer.size()),
+      scanner_(&scanner),
+      block_(cursor_),
+      block_end_(cursor_),
+      bytes_read_(buffer.size()) {}
+
+Tokenizer::Tokenizer(Tokenizer&& moved_from) noexcept { MoveFrom(moved_from); }
+
 Tokenizer& Tokenizer::operator=(Tokenizer&& moved_from) noexcept {
+  MoveFrom(moved_from);
+  return *this;
+}
+
+void Tokenizer::MoveFrom(Tokenizer& moved_from) noexcept {
   stream_ = moved_from.stream_;
-  next_ = moved_from.next_;
+  cursor_ = moved_from.cursor_;
+  end_ = moved_from.end_;
+  scanner_ = moved_from.scanner_;
+  block_ = moved_from.block_;
+  block_end_ = moved_from.block_end_;
+  block_masks_ = moved_from.block_masks_;
+  chunk_ = std::move(moved_from.chunk_);
+  chunk_capacity_ = moved_from.chunk_capacity_;
+  storage_ = std::move(moved_from.storage_);
+  tokens_ = moved_from.tokens_;
+  owned_ = moved_from.owned_;
+  current_ = moved_from.current_;
   peeked_ = moved_from.peeked_;
-  peeked_valid_ = moved_from.peeked_valid_;
+  tokens_read_ = moved_from.tokens_read_;
+  bytes_read_ = moved_from.bytes_read_;
+  status_ = std::move(moved_from.status_);
+
+  // Moving a short string may relocate its contents
+  for (size_t i = 0; i < storage_.size(); i++) {
+    if (owned_[i]) {
+      tokens_[i].text = storage_[i];
+    }
+  }
+
   moved_from.stream_ = nullptr;
-  moved_from.next_.clear();
-  moved_from.peeked_.clear();
-  moved_from.peeked_valid_.reset();
-  return *this;
+  moved_from.cursor_ = nullptr;
+  moved_from.end_ = nullptr;
+  moved_from.scanner_ = nullptr;
+  moved_from.block_ = nullptr;
+  moved_from.block_end_ = nullptr;
+  moved_from.block_masks_ = {0, 0};
+  moved_from.chunk_capacity_ = 0;
+  moved_from.storage_[0].clear();
+  moved_from.storage_[1].clear();
+  moved_from.tokens_ = {};
+  moved_from.owned_ = {false, false};
+  moved_from.current_ = 0;
+  moved_from.peeked_ = false;
+  moved_from.tokens_read_ = 0;
+  moved_from.bytes_read_ = 0;
+  moved_from.status_ = absl::OkStatus();
 }
 
-absl::StatusOr<bool> Tokenizer::ParseNext(std::string& output) {
-  output.clear();
+void Tokenizer::Fail(absl::Status status) {
+  if (status_.ok()) {
+    status_ = std::move(status);
+  }
+}
+
+void Tokenizer::ParseNext(size_t slot) {
+  Token& token = tokens_[slot];
 
-  if (!stream_) {
-    return absl::FailedPreconditionError("Bad Stream");
+  if (!status_.ok()) {
+    token = Token();
+    return;
   }
 
-  for (int read = stream_->get(); read != EOF; read = stream_->get()) {
-    if (std::isspace(read)) {
-      continue;
+  if (stream_ || cursor_) {
+    if (ParseNextFromBuffer(token, storage_[slot], owned_[slot])) {
+      tokens_read_ += 1;
+    } else {
+      token = Token();
     }
+    return;
+  }
 
-    char ch = static_cast<char>(read);
+  Fail(absl::FailedPreconditionError("Bad Stream"));
+  token = Token();
+}
 
-    if (ch == '#') {
-      for (read = stream_->get(); read != EOF; read = stream_->get()) {
-        ch = static_cast<char>(read);
-        if (ch == '\r' || ch == '\n') {
-          break;
-        }
-      }
+void Tokenizer::PreserveTokens() {
+  for (size_t i = 0; i < tokens_.size(); i++) {
+    if (!owned_[i] && !tokens_[i].text.empty()) {
+      storage_[i].assign(tokens_[i].text.data(), tokens_[i].text.size());
+      tokens_[i].text = storage_[i];
+      owned_[i] = true;
+    }
+  }
+}
 
-      continue;
+bool Tokenizer::Refill(const char* absl_nullable keep) {
+  if (!stream_ || stream_->peek() == std::char_traits<char>::eof()) {
+    return false;
+  }
+
+  // Tokens already returned may be views into the chunk
+  PreserveTokens();
+
+  size_t kept = end_ - keep;
+  if (kept == chunk_capacity_) {
+    size_t capacity = std::max(kStreamChunkSize, 2 * chunk_capacity_);
+    auto chunk = std::make_unique<char[]>(capacity);
+    if (kept != 0) {
+      std::memcpy(chunk.get(), keep, kept);
+    }
+    chunk_ = std::move(chunk);
+    chunk_capacity_ = capacity;
+  } else if (kept != 0) {
+    std::memmove(chunk_.get(), keep, kept);
+  }
+
+  stream_->read(chunk_.get() + kept, chunk_capacity_ - kept);
+
+  cursor_ = chunk_.get();
+  end_ = cursor_ + kept + stream_->gcount();
+  bytes_read_ += stream_->gcount();
+  block_ = cursor_;
+  block_end_ = cursor_;
+
+  return true;
+}
+
+void Tokenizer::ClassifyBlock() {
+  if (block_ <= cursor_ && cursor_ < block_end_) {
+    return;
+  }
+
+  block_ = cursor_;
+
+  size_t remaining = end_ - cursor_;
+  if (remaining >= kScannerBlockSize) {
+    block_end_ = cursor_ + kScannerBlockSize;
+    block_masks_ = scanner_->classify(cursor_);
+    return;
+  }
+
+  // The final block is padded with whitespace so that the end of the buffer
+  // also terminates any token that runs into it
+  char padded[kScannerBlockSize];
+  std::memset(padded, ' ', kScannerBlockSize);
+  std::memcpy(padded, cursor_, remaining);
+
+  block_end_ = end_;
+  block_masks_ = scanner_->classify(padded);
+}
+
+void Tokenizer::SkipWhitespace() {
+  while (cursor_ != end_) {
+    ClassifyBlock();
+
+    if (uint64_t found = ~block_masks_.whitespace >> (cursor_ - block_);
+        found != 0) {
+      cursor_ += absl::countr_zero(found);
+      return;
+    }
+
+    cursor_ = block_end_;
+  }
+}
+
+void Tokenizer::FindDelimiter() {
+  while (cursor_ != end_) {
+    ClassifyBlock();
+
+    if (uint64_t found = block_masks_.delimiters >> (cursor_ - block_);
+        found != 0) {
+      cursor_ += absl::countr_zero(found);
+      return;
     }
 
-    output.push_back(ch);
-
-    if (ch == '"') {
-      bool just_escaped = false;
-      bool found_end = false;
-      for (read = stream_->get(); read != EOF; read = stream_->get()) {
-        ch = static_cast<char>(read);
-
-        if (ch == '\n') {
-          return absl::InvalidArgumentError(
-              "New line found before end of quoted string");
-        }
-
-        if (just_escaped) {
-          switch (ch) {
-            case 'b':
-              ch = '\b';
-              break;
-            case 'f':
-              ch = '\f';
-              break;
-            case 'n':
-              ch = '\n';
-              break;
-            case 'r':
-              ch = '\r';
-              break;
-            case 't':
-              ch = '\t';
-              break;
-            case '\\':
-              ch = '\\';
-              break;
-            case '\'':
-              ch = '\'';
-              break;
-            case '"':
-              ch = '"';
-              break;
-            default:
-              return absl::InvalidArgumentError("Illegal escape character");
-          }
-          just_escaped = false;
-        } else if (ch == '\\') {
-          just_escaped = true;
-          continue;
-        } else if (ch == '"') {
-          found_end = true;
-        }
-
-        output.push_back(ch);
-
-        if (found_end) {
-          break;
-        }
+    cursor_ = block_end_;
+  }
+}
+
+bool Tokenizer::ParseNextFromBuffer(Token& token, std::string& storage,
+                                    bool& owned) {
+  // When reading from a stream, a token that runs into the end of the chunk
+  // may continue into the next one. In that case the chunk is refilled,
+  // keeping the start of the token, and the token is parsed again.
+  for (;;) {
+    owned = false;
+
+    SkipWhitespace();
+    if (cursor_ == end_) {
+      if (Refill(cursor_)) {
+        continue;
       }
+      return false;
+    }
+
+    const char* start = cursor_++;
 
-      if (!found_end) {
-        return absl::InvalidArgumentError("Unterminated quoted string");
+    if (*start == '#') {
+      cursor_ = scanner_->find_line_end(cursor_, end_);
+      while (cursor_ == end_ && Refill(cursor_)) {
+        cursor_ = scanner_->find_line_end(cursor_, end_);
       }
+      continue;
+    }
+
+    if (*start == '[') {
+      token.kind = TokenKind::OPEN_BRACKET;
+      token.text = absl::string_view(start, 1);
+      return true;
+    }
 
+    if (*start == ']') {
+      token.kind = TokenKind::CLOSE_BRACKET;
+      token.text = absl::string_view(start, 1);
       return true;
     }
 
-    if (ch == '[') {
+    if (*start != '"') {
+      FindDelimiter();
+      if (cursor_ == end_ && Refill(start)) {
+        continue;
+      }
+
+      token.text = absl::string_view(start, cursor_ - start);
+      ClassifyUnquoted(token);
       return true;
     }
 
-    if (ch == ']') {
+    token.kind = TokenKind::QUOTED_STRING;
+
+    // Quoted strings without escape sequences are returned in place
+    cursor_ = scanner_->find_quote_end(cursor_, end_);
+    if (cursor_ != end_ && *cursor_ == '"') {
+      cursor_++;
+      token.text = absl::string_view(start, cursor_ - start);
       return true;
     }
 
-    for (int peeked = stream_->peek(); peeked != EOF;
-         peeked = stream_->peek()) {
-      if (std::isspace(peeked) || peeked == '"' || peeked == '[' ||
-          peeked == ']') {
+    if (cursor_ == end_ && Refill(start)) {
+      continue;
+    }
+
+    storage.assign(start, cursor_);
+    owned = true;
+
+    while (cursor_ != end_) {
+      if (*cursor_ == '\n') {
         break;
       }
 
-      *stream_ >> ch;
-      output.push_back(ch);
-    }
+      if (*cursor_++ == '"') {
+        storage.push_back('"');
+        token.text = storage;
+        return true;
+      }
 
-    return true;
-  }
+      if (cursor_ == end_ || *cursor_ == '\n') {
+        break;
+      }
 
-  return false;
-}
+      absl::StatusOr<char> unescaped = Unescape(*cursor_++);
+      if (!unescaped.ok()) {
+        Fail(unescaped.status());
+        return false;
+      }
+      storage.push_back(*unescaped);
+
+      const char* unescaped_start = cursor_;
+      cursor_ = scanner_->find_quote_end(cursor_, end_);
+      storage.append(unescaped_start, cursor_);
+    }
 
-absl::StatusOr<const std::string * absl_nullable> Tokenizer::Peek() {
-  if (peeked_valid_) {
-    if (*peeked_valid_) {
-      return &peeked_;
+    if (cursor_ == end_ && Refill(start)) {
+      continue;
+    }
+
+    if (cursor_ != end_) {
+      Fail(absl::InvalidArgumentError(
+          "New line found before end of quoted string"));
     } else {
-      return nullptr;
+      Fail(absl::InvalidArgumentError("Unterminated quoted string"));
     }
-  }
 
-  absl::StatusOr<bool> found = ParseNext(peeked_);
-  if (!found.ok()) {
-    return found.status();
+    return false;
   }
+}
 
-  if (*found) {
-    peeked_valid_ = *found;
-    return &peeked_;
+bool Tokenizer::NextNumber(Token& token) {
+  if ((!stream_ && !cursor_) || peeked_ || !status_.ok()) {
+    return false;
   }
 
-  return nullptr;
-}
+  for (;;) {
+    SkipWhitespace();
+    if (cursor_ == end_) {
+      if (Refill(cursor_)) {
+        continue;
+      }
+      return false;
+    }
 
-absl::StatusOr<const std::string * absl_nullable> Tokenizer::Next() {
-  std::optional<bool> next_valid;
-  if (peeked_valid_) {
-    std::swap(next_, peeked_);
-    next_valid = *peeked_valid_;
-    peeked_valid_ = std::nullopt;
-  } else {
-    absl::StatusOr<bool> found = ParseNext(next_);
-    if (!found.ok()) {
-      return found.status();
+    const char* start = cursor_;
+    if (*start == '#' || *start == '"' || *start == '[' || *start == ']') {
+      return false;
     }
 
-    next_valid = *found;
+    FindDelimiter();
+    if (cursor_ == end_ && Refill(start)) {
+      continue;
+    }
+
+    token.text = absl::string_view(start, cursor_ - start);
+    if (!ParseNumber(token.text, token.number, token.integer)) {
+      cursor_ = start;
+      return false;
+    }
+
+    token.kind = TokenKind::NUMBER;
+    tokens_read_ += 1;
+
+    return true;
+  }
+}
+
+const Token& Tokenizer::Peek() {
+  size_t slot = current_ ^ 1;
+  if (!peeked_) {
+    ParseNext(slot);
+    peeked_ = true;
   }
 
-  if (*next_valid) {
-    return &next_;
+  return tokens_[slot];
+}
+
+const Token& Tokenizer::Next() {
+  if (peeked_) {
+    current_ ^= 1;
+    peeked_ = false;
+  } else {
+    ParseNext(current_);
   }
 
-  return nullptr;
+  return tokens_[current_];
 }
 
 }  // namespace pbrt_proto
@@ -1,21 +1,63 @@
 #ifndef _PBRT_PROTO_SHARED_TOKENIZER_
 #define _PBRT_PROTO_SHARED_TOKENIZER_
 
+#include <array>
+#include <cstdint>
 #include <istream>
-#include <optional>
+#include <memory>
 #include <string>
 
 #include "absl/base/nullability.h"
-#include "absl/status/statusor.h"
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "pbrt_proto/shared/scanner.h"
 
 namespace pbrt_proto {
 
+enum class TokenKind : uint8_t {
+  END,            // End of input or a tokenizer error
+  OPEN_BRACKET,   // [
+  CLOSE_BRACKET,  // ]
+  QUOTED_STRING,  // "..." with escape sequences already decoded
+  NUMBER,         // Any unquoted token accepted by `absl::SimpleAtod`
+  BARE_WORD,      // Any other unquoted token
+};
+
+struct Token {
+  TokenKind kind = TokenKind::END;
+
+  // Set for NUMBER tokens written as an optionally signed string of decimal
+  // digits
+  bool integer = false;
+
+  // The value of NUMBER tokens as decoded by `absl::SimpleAtod`
+  double number = 0.0;
+
+  // The text of the token. QUOTED_STRING tokens include their quotes.
+  absl::string_view text;
+};
+
 class Tokenizer {
  public:
-  // Construct a Tokenizer for an `std::istream` input.
+  // Construct a Tokenizer for an `std::istream` input. The stream is read in
+  // large chunks, so memory use does not grow with the size of the input and
+  // the stream does not need to be seekable.
   //
   // NOTE: `stream` is not owned
-  Tokenizer(std::istream* absl_nullable stream) noexcept : stream_(stream) {}
+  Tokenizer(std::istream* absl_nullable stream) noexcept
+      : stream_(stream), scanner_(&GetScanner()) {}
+
+  // Construct a Tokenizer for an in-memory input such as a memory mapped file.
+  // Tokens that do not contain escape sequences are returned as views directly
+  // into `buffer`.
+  //
+  // NOTE: `buffer` is not owned and must outlive the Tokenizer and any tokens
+  //       returned by it
+  Tokenizer(absl::string_view buffer) noexcept
+      : Tokenizer(buffer, GetScanner()) {}
+
+  // As above, but scans `buffer` using a specific `scanner` implementation.
+  Tokenizer(absl::string_view buffer, const Scanner& scanner) noexcept;
 
   Tokenizer(Tokenizer&& moved_from) noexcept;
   Tokenizer& operator=(Tokenizer&& moved_from) noexcept;
@@ -23,16 +65,82 @@ class Tokenizer {
   Tokenizer(const Tokenizer&) = delete;
   Tokenizer& operator=(const Tokenizer&) = delete;
 
-  absl::StatusOr<const std::string * absl_nullable> Peek();
-  absl::StatusOr<const std::string * absl_nullable> Next();
+  // The tokens returned remain valid until the next call to `Next()`; however,
+  // the text of tokens read from an in-memory buffer that did not require
+  // unescaping remains valid for as long as the buffer does.
+  //
+  // Once an error is encountered it is recorded in `status()` and all further
+  // tokens returned are END tokens.
+  const Token& Peek();
+  const Token& Next();
+
+  // A fast path for reading runs of numbers such as the contents of parameter
+  // arrays. If no token has been peeked and the next token is a NUMBER,
+  // consumes that token into `token` and returns true. Otherwise, returns false
+  // without consuming any tokens.
+  //
+  // Unlike `Next()`, this does not invalidate previously returned tokens. The
+  // text of `token` remains valid only until the next call to the Tokenizer.
+  bool NextNumber(Token& token);
+
+  const absl::Status& status() const { return status_; }
+
+  // The number of tokens read so far, not counting END tokens, and the number
+  // of bytes of input the Tokenizer has been given. An in-memory input is
+  // counted in full from the start.
+  uint64_t tokens_read() const { return tokens_read_; }
+  uint64_t bytes_read() const { return bytes_read_; }
 
  private:
-  absl::StatusOr<bool> ParseNext(std::string& output);
+  void ParseNext(size_t slot);
+  bool ParseNextFromBuffer(Token& token, std::string& storage, bool& owned);
+  void Fail(absl::Status status);
+
+  void MoveFrom(Tokenizer& moved_from) noexcept;
+
+  // Helpers for scanning in-memory buffers. `SkipWhitespace` and
+  // `FindDelimiter` advance `cursor_` to the next matching character or to
+  // `end_` if there is none. `ClassifyBlock` ensures `cursor_` is within the
+  // current block.
+  void SkipWhitespace();
+  void FindDelimiter();
+  void ClassifyBlock();
+
+  // Refills the chunk from `stream_`, keeping the input from `keep` to `end_`
+  // and moving `cursor_` to the start of it. Returns false and does nothing if
+  // there is no more input. The chunk only grows if a single token does not
+  // fit within it.
+  bool Refill(const char* absl_nullable keep);
+
+  // Copies any returned tokens that are views into the chunk into storage
+  void PreserveTokens();
 
   std::istream* absl_nullable stream_;  // Not owned
-  std::string next_;
-  std::string peeked_;
-  std::optional<bool> peeked_valid_;
+  const char* absl_nullable cursor_ = nullptr;
+  const char* absl_nullable end_ = nullptr;
+  const Scanner* absl_nullable scanner_ = nullptr;
+
+  // The most recently classified block of the buffer, [block_, block_end_)
+  const char* absl_nullable block_ = nullptr;
+  const char* absl_nullable block_end_ = nullptr;
+  ScannerBlock block_masks_ = {0, 0};
+
+  // The buffered input read from `stream_`
+  std::unique_ptr<char[]> chunk_;
+  size_t chunk_capacity_ = 0;
+
+  // Tokens alternate between two slots so that peeking does not invalidate
+  // the token most recently returned by `Next()`.
+  std::array<std::string, 2> storage_;
+  std::array<Token, 2> tokens_;
+  std::array<bool, 2> owned_ = {false, false};
+  size_t current_ = 0;
+  bool peeked_ = false;
+
+  uint64_t tokens_read_ = 0;
+  uint64_t bytes_read_ = 0;
+
+  absl::Status status_;
 };
 
 }  // namespace pbrt_proto
@@ -1,8 +1,16 @@
 #include "pbrt_proto/shared/tokenizer.h"
 
+#include <cmath>
+#include <initializer_list>
 #include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/strings/numbers.h"
+#include "absl/strings/string_view.h"
 #include "gtest/gtest.h"
+#include "pbrt_proto/shared/scanner.h"
 
 namespace pbrt_proto {
 namespace {
@@ -10,41 +18,43 @@ namespace {
 TEST(Tokenizer, Empty) {
   std::stringstream input;
   Tokenizer tokenizer(&input);
-  EXPECT_FALSE(tokenizer.Peek().value());
-  EXPECT_FALSE(tokenizer.Next().value());
+  EXPECT_EQ(TokenKind::END, tokenizer.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
 }
 
 TEST(Tokenizer, MoveConstruct) {
   std::stringstream input("hello");
   Tokenizer tokenizer0(&input);
-  EXPECT_EQ("hello", *tokenizer0.Peek().value());
+  EXPECT_EQ("hello", tokenizer0.Peek().text);
 
   Tokenizer tokenizer1(std::move(tokenizer0));
-  EXPECT_FALSE(tokenizer0.Peek().ok());
-  EXPECT_FALSE(tokenizer0.Next().ok());
-  EXPECT_EQ("hello", *tokenizer1.Peek().value());
-  EXPECT_EQ("hello", *tokenizer1.Next().value());
+  EXPECT_EQ(TokenKind::END, tokenizer0.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer0.Next().kind);
+  EXPECT_FALSE(tokenizer0.status().ok());
+  EXPECT_EQ("hello", tokenizer1.Peek().text);
+  EXPECT_EQ("hello", tokenizer1.Next().text);
 }
 
 TEST(Tokenizer, Move) {
   std::stringstream input("hello");
   Tokenizer tokenizer0(&input);
-  EXPECT_EQ("hello", *tokenizer0.Peek().value());
+  EXPECT_EQ("hello", tokenizer0.Peek().text);
 
   std::stringstream empty;
   Tokenizer tokenizer1(&empty);
   tokenizer1 = std::move(tokenizer0);
 
-  EXPECT_FALSE(tokenizer0.Peek().ok());
-  EXPECT_FALSE(tokenizer0.Next().ok());
-  EXPECT_EQ("hello", *tokenizer1.Peek().value());
-  EXPECT_EQ("hello", *tokenizer1.Next().value());
+  EXPECT_EQ(TokenKind::END, tokenizer0.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer0.Next().kind);
+  EXPECT_FALSE(tokenizer0.status().ok());
+  EXPECT_EQ("hello", tokenizer1.Peek().text);
+  EXPECT_EQ("hello", tokenizer1.Next().text);
 }
 
 TEST(Tokenizer, QuotedString) {
   std::stringstream input("\"hello world!\"");
   Tokenizer tokenizer(&input);
-  EXPECT_EQ("\"hello world!\"", *tokenizer.Next().value());
+  EXPECT_EQ("\"hello world!\"", tokenizer.Next().text);
 }
 
 TEST(Tokenizer, ValidEscapeCodes) {
@@ -56,79 +66,498 @@ TEST(Tokenizer, ValidEscapeCodes) {
     std::string contents = "\"\\" + escaped_characters[i] + "\"";
     std::stringstream input(contents);
     Tokenizer tokenizer(&input);
-    EXPECT_EQ("\"" + escaped_values[i] + "\"", *tokenizer.Next().value());
+    EXPECT_EQ("\"" + escaped_values[i] + "\"", tokenizer.Next().text);
   }
 }
 
 TEST(Tokenizer, IllegalEscape) {
   std::stringstream input("\"\\!\"");
   Tokenizer tokenizer(&input);
-  EXPECT_EQ("Illegal escape character", tokenizer.Next().status().message());
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("Illegal escape character", tokenizer.status().message());
 }
 
 TEST(Tokenizer, IllegalNewline) {
   std::stringstream input("\"\n\"");
   Tokenizer tokenizer(&input);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
   EXPECT_EQ("New line found before end of quoted string",
-            tokenizer.Next().status().message());
+            tokenizer.status().message());
 }
 
 TEST(Tokenizer, UnusedEscapeCharacter) {
   std::stringstream input("\"\n\"");
   Tokenizer tokenizer(&input);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
   EXPECT_EQ("New line found before end of quoted string",
-            tokenizer.Next().status().message());
+            tokenizer.status().message());
 }
 
 TEST(Tokenizer, UnterminatedQuote) {
   std::stringstream input("\"");
   Tokenizer tokenizer(&input);
-  EXPECT_EQ("Unterminated quoted string", tokenizer.Next().status().message());
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("Unterminated quoted string", tokenizer.status().message());
 }
 
 TEST(Tokenizer, IgnoresComments) {
   std::stringstream input("#ignored one\n#ignored two\nAbc");
   Tokenizer tokenizer(&input);
-  EXPECT_EQ("Abc", *tokenizer.Next().value());
+  EXPECT_EQ("Abc", tokenizer.Next().text);
 }
 
 TEST(Tokenizer, Array) {
   std::stringstream input("[]");
   Tokenizer tokenizer(&input);
-  EXPECT_EQ("[", *tokenizer.Next().value());
-  EXPECT_EQ("]", *tokenizer.Next().value());
+  EXPECT_EQ("[", tokenizer.Next().text);
+  EXPECT_EQ("]", tokenizer.Next().text);
 }
 
 TEST(Tokenizer, MultipleTokens) {
   std::stringstream input("Token1 [1.0] Two \"hello world\" [3] [\"a\"]");
   Tokenizer tokenizer(&input);
-  EXPECT_EQ("Token1", *tokenizer.Peek().value());
-  EXPECT_EQ("Token1", *tokenizer.Peek().value());
-  EXPECT_EQ("Token1", *tokenizer.Next().value());
-  EXPECT_EQ("[", *tokenizer.Peek().value());
-  EXPECT_EQ("[", *tokenizer.Next().value());
-  EXPECT_EQ("1.0", *tokenizer.Peek().value());
-  EXPECT_EQ("1.0", *tokenizer.Next().value());
-  EXPECT_EQ("]", *tokenizer.Peek().value());
-  EXPECT_EQ("]", *tokenizer.Next().value());
-  EXPECT_EQ("Two", *tokenizer.Peek().value());
-  EXPECT_EQ("Two", *tokenizer.Next().value());
-  EXPECT_EQ("\"hello world\"", *tokenizer.Peek().value());
-  EXPECT_EQ("\"hello world\"", *tokenizer.Next().value());
-  EXPECT_EQ("[", *tokenizer.Peek().value());
-  EXPECT_EQ("[", *tokenizer.Next().value());
-  EXPECT_EQ("3", *tokenizer.Peek().value());
-  EXPECT_EQ("3", *tokenizer.Next().value());
-  EXPECT_EQ("]", *tokenizer.Peek().value());
-  EXPECT_EQ("]", *tokenizer.Next().value());
-  EXPECT_EQ("[", *tokenizer.Peek().value());
-  EXPECT_EQ("[", *tokenizer.Next().value());
-  EXPECT_EQ("\"a\"", *tokenizer.Peek().value());
-  EXPECT_EQ("\"a\"", *tokenizer.Next().value());
-  EXPECT_EQ("]", *tokenizer.Peek().value());
-  EXPECT_EQ("]", *tokenizer.Next().value());
-  EXPECT_FALSE(tokenizer.Peek().value());
-  EXPECT_FALSE(tokenizer.Next().value());
+  EXPECT_EQ("Token1", tokenizer.Peek().text);
+  EXPECT_EQ("Token1", tokenizer.Peek().text);
+  EXPECT_EQ("Token1", tokenizer.Next().text);
+  EXPECT_EQ("[", tokenizer.Peek().text);
+  EXPECT_EQ("[", tokenizer.Next().text);
+  EXPECT_EQ("1.0", tokenizer.Peek().text);
+  EXPECT_EQ("1.0", tokenizer.Next().text);
+  EXPECT_EQ("]", tokenizer.Peek().text);
+  EXPECT_EQ("]", tokenizer.Next().text);
+  EXPECT_EQ("Two", tokenizer.Peek().text);
+  EXPECT_EQ("Two", tokenizer.Next().text);
+  EXPECT_EQ("\"hello world\"", tokenizer.Peek().text);
+  EXPECT_EQ("\"hello world\"", tokenizer.Next().text);
+  EXPECT_EQ("[", tokenizer.Peek().text);
+  EXPECT_EQ("[", tokenizer.Next().text);
+  EXPECT_EQ("3", tokenizer.Peek().text);
+  EXPECT_EQ("3", tokenizer.Next().text);
+  EXPECT_EQ("]", tokenizer.Peek().text);
+  EXPECT_EQ("]", tokenizer.Next().text);
+  EXPECT_EQ("[", tokenizer.Peek().text);
+  EXPECT_EQ("[", tokenizer.Next().text);
+  EXPECT_EQ("\"a\"", tokenizer.Peek().text);
+  EXPECT_EQ("\"a\"", tokenizer.Next().text);
+  EXPECT_EQ("]", tokenizer.Peek().text);
+  EXPECT_EQ("]", tokenizer.Next().text);
+  EXPECT_EQ(TokenKind::END, tokenizer.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+}
+
+TEST(BufferTokenizer, Empty) {
+  Tokenizer tokenizer(absl::string_view{});
+  EXPECT_EQ(TokenKind::END, tokenizer.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+}
+
+TEST(BufferTokenizer, MoveConstruct) {
+  Tokenizer tokenizer0(absl::string_view("hello"));
+  EXPECT_EQ("hello", tokenizer0.Peek().text);
+
+  Tokenizer tokenizer1(std::move(tokenizer0));
+  EXPECT_EQ(TokenKind::END, tokenizer0.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer0.Next().kind);
+  EXPECT_FALSE(tokenizer0.status().ok());
+  EXPECT_EQ("hello", tokenizer1.Peek().text);
+  EXPECT_EQ("hello", tokenizer1.Next().text);
+}
+
+TEST(BufferTokenizer, MoveEscaped) {
+  Tokenizer tokenizer0(absl::string_view("\"\\t\""));
+  EXPECT_EQ("\"\t\"", tokenizer0.Peek().text);
+
+  Tokenizer tokenizer1(absl::string_view{});
+  tokenizer1 = std::move(tokenizer0);
+
+  EXPECT_EQ(TokenKind::END, tokenizer0.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer0.Next().kind);
+  EXPECT_FALSE(tokenizer0.status().ok());
+  EXPECT_EQ("\"\t\"", tokenizer1.Peek().text);
+  EXPECT_EQ("\"\t\"", tokenizer1.Next().text);
+}
+
+TEST(BufferTokenizer, ReturnsViewsIntoBuffer) {
+  absl::string_view input = "Token [ \"hello world\" ]";
+  Tokenizer tokenizer(input);
+  EXPECT_EQ(input.data(), tokenizer.Next().text.data());
+  EXPECT_EQ(input.data() + 6, tokenizer.Next().text.data());
+  EXPECT_EQ(input.data() + 8, tokenizer.Next().text.data());
+  EXPECT_EQ(input.data() + 22, tokenizer.Next().text.data());
+}
+
+TEST(BufferTokenizer, QuotedString) {
+  Tokenizer tokenizer(absl::string_view("\"hello world!\""));
+  EXPECT_EQ("\"hello world!\"", tokenizer.Next().text);
+}
+
+TEST(BufferTokenizer, ValidEscapeCodes) {
+  std::string escaped_characters[8] = {"b", "f",  "n", "r",
+                                       "t", "\\", "'", "\""};
+  std::string escaped_values[8] = {"\b", "\f", "\n", "\r",
+                                   "\t", "\\", "'",  "\""};
+  for (size_t i = 0; i < 8; i++) {
+    std::string contents = "\"a\\" + escaped_characters[i] + "b\"";
+    Tokenizer tokenizer(contents);
+    EXPECT_EQ("\"a" + escaped_values[i] + "b\"", tokenizer.Next().text);
+  }
+}
+
+TEST(BufferTokenizer, IllegalEscape) {
+  Tokenizer tokenizer(absl::string_view("\"\\!\""));
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("Illegal escape character", tokenizer.status().message());
+}
+
+TEST(BufferTokenizer, IllegalNewline) {
+  Tokenizer tokenizer(absl::string_view("\"\n\""));
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("New line found before end of quoted string",
+            tokenizer.status().message());
+}
+
+TEST(BufferTokenizer, IllegalNewlineAfterEscape) {
+  Tokenizer tokenizer(absl::string_view("\"\\t\n\""));
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("New line found before end of quoted string",
+            tokenizer.status().message());
+}
+
+TEST(BufferTokenizer, UnterminatedQuote) {
+  Tokenizer tokenizer(absl::string_view("\""));
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("Unterminated quoted string", tokenizer.status().message());
+}
+
+TEST(BufferTokenizer, UnterminatedEscapedQuote) {
+  Tokenizer tokenizer(absl::string_view("\"\\\""));
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("Unterminated quoted string", tokenizer.status().message());
+}
+
+TEST(BufferTokenizer, IgnoresComments) {
+  Tokenizer tokenizer(absl::string_view("#ignored one\n#ignored two\nAbc"));
+  EXPECT_EQ("Abc", tokenizer.Next().text);
+}
+
+TEST(BufferTokenizer, MultipleTokens) {
+  Tokenizer tokenizer(
+      absl::string_view("Token1 [1.0] Two \"hello world\" [3] [\"a\"]"));
+  EXPECT_EQ("Token1", tokenizer.Peek().text);
+  EXPECT_EQ("Token1", tokenizer.Peek().text);
+  EXPECT_EQ("Token1", tokenizer.Next().text);
+  EXPECT_EQ("[", tokenizer.Peek().text);
+  EXPECT_EQ("[", tokenizer.Next().text);
+  EXPECT_EQ("1.0", tokenizer.Peek().text);
+  EXPECT_EQ("1.0", tokenizer.Next().text);
+  EXPECT_EQ("]", tokenizer.Peek().text);
+  EXPECT_EQ("]", tokenizer.Next().text);
+  EXPECT_EQ("Two", tokenizer.Peek().text);
+  EXPECT_EQ("Two", tokenizer.Next().text);
+  EXPECT_EQ("\"hello world\"", tokenizer.Peek().text);
+  EXPECT_EQ("\"hello world\"", tokenizer.Next().text);
+  EXPECT_EQ("[", tokenizer.Peek().text);
+  EXPECT_EQ("[", tokenizer.Next().text);
+  EXPECT_EQ("3", tokenizer.Peek().text);
+  EXPECT_EQ("3", tokenizer.Next().text);
+  EXPECT_EQ("]", tokenizer.Peek().text);
+  EXPECT_EQ("]", tokenizer.Next().text);
+  EXPECT_EQ("[", tokenizer.Peek().text);
+  EXPECT_EQ("[", tokenizer.Next().text);
+  EXPECT_EQ("\"a\"", tokenizer.Peek().text);
+  EXPECT_EQ("\"a\"", tokenizer.Next().text);
+  EXPECT_EQ("]", tokenizer.Peek().text);
+  EXPECT_EQ("]", tokenizer.Next().text);
+  EXPECT_EQ(TokenKind::END, tokenizer.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+}
+
+TEST(BufferTokenizer, PeekPreservesPreviousToken) {
+  Tokenizer tokenizer(absl::string_view("\"a\\tb\" \"c\\td\""));
+  absl::string_view first = tokenizer.Next().text;
+  EXPECT_EQ("\"c\td\"", tokenizer.Peek().text);
+  EXPECT_EQ("\"a\tb\"", first);
+}
+
+TEST(BufferTokenizer, NextNumber) {
+  Tokenizer tokenizer(absl::string_view("[ 1 -2.5\t1e3 # 4\n5 x]"));
+  EXPECT_EQ(TokenKind::OPEN_BRACKET, tokenizer.Next().kind);
+
+  Token token;
+  ASSERT_TRUE(tokenizer.NextNumber(token));
+  EXPECT_EQ(TokenKind::NUMBER, token.kind);
+  EXPECT_EQ("1", token.text);
+  EXPECT_TRUE(token.integer);
+  EXPECT_EQ(1.0, token.number);
+
+  ASSERT_TRUE(tokenizer.NextNumber(token));
+  EXPECT_EQ("-2.5", token.text);
+  EXPECT_FALSE(token.integer);
+  EXPECT_EQ(-2.5, token.number);
+
+  ASSERT_TRUE(tokenizer.NextNumber(token));
+  EXPECT_EQ("1e3", token.text);
+  EXPECT_EQ(1000.0, token.number);
+
+  // Comments are left to `Next()`
+  EXPECT_FALSE(tokenizer.NextNumber(token));
+  EXPECT_EQ("5", tokenizer.Next().text);
+
+  EXPECT_FALSE(tokenizer.NextNumber(token));
+  EXPECT_EQ("x", tokenizer.Peek().text);
+
+  // Peeked tokens must be consumed by `Next()`
+  EXPECT_FALSE(tokenizer.NextNumber(token));
+  EXPECT_EQ("x", tokenizer.Next().text);
+  EXPECT_EQ(TokenKind::CLOSE_BRACKET, tokenizer.Next().kind);
+  EXPECT_FALSE(tokenizer.NextNumber(token));
+}
+
+TEST(Tokenizer, NextNumber) {
+  std::stringstream stream("1 x");
+  Tokenizer tokenizer(&stream);
+
+  Token token;
+  ASSERT_TRUE(tokenizer.NextNumber(token));
+  EXPECT_EQ("1", token.text);
+  EXPECT_FALSE(tokenizer.NextNumber(token));
+  EXPECT_EQ("x", tokenizer.Next().text);
+}
+
+TEST(BufferTokenizer, MatchesStreamForAllScanners) {
+  std::string input;
+  for (int i = 0; i < 200; i++) {
+    input += "Shape \"trianglemesh\" \"point P\" [ 0.25 -1e3\t7\r\n";
+    input += std::string(i % 67, ' ') + "]\"a\\tb\"#comment " +
+             std::string(i % 71, 'x') + "\n";
+    input += std::to_string(i) + "[" + std::to_string(i * 31) + "]";
+  }
+  input += "trailing";
+
+  std::vector<std::string> expected;
+  std::stringstream stream(input);
+  Tokenizer stream_tokenizer(&stream);
+  for (Token token = stream_tokenizer.Next(); token.kind != TokenKind::END;
+       token = stream_tokenizer.Next()) {
+    expected.emplace_back(token.text);
+  }
+
+  for (ScannerKernel kernel :
+       {ScannerKernel::SWAR, ScannerKernel::SSE2, ScannerKernel::AVX2}) {
+    const Scanner* scanner = GetScanner(kernel);
+    if (scanner == nullptr) {
+      continue;
+    }
+
+    // Tokenize every suffix length near the end to exercise the final block
+    for (size_t trim = 0; trim < 70; trim++) {
+      absl::string_view buffer(input.data(), input.size() - trim);
+      std::stringstream trimmed_stream{std::string(buffer)};
+      Tokenizer trimmed_stream_tokenizer(&trimmed_stream);
+      Tokenizer tokenizer(buffer, *scanner);
+
+      Token expected_token = trimmed_stream_tokenizer.Next();
+      Token actual_token = tokenizer.Next();
+      for (; expected_token.kind != TokenKind::END;
+           expected_token = trimmed_stream_tokenizer.Next(),
+           actual_token = tokenizer.Next()) {
+        ASSERT_EQ(expected_token.kind, actual_token.kind);
+        ASSERT_EQ(expected_token.text, actual_token.text);
+      }
+      EXPECT_EQ(TokenKind::END, actual_token.kind);
+      EXPECT_EQ(trimmed_stream_tokenizer.status(), tokenizer.status());
+    }
+
+    Tokenizer tokenizer(input, *scanner);
+    for (const std::string& token : expected) {
+      EXPECT_EQ(token, tokenizer.Next().text);
+    }
+    EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  }
+}
+
+TEST(Tokenizer, MatchesBufferAcrossChunks) {
+  std::string input;
+  for (int i = 0; input.size() < 3 * 1024 * 1024; i++) {
+    input += "Shape \"trianglemesh\" \"point P\" [ 0.25 -1e3\t7\r\n";
+    input += std::string(i % 67, ' ') + "]\"a\\tb\"#comment " +
+             std::string(i % 71, 'x') + "\n";
+    input += std::string(i % 13, 'y') + "[" + std::to_string(i * 31) + "]";
+  }
+
+  // Shift the input so that each kind of token straddles a chunk boundary
+  for (size_t shift = 0; shift < 97; shift += 7) {
+    std::string shifted = std::string(shift, ' ') + input;
+    std::stringstream stream(shifted);
+    Tokenizer stream_tokenizer(&stream);
+    Tokenizer tokenizer(absl::string_view{shifted});
+
+    const Token* expected_token = &tokenizer.Next();
+    const Token* actual_token = &stream_tokenizer.Next();
+    for (; expected_token->kind != TokenKind::END;
+         expected_token = &tokenizer.Next(),
+         actual_token = &stream_tokenizer.Next()) {
+      ASSERT_EQ(expected_token->kind, actual_token->kind);
+      ASSERT_EQ(expected_token->text, actual_token->text);
+    }
+    EXPECT_EQ(TokenKind::END, actual_token->kind);
+    EXPECT_TRUE(stream_tokenizer.status().ok());
+  }
+}
+
+TEST(Tokenizer, PeekAcrossChunksPreservesPreviousToken) {
+  for (size_t offset = 0; offset < 8; offset++) {
+    std::stringstream input(std::string(1024 * 1024 - offset, ' ') +
+                            "abc defgh");
+    Tokenizer tokenizer(&input);
+    absl::string_view first = tokenizer.Next().text;
+    EXPECT_EQ("defgh", tokenizer.Peek().text);
+    EXPECT_EQ("abc", first);
+  }
+}
+
+TEST(Tokenizer, TokenLargerThanChunk) {
+  std::string contents(3 * 1024 * 1024, 'x');
+  contents[contents.size() / 2] = 'y';
+
+  std::stringstream input("1 \"" + contents + "\" \"" + contents +
+                          "\\t\" 2");
+  Tokenizer tokenizer(&input);
+  EXPECT_EQ("1", tokenizer.Next().text);
+  EXPECT_EQ("\"" + contents + "\"", tokenizer.Next().text);
+  EXPECT_EQ("\"" + contents + "\t\"", tokenizer.Next().text);
+  EXPECT_EQ("2", tokenizer.Next().text);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+}
+
+TEST(Tokenizer, NextNumberAcrossChunks) {
+  std::string input;
+  while (input.size() < 2 * 1024 * 1024) {
+    input += std::to_string(input.size()) + " ";
+  }
+
+  std::stringstream stream(input);
+  Tokenizer tokenizer(&stream);
+
+  size_t offset = 0;
+  for (Token token; tokenizer.NextNumber(token);) {
+    ASSERT_EQ(static_cast<double>(offset), token.number);
+    offset += token.text.size() + 1;
+  }
+  EXPECT_EQ(input.size(), offset);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+}
+
+TEST(Tokenizer, CountsTokensAndBytes) {
+  std::string input = "A [ 1 2 ] \"b\" # comment\n";
+  std::stringstream stream(input);
+  Tokenizer tokenizer(&stream);
+
+  EXPECT_EQ("A", tokenizer.Peek().text);
+  EXPECT_EQ("A", tokenizer.Next().text);
+  EXPECT_EQ("[", tokenizer.Next().text);
+  Token token;
+  EXPECT_TRUE(tokenizer.NextNumber(token));
+  EXPECT_TRUE(tokenizer.NextNumber(token));
+  EXPECT_EQ("]", tokenizer.Next().text);
+  EXPECT_EQ("\"b\"", tokenizer.Next().text);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ(6u, tokenizer.tokens_read());
+  EXPECT_EQ(input.size(), tokenizer.bytes_read());
+
+  Tokenizer moved(std::move(tokenizer));
+  EXPECT_EQ(6u, moved.tokens_read());
+  EXPECT_EQ(0u, tokenizer.tokens_read());
+}
+
+TEST(BufferTokenizer, CountsTokensAndBytes) {
+  Tokenizer tokenizer(absl::string_view("A [ 1 ]"));
+  EXPECT_EQ(7u, tokenizer.bytes_read());
+
+  while (tokenizer.Next().kind != TokenKind::END) {
+  }
+  EXPECT_EQ(4u, tokenizer.tokens_read());
+}
+
+TEST(Tokenizer, Kinds) {
+  std::stringstream input("[ ] \"a b\" 1.5 -2 Shape");
+  Tokenizer tokenizer(&input);
+  EXPECT_EQ(TokenKind::OPEN_BRACKET, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::CLOSE_BRACKET, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::QUOTED_STRING, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::NUMBER, tokenizer.Peek().kind);
+  EXPECT_EQ(1.5, tokenizer.Next().number);
+  EXPECT_EQ(TokenKind::NUMBER, tokenizer.Peek().kind);
+  EXPECT_EQ(-2.0, tokenizer.Next().number);
+  EXPECT_EQ(TokenKind::BARE_WORD, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_TRUE(tokenizer.status().ok());
+}
+
+TEST(Tokenizer, StickyError) {
+  std::stringstream input("A \"\\!\" B");
+  Tokenizer tokenizer(&input);
+  EXPECT_EQ("A", tokenizer.Next().text);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("Illegal escape character", tokenizer.status().message());
+}
+
+TEST(BufferTokenizer, Kinds) {
+  Tokenizer tokenizer(absl::string_view("[ ] \"a\\tb\" 1.5 -2 Shape"));
+  EXPECT_EQ(TokenKind::OPEN_BRACKET, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::CLOSE_BRACKET, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::QUOTED_STRING, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::NUMBER, tokenizer.Peek().kind);
+  EXPECT_EQ(1.5, tokenizer.Next().number);
+  EXPECT_EQ(TokenKind::NUMBER, tokenizer.Peek().kind);
+  EXPECT_EQ(-2.0, tokenizer.Next().number);
+  EXPECT_EQ(TokenKind::BARE_WORD, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_TRUE(tokenizer.status().ok());
+}
+
+TEST(BufferTokenizer, StickyError) {
+  Tokenizer tokenizer(absl::string_view("A \"\\!\" B"));
+  EXPECT_EQ("A", tokenizer.Next().text);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Peek().kind);
+  EXPECT_EQ(TokenKind::END, tokenizer.Next().kind);
+  EXPECT_EQ("Illegal escape character", tokenizer.status().message());
+}
+
+TEST(BufferTokenizer, NumbersMatchSimpleAtod) {
+  for (absl::string_view text :
+       {"0", "-0", "+0", "1", "-1", "+1", "007", "2147483647", "2147483648",
+        "-2147483649", "999999999999999", "9999999999999999",
+        "12345678901234567890", "0.1", ".5", "-.5", "5.", "1e10", "1E-10",
+        "-1.5e+3", "1e400", "-1e400", "1e-400", "inf", "-inf", "Infinity",
+        "nan", "NaN", "+", "-", ".", "e5", "1e", "0x10", "1f", "--1", "+-1",
+        "1-", "name", "Shape", "i", "n"}) {
+    SCOPED_TRACE(text);
+
+    Tokenizer tokenizer(text);
+    const Token& token = tokenizer.Next();
+    EXPECT_EQ(text, token.text);
+
+    double expected;
+    if (!absl::SimpleAtod(text, &expected)) {
+      EXPECT_EQ(TokenKind::BARE_WORD, token.kind);
+      continue;
+    }
+
+    ASSERT_EQ(TokenKind::NUMBER, token.kind);
+    if (std::isnan(expected)) {
+      EXPECT_TRUE(std::isnan(token.number));
+    } else {
+      EXPECT_EQ(expected, token.number);
+      EXPECT_EQ(std::signbit(expected), std::signbit(token.number));
+    }
+
+    bool integer = text.find_first_not_of("+-0123456789") == text.npos;
+    EXPECT_EQ(integer, token.integer);
+  }
 }
 
 }  // namespace
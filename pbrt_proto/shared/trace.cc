@@ -0,0 +1,22 @@
+#include "pbrt_proto/shared/trace.h"
+
+#include <atomic>
+
+#include "absl/base/nullability.h"
+
+namespace pbrt_proto {
+namespace {
+
+std::atomic<Tracer*> g_tracer = nullptr;
+
+}  // namespace
+
+void SetTracer(Tracer* absl_nullable tracer) {
+  g_tracer.store(tracer, std::memory_order_release);
+}
+
+Tracer* absl_nullable GetTracer() {
+  return g_tracer.load(std::memory_order_acquire);
+}
+
+}  // namespace pbrt_proto
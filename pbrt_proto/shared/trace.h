@@ -0,0 +1,70 @@
+#ifndef _PBRT_PROTO_SHARED_TRACE_
+#define _PBRT_PROTO_SHARED_TRACE_
+
+#include <filesystem>
+#include <type_traits>
+
+#include "absl/base/nullability.h"
+#include "absl/strings/string_view.h"
+
+namespace pbrt_proto {
+
+// Receives the spans of work done by the library, such as reading and parsing
+// an input, so that they can be routed into an embedder's own tracer. Spans are
+// begun and ended on the thread doing the work, and the spans of each thread
+// nest, so `EndSpan` always ends the span most recently begun on the calling
+// thread. Methods may be called from many threads at once.
+class Tracer {
+ public:
+  virtual ~Tracer() = default;
+
+  // `name` names the kind of work, such as "parse", and `detail`, which may be
+  // empty, what it is working on. Neither remains valid after the call.
+  virtual void BeginSpan(absl::string_view name, absl::string_view detail) = 0;
+  virtual void EndSpan() = 0;
+};
+
+// Sets the tracer that receives every span, or stops tracing if null. The
+// tracer must outlive any work started while it is set.
+void SetTracer(Tracer* absl_nullable tracer);
+Tracer* absl_nullable GetTracer();
+
+// Traces a span from its construction to its destruction. When no tracer is
+// set this costs a single atomic load.
+class TraceScope {
+ public:
+  explicit TraceScope(absl::string_view name, absl::string_view detail = {})
+      : tracer_(GetTracer()) {
+    if (tracer_) {
+      tracer_->BeginSpan(name, detail);
+    }
+  }
+
+  // Takes a path as the detail, which is only converted to a string if there is
+  // a tracer to receive it. Only selected for an actual `std::filesystem::path`
+  // so that strings, which also convert to one, still bind to `string_view`.
+  template <typename Path, typename = std::enable_if_t<
+                               std::is_same_v<Path, std::filesystem::path>>>
+  TraceScope(absl::string_view name, const Path& detail)
+      : tracer_(GetTracer()) {
+    if (tracer_) {
+      tracer_->BeginSpan(name, detail.string());
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  ~TraceScope() {
+    if (tracer_) {
+      tracer_->EndSpan();
+    }
+  }
+
+ private:
+  Tracer* absl_nullable tracer_;
+};
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_TRACE_
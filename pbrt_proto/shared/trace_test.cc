@@ -0,0 +1,64 @@
+#include "pbrt_proto/shared/trace.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+#include "gtest/gtest.h"
+
+namespace pbrt_proto {
+namespace {
+
+class RecordingTracer final : public Tracer {
+ public:
+  void BeginSpan(absl::string_view name, absl::string_view detail) override {
+    events.push_back("begin " + std::string(name) + " " + std::string(detail));
+  }
+
+  void EndSpan() override { events.push_back("end"); }
+
+  std::vector<std::string> events;
+};
+
+TEST(TraceScope, NoTracer) {
+  SetTracer(nullptr);
+  EXPECT_EQ(nullptr, GetTracer());
+
+  TraceScope scope("parse");
+}
+
+TEST(TraceScope, Nests) {
+  RecordingTracer tracer;
+  SetTracer(&tracer);
+  EXPECT_EQ(&tracer, GetTracer());
+
+  {
+    TraceScope outer("file", "a.pbrt");
+    TraceScope inner("parse");
+  }
+
+  SetTracer(nullptr);
+  { TraceScope ignored("parse"); }
+
+  EXPECT_EQ(std::vector<std::string>(
+                {"begin file a.pbrt", "begin parse ", "end", "end"}),
+            tracer.events);
+}
+
+TEST(TraceScope, Details) {
+  RecordingTracer tracer;
+  SetTracer(&tracer);
+
+  { TraceScope path("map", std::filesystem::path("a.pbrt")); }
+  { TraceScope string("store", std::string("key")); }
+
+  SetTracer(nullptr);
+
+  EXPECT_EQ(std::vector<std::string>(
+                {"begin map a.pbrt", "end", "begin store key", "end"}),
+            tracer.events);
+}
+
+}  // namespace
+}  // namespace pbrt_proto
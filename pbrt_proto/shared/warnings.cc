@@ -0,0 +1,21 @@
+#include "pbrt_proto/shared/warnings.h"
+
+#include <iostream>
+#include <ostream>
+
+namespace pbrt_proto {
+namespace {
+
+thread_local std::ostream* t_warnings = nullptr;
+
+}  // namespace
+
+std::ostream& Warnings() { return t_warnings ? *t_warnings : std::cerr; }
+
+WarningCollector::WarningCollector() : previous_(t_warnings) {
+  t_warnings = &warnings_;
+}
+
+WarningCollector::~WarningCollector() { t_warnings = previous_; }
+
+}  // namespace pbrt_proto
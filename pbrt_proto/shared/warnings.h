@@ -0,0 +1,36 @@
+#ifndef _PBRT_PROTO_SHARED_WARNINGS_
+#define _PBRT_PROTO_SHARED_WARNINGS_
+
+#include <ostream>
+#include <sstream>
+#include <string>
+
+namespace pbrt_proto {
+
+// Returns the stream that warnings about the input are written to on the
+// calling thread. This is std::cerr unless a `WarningCollector` created on the
+// thread is collecting them.
+std::ostream& Warnings();
+
+// Collects the warnings written on the thread that created it, instead of
+// letting them reach std::cerr, until it is destroyed. Collectors may nest.
+class WarningCollector {
+ public:
+  WarningCollector();
+
+  WarningCollector(const WarningCollector&) = delete;
+  WarningCollector& operator=(const WarningCollector&) = delete;
+
+  ~WarningCollector();
+
+  // Returns the warnings collected so far, in the order they were written
+  std::string Collected() const { return warnings_.str(); }
+
+ private:
+  std::ostringstream warnings_;
+  std::ostream* previous_;
+};
+
+}  // namespace pbrt_proto
+
+#endif  // _PBRT_PROTO_SHARED_WARNINGS_
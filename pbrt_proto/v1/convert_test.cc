@@ -1,10 +1,13 @@
 #include "pbrt_proto/v1/convert.h"
 
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <string>
 
 #include "absl/status/status.h"
 #include "absl/status/status_matchers.h"
+#include "absl/status/statusor.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "pbrt_proto/testing/proto_matchers.h"
@@ -16,10 +19,123 @@ namespace {
 using ::absl_testing::StatusIs;
 using ::google::protobuf::EqualsProto;
 
-absl::Status Convert(absl::string_view input, PbrtProto& output) {
-  std::string as_string(input);
-  std::istringstream as_stream(as_string);
-  return Convert(as_stream, output);
+TEST(Convert, Stream) {
+  std::istringstream input(R"pbrt(WorldBegin WorldEnd)pbrt");
+
+  PbrtProto actual;
+  EXPECT_TRUE(Convert(input, actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(directives { world_begin {} }
+                                       directives { world_end {} })pb"));
+}
+
+TEST(Convert, File) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_test.pbrt";
+  std::ofstream(path) << R"pbrt(WorldBegin WorldEnd)pbrt";
+
+  PbrtProto actual;
+  EXPECT_TRUE(ConvertFile(path, actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(directives { world_begin {} }
+                                       directives { world_end {} })pb"));
+}
+
+std::string MakeScene(size_t num_shapes) {
+  std::string scene = "WorldBegin\n";
+  for (size_t i = 0; i < num_shapes; i++) {
+    scene += "AttributeBegin\n  Translate " + std::to_string(i) +
+             " 0 0\n  # Shape \"sphere\"\n  Shape \"trianglemesh\"\n"
+             "    \"integer indices\" [ 0 1 2 ]\n"
+             "    \"point P\" [ 0 0 0\n    1 0 0\n    0 1 0 ]\n"
+             "AttributeEnd\n";
+  }
+  scene += "WorldEnd\n";
+  return scene;
+}
+
+TEST(Convert, Parallel) {
+  std::string input = MakeScene(1000);
+
+  PbrtProto expected;
+  ASSERT_TRUE(Convert(input, expected).ok());
+  ASSERT_EQ(expected.directives_size(), 4002);
+
+  for (size_t num_threads : {0, 1, 2, 3, 8, 64}) {
+    PbrtProto actual;
+    EXPECT_TRUE(Convert(input, num_threads, actual).ok());
+    EXPECT_EQ(actual.DebugString(), expected.DebugString()) << num_threads;
+  }
+}
+
+TEST(Convert, ParallelAppends) {
+  PbrtProto actual;
+  actual.add_directives()->mutable_world_begin();
+  EXPECT_TRUE(Convert("Identity\nWorldEnd\n", 2, actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(directives { world_begin {} }
+                                       directives { identity {} }
+                                       directives { world_end {} })pb"));
+}
+
+TEST(Convert, ParallelError) {
+  std::string input = MakeScene(1000) + "Shape \"sphere\" \"float radius\"\n";
+
+  PbrtProto expected;
+  absl::Status expected_status = Convert(input, expected);
+  ASSERT_FALSE(expected_status.ok());
+
+  PbrtProto actual;
+  EXPECT_EQ(Convert(input, 8, actual), expected_status);
+  EXPECT_EQ(actual.DebugString(), expected.DebugString());
+}
+
+TEST(Convert, ParallelFile) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_parallel_test.pbrt";
+  std::ofstream(path) << MakeScene(100);
+
+  absl::StatusOr<PbrtProto> expected = ConvertFile(path);
+  ASSERT_TRUE(expected.ok());
+
+  absl::StatusOr<PbrtProto> actual = ConvertFile(path, 4);
+  ASSERT_TRUE(actual.ok());
+  EXPECT_EQ(actual->DebugString(), expected->DebugString());
+}
+
+TEST(Convert, Sink) {
+  std::string input = MakeScene(100);
+
+  PbrtProto expected;
+  ASSERT_TRUE(Convert(input, expected).ok());
+
+  PbrtProto actual;
+  auto sink = [&](Directive& directive) {
+    actual.add_directives()->Swap(&directive);
+    return absl::OkStatus();
+  };
+
+  std::istringstream stream(input);
+  EXPECT_TRUE(Convert(stream, sink).ok());
+  EXPECT_EQ(actual.DebugString(), expected.DebugString());
+
+  actual.Clear();
+  EXPECT_TRUE(Convert(input, sink).ok());
+  EXPECT_EQ(actual.DebugString(), expected.DebugString());
+
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_sink_test.pbrt";
+  std::ofstream(path) << input;
+
+  actual.Clear();
+  EXPECT_TRUE(ConvertFile(path, sink).ok());
+  EXPECT_EQ(actual.DebugString(), expected.DebugString());
+}
+
+TEST(Convert, MissingFile) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_test_missing.pbrt";
+
+  PbrtProto actual;
+  EXPECT_THAT(ConvertFile(path, actual),
+              StatusIs(absl::StatusCode::kNotFound, testing::_));
 }
 
 TEST(Accelerator, Grid) {
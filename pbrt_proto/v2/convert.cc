@@ -1,9 +1,14 @@
 #include "pbrt_proto/v2/convert.h"
 
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
 #include <functional>
-#include <iostream>
+#include <ostream>
 #include <istream>
+#include <optional>
 
+#include "absl/base/nullability.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
@@ -17,8 +22,10 @@
 #include "pbrt_proto/shared/films.h"
 #include "pbrt_proto/shared/integrators.h"
 #include "pbrt_proto/shared/light_sources.h"
+#include "pbrt_proto/shared/mapped_file.h"
 #include "pbrt_proto/shared/materials.h"
 #include "pbrt_proto/shared/media.h"
+#include "pbrt_proto/shared/parallel_parser.h"
 #include "pbrt_proto/shared/parser.h"
 #include "pbrt_proto/shared/pixel_filters.h"
 #include "pbrt_proto/shared/proto_parser.h"
@@ -26,6 +33,7 @@
 #include "pbrt_proto/shared/samplers.h"
 #include "pbrt_proto/shared/shapes.h"
 #include "pbrt_proto/shared/textures.h"
+#include "pbrt_proto/shared/warnings.h"
 #include "pbrt_proto/v2/v2.pb.h"
 
 namespace pbrt_proto::v2 {
@@ -50,8 +58,9 @@ static const absl::flat_hash_map<absl::string_view, ParameterType>
 
 class ParserV2 final : public ProtoParser<PbrtProto, 2> {
  public:
-  ParserV2(PbrtProto& output) noexcept
-      : ProtoParser(kParameterTypeNames, output) {}
+  ParserV2(PbrtProto& output,
+           std::optional<DirectiveSink> sink = std::nullopt) noexcept
+      : ProtoParser(kParameterTypeNames, output, sink) {}
 
  private:
   absl::Status Accelerator(
@@ -195,9 +204,9 @@ absl::Status ParserV2::FloatTexture(
                *float_texture.mutable_checkerboard3d());
          }
 
-         std::cerr << "WARNING: Unsupported value for 'checkerboard' Texture "
-                      "parameter 'dimension': "
-                   << dimension << std::endl;
+         Warnings() << "WARNING: Unsupported value for 'checkerboard' Texture "
+                       "parameter 'dimension': "
+                    << dimension << std::endl;
 
          return absl::OkStatus();
        }},
@@ -357,6 +366,14 @@ absl::Status ParserV2::Shape(
 
   // No need to check status. The directive is always added by Parse.
   auto& shape = *output_.mutable_directives()->rbegin()->mutable_shape();
+  if (shape.has_trianglemesh()) {
+    if (absl::Status status =
+            triangle_mesh_sink_.MoveTo(*shape.mutable_trianglemesh());
+        !status.ok()) {
+      return status;
+    }
+  }
+
   auto overrides = std::bind(&Shape::mutable_overrides, &shape);
 
   TryRemoveFloatTexture(
@@ -534,9 +551,9 @@ absl::Status ParserV2::SpectrumTexture(
                *spectrum_texture.mutable_checkerboard3d());
          }
 
-         std::cerr << "WARNING: Unsupported value for 'checkerboard' Texture "
-                      "parameter 'dimension': "
-                   << dimension << std::endl;
+         Warnings() << "WARNING: Unsupported value for 'checkerboard' Texture "
+                       "parameter 'dimension': "
+                    << dimension << std::endl;
 
          return absl::OkStatus();
        }},
@@ -641,4 +658,117 @@ absl::StatusOr<PbrtProto> Convert(std::istream& input) {
   return output;
 }
 
+absl::Status Convert(absl::string_view input, PbrtProto& output) {
+  return ParserV2(output).ReadFrom(input);
+}
+
+absl::StatusOr<PbrtProto> Convert(absl::string_view input) {
+  PbrtProto output;
+  if (absl::Status error = Convert(input, output); !error.ok()) {
+    return error;
+  }
+  return output;
+}
+
+absl::Status ConvertFile(const std::filesystem::path& path, PbrtProto& output) {
+  if (IsUnmappable(path)) {
+    absl::StatusOr<std::ifstream> input = OpenStream(path);
+    if (!input.ok()) {
+      return input.status();
+    }
+
+    return Convert(*input, output);
+  }
+
+  absl::StatusOr<MappedFile> file = MappedFile::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  return Convert(file->contents(), output);
+}
+
+absl::StatusOr<PbrtProto> ConvertFile(const std::filesystem::path& path) {
+  PbrtProto output;
+  if (absl::Status error = ConvertFile(path, output); !error.ok()) {
+    return error;
+  }
+  return output;
+}
+
+absl::Status Convert(std::istream& input, DirectiveSink sink,
+                     ParseStats* absl_nullable stats) {
+  PbrtProto output;
+  return ParserV2(output, sink).ReadFrom(input, stats);
+}
+
+absl::Status Convert(absl::string_view input, DirectiveSink sink,
+                     ParseStats* absl_nullable stats) {
+  PbrtProto output;
+  return ParserV2(output, sink).ReadFrom(input, stats);
+}
+
+absl::Status ConvertFile(const std::filesystem::path& path, DirectiveSink sink,
+                         ParseStats* absl_nullable stats) {
+  if (IsUnmappable(path)) {
+    absl::StatusOr<std::ifstream> input = OpenStream(path);
+    if (!input.ok()) {
+      return input.status();
+    }
+
+    return Convert(*input, sink, stats);
+  }
+
+  absl::StatusOr<MappedFile> file = MappedFile::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  return Convert(file->contents(), sink, stats);
+}
+
+absl::Status Convert(absl::string_view input, size_t num_threads,
+                     PbrtProto& output) {
+  return ReadInParallel<ParserV2>(input, num_threads, output);
+}
+
+absl::StatusOr<PbrtProto> Convert(absl::string_view input,
+                                  size_t num_threads) {
+  PbrtProto output;
+  if (absl::Status error = Convert(input, num_threads, output); !error.ok()) {
+    return error;
+  }
+  return output;
+}
+
+absl::Status ConvertFile(const std::filesystem::path& path, size_t num_threads,
+                         PbrtProto& output) {
+  // A stream cannot be split, so it is converted on a single thread
+  if (IsUnmappable(path)) {
+    absl::StatusOr<std::ifstream> input = OpenStream(path);
+    if (!input.ok()) {
+      return input.status();
+    }
+
+    return Convert(*input, output);
+  }
+
+  absl::StatusOr<MappedFile> file = MappedFile::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  return Convert(file->contents(), num_threads, output);
+}
+
+absl::StatusOr<PbrtProto> ConvertFile(const std::filesystem::path& path,
+                                      size_t num_threads) {
+  PbrtProto output;
+  if (absl::Status error = ConvertFile(path, num_threads, output);
+      !error.ok()) {
+    return error;
+  }
+  return output;
+}
+
 }  // namespace pbrt_proto::v2
@@ -1,8 +1,13 @@
 #include "pbrt_proto/v3/convert.h"
 
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
 #include <functional>
 #include <istream>
+#include <optional>
 
+#include "absl/base/nullability.h"
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
@@ -16,14 +21,17 @@
 #include "pbrt_proto/shared/films.h"
 #include "pbrt_proto/shared/integrators.h"
 #include "pbrt_proto/shared/light_sources.h"
+#include "pbrt_proto/shared/mapped_file.h"
 #include "pbrt_proto/shared/materials.h"
 #include "pbrt_proto/shared/media.h"
+#include "pbrt_proto/shared/parallel_parser.h"
 #include "pbrt_proto/shared/parser.h"
 #include "pbrt_proto/shared/pixel_filters.h"
 #include "pbrt_proto/shared/proto_parser.h"
 #include "pbrt_proto/shared/samplers.h"
 #include "pbrt_proto/shared/shapes.h"
 #include "pbrt_proto/shared/textures.h"
+#include "pbrt_proto/shared/warnings.h"
 #include "pbrt_proto/v3/v3.pb.h"
 
 namespace pbrt_proto::v3 {
@@ -53,8 +61,9 @@ static const absl::flat_hash_map<absl::string_view, ParameterType>
 
 class ParserV3 final : public ProtoParser<PbrtProto, 3> {
  public:
-  ParserV3(PbrtProto& output) noexcept
-      : ProtoParser(kParameterTypeNames, output) {}
+  ParserV3(PbrtProto& output,
+           std::optional<DirectiveSink> sink = std::nullopt) noexcept
+      : ProtoParser(kParameterTypeNames, output, sink) {}
 
  private:
   absl::Status Accelerator(
@@ -185,9 +194,9 @@ absl::Status ParserV3::FloatTexture(
          }
 
          if (dimension != 3) {
-           std::cerr << "WARNING: Unsupported value for 'checkerboard' Texture "
-                        "parameter 'dimension': "
-                     << dimension << std::endl;
+           Warnings() << "WARNING: Unsupported value for 'checkerboard' "
+                         "Texture parameter 'dimension': "
+                      << dimension << std::endl;
          }
 
          return RemoveCheckerboard3DFloatTexture(
@@ -395,6 +404,14 @@ absl::Status ParserV3::Shape(
 
   // No need to check status. The directive is always added by Parse.
   auto& shape = *output_.mutable_directives()->rbegin()->mutable_shape();
+  if (shape.has_trianglemesh()) {
+    if (absl::Status status =
+            triangle_mesh_sink_.MoveTo(*shape.mutable_trianglemesh());
+        !status.ok()) {
+      return status;
+    }
+  }
+
   auto overrides = std::bind(&Shape::mutable_overrides, &shape);
 
   TryRemoveFloatTexture(
@@ -649,9 +666,9 @@ absl::Status ParserV3::SpectrumTexture(
          }
 
          if (dimension != 3) {
-           std::cerr << "WARNING: Unsupported value for 'checkerboard' Texture "
-                        "parameter 'dimension': "
-                     << dimension << std::endl;
+           Warnings() << "WARNING: Unsupported value for 'checkerboard' "
+                         "Texture parameter 'dimension': "
+                      << dimension << std::endl;
          }
 
          return RemoveCheckerboard3DSpectrumTexture(
@@ -700,4 +717,117 @@ absl::StatusOr<PbrtProto> Convert(std::istream& input) {
   return output;
 }
 
+absl::Status Convert(absl::string_view input, PbrtProto& output) {
+  return ParserV3(output).ReadFrom(input);
+}
+
+absl::StatusOr<PbrtProto> Convert(absl::string_view input) {
+  PbrtProto output;
+  if (absl::Status error = Convert(input, output); !error.ok()) {
+    return error;
+  }
+  return output;
+}
+
+absl::Status ConvertFile(const std::filesystem::path& path, PbrtProto& output) {
+  if (IsUnmappable(path)) {
+    absl::StatusOr<std::ifstream> input = OpenStream(path);
+    if (!input.ok()) {
+      return input.status();
+    }
+
+    return Convert(*input, output);
+  }
+
+  absl::StatusOr<MappedFile> file = MappedFile::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  return Convert(file->contents(), output);
+}
+
+absl::StatusOr<PbrtProto> ConvertFile(const std::filesystem::path& path) {
+  PbrtProto output;
+  if (absl::Status error = ConvertFile(path, output); !error.ok()) {
+    return error;
+  }
+  return output;
+}
+
+absl::Status Convert(std::istream& input, DirectiveSink sink,
+                     ParseStats* absl_nullable stats) {
+  PbrtProto output;
+  return ParserV3(output, sink).ReadFrom(input, stats);
+}
+
+absl::Status Convert(absl::string_view input, DirectiveSink sink,
+                     ParseStats* absl_nullable stats) {
+  PbrtProto output;
+  return ParserV3(output, sink).ReadFrom(input, stats);
+}
+
+absl::Status ConvertFile(const std::filesystem::path& path, DirectiveSink sink,
+                         ParseStats* absl_nullable stats) {
+  if (IsUnmappable(path)) {
+    absl::StatusOr<std::ifstream> input = OpenStream(path);
+    if (!input.ok()) {
+      return input.status();
+    }
+
+    return Convert(*input, sink, stats);
+  }
+
+  absl::StatusOr<MappedFile> file = MappedFile::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  return Convert(file->contents(), sink, stats);
+}
+
+absl::Status Convert(absl::string_view input, size_t num_threads,
+                     PbrtProto& output) {
+  return ReadInParallel<ParserV3>(input, num_threads, output);
+}
+
+absl::StatusOr<PbrtProto> Convert(absl::string_view input,
+                                  size_t num_threads) {
+  PbrtProto output;
+  if (absl::Status error = Convert(input, num_threads, output); !error.ok()) {
+    return error;
+  }
+  return output;
+}
+
+absl::Status ConvertFile(const std::filesystem::path& path, size_t num_threads,
+                         PbrtProto& output) {
+  // A stream cannot be split, so it is converted on a single thread
+  if (IsUnmappable(path)) {
+    absl::StatusOr<std::ifstream> input = OpenStream(path);
+    if (!input.ok()) {
+      return input.status();
+    }
+
+    return Convert(*input, output);
+  }
+
+  absl::StatusOr<MappedFile> file = MappedFile::Open(path);
+  if (!file.ok()) {
+    return file.status();
+  }
+
+  return Convert(file->contents(), num_threads, output);
+}
+
+absl::StatusOr<PbrtProto> ConvertFile(const std::filesystem::path& path,
+                                      size_t num_threads) {
+  PbrtProto output;
+  if (absl::Status error = ConvertFile(path, num_threads, output);
+      !error.ok()) {
+    return error;
+  }
+  return output;
+}
+
 }  // namespace pbrt_proto::v3
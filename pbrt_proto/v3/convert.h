@@ -1,10 +1,16 @@
 #ifndef _PBRT_PROTO_V3_CONVERT_
 #define _PBRT_PROTO_V3_CONVERT_
 
+#include <cstddef>
+#include <filesystem>
 #include <istream>
 
+#include "absl/base/nullability.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "pbrt_proto/shared/parser.h"
 #include "pbrt_proto/v3/v3.pb.h"
 
 namespace pbrt_proto::v3 {
@@ -12,6 +18,45 @@ namespace pbrt_proto::v3 {
 absl::Status Convert(std::istream& input, PbrtProto& output);
 absl::StatusOr<PbrtProto> Convert(std::istream& input);
 
+// Converts an in-memory input. This avoids copying the input through a stream.
+absl::Status Convert(absl::string_view input, PbrtProto& output);
+absl::StatusOr<PbrtProto> Convert(absl::string_view input);
+
+// Converts the file at `path` by mapping it into memory. Files that cannot be
+// mapped, such as pipes, are read as a stream instead.
+absl::Status ConvertFile(const std::filesystem::path& path, PbrtProto& output);
+absl::StatusOr<PbrtProto> ConvertFile(const std::filesystem::path& path);
+
+// Receives each directive of a converted input as soon as it is complete. The
+// sink may modify or take the contents of the directive it is passed.
+using DirectiveSink = absl::FunctionRef<absl::Status(Directive&)>;
+
+// Converts an input one directive at a time, passing each to `sink` rather
+// than accumulating them in a `PbrtProto`, so that memory use is bounded by the
+// largest directive instead of the size of the input. If `sink` returns an
+// error, conversion stops and that error is returned. If `stats` is not null,
+// the input read is added to it.
+absl::Status Convert(std::istream& input, DirectiveSink sink,
+                     ParseStats* absl_nullable stats = nullptr);
+absl::Status Convert(absl::string_view input, DirectiveSink sink,
+                     ParseStats* absl_nullable stats = nullptr);
+absl::Status ConvertFile(const std::filesystem::path& path, DirectiveSink sink,
+                         ParseStats* absl_nullable stats = nullptr);
+
+// Converts an in-memory input by splitting it at directive boundaries and
+// converting the pieces on up to `num_threads` threads. The output is the same
+// as converting the input on a single thread.
+absl::Status Convert(absl::string_view input, size_t num_threads,
+                     PbrtProto& output);
+absl::StatusOr<PbrtProto> Convert(absl::string_view input, size_t num_threads);
+
+// Converts the file at `path` as above by mapping it into memory. Files that
+// cannot be mapped are read as a stream and converted on a single thread.
+absl::Status ConvertFile(const std::filesystem::path& path, size_t num_threads,
+                         PbrtProto& output);
+absl::StatusOr<PbrtProto> ConvertFile(const std::filesystem::path& path,
+                                      size_t num_threads);
+
 }  // namespace pbrt_proto::v3
 
 #endif  // _PBRT_PROTO_V3_CONVERT_
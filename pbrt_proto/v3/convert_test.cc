@@ -1,25 +1,236 @@
 #include "pbrt_proto/v3/convert.h"
 
+#include <filesystem>
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/status_matchers.h"
+#include "absl/status/statusor.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "pbrt_proto/testing/proto_matchers.h"
 #include "pbrt_proto/v3/v3.pb.h"
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 namespace pbrt_proto::v3 {
 namespace {
 
 using ::absl_testing::StatusIs;
 using ::google::protobuf::EqualsProto;
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+TEST(Convert, Stream) {
+  std::istringstream input(R"pbrt(WorldBegin WorldEnd)pbrt");
+
+  PbrtProto actual;
+  EXPECT_TRUE(Convert(input, actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(directives { world_begin {} }
+                                       directives { world_end {} })pb"));
+}
+
+TEST(Convert, File) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_test.pbrt";
+  std::ofstream(path) << R"pbrt(WorldBegin WorldEnd)pbrt";
+
+  PbrtProto actual;
+  EXPECT_TRUE(ConvertFile(path, actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(directives { world_begin {} }
+                                       directives { world_end {} })pb"));
+}
+
+#ifndef _WIN32
+TEST(Convert, Fifo) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_test_fifo.pbrt";
+  std::filesystem::remove(path);
+  ASSERT_EQ(0, mkfifo(path.c_str(), 0600));
+
+  std::thread writer(
+      [&]() { std::ofstream(path) << R"pbrt(WorldBegin WorldEnd)pbrt"; });
+
+  std::vector<Directive> directives;
+  absl::Status status = ConvertFile(path, [&](Directive& directive) {
+    directives.push_back(directive);
+    return absl::OkStatus();
+  });
+  writer.join();
+  std::filesystem::remove(path);
+
+  ASSERT_TRUE(status.ok());
+  ASSERT_EQ(2u, directives.size());
+  EXPECT_TRUE(directives[0].has_world_begin());
+  EXPECT_TRUE(directives[1].has_world_end());
+}
+#endif
+
+std::string MakeScene(size_t num_shapes) {
+  std::string scene = "WorldBegin\n";
+  for (size_t i = 0; i < num_shapes; i++) {
+    scene += "AttributeBegin\n  Translate " + std::to_string(i) +
+             " 0 0\n  # Shape \"sphere\"\n  Shape \"trianglemesh\"\n"
+             "    \"integer indices\" [ 0 1 2 ]\n"
+             "    \"point P\" [ 0 0 0\n    1 0 0\n    0 1 0 ]\n"
+             "AttributeEnd\n";
+  }
+  scene += "WorldEnd\n";
+  return scene;
+}
+
+TEST(Convert, Parallel) {
+  std::string input = MakeScene(1000);
+
+  PbrtProto expected;
+  ASSERT_TRUE(Convert(input, expected).ok());
+  ASSERT_EQ(expected.directives_size(), 4002);
+
+  for (size_t num_threads : {0, 1, 2, 3, 8, 64}) {
+    PbrtProto actual;
+    EXPECT_TRUE(Convert(input, num_threads, actual).ok());
+    EXPECT_EQ(actual.DebugString(), expected.DebugString()) << num_threads;
+  }
+}
+
+TEST(Convert, ParallelAppends) {
+  PbrtProto actual;
+  actual.add_directives()->mutable_world_begin();
+  EXPECT_TRUE(Convert("Identity\nWorldEnd\n", 2, actual).ok());
+  EXPECT_THAT(actual, EqualsProto(R"pb(directives { world_begin {} }
+                                       directives { identity {} }
+                                       directives { world_end {} })pb"));
+}
+
+TEST(Convert, ParallelError) {
+  std::string input = MakeScene(1000) + "Shape \"sphere\" \"float radius\"\n";
+
+  PbrtProto expected;
+  absl::Status expected_status = Convert(input, expected);
+  ASSERT_FALSE(expected_status.ok());
+
+  PbrtProto actual;
+  EXPECT_EQ(Convert(input, 8, actual), expected_status);
+  EXPECT_EQ(actual.DebugString(), expected.DebugString());
+}
+
+TEST(Convert, ParallelWarnings) {
+  std::string input;
+  for (size_t i = 0; i < 8; i++) {
+    input += MakeScene(100) + "Shape \"sphere\" \"float unused" +
+             std::to_string(i) + "\" [ 1 ]\n";
+  }
+
+  PbrtProto expected;
+  testing::internal::CaptureStderr();
+  ASSERT_TRUE(Convert(input, expected).ok());
+  std::string expected_warnings = testing::internal::GetCapturedStderr();
+  ASSERT_THAT(expected_warnings, HasSubstr("'unused7'"));
+
+  PbrtProto actual;
+  testing::internal::CaptureStderr();
+  EXPECT_TRUE(Convert(input, 8, actual).ok());
+  EXPECT_EQ(testing::internal::GetCapturedStderr(), expected_warnings);
+}
 
-absl::Status Convert(absl::string_view input, PbrtProto& output) {
-  std::string as_string(input);
-  std::istringstream as_stream(as_string);
-  return Convert(as_stream, output);
+TEST(Convert, ParallelErrorWarnings) {
+  std::string input = "Shape \"sphere\" \"float unused\" [ 1 ]\n" +
+                      MakeScene(1000) + "Shape \"sphere\" \"float radius\"\n";
+
+  PbrtProto expected;
+  testing::internal::CaptureStderr();
+  absl::Status expected_status = Convert(input, expected);
+  std::string expected_warnings = testing::internal::GetCapturedStderr();
+  ASSERT_FALSE(expected_status.ok());
+  ASSERT_THAT(expected_warnings, HasSubstr("'unused'"));
+
+  PbrtProto actual;
+  testing::internal::CaptureStderr();
+  EXPECT_EQ(Convert(input, 8, actual), expected_status);
+  EXPECT_EQ(testing::internal::GetCapturedStderr(), expected_warnings);
+}
+
+TEST(Convert, ParallelFile) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_parallel_test.pbrt";
+  std::ofstream(path) << MakeScene(100);
+
+  absl::StatusOr<PbrtProto> expected = ConvertFile(path);
+  ASSERT_TRUE(expected.ok());
+
+  absl::StatusOr<PbrtProto> actual = ConvertFile(path, 4);
+  ASSERT_TRUE(actual.ok());
+  EXPECT_EQ(actual->DebugString(), expected->DebugString());
+}
+
+TEST(Convert, MissingFile) {
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_test_missing.pbrt";
+
+  PbrtProto actual;
+  EXPECT_THAT(ConvertFile(path, actual),
+              StatusIs(absl::StatusCode::kNotFound, testing::_));
+}
+
+TEST(Convert, Sink) {
+  std::string input = MakeScene(100);
+
+  PbrtProto expected;
+  ASSERT_TRUE(Convert(input, expected).ok());
+
+  PbrtProto actual;
+  auto sink = [&](Directive& directive) {
+    actual.add_directives()->Swap(&directive);
+    return absl::OkStatus();
+  };
+
+  std::istringstream stream(input);
+  EXPECT_TRUE(Convert(stream, sink).ok());
+  EXPECT_EQ(actual.DebugString(), expected.DebugString());
+
+  actual.Clear();
+  EXPECT_TRUE(Convert(input, sink).ok());
+  EXPECT_EQ(actual.DebugString(), expected.DebugString());
+
+  std::filesystem::path path =
+      std::filesystem::path(testing::TempDir()) / "convert_sink_test.pbrt";
+  std::ofstream(path) << input;
+
+  actual.Clear();
+  EXPECT_TRUE(ConvertFile(path, sink).ok());
+  EXPECT_EQ(actual.DebugString(), expected.DebugString());
+}
+
+TEST(Convert, SinkError) {
+  size_t num_directives = 0;
+  auto sink = [&](Directive& directive) {
+    if (++num_directives == 2) {
+      return absl::UnavailableError("Sink failed");
+    }
+    return absl::OkStatus();
+  };
+
+  EXPECT_THAT(Convert("WorldBegin Identity WorldEnd", sink),
+              StatusIs(absl::StatusCode::kUnavailable, "Sink failed"));
+  EXPECT_EQ(num_directives, 2u);
+}
+
+TEST(Convert, SinkParseError) {
+  PbrtProto actual;
+  auto sink = [&](Directive& directive) {
+    actual.add_directives()->Swap(&directive);
+    return absl::OkStatus();
+  };
+
+  EXPECT_THAT(Convert("WorldBegin Shape \"sphere\" \"float radius\"", sink),
+              StatusIs(absl::StatusCode::kInvalidArgument, testing::_));
+  EXPECT_THAT(actual, EqualsProto(R"pb(directives { world_begin {} })pb"));
 }
 
 TEST(Accelerator, Bvh) {
@@ -790,6 +1001,42 @@ TEST(Shape, TriangleMesh) {
               EqualsProto(R"pb(directives { shape { trianglemesh {} } })pb"));
 }
 
+TEST(Shape, TriangleMeshUnusedParameters) {
+  absl::string_view directive = R"pbrt(
+    Shape "trianglemesh"
+        "point P" [ 0 0 0 1 0 0 0 1 0 ]
+        "integer indices" [ 0 1 2 ]
+        "float uv" [ 0 0 1 0 0 1 ]
+        "float st" [ 1 1 0 1 1 0 ]
+        "float unknown" [ 1 2 3 ]
+  )pbrt";
+
+  PbrtProto actual;
+  testing::internal::CaptureStderr();
+  EXPECT_TRUE(Convert(directive, actual).ok());
+  std::string warnings = testing::internal::GetCapturedStderr();
+  EXPECT_THAT(warnings,
+              HasSubstr("WARNING: Unused Shape float parameter: 'st'"));
+  EXPECT_THAT(warnings,
+              HasSubstr("WARNING: Unused Shape float parameter: 'unknown'"));
+  EXPECT_THAT(warnings, Not(HasSubstr("'uv'")));
+  EXPECT_THAT(warnings, Not(HasSubstr("'P'")));
+  EXPECT_THAT(warnings, Not(HasSubstr("'indices'")));
+  EXPECT_THAT(actual, EqualsProto(R"pb(directives {
+                                         shape {
+                                           trianglemesh {
+                                             indices { v0: 0 v1: 1 v2: 2 }
+                                             P { x: 0 y: 0 z: 0 }
+                                             P { x: 1 y: 0 z: 0 }
+                                             P { x: 0 y: 1 z: 0 }
+                                             uv { u: 0 v: 0 }
+                                             uv { u: 1 v: 0 }
+                                             uv { u: 0 v: 1 }
+                                           }
+                                         }
+                                       })pb"));
+}
+
 TEST(Shape, Overrides) {
   absl::string_view directive = R"pbrt(
     Shape "sphere"
@@ -1,22 +1,48 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <limits>
+#include <map>
 #include <memory>
 #include <optional>
+#include <random>
 #include <streambuf>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
-#include "absl/container/flat_hash_set.h"
+#include "absl/base/thread_annotations.h"
+#include "absl/container/flat_hash_map.h"
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
+#include "absl/functional/function_ref.h"
 #include "absl/status/status.h"
-#include "google/protobuf/arena.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/match.h"
+#include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
+#include "google/protobuf/descriptor.h"
+#include "google/protobuf/io/coded_stream.h"
 #include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/message.h"
 #include "google/protobuf/text_format.h"
+#include "pbrt_proto/shared/directive_stream.h"
+#include "pbrt_proto/shared/geometry.h"
+#include "pbrt_proto/shared/mapped_file.h"
+#include "pbrt_proto/shared/parser.h"
+#include "pbrt_proto/shared/sha256.h"
+#include "pbrt_proto/shared/sidecar.h"
+#include "pbrt_proto/shared/trace.h"
 #include "pbrt_proto/v1/convert.h"
 #include "pbrt_proto/v1/v1.pb.h"
 #include "pbrt_proto/v2/convert.h"
@@ -24,6 +50,16 @@
 #include "pbrt_proto/v3/convert.h"
 #include "pbrt_proto/v3/v3.pb.h"
 
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+constexpr size_t kMaxProtoSize = std::numeric_limits<int32_t>::max() / 16;
+
 ABSL_FLAG(bool, recursive, false,
           "If true, recursively converts PBRT files that are included or "
           "imported and the files the directives will be updated to reference "
@@ -40,25 +76,103 @@ ABSL_FLAG(bool, write_progress, false,
 ABSL_FLAG(bool, textproto, false,
           "If true, output a text proto instead of a binary proto");
 
-ABSL_FLAG(std::optional<uint16_t>, pbrt_version, std::nullopt,
-          "The version of pbrt input specified.");
+ABSL_FLAG(bool, packed_geometry, false,
+          "If true, the geometry of trianglemesh, loopsubdiv, and curve shapes "
+          "and the samples of sampled spectra are written using the packed "
+          "fields (P_xyz, indices_flat, samples_flat, etc.), which are "
+          "smaller and faster to parse.");
 
-constexpr size_t kMaxProtoSize = std::numeric_limits<int32_t>::max() / 16;
+ABSL_FLAG(bool, single_precision, false,
+          "If true, implies --packed_geometry and additionally writes the "
+          "vertex data of trianglemesh, loopsubdiv, curve, and nurbs shapes "
+          "and the voxels of grid media as 32-bit floats (P_xyz_f32, "
+          "density_f32, etc.). Values are rounded to the nearest float and "
+          "finite values beyond the range of a float are clamped to the "
+          "largest float.");
 
-class ScopedArena {
- public:
-  ~ScopedArena() { arena_.Reset(); }
+ABSL_FLAG(bool, geometry_sidecar, false,
+          "If true, the vertex and index arrays of trianglemesh, loopsubdiv, "
+          "and curve shapes and the voxels of grid media are written to a "
+          "separate .geom file next to each output file and referenced from "
+          "the proto by offset (P_ref, density_ref, etc.) so that they can be "
+          "mapped into memory without parsing.");
 
-  template <typename T>
-  T* Allocate() {
-    return google::protobuf::Arena::Create<T>(&arena_);
-  }
+ABSL_FLAG(bool, compress_meshes, false,
+          "If true, the geometry of trianglemesh shapes is written using the "
+          "compressed encodings (indices_delta, P_quantized, N_octahedral, "
+          "etc.). Indices are stored exactly. Positions, normals, tangents, "
+          "and texture coordinates are quantized to the precision set by "
+          "--position_bits, --direction_bits, and --uv_bits, and the largest "
+          "error introduced is recorded in each mesh.");
 
-  void FreeAll() { arena_.Reset(); }
+ABSL_FLAG(uint32_t, position_bits, 16,
+          "The number of bits each position component is quantized to by "
+          "--compress_meshes, between 1 and 32.");
 
- private:
-  google::protobuf::Arena arena_;
-};
+ABSL_FLAG(uint32_t, direction_bits, 12,
+          "The number of bits each octahedral coordinate of a normal or "
+          "tangent is quantized to by --compress_meshes, between 2 and 32.");
+
+ABSL_FLAG(uint32_t, uv_bits, 16,
+          "The number of bits each texture coordinate is quantized to by "
+          "--compress_meshes, between 1 and 32.");
+
+ABSL_FLAG(uint32_t, jobs, 1,
+          "The number of files converted at once by --recursive or when "
+          "converting several scenes. Each file is converted once on "
+          "whichever thread is free.");
+
+ABSL_FLAG(std::string, manifest, "",
+          "If set, converts every scene listed in this file instead of a "
+          "single input. Each line holds the PBRT version of a scene followed "
+          "by its path, relative to the directory of the manifest. Blank "
+          "lines and lines starting with '#' are ignored. Files included by "
+          "more than one scene are converted once.");
+
+ABSL_FLAG(std::string, summary, "",
+          "If set, a JSON summary of each file converted is written to this "
+          "path, giving its result, any error, the number of bytes read and "
+          "written, and the time taken.");
+
+ABSL_FLAG(std::string, stats, "",
+          "If set, a report of where the time converting was spent is "
+          "written to this path as JSON, or printed to stdout if set to '-'. "
+          "It gives the throughput of parsing, the count, size, and parsing "
+          "time of each kind of directive, the largest directives, the peak "
+          "resident memory, and the time taken by each file.");
+
+ABSL_FLAG(std::string, trace_file, "",
+          "If set, a trace of the conversion is written to this path in the "
+          "Chrome trace event format, which can be viewed with Perfetto or "
+          "chrome://tracing. It holds a span on the thread that did it for "
+          "each file and for each step of converting it.");
+
+ABSL_FLAG(std::string, cache_dir, "",
+          "If set, the output of each converted file is stored in this "
+          "directory keyed by a hash of the file's contents, the PBRT version, "
+          "the flags that affect the output, and the converter binary. Files "
+          "that are unchanged since they were last converted are hard linked "
+          "or copied from it instead of being converted again. Input read "
+          "from stdin is always converted.");
+
+ABSL_FLAG(bool, shared_cache, false,
+          "If true, the directories and files created in --cache_dir can be "
+          "read and added to by every user of the machine so that a single "
+          "cache can be shared between them.");
+
+ABSL_FLAG(uint64_t, max_output_size, kMaxProtoSize,
+          "Outputs of at least this many bytes are split into child files. "
+          "It cannot be larger than its default, and is only lowered to test "
+          "how outputs are split.");
+
+ABSL_FLAG(std::optional<uint16_t>, pbrt_version, std::nullopt,
+          "The version of pbrt input specified.");
+
+// Passing this in place of the input file reads the input from stdin
+constexpr char kStdinArgument[] = "-";
+constexpr char kStdinPath[] = "stdin.pbrt";
+
+constexpr size_t kMaxQueuedBytes = 64 << 20;
 
 class NullOstream : public std::ostream, std::streambuf {
  public:
@@ -66,224 +180,2388 @@ class NullOstream : public std::ostream, std::streambuf {
   int overflow(int c) { return c; }
 };
 
-std::string FileExtension() {
+std::string FileExtension(uint16_t pbrt_version) {
   if (absl::GetFlag(FLAGS_textproto)) {
-    return "." + std::to_string(*absl::GetFlag(FLAGS_pbrt_version)) + ".txtpb";
+    return "." + std::to_string(pbrt_version) + ".txtpb";
   } else {
-    return "." + std::to_string(*absl::GetFlag(FLAGS_pbrt_version)) + ".binpb";
+    return "." + std::to_string(pbrt_version) + ".binpb";
   }
 }
 
+// Returns the path `output_path` is written to until its conversion succeeds,
+// which keeps a failed conversion from truncating or removing the output of an
+// earlier one
+std::filesystem::path TemporaryPath(std::filesystem::path output_path) {
+  output_path += ".tmp";
+  return output_path;
+}
+
+// Opens the temporary file of `output_path`
 std::unique_ptr<std::ostream> MakeOstream(
     const std::filesystem::path& output_path) {
   if (absl::GetFlag(FLAGS_validate_only)) {
     return std::make_unique<NullOstream>();
   }
 
-  return std::make_unique<std::ofstream>(output_path,
+  return std::make_unique<std::ofstream>(TemporaryPath(output_path),
                                          std::ios::binary | std::ios::out);
 }
 
+// Removes the temporary file of `output_path`, if there is one
+void RemoveTemporary(const std::filesystem::path& output_path) {
+  if (absl::GetFlag(FLAGS_validate_only)) {
+    return;
+  }
+
+  std::error_code error_code;
+  std::filesystem::remove(TemporaryPath(output_path), error_code);
+}
+
+// Moves each of `output_files` from its temporary file into place. Replacing
+// the output, rather than writing it in place, also keeps an output that is a
+// hard link to a file in `--cache_dir` from modifying the cache.
+absl::Status CommitOutputs(
+    const std::vector<std::filesystem::path>& output_files) {
+  if (absl::GetFlag(FLAGS_validate_only)) {
+    return absl::OkStatus();
+  }
+
+  for (const std::filesystem::path& output_file : output_files) {
+    std::error_code error_code;
+    std::filesystem::rename(TemporaryPath(output_file), output_file,
+                            error_code);
+    if (error_code) {
+      return absl::UnavailableError("Could not move output file into place " +
+                                    output_file.string());
+    }
+  }
+
+  return absl::OkStatus();
+}
+
+// Returns `path` without a trailing ".gz" or ".zst" extension
+std::filesystem::path WithoutCompressionExtension(std::filesystem::path path) {
+  if (path.extension() == ".gz" || path.extension() == ".zst") {
+    path.replace_extension();
+  }
+  return path;
+}
+
 std::string MakePath(std::filesystem::path partial_file_name,
-                     size_t child_index) {
+                     size_t child_index, uint16_t pbrt_version) {
   partial_file_name += ".";
   partial_file_name += std::to_string(child_index);
   partial_file_name += ".pbrt";
-  partial_file_name += FileExtension();
+  partial_file_name += FileExtension(pbrt_version);
   return partial_file_name.string();
 }
 
 template <typename T>
-void Serialize(std::filesystem::path output_path, size_t file_index,
-               const T& proto) {
-  std::string prefix;
-  if (file_index != 0) {
-    prefix = "." + std::to_string(file_index);
+using Directive = pbrt_proto::DirectiveOf<T>;
+
+// The version of PBRT converted to `T`
+template <typename T>
+constexpr uint16_t kPbrtVersion = 0;
+template <>
+constexpr uint16_t kPbrtVersion<pbrt_proto::v1::PbrtProto> = 1;
+template <>
+constexpr uint16_t kPbrtVersion<pbrt_proto::v2::PbrtProto> = 2;
+template <>
+constexpr uint16_t kPbrtVersion<pbrt_proto::v3::PbrtProto> = 3;
+
+template <typename T>
+using DirectiveSink = absl::FunctionRef<absl::Status(Directive<T>&)>;
+
+template <typename Shape>
+void PackShapeGeometry(Shape& shape) {
+  if (absl::GetFlag(FLAGS_single_precision)) {
+    pbrt_proto::PackGeometryFloat32(shape);
+  } else {
+    pbrt_proto::PackGeometry(shape);
   }
+}
 
-  output_path.replace_extension(prefix + ".pbrt" + FileExtension());
+// Packs the samples of every sampled spectrum within `message`. Only singular
+// fields are searched since no repeated field of a directive holds a spectrum.
+void PackSpectra(google::protobuf::Message& message) {
+  const google::protobuf::Reflection* reflection = message.GetReflection();
+  std::vector<const google::protobuf::FieldDescriptor*> fields;
+  reflection->ListFields(message, &fields);
+  for (const google::protobuf::FieldDescriptor* field : fields) {
+    if (field->is_repeated() ||
+        field->cpp_type() !=
+            google::protobuf::FieldDescriptor::CPPTYPE_MESSAGE) {
+      continue;
+    }
 
-  std::unique_ptr<std::ostream> output = MakeOstream(output_path);
-  if (!*output) {
-    std::cerr << "ERROR: Could not open output file " << output_path
-              << std::endl;
-    exit(EXIT_FAILURE);
+    google::protobuf::Message& child =
+        *reflection->MutableMessage(&message, field);
+    if (child.GetDescriptor() == pbrt_proto::SampledSpectrum::descriptor()) {
+      pbrt_proto::PackSamples(static_cast<pbrt_proto::SampledSpectrum&>(child));
+    } else {
+      PackSpectra(child);
+    }
   }
+}
+
+template <typename T>
+void PackGeometry(Directive<T>& directive) {
+  PackSpectra(directive);
 
-  if (absl::GetFlag(FLAGS_write_progress)) {
-    std::cout << "Writing to output: " << output_path.string() << std::endl;
+  bool single_precision = absl::GetFlag(FLAGS_single_precision);
+  if (directive.has_shape()) {
+    auto& shape = *directive.mutable_shape();
+    if (shape.has_trianglemesh()) {
+      PackShapeGeometry(*shape.mutable_trianglemesh());
+    } else if (shape.has_loopsubdiv()) {
+      PackShapeGeometry(*shape.mutable_loopsubdiv());
+    } else if (shape.has_nurbs() && single_precision) {
+      pbrt_proto::PackGeometryFloat32(*shape.mutable_nurbs());
+    }
+
+    if constexpr (std::is_same_v<T, pbrt_proto::v3::PbrtProto>) {
+      if (shape.has_curve()) {
+        PackShapeGeometry(*shape.mutable_curve());
+      }
+    }
   }
 
-  if (absl::GetFlag(FLAGS_textproto)) {
-    google::protobuf::io::OstreamOutputStream zero_copy_output(output.get());
-    if (!google::protobuf::TextFormat::Print(proto, &zero_copy_output)) {
-      std::cerr << "ERROR: Could not serialize proto to output" << std::endl;
-      exit(EXIT_FAILURE);
+  if (!single_precision) {
+    return;
+  }
+
+  if constexpr (std::is_same_v<T, pbrt_proto::v3::PbrtProto>) {
+    if (directive.has_make_named_medium() &&
+        directive.make_named_medium().has_heterogeneous()) {
+      pbrt_proto::PackGridFloat32(
+          *directive.mutable_make_named_medium()->mutable_heterogeneous());
     }
   } else {
-    if (!proto.SerializeToOstream(output.get())) {
-      std::cerr << "ERROR: Could not serialize proto to output" << std::endl;
-      exit(EXIT_FAILURE);
+    if (directive.has_volume() && directive.volume().has_volumegrid()) {
+      pbrt_proto::PackGridFloat32(
+          *directive.mutable_volume()->mutable_volumegrid());
     }
   }
 }
 
-template <typename T, absl::Status (*Convert)(std::istream&, T&)>
-void ConvertFile(const std::filesystem::path& search_root,
-                 const std::filesystem::path& file,
-                 const std::filesystem::path& partial_file_name,
-                 std::vector<std::pair<std::filesystem::path, std::string>>&
-                     included_files) {
-  std::ifstream input(file.c_str(), std::ios_base::in | std::ios_base::binary);
-  if (!input) {
-    std::cerr << "ERROR: Could not open file: " << file << std::endl;
-    exit(EXIT_FAILURE);
+// Compresses the meshes of a file and tracks the largest error introduced
+class MeshCompressor {
+ public:
+  MeshCompressor() {
+    options_.position_bits = absl::GetFlag(FLAGS_position_bits);
+    options_.direction_bits = absl::GetFlag(FLAGS_direction_bits);
+    options_.uv_bits = absl::GetFlag(FLAGS_uv_bits);
+  }
+
+  template <typename T>
+  void Compress(Directive<T>& directive) {
+    if (!directive.has_shape() || !directive.shape().has_trianglemesh()) {
+      return;
+    }
+
+    auto& mesh = *directive.mutable_shape()->mutable_trianglemesh();
+    pbrt_proto::CompressGeometry(mesh, options_);
+
+    position_error_ =
+        std::max(position_error_, mesh.p_quantized().max_error());
+    direction_error_ =
+        std::max({direction_error_, mesh.n_octahedral().max_error(),
+                  mesh.s_octahedral().max_error()});
+    uv_error_ = std::max(uv_error_, mesh.uv_quantized().max_error());
   }
 
-  ScopedArena parent_arena;
-  T* to_output = parent_arena.Allocate<T>();
-  if (absl::Status error = Convert(input, *to_output); !error.ok()) {
-    std::cerr << "ERROR: " << error.message() << std::endl;
-    exit(EXIT_FAILURE);
+  void Finish() const {
+    if (absl::GetFlag(FLAGS_write_progress)) {
+      std::cout << "Largest mesh compression error: position "
+                << position_error_ << ", direction " << direction_error_
+                << " radians, uv " << uv_error_ << std::endl;
+    }
   }
 
-  for (auto& directive : *to_output->mutable_directives()) {
-    if (!directive.has_include() || !absl::GetFlag(FLAGS_recursive)) {
-      continue;
+ private:
+  pbrt_proto::MeshCompressionOptions options_;
+  double position_error_ = 0.0;
+  double direction_error_ = 0.0;
+  double uv_error_ = 0.0;
+};
+
+// Moves the geometry of each directive of a file into its sidecar
+class GeometrySidecar {
+ public:
+  GeometrySidecar(const std::filesystem::path& output_file,
+                  uint16_t pbrt_version)
+      : output_path_(SidecarPath(output_file, pbrt_version)),
+        output_(MakeOstream(output_path_)),
+        writer_(*output_, output_path_.filename().string()) {}
+
+  // Removes the sidecar unless it was committed
+  ~GeometrySidecar() {
+    output_.reset();
+    RemoveTemporary(output_path_);
+  }
+
+  // Returns an error if the sidecar could not be opened
+  absl::Status status() const {
+    if (!*output_) {
+      return absl::UnavailableError("Could not open output file " +
+                                    output_path_.string());
     }
+    return absl::OkStatus();
+  }
 
-    std::filesystem::path included_path(directive.include().path());
-    if (included_path.extension() != ".pbrt") {
-      std::cerr << "ERROR: Included files must be pbrt files" << std::endl;
-      exit(EXIT_FAILURE);
+  template <typename T>
+  absl::Status Move(Directive<T>& directive) {
+    if (directive.has_shape()) {
+      auto& shape = *directive.mutable_shape();
+      if (shape.has_trianglemesh()) {
+        return pbrt_proto::MoveToSidecar(*shape.mutable_trianglemesh(),
+                                         writer_);
+      } else if (shape.has_loopsubdiv()) {
+        return pbrt_proto::MoveToSidecar(*shape.mutable_loopsubdiv(), writer_);
+      }
+
+      if constexpr (std::is_same_v<T, pbrt_proto::v3::PbrtProto>) {
+        if (shape.has_curve()) {
+          return pbrt_proto::MoveToSidecar(*shape.mutable_curve(), writer_);
+        }
+      }
     }
 
-    if (included_path.is_relative()) {
-      included_path = search_root / included_path;
+    if constexpr (std::is_same_v<T, pbrt_proto::v3::PbrtProto>) {
+      if (directive.has_make_named_medium() &&
+          directive.make_named_medium().has_heterogeneous()) {
+        return pbrt_proto::MoveToSidecar(
+            *directive.mutable_make_named_medium()->mutable_heterogeneous(),
+            writer_);
+      }
+    } else {
+      if (directive.has_volume() && directive.volume().has_volumegrid()) {
+        return pbrt_proto::MoveToSidecar(
+            *directive.mutable_volume()->mutable_volumegrid(), writer_);
+      }
     }
 
-    included_files.emplace_back(included_path,
-                                directive.include().path().substr(
-                                    0, directive.include().path().size() - 5));
-    *directive.mutable_include()->mutable_path() += FileExtension();
+    return absl::OkStatus();
   }
 
-  if (to_output->ByteSizeLong() < kMaxProtoSize) {
-    Serialize(file, 0, *to_output);
-    return;
+  // Adds the path of the sidecar to `output_files` if one was written. It is
+  // left in its temporary file until committed with `CommitOutputs`.
+  absl::Status Finish(std::vector<std::filesystem::path>& output_files) {
+    if (absl::Status status = writer_.Finish(); !status.ok()) {
+      return status;
+    }
+
+    output_.reset();
+
+    // Scenes without any geometry to move do not get a sidecar
+    if (writer_.empty()) {
+      RemoveTemporary(output_path_);
+      return absl::OkStatus();
+    }
+
+    output_files.push_back(output_path_);
+
+    if (absl::GetFlag(FLAGS_write_progress)) {
+      std::cout << "Wrote geometry to: " << output_path_.string()
+                << std::endl;
+    }
+
+    return absl::OkStatus();
   }
 
-  ScopedArena child_arena;
-  T* child = child_arena.Allocate<T>();
+ private:
+  static std::filesystem::path SidecarPath(std::filesystem::path output_file,
+                                           uint16_t pbrt_version) {
+    return output_file.replace_extension(
+        ".pbrt." + std::to_string(pbrt_version) + ".geom");
+  }
+
+  std::filesystem::path output_path_;
+  std::unique_ptr<std::ostream> output_;
+  pbrt_proto::SidecarWriter writer_;
+};
+
+// The number, output size, and parsing time of one kind of directive
+struct DirectiveStats {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+  double seconds = 0.0;
+};
+
+// A directive of a file's output, identified by its field number in the
+// `Directive` message of the file's PBRT version
+struct LargeDirective {
+  int field_number;
+  size_t bytes;
+};
 
-  T parent;
-  size_t current_size = 0;
-  size_t child_index = 1;
-  for (const auto& directive : to_output->directives()) {
-    if (current_size + directive.ByteSizeLong() > kMaxProtoSize &&
-        current_size != 0) {
-      parent.add_directives()->mutable_include()->set_path(
-          MakePath(partial_file_name, child_index));
-      Serialize(file, child_index++, *child);
+// Where the time converting a file went, reported by `--stats`. Parsing covers
+// tokenizing the input and reading and converting each directive, and is also
+// counted for each kind of directive read, keyed by its field number. Time
+// spent waiting for the output to catch up is counted as `wait_seconds`.
+struct ConversionStats {
+  static constexpr size_t kNumLargest = 10;
 
-      child_arena.FreeAll();
-      child = child_arena.Allocate<T>();
-      current_size = 0;
+  pbrt_proto::ParseStats input;
+  absl::flat_hash_map<int, DirectiveStats> directives;
+  std::vector<LargeDirective> largest;  // Largest first
+  double parse_seconds = 0.0;
+  double pack_seconds = 0.0;
+  double compress_seconds = 0.0;
+  double sidecar_seconds = 0.0;
+  double size_seconds = 0.0;
+  double split_seconds = 0.0;
+  double wait_seconds = 0.0;
+  double serialize_seconds = 0.0;
+
+  // Counts a directive of `bytes` written to the output
+  void AddOutput(int field_number, size_t bytes) {
+    directives[field_number].bytes += bytes;
+
+    if (largest.size() == kNumLargest && largest.back().bytes >= bytes) {
+      return;
     }
 
-    current_size += directive.ByteSizeLong();
-    *child->add_directives() = directive;
+    auto position =
+        std::find_if(largest.begin(), largest.end(),
+                     [&](const LargeDirective& other) {
+                       return other.bytes < bytes;
+                     });
+    largest.insert(position, LargeDirective{field_number, bytes});
+    if (largest.size() > kNumLargest) {
+      largest.pop_back();
+    }
   }
 
-  parent.add_directives()->mutable_include()->set_path(
-      MakePath(partial_file_name, child_index));
-  Serialize(file, child_index, *child);
+  // The time spent on every phase of writing a directive that follows parsing
+  double WriteSeconds() const {
+    return pack_seconds + compress_seconds + sidecar_seconds + size_seconds +
+           wait_seconds;
+  }
+};
 
-  Serialize(file, 0, parent);
-}
+// Adds the time from its construction to its destruction to a phase of
+// `stats`, or does nothing if `stats` is null
+class PhaseTimer {
+ public:
+  PhaseTimer(ConversionStats* stats, double ConversionStats::* phase)
+      : seconds_(stats ? &(stats->*phase) : nullptr) {
+    if (seconds_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
 
-void ConvertFile(const std::filesystem::path& search_root,
-                 const std::filesystem::path& file,
-                 const std::filesystem::path& partial_file_name,
-                 std::vector<std::pair<std::filesystem::path, std::string>>&
-                     included_files) {
-  switch (*absl::GetFlag(FLAGS_pbrt_version)) {
-    case 1:
-      ConvertFile<pbrt_proto::v1::PbrtProto, pbrt_proto::v1::Convert>(
-          search_root, file, partial_file_name, included_files);
-      break;
-    case 2:
-      ConvertFile<pbrt_proto::v2::PbrtProto, pbrt_proto::v2::Convert>(
-          search_root, file, partial_file_name, included_files);
-      break;
-    case 3:
-      ConvertFile<pbrt_proto::v3::PbrtProto, pbrt_proto::v3::Convert>(
-          search_root, file, partial_file_name, included_files);
-      break;
+  ~PhaseTimer() {
+    if (seconds_) {
+      *seconds_ += std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start_)
+                       .count();
+    }
   }
-}
 
-int main(int argc, char** argv) {
-  auto unparsed = absl::ParseCommandLine(argc, argv);
-  if (2 != unparsed.size()) {
-    std::cerr << "ERROR: Missing input file argument " << std::endl;
-    return EXIT_FAILURE;
+ private:
+  double* seconds_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+// Writes the directives of a file to its output as they are converted. Once
+// the output would exceed `max_size` the directives written so far become the
+// first child file, each later child is started whenever the current one would
+// exceed it, and the output is replaced with a parent file that includes the
+// children in order. Outputs of at least `max_size` bytes are always split,
+// even if they fit in a single child.
+//
+// Directives are serialized and written on a separate thread, so that this
+// overlaps converting the directives that follow them. Directives waiting to be
+// written are limited to `kMaxQueuedBytes` in total, or to a single batch if it
+// is larger than that.
+template <typename T>
+class DirectiveOutput {
+ public:
+  // If `stats` is not null, the time spent writing and the size of each
+  // directive written are added to it
+  DirectiveOutput(const std::filesystem::path& output_file,
+                  const std::filesystem::path& partial_file_name,
+                  size_t max_size, ConversionStats* stats)
+      : output_file_(output_file),
+        partial_file_name_(partial_file_name),
+        max_size_(max_size),
+        stats_(stats) {}
+
+  // Stops writing if `Finish` was not called, and removes any of the output
+  // that was not committed
+  ~DirectiveOutput() {
+    if (writer_thread_.joinable()) {
+      {
+        absl::MutexLock lock(&mutex_);
+        status_ = absl::CancelledError("Output was abandoned");
+        finished_ = true;
+      }
+
+      writer_thread_.join();
+    }
+
+    Close();
+    for (size_t file_index = 0; file_index <= num_children_; file_index++) {
+      RemoveTemporary(OutputPath(file_index));
+    }
   }
 
-  if (!absl::GetFlag(FLAGS_pbrt_version).has_value()) {
-    std::cerr << "ERROR: PBRT version was not specified" << std::endl;
-    return EXIT_FAILURE;
+  // Must be called before any directives are written
+  absl::Status Start() {
+    if (absl::Status status = Open(0); !status.ok()) {
+      return status;
+    }
+
+    writer_thread_ = std::thread([this]() { WriteQueued(); });
+
+    return absl::OkStatus();
   }
 
-  if (*absl::GetFlag(FLAGS_pbrt_version) != 1 &&
-      *absl::GetFlag(FLAGS_pbrt_version) != 2 &&
-      *absl::GetFlag(FLAGS_pbrt_version) != 3) {
-    std::cerr << "ERROR: PBRT version was not recognized" << std::endl;
-    return EXIT_FAILURE;
+  // Takes the contents of `directive`, leaving it empty
+  absl::Status Write(Directive<T>& directive) {
+    Directive<T>& batched = *batch_.directives.add_directives();
+    batched.Swap(&directive);
+
+    // Computed once here; the sizes this caches are reused for serialization
+    size_t size;
+    {
+      PhaseTimer timer(stats_, &ConversionStats::size_seconds);
+      size = batched.ByteSizeLong();
+    }
+    batch_.sizes.push_back(size);
+    batch_.size += size;
+
+    if (stats_) {
+      stats_->AddOutput(static_cast<int>(batched.directive_type_case()), size);
+    }
+
+    if (batch_.size >= kBatchBytes) {
+      PhaseTimer timer(stats_, &ConversionStats::wait_seconds);
+      return Flush();
+    }
+
+    return absl::OkStatus();
   }
 
-  std::filesystem::path input_path(unparsed[1]);
-  if (input_path.extension() != ".pbrt") {
-    std::cerr << "ERROR: Input file was not a pbrt file" << std::endl;
-    return EXIT_FAILURE;
+  // Adds the path of each file written to `output_files`. They are left in
+  // their temporary files until committed with `CommitOutputs`.
+  absl::Status Finish(std::vector<std::filesystem::path>& output_files) {
+    if (absl::Status status = Flush(); !status.ok()) {
+      return status;
+    }
+
+    {
+      absl::MutexLock lock(&mutex_);
+      finished_ = true;
+    }
+
+    writer_thread_.join();
+
+    if (stats_) {
+      stats_->serialize_seconds += serialize_seconds_;
+    }
+
+    {
+      absl::MutexLock lock(&mutex_);
+      if (!status_.ok()) {
+        return status_;
+      }
+    }
+
+    if (absl::Status status = WriteParent(); !status.ok()) {
+      return status;
+    }
+
+    for (size_t file_index = 0; file_index <= num_children_; file_index++) {
+      output_files.push_back(OutputPath(file_index));
+    }
+
+    return absl::OkStatus();
   }
 
-  std::error_code error_code;
-  std::filesystem::path canonical_input_path =
-      std::filesystem::canonical(input_path, error_code);
-  if (error_code) {
-    std::cerr << "ERROR: Could not resolve input file to a canonical path"
-              << std::endl;
-    return EXIT_FAILURE;
+ private:
+  // Directives are passed to `writer_thread_` in batches, which keeps the cost
+  // of waking it small relative to the work it is given
+  static constexpr size_t kBatchBytes = 1 << 20;
+
+  struct Batch {
+    T directives;
+    std::vector<size_t> sizes;
+    size_t size = 0;
+  };
+
+  absl::Status Flush() {
+    if (batch_.sizes.empty()) {
+      return absl::OkStatus();
+    }
+
+    absl::MutexLock lock(&mutex_);
+    auto has_room = [&]() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+      return !status_.ok() || queued_size_ == 0 ||
+             queued_size_ + batch_.size <= kMaxQueuedBytes;
+    };
+    mutex_.Await(absl::Condition(&has_room));
+
+    if (!status_.ok()) {
+      return status_;
+    }
+
+    queued_size_ += batch_.size;
+    queue_.push_back(std::move(batch_));
+    batch_ = Batch();
+
+    return absl::OkStatus();
+  }
+
+  bool HasQueued() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return !queue_.empty() || finished_;
+  }
+
+  // Runs on `writer_thread_` until `Finish` is called and every queued
+  // directive is written, or until a directive cannot be written
+  void WriteQueued() {
+    for (;;) {
+      Batch batch;
+      {
+        absl::MutexLock lock(&mutex_);
+        mutex_.Await(absl::Condition(this, &DirectiveOutput::HasQueued));
+        if (queue_.empty() || !status_.ok()) {
+          return;
+        }
+
+        batch = std::move(queue_.front());
+        queue_.pop_front();
+      }
+
+      pbrt_proto::TraceScope trace("serialize");
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < batch.sizes.size(); i++) {
+        if (absl::Status status = WriteDirective(
+                *batch.directives.mutable_directives(static_cast<int>(i)),
+                batch.sizes[i]);
+            !status.ok()) {
+          absl::MutexLock lock(&mutex_);
+          status_ = status;
+          return;
+        }
+      }
+      serialize_seconds_ += std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - start)
+                                .count();
+
+      absl::MutexLock lock(&mutex_);
+      queued_size_ -= batch.size;
+    }
+  }
+
+  // `size` must be the value last returned by `directive.ByteSizeLong()`
+  absl::Status WriteDirective(Directive<T>& directive, size_t size) {
+    if (current_size_ + size > max_size_ && current_size_ != 0) {
+      Close();
+
+      if (num_children_ == 0) {
+        if (absl::Status status = Rename(0, 1); !status.ok()) {
+          return status;
+        }
+        num_children_ = 1;
+      }
+
+      if (absl::Status status = Open(++num_children_); !status.ok()) {
+        return status;
+      }
+    }
+
+    current_size_ += size;
+    output_size_ +=
+        google::protobuf::io::CodedOutputStream::VarintSize32(
+            pbrt_proto::kDirectiveTag<T>) +
+        google::protobuf::io::CodedOutputStream::VarintSize64(size) + size;
+
+    return Serialize(directive, size);
+  }
+
+  // Writes `directive` to the open file, whatever its size
+  absl::Status Serialize(Directive<T>& directive, size_t size) {
+    if (absl::GetFlag(FLAGS_textproto)) {
+      // Printing each directive on its own produces the same text as printing
+      // the whole proto at once
+      single_directive_.mutable_directives()->Clear();
+      single_directive_.add_directives()->Swap(&directive);
+      if (!google::protobuf::TextFormat::Print(single_directive_,
+                                               &*zero_copy_output_)) {
+        return absl::InternalError("Could not serialize proto to output");
+      }
+    } else if (!writer_->WriteWithCachedSize(directive, size).ok()) {
+      return absl::InternalError("Could not serialize proto to output");
+    }
+
+    return absl::OkStatus();
+  }
+
+  absl::Status WriteParent() {
+    Close();
+
+    // The directives are split by their sizes alone, but whether to split at
+    // all also counts the tag and length written before each of them
+    if (num_children_ == 0 && output_size_ >= max_size_) {
+      if (absl::Status status = Rename(0, 1); !status.ok()) {
+        return status;
+      }
+      num_children_ = 1;
+    }
+
+    if (num_children_ == 0) {
+      return absl::OkStatus();
+    }
+
+    if (absl::Status status = Open(0); !status.ok()) {
+      return status;
+    }
+
+    for (size_t child_index = 1; child_index <= num_children_;
+         child_index++) {
+      Directive<T> directive;
+      directive.mutable_include()->set_path(
+          MakePath(partial_file_name_, child_index, kPbrtVersion<T>));
+      // The parent is never split, however many children it includes
+      if (absl::Status status = Serialize(directive, directive.ByteSizeLong());
+          !status.ok()) {
+        return status;
+      }
+    }
+
+    Close();
+
+    return absl::OkStatus();
+  }
+
+  std::filesystem::path OutputPath(size_t file_index) const {
+    std::string prefix;
+    if (file_index != 0) {
+      prefix = "." + std::to_string(file_index);
+    }
+
+    return std::filesystem::path(output_file_)
+        .replace_extension(prefix + ".pbrt" + FileExtension(kPbrtVersion<T>));
+  }
+
+  absl::Status Open(size_t file_index) {
+    std::filesystem::path output_path = OutputPath(file_index);
+    output_ = MakeOstream(output_path);
+    if (!*output_) {
+      return absl::UnavailableError("Could not open output file " +
+                                    output_path.string());
+    }
+
+    zero_copy_output_.emplace(output_.get());
+    if (!absl::GetFlag(FLAGS_textproto)) {
+      writer_.emplace(&*zero_copy_output_);
+    }
+    current_size_ = 0;
+
+    if (absl::GetFlag(FLAGS_write_progress)) {
+      std::cout << "Writing to output: " << output_path.string() << std::endl;
+    }
+
+    return absl::OkStatus();
   }
 
-  std::vector<std::pair<std::filesystem::path, std::string>> included_files;
-  ConvertFile(input_path.parent_path(), input_path, input_path.stem(),
-              included_files);
+  void Close() {
+    writer_.reset();
+    zero_copy_output_.reset();
+    output_.reset();
+  }
 
-  absl::flat_hash_set<std::filesystem::path> parsed_files;
-  parsed_files.insert(canonical_input_path);
+  absl::Status Rename(size_t from_index, size_t to_index) {
+    if (absl::GetFlag(FLAGS_validate_only)) {
+      return absl::OkStatus();
+    }
 
-  while (!included_files.empty()) {
-    auto [next_file, next_partial_file_name] = included_files.back();
-    included_files.pop_back();
+    std::filesystem::path from = OutputPath(from_index);
+    std::filesystem::path to = OutputPath(to_index);
 
-    std::filesystem::path canonical_next_file =
-        std::filesystem::canonical(next_file, error_code);
+    std::error_code error_code;
+    std::filesystem::rename(TemporaryPath(from), TemporaryPath(to),
+                            error_code);
     if (error_code) {
-      std::cerr << "ERROR: Could not resolve included file to a canonical path"
-                << std::endl;
-      return EXIT_FAILURE;
+      return absl::UnavailableError("Could not rename output file " +
+                                    from.string() + " to " + to.string());
     }
 
-    if (parsed_files.contains(canonical_next_file)) {
-      continue;
+    if (absl::GetFlag(FLAGS_write_progress)) {
+      std::cout << "Moved output to: " << to.string() << std::endl;
+    }
+
+    return absl::OkStatus();
+  }
+
+  std::filesystem::path output_file_;
+  std::filesystem::path partial_file_name_;
+  size_t max_size_;
+
+  // Only used by the thread calling `Write`
+  ConversionStats* stats_;
+  Batch batch_;
+
+  absl::Mutex mutex_;
+  std::deque<Batch> queue_ ABSL_GUARDED_BY(mutex_);
+  size_t queued_size_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool finished_ ABSL_GUARDED_BY(mutex_) = false;
+  absl::Status status_ ABSL_GUARDED_BY(mutex_);
+  std::thread writer_thread_;
+
+  // Only used by `writer_thread_` while it runs
+  std::unique_ptr<std::ostream> output_;
+  std::optional<google::protobuf::io::OstreamOutputStream> zero_copy_output_;
+  std::optional<pbrt_proto::DirectiveWriter<T>> writer_;
+  T single_directive_;
+  size_t current_size_ = 0;
+
+  // The size of every directive written along with its tag and length, which is
+  // the size of the output if it is not split
+  size_t output_size_ = 0;
+  size_t num_children_ = 0;
+  double serialize_seconds_ = 0.0;
+};
+
+// A file waiting to be converted
+struct PendingFile {
+  std::filesystem::path file;
+
+  // The name its output is included by
+  std::string partial_file_name;
+
+  // The directory the paths it includes are relative to
+  std::filesystem::path search_root;
+
+  uint16_t pbrt_version;
+
+  // Whether its output was claimed when it was added, which keeps it from being
+  // converted from some other path first
+  bool claimed = false;
+};
+
+// Returns the name the output of an included file is included by
+std::string PartialIncludeName(const std::filesystem::path& include_path) {
+  return WithoutCompressionExtension(include_path).replace_extension().string();
+}
+
+// Returns the file at `include_path`, the path given by an `Include` directive
+// of a file converted from PBRT `pbrt_version`
+PendingFile ResolveInclude(const std::filesystem::path& search_root,
+                           const std::string& include_path,
+                           uint16_t pbrt_version) {
+  std::filesystem::path included_path(include_path);
+  if (included_path.is_relative()) {
+    included_path = search_root / included_path;
+  }
+
+  PendingFile pending;
+  pending.file = included_path;
+  pending.partial_file_name = PartialIncludeName(include_path);
+  pending.search_root = search_root;
+  pending.pbrt_version = pbrt_version;
+  return pending;
+}
+
+// Returns the scene at `file`, whose includes are resolved from its directory
+PendingFile ResolveScene(const std::filesystem::path& file,
+                         uint16_t pbrt_version) {
+  PendingFile pending;
+  pending.file = file;
+  pending.partial_file_name = WithoutCompressionExtension(file).stem().string();
+  pending.search_root = file.parent_path();
+  pending.pbrt_version = pbrt_version;
+  return pending;
+}
+
+// Adds the path `directive` includes to `include_paths` and replaces it with
+// the path of its output
+template <typename T>
+absl::Status RewriteInclude(Directive<T>& directive,
+                            std::vector<std::string>& include_paths) {
+  std::filesystem::path included_path(directive.include().path());
+  if (WithoutCompressionExtension(included_path).extension() != ".pbrt") {
+    return absl::InvalidArgumentError("Included files must be pbrt files");
+  }
+
+  include_paths.push_back(directive.include().path());
+  directive.mutable_include()->set_path(PartialIncludeName(included_path) +
+                                        ".pbrt" +
+                                        FileExtension(kPbrtVersion<T>));
+
+  return absl::OkStatus();
+}
+
+// Returns false if a mesh is certain to be far smaller than `kMaxProtoSize`,
+// which can be determined without the cost of computing its size
+bool MayExceedMaxProtoSize(const pbrt_proto::TriangleMeshShape& mesh) {
+  // No point, vector, texture coordinate, triangle, or face index takes more
+  // than this many bytes to serialize
+  constexpr size_t kMaxElementSize = 32;
+
+  size_t num_elements = static_cast<size_t>(mesh.p_size()) + mesh.n_size() +
+                        mesh.s_size() + mesh.uv_size() + mesh.indices_size() +
+                        mesh.faceindices_size();
+  return num_elements > kMaxProtoSize / 2 / kMaxElementSize;
+}
+
+// Replaces a mesh too large to be written to a single file with a run of
+// shape directives that each hold a part of it. Meshes that cannot be split are
+// written as they are.
+template <typename T>
+absl::Status SplitMesh(Directive<T>& directive,
+                       absl::FunctionRef<absl::Status(Directive<T>&)> output) {
+  pbrt_proto::TraceScope trace("split");
+  pbrt_proto::TriangleMeshShape mesh;
+  mesh.Swap(directive.mutable_shape()->mutable_trianglemesh());
+
+  // Leaves room for the rest of the directive, which each part copies, and for
+  // the length of the mesh, which grows from one byte to at most five
+  size_t max_size = kMaxProtoSize - directive.ByteSizeLong() - 4;
+
+  // Parts that follow an error are dropped
+  absl::Status status;
+  bool split = pbrt_proto::SplitGeometry(
+      mesh, max_size, [&](pbrt_proto::TriangleMeshShape& part) {
+        if (!status.ok()) {
+          return;
+        }
+
+        Directive<T> part_directive = directive;
+        part_directive.mutable_shape()->mutable_trianglemesh()->Swap(&part);
+        status = output(part_directive);
+      });
+
+  if (!split) {
+    mesh.Swap(directive.mutable_shape()->mutable_trianglemesh());
+    return output(directive);
+  }
+
+  if (status.ok() && absl::GetFlag(FLAGS_write_progress)) {
+    std::cout << "Split a trianglemesh shape of " << mesh.indices_size()
+              << " triangles" << std::endl;
+  }
+
+  return status;
+}
+
+// Each directive is split, packed, compressed, moved to the sidecar, and
+// written to the output as soon as it is converted, so memory use is bounded by
+// the largest directive of the input rather than by its total size. The paths
+// of the files included by `file` are added to `include_paths`, and the files
+// written to `output_files`. If the conversion fails, nothing is written and
+// any earlier output is left as it was. If `stats` is not null, the time spent
+// on each phase of the conversion is added to it.
+template <typename T,
+          absl::Status (*ConvertStream)(std::istream&, DirectiveSink<T>,
+                                        pbrt_proto::ParseStats*),
+          absl::Status (*Convert)(const std::filesystem::path&,
+                                  DirectiveSink<T>, pbrt_proto::ParseStats*)>
+absl::Status ConvertFile(const std::filesystem::path& file,
+                         const std::filesystem::path& partial_file_name,
+                         std::istream* input,
+                         std::vector<std::string>& include_paths,
+                         std::vector<std::filesystem::path>& output_files,
+                         ConversionStats* stats) {
+  pbrt_proto::TraceScope trace("convert", file);
+
+  bool pack_geometry = absl::GetFlag(FLAGS_packed_geometry) ||
+                       absl::GetFlag(FLAGS_single_precision);
+  bool recursive = absl::GetFlag(FLAGS_recursive);
+
+  // Output is named after the uncompressed input
+  std::filesystem::path output_file = WithoutCompressionExtension(file);
+
+  std::optional<MeshCompressor> compressor;
+  if (absl::GetFlag(FLAGS_compress_meshes)) {
+    compressor.emplace();
+  }
+
+  std::optional<GeometrySidecar> sidecar;
+  if (absl::GetFlag(FLAGS_geometry_sidecar)) {
+    sidecar.emplace(output_file, kPbrtVersion<T>);
+    if (absl::Status status = sidecar->status(); !status.ok()) {
+      return status;
+    }
+  }
+
+  DirectiveOutput<T> output(output_file, partial_file_name,
+                            absl::GetFlag(FLAGS_max_output_size), stats);
+  if (absl::Status status = output.Start(); !status.ok()) {
+    return status;
+  }
+
+  auto write = [&](Directive<T>& directive) -> absl::Status {
+    if (pack_geometry) {
+      PhaseTimer timer(stats, &ConversionStats::pack_seconds);
+      PackGeometry<T>(directive);
+    }
+
+    if (compressor) {
+      PhaseTimer timer(stats, &ConversionStats::compress_seconds);
+      compressor->Compress<T>(directive);
+    }
+
+    if (sidecar) {
+      PhaseTimer timer(stats, &ConversionStats::sidecar_seconds);
+      if (absl::Status status = sidecar->Move<T>(directive); !status.ok()) {
+        return status;
+      }
+    }
+
+    if (recursive && directive.has_include()) {
+      if (absl::Status status = RewriteInclude<T>(directive, include_paths);
+          !status.ok()) {
+        return status;
+      }
+    }
+
+    return output.Write(directive);
+  };
+
+  auto split = [&](Directive<T>& directive) {
+    if (directive.has_shape() && directive.shape().has_trianglemesh() &&
+        MayExceedMaxProtoSize(directive.shape().trianglemesh()) &&
+        directive.ByteSizeLong() > kMaxProtoSize) {
+      return SplitMesh<T>(directive, write);
+    }
+
+    return write(directive);
+  };
+
+  // Parsing is timed from the return of one directive to the arrival of the
+  // next, and splitting as the time left once the parts have been written
+  auto parsed = std::chrono::steady_clock::now();
+  auto timed_sink = [&](Directive<T>& directive) {
+    auto start = std::chrono::steady_clock::now();
+    double parse_seconds =
+        std::chrono::duration<double>(start - parsed).count();
+    DirectiveStats& directive_stats =
+        stats->directives[static_cast<int>(directive.directive_type_case())];
+    directive_stats.count += 1;
+    directive_stats.seconds += parse_seconds;
+    stats->parse_seconds += parse_seconds;
+
+    double write_seconds = stats->WriteSeconds();
+    absl::Status status = split(directive);
+    parsed = std::chrono::steady_clock::now();
+    stats->split_seconds +=
+        std::chrono::duration<double>(parsed - start).count() -
+        (stats->WriteSeconds() - write_seconds);
+
+    return status;
+  };
+
+  DirectiveSink<T> sink = stats ? DirectiveSink<T>(timed_sink)
+                                : DirectiveSink<T>(split);
+  pbrt_proto::ParseStats* parse_stats = stats ? &stats->input : nullptr;
+  absl::Status status = input ? ConvertStream(*input, sink, parse_stats)
+                              : Convert(file, sink, parse_stats);
+  if (stats) {
+    stats->parse_seconds += std::chrono::duration<double>(
+                                std::chrono::steady_clock::now() - parsed)
+                                .count();
+  }
+
+  if (!status.ok()) {
+    return status;
+  }
+
+  pbrt_proto::TraceScope finish_trace("finish");
+
+  if (compressor) {
+    compressor->Finish();
+  }
+
+  // Nothing replaces the previous output until every file has been written
+  std::vector<std::filesystem::path> written_files;
+  if (sidecar) {
+    if (absl::Status status = sidecar->Finish(written_files); !status.ok()) {
+      return status;
+    }
+  }
+
+  if (absl::Status status = output.Finish(written_files); !status.ok()) {
+    return status;
+  }
+
+  if (absl::Status status = CommitOutputs(written_files); !status.ok()) {
+    return status;
+  }
+
+  output_files.insert(output_files.end(), written_files.begin(),
+                      written_files.end());
+
+  return absl::OkStatus();
+}
+
+// Returns the path of the running converter binary, or an empty path where it
+// cannot be found
+std::filesystem::path ExecutablePath() {
+#if defined(_WIN32)
+  wchar_t* path = nullptr;
+  if (_get_wpgmptr(&path) != 0 || path == nullptr) {
+    return {};
+  }
+
+  return path;
+#elif defined(__APPLE__)
+  uint32_t size = 0;
+  _NSGetExecutablePath(nullptr, &size);
+  std::string path(size, '\0');
+  if (_NSGetExecutablePath(path.data(), &size) != 0) {
+    return {};
+  }
+
+  path.resize(std::strlen(path.c_str()));
+  return path;
+#else
+  std::error_code error_code;
+  std::filesystem::path path =
+      std::filesystem::read_symlink("/proc/self/exe", error_code);
+  if (error_code) {
+    return {};
+  }
+
+  return path;
+#endif
+}
+
+// Returns the SHA-256 digest of the converter binary, which keeps outputs in
+// `--cache_dir` from being reused by a build that may convert differently
+absl::StatusOr<std::string> ConverterDigest() {
+  std::filesystem::path binary = ExecutablePath();
+  if (binary.empty()) {
+    return absl::NotFoundError("Could not find the converter binary");
+  }
+
+  absl::StatusOr<pbrt_proto::MappedFile> contents =
+      pbrt_proto::MappedFile::Open(binary);
+  if (!contents.ok()) {
+    return absl::NotFoundError("Could not read the converter binary " +
+                               binary.string());
+  }
+
+  pbrt_proto::Sha256 sha256;
+  sha256.Update(contents->contents());
+  return sha256.Finish();
+}
+
+// Stores the output of converted files in `--cache_dir`. Each entry is a
+// directory named after a digest of everything that affects the output of a
+// file, holding a copy of each file written and a manifest listing them and
+// the paths the file includes. Entries are completed in a temporary directory
+// and renamed into place, so they are never seen partially written by other
+// threads or processes.
+class ConversionCache {
+ public:
+  ConversionCache(const std::filesystem::path& directory,
+                  const std::string& converter_digest, bool shared)
+      : directory_(directory),
+        converter_digest_(converter_digest),
+        shared_(shared) {}
+
+  // Creates the cache directory if it does not exist
+  absl::Status Open() const {
+    std::error_code error_code;
+    CreateDirectory(directory_);
+    if (!std::filesystem::is_directory(directory_, error_code)) {
+      return absl::UnavailableError("Could not create cache directory " +
+                                    directory_.string());
+    }
+
+    return absl::OkStatus();
+  }
+
+  // Returns the key of the output of `file` converted from PBRT `pbrt_version`
+  // with the current flags
+  absl::StatusOr<std::string> Key(
+      const std::filesystem::path& file,
+      const std::filesystem::path& partial_file_name,
+      uint16_t pbrt_version) const {
+    pbrt_proto::TraceScope trace("hash", file);
+    absl::StatusOr<pbrt_proto::MappedFile> contents =
+        pbrt_proto::MappedFile::Open(file);
+    if (!contents.ok()) {
+      return contents.status();
+    }
+
+    // The names of the output and its children are written to the output
+    std::string fields[] = {
+        converter_digest_,
+        FileExtension(pbrt_version),
+        WithoutCompressionExtension(file).filename().string(),
+        partial_file_name.string(),
+        std::to_string(absl::GetFlag(FLAGS_recursive)),
+        std::to_string(absl::GetFlag(FLAGS_packed_geometry)),
+        std::to_string(absl::GetFlag(FLAGS_single_precision)),
+        std::to_string(absl::GetFlag(FLAGS_geometry_sidecar)),
+        std::to_string(absl::GetFlag(FLAGS_compress_meshes)),
+        std::to_string(absl::GetFlag(FLAGS_position_bits)),
+        std::to_string(absl::GetFlag(FLAGS_direction_bits)),
+        std::to_string(absl::GetFlag(FLAGS_uv_bits)),
+        std::to_string(absl::GetFlag(FLAGS_max_output_size)),
+    };
+
+    // Each field is prefixed by its length so that no two sets of fields hash
+    // the same bytes
+    pbrt_proto::Sha256 sha256;
+    for (const std::string& field : fields) {
+      sha256.Update(std::to_string(field.size()) + ":");
+      sha256.Update(field);
+    }
+    sha256.Update(contents->contents());
+
+    return sha256.Finish();
+  }
+
+  // If the cache holds the output for `key`, places it next to `output_file`,
+  // adds the files placed to `output_files`, and returns the paths included by
+  // the file it was converted from.
+  std::optional<std::vector<std::string>> Restore(
+      const std::string& key, const std::filesystem::path& output_file,
+      std::vector<std::filesystem::path>& output_files) const {
+    pbrt_proto::TraceScope trace("restore", output_file);
+    std::filesystem::path entry = EntryPath(key);
+
+    std::ifstream manifest(entry / kManifestName);
+    if (!manifest) {
+      return std::nullopt;
+    }
+
+    // A manifest that does not end with `kEndLine` was truncated
+    std::vector<std::string> output_names;
+    std::vector<std::string> include_paths;
+    bool ended = false;
+    for (std::string line; std::getline(manifest, line);) {
+      if (ended) {
+        return std::nullopt;
+      } else if (line == kEndLine) {
+        ended = true;
+      } else if (absl::StartsWith(line, kOutputPrefix)) {
+        output_names.push_back(line.substr(std::strlen(kOutputPrefix)));
+      } else if (absl::StartsWith(line, kIncludePrefix)) {
+        include_paths.push_back(line.substr(std::strlen(kIncludePrefix)));
+      } else {
+        return std::nullopt;
+      }
+    }
+
+    if (!ended) {
+      return std::nullopt;
+    }
+
+    // Outputs are only ever placed next to `output_file`, and nothing is placed
+    // unless every one of them can be
+    for (const std::string& output_name : output_names) {
+      if (!IsPlainFileName(output_name)) {
+        return std::nullopt;
+      }
+    }
+
+    for (const std::string& output_name : output_names) {
+      std::filesystem::path output_path =
+          output_file.parent_path() / output_name;
+      if (!LinkOrCopy(entry / output_name, output_path)) {
+        return std::nullopt;
+      }
+      output_files.push_back(output_path);
+
+      if (absl::GetFlag(FLAGS_write_progress)) {
+        std::cout << "Reused cached output: " << output_path.string()
+                  << std::endl;
+      }
+    }
+
+    return include_paths;
+  }
+
+  // Adds the files written for `key` to the cache
+  absl::Status Store(const std::string& key,
+                     const std::vector<std::filesystem::path>& output_files,
+                     const std::vector<std::string>& include_paths) const {
+    pbrt_proto::TraceScope trace("store", key);
+    std::filesystem::path entry = EntryPath(key);
+
+    std::error_code error_code;
+    if (std::filesystem::exists(entry, error_code)) {
+      return absl::OkStatus();
+    }
+
+    CreateDirectory(entry.parent_path());
+
+    std::random_device random;
+    std::filesystem::path temporary = entry;
+    temporary += ".tmp" + std::to_string(random()) + std::to_string(random());
+    if (!std::filesystem::create_directory(temporary, error_code)) {
+      return absl::UnavailableError("Could not create cache directory " +
+                                    temporary.string());
+    }
+
+    absl::Status status = Fill(temporary, output_files, include_paths);
+    if (status.ok()) {
+      // Fails if another thread or process stored the same entry first
+      std::filesystem::rename(temporary, entry, error_code);
+    }
+
+    std::filesystem::remove_all(temporary, error_code);
+
+    return status;
+  }
+
+ private:
+  static constexpr char kManifestName[] = "manifest";
+  static constexpr char kOutputPrefix[] = "output ";
+  static constexpr char kIncludePrefix[] = "include ";
+  static constexpr char kEndLine[] = "end";
+
+  // Returns true if `name` names a file without naming any directory
+  static bool IsPlainFileName(const std::string& name) {
+    std::filesystem::path path(name);
+    return !name.empty() && name != "." && name != ".." &&
+           path.filename() == path;
+  }
+
+  std::filesystem::path EntryPath(const std::string& key) const {
+    return directory_ / key.substr(0, 2) / key;
+  }
+
+  // Shared directories are writable by everyone but, like /tmp, only allow
+  // the owner of an entry to remove it
+  void CreateDirectory(const std::filesystem::path& path) const {
+    std::error_code error_code;
+    if (std::filesystem::create_directories(path, error_code) && shared_) {
+      std::filesystem::permissions(
+          path,
+          std::filesystem::perms::all | std::filesystem::perms::sticky_bit,
+          error_code);
+    }
+  }
+
+  absl::Status Fill(const std::filesystem::path& temporary,
+                    const std::vector<std::filesystem::path>& output_files,
+                    const std::vector<std::string>& include_paths) const {
+    std::string manifest;
+    for (const std::filesystem::path& output_file : output_files) {
+      std::error_code error_code;
+      std::filesystem::path cached_file = temporary / output_file.filename();
+      if (!std::filesystem::copy_file(output_file, cached_file, error_code)) {
+        return absl::UnavailableError("Could not copy output file " +
+                                      output_file.string() + " to cache");
+      }
+      MakeReadOnly(cached_file);
+
+      manifest += kOutputPrefix + output_file.filename().string() + "\n";
+    }
+
+    for (const std::string& include_path : include_paths) {
+      if (include_path.find('\n') != std::string::npos) {
+        return absl::InvalidArgumentError(
+            "Could not cache a file including a path containing a newline");
+      }
+
+      manifest += kIncludePrefix + include_path + "\n";
+    }
+    manifest += kEndLine;
+    manifest += "\n";
+
+    std::filesystem::path manifest_path = temporary / kManifestName;
+    if (!(std::ofstream(manifest_path, std::ios::binary) << manifest)) {
+      return absl::UnavailableError("Could not write cache manifest " +
+                                    manifest_path.string());
+    }
+    MakeReadOnly(manifest_path);
+
+    if (shared_) {
+      std::error_code error_code;
+      std::filesystem::permissions(
+          temporary,
+          std::filesystem::perms::owner_all |
+              std::filesystem::perms::group_read |
+              std::filesystem::perms::group_exec |
+              std::filesystem::perms::others_read |
+              std::filesystem::perms::others_exec,
+          error_code);
+    }
+
+    return absl::OkStatus();
+  }
+
+  // Cached files are never modified, including through the hard links to them
+  // made by `Restore`
+  void MakeReadOnly(const std::filesystem::path& path) const {
+    std::filesystem::perms perms = std::filesystem::perms::owner_read;
+    if (shared_) {
+      perms |= std::filesystem::perms::group_read |
+               std::filesystem::perms::others_read;
+    }
+
+    std::error_code error_code;
+    std::filesystem::permissions(path, perms, error_code);
+  }
+
+  // Hard links are used where possible, which is not the case across file
+  // systems or, on some systems, for files in a shared cache owned by others
+  static bool LinkOrCopy(const std::filesystem::path& from,
+                         const std::filesystem::path& to) {
+    std::error_code error_code;
+    std::filesystem::remove(to, error_code);
+    std::filesystem::create_hard_link(from, to, error_code);
+    if (!error_code) {
+      return true;
+    }
+
+    return std::filesystem::copy_file(from, to, error_code);
+  }
+
+  std::filesystem::path directory_;
+  std::string converter_digest_;
+  bool shared_;
+};
+
+// What became of a file, reported by `--summary`
+struct FileSummary {
+  // The canonical path of the input, if it exists
+  std::filesystem::path input;
+
+  // The canonical path of the output, if the input exists
+  std::filesystem::path output;
+
+  uint16_t pbrt_version;
+  absl::Status status;
+  bool cached = false;
+  uintmax_t bytes_in = 0;
+  uintmax_t bytes_out = 0;
+  double seconds = 0.0;
+
+  // Only filled in for files converted with `--stats`
+  ConversionStats stats;
+};
+
+// Returns the size of `path`, or zero if it cannot be determined
+uintmax_t FileSize(const std::filesystem::path& path) {
+  std::error_code error_code;
+  uintmax_t size = std::filesystem::file_size(path, error_code);
+  return error_code ? 0 : size;
+}
+
+// Converts `file`, or reuses its output from `cache` if not null, and adds the
+// paths it includes to `include_paths`. If `input` is not null, it is read
+// instead of `file` and the cache is not used. Nor is the cache used for files
+// such as pipes, which hashing them for its key would consume.
+absl::Status ConvertFile(const PendingFile& file, std::istream* input,
+                         const ConversionCache* cache,
+                         std::vector<std::string>& include_paths,
+                         FileSummary& summary) {
+  std::optional<std::string> key;
+  std::vector<std::filesystem::path> output_files;
+  if (cache != nullptr && input == nullptr &&
+      !pbrt_proto::IsUnmappable(file.file)) {
+    absl::StatusOr<std::string> file_key =
+        cache->Key(file.file, file.partial_file_name, file.pbrt_version);
+    if (!file_key.ok()) {
+      return file_key.status();
+    }
+
+    if (std::optional<std::vector<std::string>> cached_include_paths =
+            cache->Restore(*file_key, WithoutCompressionExtension(file.file),
+                           output_files)) {
+      summary.cached = true;
+      include_paths = *std::move(cached_include_paths);
+    } else {
+      key = *std::move(file_key);
+      output_files.clear();
+    }
+  }
+
+  if (!summary.cached) {
+    ConversionStats* stats =
+        absl::GetFlag(FLAGS_stats).empty() ? nullptr : &summary.stats;
+
+    absl::Status status;
+    switch (file.pbrt_version) {
+      case 1:
+        status =
+            ConvertFile<pbrt_proto::v1::PbrtProto, pbrt_proto::v1::Convert,
+                        pbrt_proto::v1::ConvertFile>(
+                file.file, file.partial_file_name, input, include_paths,
+                output_files, stats);
+        break;
+      case 2:
+        status =
+            ConvertFile<pbrt_proto::v2::PbrtProto, pbrt_proto::v2::Convert,
+                        pbrt_proto::v2::ConvertFile>(
+                file.file, file.partial_file_name, input, include_paths,
+                output_files, stats);
+        break;
+      case 3:
+        status =
+            ConvertFile<pbrt_proto::v3::PbrtProto, pbrt_proto::v3::Convert,
+                        pbrt_proto::v3::ConvertFile>(
+                file.file, file.partial_file_name, input, include_paths,
+                output_files, stats);
+        break;
+      default:
+        status = absl::InvalidArgumentError("PBRT version was not recognized");
+        break;
+    }
+
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  // The output is complete whether or not it can be cached
+  if (key) {
+    if (absl::Status cached = cache->Store(*key, output_files, include_paths);
+        !cached.ok()) {
+      std::cerr << "WARNING: " << cached.message() << std::endl;
+    }
+  }
+
+  for (const std::filesystem::path& output_file : output_files) {
+    summary.bytes_out += FileSize(output_file);
+  }
+
+  return absl::OkStatus();
+}
+
+// Returns the canonical path of the output written for `file` when converted
+// from PBRT `pbrt_version`, or nothing if `file` does not exist. Files are
+// deduplicated by this rather than by their own canonical path since the output
+// for each path a file is included by must exist.
+std::optional<std::filesystem::path> CanonicalOutputPath(
+    const std::filesystem::path& file, uint16_t pbrt_version) {
+  std::error_code error_code;
+  if (!std::filesystem::exists(file, error_code)) {
+    return std::nullopt;
+  }
+
+  std::filesystem::path directory = std::filesystem::canonical(
+      std::filesystem::absolute(file).parent_path(), error_code);
+  if (error_code) {
+    return std::nullopt;
+  }
+
+  return directory /
+         WithoutCompressionExtension(file).filename().replace_extension(
+             ".pbrt" + FileExtension(pbrt_version));
+}
+
+// Returns the canonical path of `search_root`, the directory the includes of a
+// file are resolved from
+std::filesystem::path CanonicalSearchRoot(
+    const std::filesystem::path& search_root) {
+  std::error_code error_code;
+  std::filesystem::path absolute =
+      std::filesystem::absolute(search_root, error_code);
+  std::filesystem::path canonical =
+      std::filesystem::weakly_canonical(absolute, error_code);
+  return error_code ? absolute.lexically_normal() : canonical;
+}
+
+// Returns the path of the output written for a scene read from a stream as if
+// it were `file`, which need not exist
+std::filesystem::path StreamOutputPath(const std::filesystem::path& file,
+                                       uint16_t pbrt_version) {
+  std::filesystem::path output_path = std::filesystem::absolute(
+      WithoutCompressionExtension(file).replace_extension(
+          ".pbrt" + FileExtension(pbrt_version)));
+
+  std::error_code error_code;
+  std::filesystem::path canonical =
+      std::filesystem::weakly_canonical(output_path, error_code);
+  return error_code ? output_path : canonical;
+}
+
+// Converts scenes, and the files they include in turn, on a pool of threads
+// that each take the most recently discovered file waiting to be converted.
+// Each output is written at most once no matter how many times it is included
+// or by how many scenes. Since the paths a file includes are resolved from the
+// directory of the scene it was reached from, those paths are resolved again
+// from each other directory it is reached from. Every file reachable through
+// files that converted successfully is converted even if others fail, so the
+// set of files converted and the summary of each do not depend on how the work
+// was scheduled.
+class ConversionPool {
+ public:
+  explicit ConversionPool(const ConversionCache* cache) : cache_(cache) {}
+
+  // Adds a scene to convert, unless its output was already claimed by another.
+  // Scenes claim their output immediately so that a scene that is also
+  // included by another is always converted as a scene.
+  void AddScene(const std::filesystem::path& file, uint16_t pbrt_version) {
+    std::optional<std::filesystem::path> output_path =
+        CanonicalOutputPath(file, pbrt_version);
+    PendingFile scene = ResolveScene(file, pbrt_version);
+    scene.claimed = true;
+    std::filesystem::path search_root = CanonicalSearchRoot(scene.search_root);
+
+    FileSummary summary;
+    summary.input = file;
+    summary.pbrt_version = pbrt_version;
+
+    absl::MutexLock lock(&mutex_);
+    if (!output_path) {
+      summary.status = absl::NotFoundError(
+          "Could not resolve input file to a canonical path");
+      summaries_.push_back(std::move(summary));
+      return;
+    }
+
+    absl::StatusOr<bool> claimed =
+        Claim(*output_path, scene, search_root, /*stream=*/false);
+    if (!claimed.ok()) {
+      summary.output = *output_path;
+      summary.status = claimed.status();
+      summaries_.push_back(std::move(summary));
+      return;
+    }
+
+    if (*claimed) {
+      pending_.push_back(std::move(scene));
+    }
+  }
+
+  // Converts a scene read from `input` as if it were `file`, then adds the
+  // files it includes. No other file may write the same output.
+  void ConvertStream(const std::filesystem::path& file, uint16_t pbrt_version,
+                     std::istream& input) {
+    Convert(ResolveScene(file, pbrt_version), &input);
+  }
+
+  // Converts every file added and the files they include using `num_threads`
+  // threads, including the calling thread. Returns the summary of each file
+  // converted or that failed, ordered by path and then by error, so that their
+  // order does not depend on how the work was scheduled.
+  std::vector<FileSummary> Run(uint32_t num_threads) {
+    std::vector<std::thread> threads;
+    for (uint32_t i = 1; i < num_threads; i++) {
+      threads.emplace_back([this]() { ConvertPending(); });
+    }
+
+    ConvertPending();
+
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+
+    absl::MutexLock lock(&mutex_);
+    std::sort(summaries_.begin(), summaries_.end(),
+              [](const FileSummary& a, const FileSummary& b) {
+                if (std::tie(a.output, a.input) !=
+                    std::tie(b.output, b.input)) {
+                  return std::tie(a.output, a.input) <
+                         std::tie(b.output, b.input);
+                }
+                return a.status.message() < b.status.message();
+              });
+    return std::move(summaries_);
+  }
+
+ private:
+  // A claimed output, which is written by the first file to claim it
+  struct OutputClaim {
+    // The directories the paths its file includes are resolved from, keyed by
+    // their canonical paths
+    absl::flat_hash_map<std::filesystem::path, std::filesystem::path>
+        search_roots;
+
+    // The paths its file includes, once it has converted successfully
+    std::optional<std::vector<std::string>> include_paths;
+
+    // Whether it is written for a stream
+    bool stream = false;
+  };
+
+  // Claims `output_path` for `file`, whose includes are resolved from the
+  // canonical directory `search_root`. Returns true if `file` is to be
+  // converted, or false if the output was already claimed, in which case the
+  // paths it includes are also resolved from `search_root` if they were not
+  // already. It is an error for the output of a stream to be claimed twice.
+  absl::StatusOr<bool> Claim(const std::filesystem::path& output_path,
+                             const PendingFile& file,
+                             const std::filesystem::path& search_root,
+                             bool stream)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    auto [entry, inserted] = converted_outputs_.try_emplace(output_path);
+    OutputClaim& claim = entry->second;
+    if (inserted) {
+      claim.search_roots.emplace(search_root, file.search_root);
+      claim.stream = stream;
+      return true;
+    }
+
+    if (stream || claim.stream) {
+      return absl::AlreadyExistsError("Output " + output_path.string() +
+                                      " would be written for both a stream "
+                                      "and another file");
+    }
+
+    if (!claim.search_roots.emplace(search_root, file.search_root).second) {
+      return false;
+    }
+
+    if (claim.include_paths) {
+      for (const std::string& include_path : *claim.include_paths) {
+        pending_.push_back(ResolveInclude(file.search_root, include_path,
+                                          file.pbrt_version));
+      }
+    }
+
+    return false;
+  }
+
+  // There is nothing left to do once no file is waiting and none is being
+  // converted, since only files being converted can add more
+  bool HasWork() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return !pending_.empty() || num_converting_ == 0;
+  }
+
+  void ConvertPending() {
+    for (;;) {
+      PendingFile next;
+      {
+        absl::MutexLock lock(&mutex_);
+        mutex_.Await(absl::Condition(this, &ConversionPool::HasWork));
+        if (pending_.empty()) {
+          return;
+        }
+
+        next = std::move(pending_.back());
+        pending_.pop_back();
+        num_converting_ += 1;
+      }
+
+      Convert(next, /*input=*/nullptr);
+
+      absl::MutexLock lock(&mutex_);
+      num_converting_ -= 1;
+    }
+  }
+
+  // Converts `file` unless its output has already been claimed by another
+  void Convert(const PendingFile& file, std::istream* input) {
+    FileSummary summary;
+    summary.input = file.file;
+    summary.pbrt_version = file.pbrt_version;
+
+    std::optional<std::filesystem::path> output_path =
+        input ? StreamOutputPath(file.file, file.pbrt_version)
+              : CanonicalOutputPath(file.file, file.pbrt_version);
+    if (!output_path) {
+      summary.status = absl::NotFoundError(
+          "Could not resolve included file to a canonical path");
+      absl::MutexLock lock(&mutex_);
+      summaries_.push_back(std::move(summary));
+      return;
+    }
+
+    summary.output = *output_path;
+    if (!input) {
+      std::error_code error_code;
+      summary.input = std::filesystem::canonical(file.file, error_code);
+      summary.bytes_in = FileSize(file.file);
+    }
+
+    if (!file.claimed) {
+      std::filesystem::path search_root = CanonicalSearchRoot(file.search_root);
+
+      absl::MutexLock lock(&mutex_);
+      absl::StatusOr<bool> claimed = Claim(*output_path, file, search_root,
+                                           /*stream=*/input != nullptr);
+      if (!claimed.ok()) {
+        summary.status = claimed.status();
+        summaries_.push_back(std::move(summary));
+        return;
+      }
+
+      if (!*claimed) {
+        return;
+      }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::string> include_paths;
+    {
+      pbrt_proto::TraceScope trace("file", file.file);
+      summary.status = ConvertFile(file, input, cache_, include_paths, summary);
+    }
+    summary.seconds = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+
+    absl::MutexLock lock(&mutex_);
+
+    // Files included by a file that failed are not converted
+    if (summary.status.ok()) {
+      OutputClaim& claim = converted_outputs_[*output_path];
+      for (const auto& [_, search_root] : claim.search_roots) {
+        for (const std::string& include_path : include_paths) {
+          pending_.push_back(
+              ResolveInclude(search_root, include_path, file.pbrt_version));
+        }
+      }
+      claim.include_paths = std::move(include_paths);
+    }
+
+    summaries_.push_back(std::move(summary));
+  }
+
+  const ConversionCache* cache_;
+
+  absl::Mutex mutex_;
+  std::vector<PendingFile> pending_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::filesystem::path, OutputClaim> converted_outputs_
+      ABSL_GUARDED_BY(mutex_);
+  size_t num_converting_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::vector<FileSummary> summaries_ ABSL_GUARDED_BY(mutex_);
+};
+
+// A scene given on the command line or listed in a manifest
+struct Scene {
+  std::filesystem::path file;
+  uint16_t pbrt_version;
+};
+
+// Returns the scenes listed in the manifest at `path`
+absl::StatusOr<std::vector<Scene>> ReadManifest(
+    const std::filesystem::path& path) {
+  std::ifstream manifest(path);
+  if (!manifest) {
+    return absl::NotFoundError("Could not open manifest " + path.string());
+  }
+
+  std::vector<Scene> scenes;
+  size_t line_number = 0;
+  for (std::string line; std::getline(manifest, line);) {
+    line_number += 1;
+
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#') {
+      continue;
+    }
+
+    size_t version_end = line.find_first_of(" \t", start);
+    size_t path_start = version_end == std::string::npos
+                            ? std::string::npos
+                            : line.find_first_not_of(" \t", version_end);
+    size_t path_end = line.find_last_not_of(" \t\r");
+    std::string version = line.substr(start, version_end - start);
+    if (path_start == std::string::npos ||
+        (version != "1" && version != "2" && version != "3")) {
+      return absl::InvalidArgumentError(
+          "Line " + std::to_string(line_number) + " of manifest " +
+          path.string() + " was not a PBRT version followed by a path");
+    }
+
+    std::filesystem::path file =
+        line.substr(path_start, path_end + 1 - path_start);
+    if (file.is_relative()) {
+      file = path.parent_path() / file;
+    }
+
+    scenes.push_back(Scene{file, static_cast<uint16_t>(version[0] - '0')});
+  }
+
+  return scenes;
+}
+
+// Returns every pbrt file in the tree under `directory` in order of path
+std::vector<Scene> FindScenes(const std::filesystem::path& directory,
+                              uint16_t pbrt_version) {
+  std::vector<Scene> scenes;
+  std::error_code error_code;
+  for (const std::filesystem::directory_entry& entry :
+       std::filesystem::recursive_directory_iterator(directory, error_code)) {
+    if (entry.is_regular_file(error_code) &&
+        WithoutCompressionExtension(entry.path()).extension() == ".pbrt") {
+      scenes.push_back(Scene{entry.path(), pbrt_version});
+    }
+  }
+
+  std::sort(scenes.begin(), scenes.end(), [](const Scene& a, const Scene& b) {
+    return a.file < b.file;
+  });
+
+  return scenes;
+}
+
+std::string JsonString(absl::string_view value) {
+  std::string result = "\"";
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      static constexpr char kHexDigits[] = "0123456789abcdef";
+      result += "\\u00";
+      result += kHexDigits[c >> 4];
+      result += kHexDigits[c & 0xF];
+    } else {
+      result += c;
+    }
+  }
+  result += '"';
+  return result;
+}
+
+// Writes `summaries` to `path` as a JSON object whose "files" array holds an
+// object for each file
+absl::Status WriteSummary(const std::filesystem::path& path,
+                          const std::vector<FileSummary>& summaries) {
+  std::ofstream output(path, std::ios::binary | std::ios::out);
+
+  output << "{\n  \"files\": [";
+  for (size_t i = 0; i < summaries.size(); i++) {
+    const FileSummary& summary = summaries[i];
+
+    const char* result = "converted";
+    if (!summary.status.ok()) {
+      result = "failed";
+    } else if (summary.cached) {
+      result = "cached";
+    }
+
+    output << (i == 0 ? "\n" : ",\n") << "    {\"input\": "
+           << JsonString(summary.input.string())
+           << ", \"output\": " << JsonString(summary.output.string())
+           << ", \"pbrt_version\": " << summary.pbrt_version
+           << ", \"result\": \"" << result << "\"";
+    if (!summary.status.ok()) {
+      output << ", \"error\": " << JsonString(summary.status.message());
+    }
+    output << ", \"bytes_in\": " << summary.bytes_in
+           << ", \"bytes_out\": " << summary.bytes_out
+           << ", \"seconds\": " << summary.seconds << "}";
+  }
+  output << (summaries.empty() ? "]\n}\n" : "\n  ]\n}\n");
+
+  if (!output) {
+    return absl::UnavailableError("Could not write summary " + path.string());
+  }
+
+  return absl::OkStatus();
+}
+
+// Returns the name of the directive with `field_number` in the `Directive`
+// message of PBRT `pbrt_version`
+std::string DirectiveName(uint16_t pbrt_version, int field_number) {
+  const google::protobuf::Descriptor* descriptor = nullptr;
+  switch (pbrt_version) {
+    case 1:
+      descriptor = Directive<pbrt_proto::v1::PbrtProto>::descriptor();
+      break;
+    case 2:
+      descriptor = Directive<pbrt_proto::v2::PbrtProto>::descriptor();
+      break;
+    case 3:
+      descriptor = Directive<pbrt_proto::v3::PbrtProto>::descriptor();
+      break;
+  }
+
+  const google::protobuf::FieldDescriptor* field =
+      descriptor ? descriptor->FindFieldByNumber(field_number) : nullptr;
+  return field ? std::string(field->name()) : "unknown";
+}
+
+// Returns the most memory the process has had resident so far in bytes, or
+// zero where this is not known
+uint64_t PeakResidentBytes() {
+#ifdef _WIN32
+  return 0;
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// The stats of every file converted, combined for `--stats`
+struct StatsReport {
+  struct Largest {
+    std::filesystem::path input;
+    std::string type;
+    size_t bytes;
+  };
+
+  double seconds = 0.0;
+  uint64_t peak_resident_bytes = 0;
+  size_t num_converted = 0;
+  size_t num_cached = 0;
+
+  // Sums of the input and phases of each file
+  ConversionStats totals;
+
+  std::map<std::string, DirectiveStats> directives;
+  std::vector<Largest> largest;  // Largest first
+
+  // The phases of conversion in the order each directive passes through them
+  std::vector<std::pair<const char*, double>> Phases() const {
+    return {{"parse", totals.parse_seconds},
+            {"split", totals.split_seconds},
+            {"pack", totals.pack_seconds},
+            {"compress", totals.compress_seconds},
+            {"sidecar", totals.sidecar_seconds},
+            {"size", totals.size_seconds},
+            {"wait", totals.wait_seconds},
+            {"serialize", totals.serialize_seconds}};
+  }
+
+  // The rate at which input was parsed by each thread
+  double BytesPerSecond() const { return PerParseSecond(totals.input.bytes); }
+  double TokensPerSecond() const {
+    return PerParseSecond(totals.input.tokens);
+  }
+
+  double PerParseSecond(uint64_t count) const {
+    return totals.parse_seconds > 0.0
+               ? static_cast<double>(count) / totals.parse_seconds
+               : 0.0;
+  }
+};
+
+// Combines the stats of `summaries`, which took `seconds` to convert
+StatsReport MakeStatsReport(const std::vector<FileSummary>& summaries,
+                            double seconds) {
+  StatsReport report;
+  report.seconds = seconds;
+  report.peak_resident_bytes = PeakResidentBytes();
+
+  for (const FileSummary& summary : summaries) {
+    if (summary.cached) {
+      report.num_cached += 1;
+    } else if (summary.status.ok()) {
+      report.num_converted += 1;
+    }
+
+    const ConversionStats& stats = summary.stats;
+    report.totals.input.bytes += stats.input.bytes;
+    report.totals.input.tokens += stats.input.tokens;
+    report.totals.parse_seconds += stats.parse_seconds;
+    report.totals.pack_seconds += stats.pack_seconds;
+    report.totals.compress_seconds += stats.compress_seconds;
+    report.totals.sidecar_seconds += stats.sidecar_seconds;
+    report.totals.size_seconds += stats.size_seconds;
+    report.totals.split_seconds += stats.split_seconds;
+    report.totals.wait_seconds += stats.wait_seconds;
+    report.totals.serialize_seconds += stats.serialize_seconds;
+
+    for (const auto& [field_number, directive_stats] : stats.directives) {
+      DirectiveStats& total = report.directives[DirectiveName(
+          summary.pbrt_version, field_number)];
+      total.count += directive_stats.count;
+      total.bytes += directive_stats.bytes;
+      total.seconds += directive_stats.seconds;
+    }
+
+    for (const LargeDirective& large : stats.largest) {
+      report.largest.push_back(StatsReport::Largest{
+          summary.input,
+          DirectiveName(summary.pbrt_version, large.field_number),
+          large.bytes});
+    }
+  }
+
+  std::stable_sort(report.largest.begin(), report.largest.end(),
+                   [](const StatsReport::Largest& a,
+                      const StatsReport::Largest& b) {
+                     return a.bytes > b.bytes;
+                   });
+  if (report.largest.size() > ConversionStats::kNumLargest) {
+    report.largest.resize(ConversionStats::kNumLargest);
+  }
+
+  return report;
+}
+
+// Prints `report` as a table for a person to read
+void PrintStats(const StatsReport& report,
+                const std::vector<FileSummary>& summaries) {
+  constexpr double kMegabyte = 1024.0 * 1024.0;
+
+  std::cout << absl::StrFormat(
+      "Converted %d files (%d from cache) in %.3f seconds\n"
+      "Parsed %.1f MB, %d tokens (%.1f MB/s, %.0f tokens/s per thread)\n"
+      "Peak resident memory: %.1f MB\n",
+      report.num_converted, report.num_cached, report.seconds,
+      report.totals.input.bytes / kMegabyte, report.totals.input.tokens,
+      report.BytesPerSecond() / kMegabyte, report.TokensPerSecond(),
+      report.peak_resident_bytes / kMegabyte);
+
+  std::cout << absl::StrFormat("\n%-20s %12s\n", "Phase", "Seconds");
+  for (const auto& [phase, seconds] : report.Phases()) {
+    std::cout << absl::StrFormat("%-20s %12.6f\n", phase, seconds);
+  }
+
+  std::cout << absl::StrFormat("\n%-20s %12s %12s %16s\n", "Directive",
+                               "Count", "Seconds", "Bytes");
+  for (const auto& [name, stats] : report.directives) {
+    std::cout << absl::StrFormat("%-20s %12d %12.6f %16d\n", name, stats.count,
+                                 stats.seconds, stats.bytes);
+  }
+
+  std::cout << absl::StrFormat("\n%-20s %16s  %s\n", "Largest", "Bytes",
+                               "Input");
+  for (const StatsReport::Largest& large : report.largest) {
+    std::cout << absl::StrFormat("%-20s %16d  %s\n", large.type, large.bytes,
+                                 large.input.string());
+  }
+
+  std::cout << absl::StrFormat("\n%12s %16s %12s  %s\n", "Seconds", "Bytes",
+                               "Tokens", "Input");
+  for (const FileSummary& summary : summaries) {
+    std::cout << absl::StrFormat("%12.6f %16d %12d  %s\n", summary.seconds,
+                                 summary.stats.input.bytes,
+                                 summary.stats.input.tokens,
+                                 summary.input.string());
+  }
+}
+
+// Writes `report` to `path` as a JSON object, with the time taken by each file
+// of `summaries` in its "files" array
+absl::Status WriteStats(const std::filesystem::path& path,
+                        const StatsReport& report,
+                        const std::vector<FileSummary>& summaries) {
+  std::ofstream output(path, std::ios::binary | std::ios::out);
+
+  output << "{\n  \"files_converted\": " << report.num_converted
+         << ",\n  \"files_cached\": " << report.num_cached
+         << ",\n  \"seconds\": " << report.seconds
+         << ",\n  \"bytes_parsed\": " << report.totals.input.bytes
+         << ",\n  \"tokens_parsed\": " << report.totals.input.tokens
+         << ",\n  \"bytes_per_second\": " << report.BytesPerSecond()
+         << ",\n  \"tokens_per_second\": " << report.TokensPerSecond()
+         << ",\n  \"peak_resident_bytes\": " << report.peak_resident_bytes;
+
+  output << ",\n  \"phases\": {";
+  std::vector<std::pair<const char*, double>> phases = report.Phases();
+  for (size_t i = 0; i < phases.size(); i++) {
+    output << (i == 0 ? "" : ", ") << "\"" << phases[i].first
+           << "\": " << phases[i].second;
+  }
+  output << "}";
+
+  output << ",\n  \"directives\": [";
+  bool first = true;
+  for (const auto& [name, stats] : report.directives) {
+    output << (first ? "\n" : ",\n") << "    {\"type\": " << JsonString(name)
+           << ", \"count\": " << stats.count << ", \"bytes\": " << stats.bytes
+           << ", \"seconds\": " << stats.seconds << "}";
+    first = false;
+  }
+  output << (first ? "]" : "\n  ]");
+
+  output << ",\n  \"largest_directives\": [";
+  for (size_t i = 0; i < report.largest.size(); i++) {
+    const StatsReport::Largest& large = report.largest[i];
+    output << (i == 0 ? "\n" : ",\n")
+           << "    {\"input\": " << JsonString(large.input.string())
+           << ", \"type\": " << JsonString(large.type)
+           << ", \"bytes\": " << large.bytes << "}";
+  }
+  output << (report.largest.empty() ? "]" : "\n  ]");
+
+  output << ",\n  \"files\": [";
+  for (size_t i = 0; i < summaries.size(); i++) {
+    const FileSummary& summary = summaries[i];
+    output << (i == 0 ? "\n" : ",\n")
+           << "    {\"input\": " << JsonString(summary.input.string())
+           << ", \"seconds\": " << summary.seconds
+           << ", \"bytes_parsed\": " << summary.stats.input.bytes
+           << ", \"tokens_parsed\": " << summary.stats.input.tokens
+           << ", \"parse_seconds\": " << summary.stats.parse_seconds << "}";
+  }
+  output << (summaries.empty() ? "]\n}\n" : "\n  ]\n}\n");
+
+  if (!output) {
+    return absl::UnavailableError("Could not write stats " + path.string());
+  }
+
+  return absl::OkStatus();
+}
+
+// Records spans as Chrome trace events. The spans begun on each thread are
+// kept on a stack of its own until they end.
+class ChromeTracer final : public pbrt_proto::Tracer {
+ public:
+  ChromeTracer() : start_(std::chrono::steady_clock::now()) {}
+
+  void BeginSpan(absl::string_view name, absl::string_view detail) override {
+    OpenSpans().push_back(
+        Span{std::string(name), std::string(detail), /*start=*/Now()});
+  }
+
+  void EndSpan() override {
+    std::vector<Span>& open_spans = OpenSpans();
+    Span span = std::move(open_spans.back());
+    open_spans.pop_back();
+    span.duration = Now() - span.start;
+
+    absl::MutexLock lock(&mutex_);
+    span.thread = thread_ids_
+                      .try_emplace(std::this_thread::get_id(),
+                                   static_cast<int>(thread_ids_.size()))
+                      .first->second;
+    spans_.push_back(std::move(span));
+  }
+
+  // Writes every span that has ended to `path` as JSON
+  absl::Status Write(const std::filesystem::path& path) {
+    std::ofstream output(path, std::ios::binary | std::ios::out);
+
+    absl::MutexLock lock(&mutex_);
+    output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    for (size_t i = 0; i < spans_.size(); i++) {
+      const Span& span = spans_[i];
+      output << (i == 0 ? "\n" : ",\n")
+             << absl::StrFormat(
+                    "{\"name\": %s, \"cat\": \"pbrt_proto\", \"ph\": \"X\", "
+                    "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d",
+                    JsonString(span.name), span.start, span.duration,
+                    span.thread);
+      if (!span.detail.empty()) {
+        output << ", \"args\": {\"detail\": " << JsonString(span.detail)
+               << "}";
+      }
+      output << "}";
+    }
+    output << "\n]}\n";
+
+    if (!output) {
+      return absl::UnavailableError("Could not write trace " + path.string());
+    }
+
+    return absl::OkStatus();
+  }
+
+ private:
+  // Times are in microseconds since the tracer was created
+  struct Span {
+    std::string name;
+    std::string detail;
+    double start;
+    double duration = 0.0;
+    int thread = 0;
+  };
+
+  static std::vector<Span>& OpenSpans() {
+    thread_local std::vector<Span> open_spans;
+    return open_spans;
+  }
+
+  double Now() const {
+    return std::chrono::duration<double, std::micro>(
+               std::chrono::steady_clock::now() - start_)
+        .count();
+  }
+
+  std::chrono::steady_clock::time_point start_;
+
+  absl::Mutex mutex_;
+  std::vector<Span> spans_ ABSL_GUARDED_BY(mutex_);
+  std::map<std::thread::id, int> thread_ids_ ABSL_GUARDED_BY(mutex_);
+};
+
+int main(int argc, char** argv) {
+  auto unparsed = absl::ParseCommandLine(argc, argv);
+
+  // Scenes in a manifest each give their own version
+  bool read_manifest = !absl::GetFlag(FLAGS_manifest).empty();
+  if (read_manifest) {
+    if (1 != unparsed.size()) {
+      std::cerr << "ERROR: An input file cannot be combined with --manifest"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  } else {
+    if (2 != unparsed.size()) {
+      std::cerr << "ERROR: Missing input file argument " << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (!absl::GetFlag(FLAGS_pbrt_version).has_value()) {
+      std::cerr << "ERROR: PBRT version was not specified" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (*absl::GetFlag(FLAGS_pbrt_version) != 1 &&
+        *absl::GetFlag(FLAGS_pbrt_version) != 2 &&
+        *absl::GetFlag(FLAGS_pbrt_version) != 3) {
+      std::cerr << "ERROR: PBRT version was not recognized" << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (absl::GetFlag(FLAGS_jobs) < 1) {
+    std::cerr << "ERROR: --jobs must be at least 1" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (absl::GetFlag(FLAGS_compress_meshes)) {
+    if (absl::GetFlag(FLAGS_geometry_sidecar)) {
+      std::cerr << "ERROR: --compress_meshes cannot be combined with "
+                   "--geometry_sidecar"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (absl::GetFlag(FLAGS_position_bits) < 1 ||
+        absl::GetFlag(FLAGS_position_bits) > 32 ||
+        absl::GetFlag(FLAGS_direction_bits) < 2 ||
+        absl::GetFlag(FLAGS_direction_bits) > 32 ||
+        absl::GetFlag(FLAGS_uv_bits) < 1 || absl::GetFlag(FLAGS_uv_bits) > 32) {
+      std::cerr << "ERROR: Mesh compression precision was out of range"
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (absl::GetFlag(FLAGS_max_output_size) < 1 ||
+      absl::GetFlag(FLAGS_max_output_size) > kMaxProtoSize) {
+    std::cerr << "ERROR: --max_output_size was out of range" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  // Input read from stdin is converted as if it were read from a file in the
+  // current directory, which is also where its output is written
+  bool read_stdin =
+      !read_manifest && std::strcmp(unparsed[1], kStdinArgument) == 0;
+  if (read_stdin) {
+    std::ios_base::sync_with_stdio(false);
+  }
+
+  // Every pbrt file in a directory tree is converted as a scene
+  std::error_code error_code;
+  bool read_directory = !read_manifest && !read_stdin &&
+                        std::filesystem::is_directory(unparsed[1], error_code);
+
+  std::vector<Scene> scenes;
+  std::filesystem::path input_path;
+  if (read_manifest) {
+    absl::StatusOr<std::vector<Scene>> manifest_scenes =
+        ReadManifest(absl::GetFlag(FLAGS_manifest));
+    if (!manifest_scenes.ok()) {
+      std::cerr << "ERROR: " << manifest_scenes.status().message()
+                << std::endl;
+      return EXIT_FAILURE;
+    }
+    scenes = *std::move(manifest_scenes);
+  } else if (read_directory) {
+    scenes = FindScenes(unparsed[1], *absl::GetFlag(FLAGS_pbrt_version));
+  } else {
+    input_path = read_stdin ? kStdinPath : unparsed[1];
+    if (WithoutCompressionExtension(input_path).extension() != ".pbrt") {
+      std::cerr << "ERROR: Input file was not a pbrt file" << std::endl;
+      return EXIT_FAILURE;
+    }
+
+    if (!read_stdin) {
+      scenes.push_back(
+          Scene{input_path, *absl::GetFlag(FLAGS_pbrt_version)});
+    }
+  }
+
+  // Outputs are not written when only validating, so there is nothing to cache
+  std::optional<ConversionCache> cache;
+  if (!absl::GetFlag(FLAGS_cache_dir).empty() &&
+      !absl::GetFlag(FLAGS_validate_only)) {
+    // Without the binary's digest, entries written by another build could be
+    // reused, so the cache is not used at all
+    absl::StatusOr<std::string> converter_digest = ConverterDigest();
+    if (converter_digest.ok()) {
+      cache.emplace(absl::GetFlag(FLAGS_cache_dir), *converter_digest,
+                    absl::GetFlag(FLAGS_shared_cache));
+      if (absl::Status status = cache->Open(); !status.ok()) {
+        std::cerr << "ERROR: " << status.message() << std::endl;
+        return EXIT_FAILURE;
+      }
+    } else {
+      std::cerr << "WARNING: " << converter_digest.status().message()
+                << "; --cache_dir is ignored" << std::endl;
+    }
+  }
+
+  std::optional<ChromeTracer> tracer;
+  if (!absl::GetFlag(FLAGS_trace_file).empty()) {
+    pbrt_proto::SetTracer(&tracer.emplace());
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  ConversionPool pool(cache ? &*cache : nullptr);
+
+  // Scenes are added in reverse since the most recently added file is
+  // converted first
+  for (auto scene = scenes.rbegin(); scene != scenes.rend(); ++scene) {
+    pool.AddScene(scene->file, scene->pbrt_version);
+  }
+
+  if (read_stdin) {
+    pool.ConvertStream(input_path, *absl::GetFlag(FLAGS_pbrt_version),
+                       std::cin);
+  }
+
+  std::vector<FileSummary> summaries = pool.Run(absl::GetFlag(FLAGS_jobs));
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+
+  if (tracer) {
+    pbrt_proto::SetTracer(nullptr);
+    if (absl::Status status = tracer->Write(absl::GetFlag(FLAGS_trace_file));
+        !status.ok()) {
+      std::cerr << "ERROR: " << status.message() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!absl::GetFlag(FLAGS_summary).empty()) {
+    if (absl::Status status =
+            WriteSummary(absl::GetFlag(FLAGS_summary), summaries);
+        !status.ok()) {
+      std::cerr << "ERROR: " << status.message() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!absl::GetFlag(FLAGS_stats).empty()) {
+    StatsReport report = MakeStatsReport(summaries, seconds);
+    if (absl::GetFlag(FLAGS_stats) == "-") {
+      PrintStats(report, summaries);
+    } else if (absl::Status status =
+                   WriteStats(absl::GetFlag(FLAGS_stats), report, summaries);
+               !status.ok()) {
+      std::cerr << "ERROR: " << status.message() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  // A single scene reports only its first error, while each failure of a batch
+  // is reported along with the file that failed
+  bool failed = false;
+  for (const FileSummary& summary : summaries) {
+    if (summary.status.ok()) {
+      continue;
+    }
+
+    if (!read_manifest && !read_directory) {
+      std::cerr << "ERROR: " << summary.status.message() << std::endl;
+      return EXIT_FAILURE;
     }
 
-    ConvertFile(input_path.parent_path(), next_file, next_partial_file_name,
-                included_files);
-    parsed_files.insert(next_file);
+    std::cerr << "ERROR: " << summary.input.string() << ": "
+              << summary.status.message() << std::endl;
+    failed = true;
   }
 
-  return EXIT_SUCCESS;
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <atomic>
 #include <cstdio>
 #include <cstdlib>
@@ -5,6 +6,7 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <map>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -12,12 +14,22 @@
 #include <tuple>
 #include <vector>
 
+#include "google/protobuf/struct.pb.h"
+#include "google/protobuf/util/json_util.h"
 #include "gtest/gtest.h"
 #include "tools/cpp/runfiles/runfiles.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace {
 
 using ::bazel::tools::cpp::runfiles::Runfiles;
+using ::google::protobuf::Struct;
+using ::google::protobuf::Value;
 using ::testing::TestWithParam;
 using ::testing::ValuesIn;
 
@@ -69,6 +81,152 @@ std::pair<int, std::string> Convert(int version,
   return std::make_pair(result, output_stream.str());
 }
 
+// Runs the converter with `arguments` and returns its exit status. If `errors`
+// is not null, what the converter wrote to stderr is stored in it.
+int RunConverter(const std::string& arguments,
+                 std::string* errors = nullptr) {
+  std::filesystem::path binary_name = kBinaryName;
+
+#ifdef _WIN32
+  binary_name.replace_extension(".exe");
+#endif
+
+  std::string binary = GetRunfilePath(binary_name);
+
+  std::filesystem::path errors_file =
+      std::filesystem::path(::testing::TempDir()) / "converter_errors.txt";
+#ifdef _WIN32
+  std::string errors_path = errors ? "\"" + errors_file.string() + "\"" : "NUL";
+  std::string command =
+      "\"\"" + binary + "\" " + arguments + " 2> " + errors_path + "\"";
+#else
+  std::string errors_path =
+      errors ? "\"" + errors_file.string() + "\"" : "/dev/null";
+  std::string command =
+      "\"" + binary + "\" " + arguments + " 2> " + errors_path;
+#endif
+
+  int result = std::system(command.c_str());
+  if (errors) {
+    std::ostringstream output_stream;
+    output_stream << std::ifstream(errors_file).rdbuf();
+    *errors = output_stream.str();
+  }
+
+  return result;
+}
+
+// Converts `input_file` for PBRT v3, writing its output next to it, and returns
+// the exit status of the converter
+int ConvertInPlace(const std::filesystem::path& input_file) {
+  return RunConverter("--pbrt_version=3 \"" + input_file.string() + "\"");
+}
+
+void WriteFile(const std::filesystem::path& path, const std::string& contents) {
+  std::ofstream(path, std::ios::binary | std::ios::out) << contents;
+}
+
+std::string ReadFile(const std::filesystem::path& path) {
+  std::ostringstream contents;
+  contents << std::ifstream(path, std::ios::binary).rdbuf();
+  return contents.str();
+}
+
+std::vector<std::filesystem::path> ListDirectory(
+    const std::filesystem::path& directory) {
+  std::vector<std::filesystem::path> files;
+  for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+    files.push_back(entry.path().filename());
+  }
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+// Returns an empty directory for a test named `name`
+std::filesystem::path MakeTestDirectory(const std::string& name) {
+  std::filesystem::path directory =
+      std::filesystem::path(::testing::TempDir()) / name;
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+  return directory;
+}
+
+// Returns the JSON object at `path`, or nullopt if it does not hold one
+std::optional<Struct> ReadJson(const std::filesystem::path& path) {
+  Struct json;
+  if (!google::protobuf::util::JsonStringToMessage(ReadFile(path), &json)
+           .ok()) {
+    return std::nullopt;
+  }
+  return json;
+}
+
+// Returns the member `name` of `object`, which is empty if it has none
+const Value& Field(const Struct& object, const std::string& name) {
+  auto field = object.fields().find(name);
+  if (field == object.fields().end()) {
+    return Value::default_instance();
+  }
+  return field->second;
+}
+
+// A PBRT v3 scene holding a single sphere
+constexpr char kScene[] = "WorldBegin\nShape \"sphere\"\n";
+
+// `kScene` compressed with gzip
+constexpr char kGzipScene[] =
+    "\x1f\x8b\x08\x00\x00\x00\x00\x00\x02\x03\x0b\xcf\x2f\xca\x49\x71\x4a\x4d"
+    "\xcf\xcc\xe3\x0a\xce\x48\x2c\x48\x55\x50\x2a\x2e\xc8\x48\x2d\x4a\x55\xe2"
+    "\x02\x00\x25\x6a\xa5\xdd\x1a\x00\x00\x00";
+
+std::string GzipScene() {
+  return std::string(kGzipScene, sizeof(kGzipScene) - 1);
+}
+
+// Returns the "files" array of the `--summary` at `path`
+std::vector<Struct> ReadSummaryFiles(const std::filesystem::path& path) {
+  std::optional<Struct> summary = ReadJson(path);
+  if (!summary || !summary->fields().contains("files")) {
+    ADD_FAILURE() << "Could not parse summary " << path;
+    return {};
+  }
+
+  std::vector<Struct> files;
+  for (const Value& file : Field(*summary, "files").list_value().values()) {
+    files.push_back(file.struct_value());
+  }
+  return files;
+}
+
+// Returns the "result" of each file of the `--summary` at `path`, keyed by the
+// file name of its input
+std::map<std::string, std::string> ReadResults(
+    const std::filesystem::path& path) {
+  std::map<std::string, std::string> results;
+  for (const Struct& file : ReadSummaryFiles(path)) {
+    results[std::filesystem::path(Field(file, "input").string_value())
+                .filename()
+                .string()] = Field(file, "result").string_value();
+  }
+  return results;
+}
+
+// Returns the directory of each complete entry in the cache at `cache_dir`
+std::vector<std::filesystem::path> CacheEntries(
+    const std::filesystem::path& cache_dir) {
+  std::vector<std::filesystem::path> entries;
+  for (const auto& shard : std::filesystem::directory_iterator(cache_dir)) {
+    for (const auto& entry : std::filesystem::directory_iterator(shard)) {
+      if (entry.path().filename().string().find(".tmp") ==
+          std::string::npos) {
+        entries.push_back(entry.path());
+      }
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  return entries;
+}
+
 struct TestInput {
   std::filesystem::path path;
   bool allow_warnings = false;
@@ -392,4 +550,804 @@ TEST(Convert, All) {
   }
 }
 
+TEST(Convert, FailureLeavesNoOutput) {
+  std::filesystem::path directory =
+      std::filesystem::path(::testing::TempDir()) / "failure_leaves_no_output";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+
+  std::filesystem::path input_file = directory / "scene.pbrt";
+  WriteFile(input_file, "WorldBegin\nShape \"sphere\"\nNotADirective\n");
+
+  EXPECT_NE(0, ConvertInPlace(input_file));
+  EXPECT_EQ(std::vector<std::filesystem::path>({"scene.pbrt"}),
+            ListDirectory(directory));
+}
+
+TEST(Convert, FailureKeepsEarlierOutput) {
+  std::filesystem::path directory =
+      std::filesystem::path(::testing::TempDir()) /
+      "failure_keeps_earlier_output";
+  std::filesystem::remove_all(directory);
+  std::filesystem::create_directories(directory);
+
+  std::filesystem::path input_file = directory / "scene.pbrt";
+  WriteFile(input_file, "WorldBegin\nShape \"sphere\"\n");
+  ASSERT_EQ(0, ConvertInPlace(input_file));
+
+  std::vector<std::filesystem::path> files = ListDirectory(directory);
+  ASSERT_EQ(2u, files.size());
+  std::filesystem::path output_file = directory / files[1];
+  std::string output = ReadFile(output_file);
+
+  WriteFile(input_file, "WorldBegin\nShape \"sphere\"\nNotADirective\n");
+  EXPECT_NE(0, ConvertInPlace(input_file));
+  EXPECT_EQ(files, ListDirectory(directory));
+  EXPECT_EQ(output, ReadFile(output_file));
+}
+
+TEST(Convert, IncludesResolvedFromEachScene) {
+  std::filesystem::path directory =
+      std::filesystem::path(::testing::TempDir()) /
+      "includes_resolved_from_each_scene";
+  std::filesystem::remove_all(directory);
+  for (const char* subdirectory : {"a", "b", "shared"}) {
+    std::filesystem::create_directories(directory / subdirectory);
+  }
+
+  // The shared file is converted once, but the path it includes is resolved
+  // from the directory of each scene
+  WriteFile(directory / "a/scene.pbrt",
+            "WorldBegin\nInclude \"../shared/shape.pbrt\"\n");
+  WriteFile(directory / "b/scene.pbrt",
+            "WorldBegin\nInclude \"../shared/shape.pbrt\"\n");
+  WriteFile(directory / "shared/shape.pbrt", "Include \"material.pbrt\"\n");
+  WriteFile(directory / "a/material.pbrt", "Material \"matte\"\n");
+  WriteFile(directory / "b/material.pbrt", "Material \"plastic\"\n");
+  WriteFile(directory / "manifest.txt", "3 a/scene.pbrt\n3 b/scene.pbrt\n");
+
+  ASSERT_EQ(0, RunConverter("--recursive --manifest=\"" +
+                            (directory / "manifest.txt").string() + "\""));
+  EXPECT_TRUE(
+      std::filesystem::exists(directory / "shared/shape.pbrt.3.binpb"));
+  EXPECT_TRUE(std::filesystem::exists(directory / "a/material.pbrt.3.binpb"));
+  EXPECT_TRUE(std::filesystem::exists(directory / "b/material.pbrt.3.binpb"));
+}
+
+TEST(Convert, SplitCountsDirectiveOverhead) {
+  std::filesystem::path directory = MakeTestDirectory("split_overhead");
+  std::filesystem::path scene = directory / "scene.pbrt";
+  WriteFile(scene, kScene);
+
+  ASSERT_EQ(0, ConvertInPlace(scene));
+  std::string unsplit = ReadFile(directory / "scene.pbrt.3.binpb");
+
+  auto convert = [&](size_t max_output_size) {
+    return RunConverter("--pbrt_version=3 --max_output_size=" +
+                        std::to_string(max_output_size) + " \"" +
+                        scene.string() + "\"");
+  };
+
+  ASSERT_EQ(0, convert(unsplit.size() + 1));
+  EXPECT_EQ(std::vector<std::filesystem::path>(
+                {"scene.pbrt", "scene.pbrt.3.binpb"}),
+            ListDirectory(directory));
+  EXPECT_EQ(unsplit, ReadFile(directory / "scene.pbrt.3.binpb"));
+
+  // Each of the two directives is written after a one byte tag and length, so
+  // the directives alone fit in a single child
+  ASSERT_EQ(0, convert(unsplit.size() - 4));
+  EXPECT_EQ(std::vector<std::filesystem::path>(
+                {"scene.1.pbrt.3.binpb", "scene.pbrt", "scene.pbrt.3.binpb"}),
+            ListDirectory(directory));
+  EXPECT_EQ(unsplit, ReadFile(directory / "scene.1.pbrt.3.binpb"));
+  EXPECT_NE(std::string::npos,
+            ReadFile(directory / "scene.pbrt.3.binpb").find("scene.1.pbrt"));
+
+  ASSERT_EQ(0, convert(unsplit.size() - 5));
+  EXPECT_EQ(std::vector<std::filesystem::path>(
+                {"scene.1.pbrt.3.binpb", "scene.2.pbrt.3.binpb", "scene.pbrt",
+                 "scene.pbrt.3.binpb"}),
+            ListDirectory(directory));
+}
+
+// Converts the scene at `input` for PBRT v3 by piping it to the converter run
+// from `directory`, where its output is written, and returns its exit status
+int ConvertStdin(const std::filesystem::path& input,
+                 const std::filesystem::path& directory) {
+  std::filesystem::path working_directory = std::filesystem::current_path();
+  std::filesystem::current_path(directory);
+  int result = RunConverter("--pbrt_version=3 - < \"" +
+                            std::filesystem::absolute(input).string() + "\"");
+  std::filesystem::current_path(working_directory);
+  return result;
+}
+
+TEST(Stdin, ConvertsPipedScene) {
+  std::filesystem::path directory = MakeTestDirectory("stdin_scene");
+  std::filesystem::create_directories(directory / "output");
+  WriteFile(directory / "scene.pbrt", kScene);
+
+  ASSERT_EQ(0, ConvertInPlace(directory / "scene.pbrt"));
+  ASSERT_EQ(0, ConvertStdin(directory / "scene.pbrt", directory / "output"));
+  EXPECT_EQ(ReadFile(directory / "scene.pbrt.3.binpb"),
+            ReadFile(directory / "output/stdin.pbrt.3.binpb"));
+}
+
+TEST(Stdin, ConvertsPipedGzipScene) {
+  std::filesystem::path directory = MakeTestDirectory("stdin_gzip_scene");
+  std::filesystem::create_directories(directory / "output");
+  WriteFile(directory / "scene.pbrt", kScene);
+  WriteFile(directory / "scene.pbrt.gz", GzipScene());
+
+  ASSERT_EQ(0, ConvertInPlace(directory / "scene.pbrt"));
+  ASSERT_EQ(0, ConvertStdin(directory / "scene.pbrt.gz", directory / "output"));
+  EXPECT_EQ(ReadFile(directory / "scene.pbrt.3.binpb"),
+            ReadFile(directory / "output/stdin.pbrt.3.binpb"));
+}
+
+TEST(Stdin, FailureLeavesNoOutput) {
+  std::filesystem::path directory = MakeTestDirectory("stdin_failure");
+  WriteFile(directory / "scene.pbrt", "WorldBegin\nNotADirective\n");
+
+  EXPECT_NE(0, ConvertStdin(directory / "scene.pbrt", directory));
+  EXPECT_FALSE(std::filesystem::exists(directory / "stdin.pbrt.3.binpb"));
+}
+
+TEST(Convert, ZeroPaddedGzipScene) {
+  std::filesystem::path directory = MakeTestDirectory("zero_padded_gzip");
+  WriteFile(directory / "scene.pbrt", kScene);
+  WriteFile(directory / "padded.pbrt.gz", GzipScene() + std::string(512, '\0'));
+
+  ASSERT_EQ(0, ConvertInPlace(directory / "scene.pbrt"));
+  ASSERT_EQ(0, ConvertInPlace(directory / "padded.pbrt.gz"));
+  EXPECT_EQ(ReadFile(directory / "scene.pbrt.3.binpb"),
+            ReadFile(directory / "padded.pbrt.3.binpb"));
+}
+
+TEST(Convert, PackedGeometryPacksSpectra) {
+  std::filesystem::path directory = MakeTestDirectory("packed_spectra");
+  std::filesystem::path scene = directory / "scene.pbrt";
+  std::filesystem::path output = directory / "scene.pbrt.3.txtpb";
+  WriteFile(scene,
+            "WorldBegin\n"
+            "Material \"matte\" \"spectrum Kd\" [400 0.25 500 0.5]\n"
+            "AttributeBegin\nAreaLightSource \"diffuse\" "
+            "\"spectrum L\" [400 1 700 2]\nShape \"sphere\"\nAttributeEnd\n");
+
+  ASSERT_EQ(0, RunConverter("--pbrt_version=3 --textproto \"" +
+                            scene.string() + "\""));
+  std::string unpacked = ReadFile(output);
+  EXPECT_NE(std::string::npos, unpacked.find("samples {"));
+  EXPECT_EQ(std::string::npos, unpacked.find("samples_flat"));
+
+  ASSERT_EQ(0,
+            RunConverter("--pbrt_version=3 --textproto --packed_geometry \"" +
+                         scene.string() + "\""));
+  std::string packed = ReadFile(output);
+  EXPECT_EQ(std::string::npos, packed.find("samples {"));
+  EXPECT_NE(std::string::npos, packed.find("samples_flat: 400"));
+  EXPECT_NE(std::string::npos, packed.find("samples_flat: 0.25"));
+  EXPECT_NE(std::string::npos, packed.find("samples_flat: 700"));
+}
+
+// Converts `scene` for PBRT v3 using the cache at `cache_dir` and returns the
+// result of each file converted, keyed by the file name of its input
+std::map<std::string, std::string> ConvertCached(
+    const std::filesystem::path& scene, const std::filesystem::path& cache_dir,
+    const std::string& flags = "") {
+  std::filesystem::path summary = cache_dir.parent_path() / "summary.json";
+  std::filesystem::remove(summary);
+  EXPECT_EQ(0, RunConverter("--pbrt_version=3 --cache_dir=\"" +
+                            cache_dir.string() + "\" --summary=\"" +
+                            summary.string() + "\" " + flags + " \"" +
+                            scene.string() + "\""));
+  return ReadResults(summary);
+}
+
+TEST(Cache, HitRestoresOutput) {
+  std::filesystem::path directory = MakeTestDirectory("cache_hit");
+  std::filesystem::path cache_dir = directory / "cache";
+  std::filesystem::path scene = directory / "scene.pbrt";
+  std::filesystem::path output = directory / "scene.pbrt.3.binpb";
+  WriteFile(scene, "WorldBegin\nShape \"sphere\"\n");
+
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+  std::string converted = ReadFile(output);
+  ASSERT_FALSE(converted.empty());
+  EXPECT_EQ(1u, CacheEntries(cache_dir).size());
+
+  std::filesystem::remove(output);
+  EXPECT_EQ("cached", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+  EXPECT_EQ(converted, ReadFile(output));
+  EXPECT_EQ(1u, CacheEntries(cache_dir).size());
+}
+
+TEST(Cache, KeyChangesWithInput) {
+  std::filesystem::path directory = MakeTestDirectory("cache_input");
+  std::filesystem::path cache_dir = directory / "cache";
+  std::filesystem::path scene = directory / "scene.pbrt";
+  WriteFile(scene, "WorldBegin\nShape \"sphere\"\n");
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+
+  WriteFile(scene, "WorldBegin\nShape \"disk\"\n");
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+  EXPECT_EQ(2u, CacheEntries(cache_dir).size());
+}
+
+TEST(Cache, KeyChangesWithIncludedFile) {
+  std::filesystem::path directory = MakeTestDirectory("cache_included");
+  std::filesystem::path cache_dir = directory / "cache";
+  std::filesystem::path scene = directory / "scene.pbrt";
+  WriteFile(scene, "WorldBegin\nInclude \"shape.pbrt\"\n");
+  WriteFile(directory / "shape.pbrt", "Shape \"sphere\"\n");
+
+  std::map<std::string, std::string> results =
+      ConvertCached(scene, cache_dir, "--recursive");
+  EXPECT_EQ("converted", results["scene.pbrt"]);
+  EXPECT_EQ("converted", results["shape.pbrt"]);
+
+  WriteFile(directory / "shape.pbrt", "Shape \"disk\"\n");
+  results = ConvertCached(scene, cache_dir, "--recursive");
+  EXPECT_EQ("cached", results["scene.pbrt"]);
+  EXPECT_EQ("converted", results["shape.pbrt"]);
+  EXPECT_EQ(3u, CacheEntries(cache_dir).size());
+}
+
+TEST(Cache, KeyChangesWithFlags) {
+  std::filesystem::path directory = MakeTestDirectory("cache_flags");
+  std::filesystem::path cache_dir = directory / "cache";
+  std::filesystem::path scene = directory / "scene.pbrt";
+  WriteFile(scene,
+            "WorldBegin\nShape \"trianglemesh\" \"point P\" "
+            "[0 0 0 1 0 0 0 1 0] \"integer indices\" [0 1 2]\n");
+
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir,
+                                       "--packed_geometry")["scene.pbrt"]);
+  EXPECT_EQ("cached", ConvertCached(scene, cache_dir,
+                                    "--packed_geometry")["scene.pbrt"]);
+  EXPECT_EQ(2u, CacheEntries(cache_dir).size());
+}
+
+TEST(Cache, RejectsTruncatedManifest) {
+  std::filesystem::path directory = MakeTestDirectory("cache_truncated");
+  std::filesystem::path cache_dir = directory / "cache";
+  std::filesystem::path scene = directory / "scene.pbrt";
+  WriteFile(scene, "WorldBegin\nShape \"sphere\"\n");
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+
+  std::vector<std::filesystem::path> entries = CacheEntries(cache_dir);
+  ASSERT_EQ(1u, entries.size());
+  std::filesystem::path manifest = entries[0] / "manifest";
+  std::string contents = ReadFile(manifest);
+  ASSERT_FALSE(contents.empty());
+
+  // Cut off after the last complete line, then partway through the first
+  std::filesystem::permissions(manifest, std::filesystem::perms::owner_write,
+                               std::filesystem::perm_options::add);
+  ASSERT_EQ("end\n", contents.substr(contents.size() - 4));
+  WriteFile(manifest, contents.substr(0, contents.size() - 4));
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+
+  WriteFile(manifest, contents.substr(0, 20));
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+}
+
+TEST(Cache, RejectsManifestOutsideEntry) {
+  std::filesystem::path directory = MakeTestDirectory("cache_hostile");
+  std::filesystem::path cache_dir = directory / "cache";
+  std::filesystem::path scene_dir = directory / "scenes";
+  std::filesystem::create_directories(scene_dir);
+  std::filesystem::path scene = scene_dir / "scene.pbrt";
+  WriteFile(scene, "WorldBegin\nShape \"sphere\"\n");
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+
+  std::vector<std::filesystem::path> entries = CacheEntries(cache_dir);
+  ASSERT_EQ(1u, entries.size());
+  std::filesystem::path manifest = entries[0] / "manifest";
+  std::filesystem::path cached_output = entries[0] / "scene.pbrt.3.binpb";
+  ASSERT_TRUE(std::filesystem::exists(cached_output));
+  std::filesystem::permissions(manifest, std::filesystem::perms::owner_write,
+                               std::filesystem::perm_options::add);
+
+  // Followed, this would place the file next to the entry one directory above
+  // the output
+  WriteFile(entries[0].parent_path() / "escaped.binpb", "escaped");
+  for (const std::string& name :
+       {std::string(".."), std::string("../escaped.binpb"),
+        std::filesystem::absolute(cached_output).string()}) {
+    SCOPED_TRACE(name);
+    WriteFile(manifest, "output " + name + "\nend\n");
+    EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+    EXPECT_FALSE(std::filesystem::exists(directory / "escaped.binpb"));
+    EXPECT_TRUE(std::filesystem::exists(cached_output));
+    EXPECT_TRUE(std::filesystem::exists(scene_dir / "scene.pbrt.3.binpb"));
+  }
+}
+
+TEST(Cache, InterruptedStoreLeavesNoEntry) {
+  std::filesystem::path directory = MakeTestDirectory("cache_interrupted");
+  std::filesystem::path cache_dir = directory / "cache";
+  std::filesystem::path scene = directory / "scene.pbrt";
+  WriteFile(scene, "WorldBegin\nShape \"sphere\"\n");
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+
+  // An entry is only visible once its temporary directory is renamed into
+  // place, so one left behind by a store that stopped short is never used
+  std::vector<std::filesystem::path> entries = CacheEntries(cache_dir);
+  ASSERT_EQ(1u, entries.size());
+  std::filesystem::path temporary = entries[0];
+  temporary += ".tmp12345";
+  std::filesystem::rename(entries[0], temporary);
+  EXPECT_TRUE(CacheEntries(cache_dir).empty());
+
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+  EXPECT_EQ(entries, CacheEntries(cache_dir));
+  EXPECT_EQ("cached", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+}
+
+#ifndef _WIN32
+TEST(Cache, FileModes) {
+  using std::filesystem::perms;
+
+  std::filesystem::path directory = MakeTestDirectory("cache_modes");
+  std::filesystem::path scene = directory / "scene.pbrt";
+  WriteFile(scene, "WorldBegin\nShape \"sphere\"\n");
+
+  auto mode = [](const std::filesystem::path& path) {
+    return std::filesystem::status(path).permissions();
+  };
+
+  std::filesystem::path private_cache = directory / "private";
+  ConvertCached(scene, private_cache);
+  std::vector<std::filesystem::path> entries = CacheEntries(private_cache);
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ(perms::owner_read, mode(entries[0] / "manifest"));
+  EXPECT_EQ(perms::owner_read, mode(entries[0] / "scene.pbrt.3.binpb"));
+
+  // Shared directories are writable by everyone but only let the owner of an
+  // entry remove it, and the entries themselves are read-only to everyone
+  std::filesystem::path shared_cache = directory / "shared";
+  ConvertCached(scene, shared_cache, "--shared_cache");
+  entries = CacheEntries(shared_cache);
+  ASSERT_EQ(1u, entries.size());
+  EXPECT_EQ(perms::all | perms::sticky_bit, mode(shared_cache));
+  EXPECT_EQ(perms::all | perms::sticky_bit, mode(entries[0].parent_path()));
+  EXPECT_EQ(perms::owner_all | perms::group_read | perms::group_exec |
+                perms::others_read | perms::others_exec,
+            mode(entries[0]));
+  EXPECT_EQ(perms::owner_read | perms::group_read | perms::others_read,
+            mode(entries[0] / "manifest"));
+  EXPECT_EQ(perms::owner_read | perms::group_read | perms::others_read,
+            mode(entries[0] / "scene.pbrt.3.binpb"));
+}
+
+TEST(Cache, SkipsFifo) {
+  std::filesystem::path directory = MakeTestDirectory("cache_fifo");
+  std::filesystem::path cache_dir = directory / "cache";
+  std::filesystem::path scene = directory / "scene.pbrt";
+  WriteFile(directory / "regular.pbrt", kScene);
+  ASSERT_EQ(0, ConvertInPlace(directory / "regular.pbrt"));
+  ASSERT_EQ(0, mkfifo(scene.c_str(), 0600));
+
+  std::atomic<bool> written = false;
+  std::thread writer([&]() {
+    std::ofstream(scene, std::ios::binary) << kScene;
+    written = true;
+  });
+
+  // Hashing the pipe for a key would leave nothing to convert
+  EXPECT_EQ("converted", ConvertCached(scene, cache_dir)["scene.pbrt"]);
+
+  // Lets the writer finish even if the converter never opened the pipe
+  if (!written) {
+    int fd = open(scene.c_str(), O_RDONLY | O_NONBLOCK);
+    writer.join();
+    close(fd);
+  } else {
+    writer.join();
+  }
+
+  EXPECT_EQ(ReadFile(directory / "regular.pbrt.3.binpb"),
+            ReadFile(directory / "scene.pbrt.3.binpb"));
+  EXPECT_TRUE(CacheEntries(cache_dir).empty());
+}
+#endif  // _WIN32
+
+// Converts the scenes listed in `manifest`, writing a summary to `summary`, and
+// returns the exit status of the converter
+int ConvertManifest(const std::filesystem::path& manifest,
+                    const std::filesystem::path& summary,
+                    const std::string& flags = "",
+                    std::string* errors = nullptr) {
+  return RunConverter(flags + " --manifest=\"" + manifest.string() +
+                          "\" --summary=\"" + summary.string() + "\"",
+                      errors);
+}
+
+TEST(Manifest, ConvertsListedScenes) {
+  std::filesystem::path directory = MakeTestDirectory("manifest_scenes");
+  std::filesystem::create_directories(directory / "sub");
+  std::filesystem::create_directories(directory / "other");
+  WriteFile(directory / "a.pbrt", kScene);
+  WriteFile(directory / "sub/b.pbrt", kScene);
+  WriteFile(directory / "other/c.pbrt", kScene);
+  WriteFile(directory / "unlisted.pbrt", kScene);
+
+  // Paths are relative to the manifest unless absolute, and may be surrounded
+  // by blank space
+  std::string absolute_path =
+      std::filesystem::absolute(directory / "other/c.pbrt").string();
+  WriteFile(directory / "manifest.txt",
+            "# Scenes to convert\n\n3 a.pbrt\n  3\tsub/b.pbrt \r\n3 " +
+                absolute_path + "\n   # Indented comment\n");
+
+  EXPECT_EQ(0, ConvertManifest(directory / "manifest.txt",
+                               directory / "summary.json"));
+  EXPECT_TRUE(std::filesystem::exists(directory / "a.pbrt.3.binpb"));
+  EXPECT_TRUE(std::filesystem::exists(directory / "sub/b.pbrt.3.binpb"));
+  EXPECT_TRUE(std::filesystem::exists(directory / "other/c.pbrt.3.binpb"));
+  EXPECT_FALSE(std::filesystem::exists(directory / "unlisted.pbrt.3.binpb"));
+  EXPECT_EQ(3u, ReadSummaryFiles(directory / "summary.json").size());
+}
+
+TEST(Manifest, MissingSceneFailsAlone) {
+  std::filesystem::path directory = MakeTestDirectory("manifest_missing");
+  WriteFile(directory / "a.pbrt", kScene);
+  WriteFile(directory / "manifest.txt", "3 missing.pbrt\n3 a.pbrt\n");
+
+  EXPECT_NE(0, ConvertManifest(directory / "manifest.txt",
+                               directory / "summary.json"));
+  EXPECT_TRUE(std::filesystem::exists(directory / "a.pbrt.3.binpb"));
+
+  std::map<std::string, std::string> results =
+      ReadResults(directory / "summary.json");
+  EXPECT_EQ("converted", results["a.pbrt"]);
+  EXPECT_EQ("failed", results["missing.pbrt"]);
+}
+
+TEST(Manifest, RejectsInvalidLines) {
+  std::filesystem::path directory = MakeTestDirectory("manifest_invalid");
+  WriteFile(directory / "a.pbrt", kScene);
+
+  for (const char* line : {"4 a.pbrt\n", "3\n", "a.pbrt\n", "three a.pbrt\n"}) {
+    SCOPED_TRACE(line);
+    WriteFile(directory / "manifest.txt", std::string("3 a.pbrt\n") + line);
+    EXPECT_NE(0, ConvertManifest(directory / "manifest.txt",
+                                 directory / "summary.json"));
+    EXPECT_FALSE(std::filesystem::exists(directory / "a.pbrt.3.binpb"));
+    EXPECT_FALSE(std::filesystem::exists(directory / "summary.json"));
+  }
+}
+
+// Writes scenes that each include files shared with the others to
+// `directory`, and a manifest listing them
+void WriteSharedIncludes(const std::filesystem::path& directory) {
+  std::filesystem::create_directories(directory / "shared");
+  WriteFile(directory / "shared/shape.pbrt", "Shape \"sphere\"\n");
+  WriteFile(directory / "shared/material.pbrt", "Material \"matte\"\n");
+
+  std::string manifest;
+  for (int i = 0; i < 8; i++) {
+    std::string name = "scene" + std::to_string(i);
+    std::filesystem::create_directories(directory / name);
+    WriteFile(directory / name / "local.pbrt",
+              "Translate " + std::to_string(i) + " 0 0\n");
+    WriteFile(directory / name / "scene.pbrt",
+              "WorldBegin\nInclude \"../shared/material.pbrt\"\n"
+              "Include \"local.pbrt\"\nInclude \"../shared/shape.pbrt\"\n");
+    manifest += "3 " + name + "/scene.pbrt\n";
+  }
+  WriteFile(directory / "manifest.txt", manifest);
+}
+
+// Returns the contents of each output under `directory` by its relative path
+std::map<std::string, std::string> ReadOutputs(
+    const std::filesystem::path& directory) {
+  std::map<std::string, std::string> outputs;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(directory)) {
+    if (entry.path().extension() == ".binpb") {
+      outputs[std::filesystem::relative(entry.path(), directory)
+                  .generic_string()] = ReadFile(entry.path());
+    }
+  }
+  return outputs;
+}
+
+TEST(Jobs, OutputDoesNotDependOnThreads) {
+  std::filesystem::path serial = MakeTestDirectory("jobs_serial");
+  std::filesystem::path parallel = MakeTestDirectory("jobs_parallel");
+  WriteSharedIncludes(serial);
+  WriteSharedIncludes(parallel);
+
+  ASSERT_EQ(0, ConvertManifest(serial / "manifest.txt", serial / "summary.json",
+                               "--recursive --jobs=1"));
+  ASSERT_EQ(0,
+            ConvertManifest(parallel / "manifest.txt",
+                            parallel / "summary.json", "--recursive --jobs=4"));
+
+  // Each scene and its local include, and each shared include once
+  std::map<std::string, std::string> outputs = ReadOutputs(serial);
+  EXPECT_EQ(18u, outputs.size());
+  EXPECT_EQ(outputs, ReadOutputs(parallel));
+  EXPECT_EQ(18u, ReadSummaryFiles(serial / "summary.json").size());
+  EXPECT_EQ(18u, ReadSummaryFiles(parallel / "summary.json").size());
+}
+
+TEST(Jobs, DuplicateOutputsConvertedOnce) {
+  std::filesystem::path directory = MakeTestDirectory("jobs_duplicates");
+  std::filesystem::create_directories(directory / "sub");
+  WriteFile(directory / "shape.pbrt", "Shape \"sphere\"\n");
+  WriteFile(directory / "scene.pbrt", "WorldBegin\nInclude \"shape.pbrt\"\n");
+  WriteFile(directory / "other.pbrt",
+            "WorldBegin\nInclude \"./shape.pbrt\"\n");
+
+  // Every path to scene.pbrt and shape.pbrt has the same output
+  WriteFile(directory / "manifest.txt",
+            "3 scene.pbrt\n3 ./scene.pbrt\n3 sub/../scene.pbrt\n"
+            "3 other.pbrt\n");
+
+  ASSERT_EQ(0, ConvertManifest(directory / "manifest.txt",
+                               directory / "summary.json",
+                               "--recursive --jobs=4"));
+  std::vector<Struct> files = ReadSummaryFiles(directory / "summary.json");
+  ASSERT_EQ(3u, files.size());
+  std::map<std::string, int> outputs;
+  for (const Struct& file : files) {
+    EXPECT_EQ("converted", Field(file, "result").string_value());
+    outputs[std::filesystem::path(Field(file, "output").string_value())
+                .filename()
+                .string()]++;
+  }
+  EXPECT_EQ(1, outputs["scene.pbrt.3.binpb"]);
+  EXPECT_EQ(1, outputs["other.pbrt.3.binpb"]);
+  EXPECT_EQ(1, outputs["shape.pbrt.3.binpb"]);
+}
+
+TEST(Jobs, ErrorsReportedInStableOrder) {
+  std::filesystem::path directory = MakeTestDirectory("jobs_errors");
+  std::string manifest;
+  for (int i = 0; i < 8; i++) {
+    std::string name = "scene" + std::to_string(i) + ".pbrt";
+    std::string broken = "broken" + std::to_string(i) + ".pbrt";
+    WriteFile(directory / name, kScene);
+    WriteFile(directory / broken, "WorldBegin\nNotADirective\n");
+    manifest += "3 " + broken + "\n3 " + name + "\n";
+  }
+  WriteFile(directory / "missing_include.pbrt",
+            "WorldBegin\nInclude \"missing.pbrt\"\n");
+  manifest += "3 missing_include.pbrt\n3 missing.pbrt\n";
+  WriteFile(directory / "manifest.txt", manifest);
+
+  std::string expected;
+  EXPECT_NE(0,
+            ConvertManifest(directory / "manifest.txt",
+                            directory / "summary.json", "--recursive --jobs=1",
+                            &expected));
+  EXPECT_NE(std::string::npos, expected.find("broken0.pbrt"));
+  EXPECT_NE(std::string::npos, expected.find("broken7.pbrt"));
+  EXPECT_NE(std::string::npos, expected.find("missing.pbrt"));
+  EXPECT_LT(expected.find("broken0.pbrt"), expected.find("broken7.pbrt"));
+
+  for (int i = 0; i < 4; i++) {
+    std::string errors;
+    EXPECT_NE(0,
+              ConvertManifest(directory / "manifest.txt",
+                              directory / "summary.json",
+                              "--recursive --jobs=4", &errors));
+    EXPECT_EQ(expected, errors);
+  }
+}
+
+TEST(Directory, ConvertsEveryScene) {
+  std::filesystem::path directory = MakeTestDirectory("directory_scenes");
+  std::filesystem::create_directories(directory / "sub");
+  WriteFile(directory / "a.pbrt", kScene);
+  WriteFile(directory / "sub/b.pbrt", kScene);
+  WriteFile(directory / "sub/c.pbrt.gz", GzipScene());
+  WriteFile(directory / "notes.txt", "Not a scene");
+  std::filesystem::path summary =
+      std::filesystem::path(::testing::TempDir()) / "directory_summary.json";
+
+  EXPECT_EQ(0, RunConverter("--pbrt_version=3 --summary=\"" +
+                            summary.string() + "\" \"" + directory.string() +
+                            "\""));
+  EXPECT_EQ(std::vector<std::filesystem::path>(
+                {"a.pbrt", "a.pbrt.3.binpb", "notes.txt", "sub"}),
+            ListDirectory(directory));
+  EXPECT_EQ(std::vector<std::filesystem::path>({"b.pbrt", "b.pbrt.3.binpb",
+                                                "c.pbrt.3.binpb",
+                                                "c.pbrt.gz"}),
+            ListDirectory(directory / "sub"));
+
+  std::map<std::string, std::string> results = ReadResults(summary);
+  EXPECT_EQ(3u, results.size());
+  EXPECT_EQ("converted", results["a.pbrt"]);
+  EXPECT_EQ("converted", results["b.pbrt"]);
+  EXPECT_EQ("converted", results["c.pbrt.gz"]);
+}
+
+TEST(Summary, DescribesEachFile) {
+  std::filesystem::path directory = MakeTestDirectory("summary_files");
+  WriteFile(directory / "a.pbrt", kScene);
+  WriteFile(directory / "b.pbrt", "WorldBegin\nNotADirective\n");
+  WriteFile(directory / "manifest.txt", "3 b.pbrt\n2 missing.pbrt\n3 a.pbrt\n");
+
+  EXPECT_NE(0, ConvertManifest(directory / "manifest.txt",
+                               directory / "summary.json"));
+  std::vector<Struct> files = ReadSummaryFiles(directory / "summary.json");
+  ASSERT_EQ(3u, files.size());
+
+  // Ordered by output, then input, so a file without an output comes first
+  std::filesystem::path canonical = std::filesystem::canonical(directory);
+  EXPECT_EQ((directory / "missing.pbrt").string(),
+            Field(files[0], "input").string_value());
+  EXPECT_EQ("", Field(files[0], "output").string_value());
+  EXPECT_EQ(2, Field(files[0], "pbrt_version").number_value());
+  EXPECT_EQ("failed", Field(files[0], "result").string_value());
+  EXPECT_TRUE(files[0].fields().contains("error"));
+
+  EXPECT_EQ((canonical / "a.pbrt").string(),
+            Field(files[1], "input").string_value());
+  EXPECT_EQ((canonical / "a.pbrt.3.binpb").string(),
+            Field(files[1], "output").string_value());
+  EXPECT_EQ(3, Field(files[1], "pbrt_version").number_value());
+  EXPECT_EQ("converted", Field(files[1], "result").string_value());
+  EXPECT_FALSE(files[1].fields().contains("error"));
+  EXPECT_EQ(std::filesystem::file_size(directory / "a.pbrt"),
+            Field(files[1], "bytes_in").number_value());
+  EXPECT_EQ(std::filesystem::file_size(directory / "a.pbrt.3.binpb"),
+            Field(files[1], "bytes_out").number_value());
+
+  EXPECT_EQ((canonical / "b.pbrt").string(),
+            Field(files[2], "input").string_value());
+  EXPECT_EQ("failed", Field(files[2], "result").string_value());
+  EXPECT_EQ(0, Field(files[2], "bytes_out").number_value());
+}
+
+TEST(Summary, EscapesPaths) {
+  std::filesystem::path directory = MakeTestDirectory("summary_escapes");
+
+  // Windows paths need their separators escaped, and elsewhere a file name may
+  // hold quotes, backslashes, and control characters
+#ifdef _WIN32
+  std::string file_name = "scene.pbrt";
+#else
+  std::string file_name = "say \"hi\"\\\tto me.pbrt";
+#endif
+
+  WriteFile(directory / file_name, kScene);
+  WriteFile(directory / "manifest.txt", "3 " + file_name + "\n");
+
+  EXPECT_EQ(0, ConvertManifest(directory / "manifest.txt",
+                               directory / "summary.json"));
+  std::vector<Struct> files = ReadSummaryFiles(directory / "summary.json");
+  ASSERT_EQ(1u, files.size());
+  EXPECT_EQ((std::filesystem::canonical(directory) / file_name).string(),
+            Field(files[0], "input").string_value());
+}
+
+// Returns the count of each type of directive in the stats at `path`
+std::map<std::string, double> ReadDirectiveCounts(
+    const std::filesystem::path& path) {
+  std::map<std::string, double> counts;
+  std::optional<Struct> stats = ReadJson(path);
+  EXPECT_TRUE(stats);
+  if (!stats || !stats->fields().contains("directives")) {
+    return counts;
+  }
+
+  for (const Value& value : Field(*stats, "directives").list_value().values()) {
+    const Struct& directive = value.struct_value();
+    counts[Field(directive, "type").string_value()] =
+        Field(directive, "count").number_value();
+  }
+  return counts;
+}
+
+TEST(Stats, CountsEachDirective) {
+  std::filesystem::path directory = MakeTestDirectory("stats_directives");
+  std::string scene =
+      "LookAt 0 0 5 0 0 0 0 1 0\nWorldBegin\nAttributeBegin\n"
+      "Translate 1 0 0\nShape \"sphere\"\nShape \"disk\"\nAttributeEnd\n"
+      "Shape \"sphere\" \"float radius\" 2\nWorldEnd\n";
+  WriteFile(directory / "scene.pbrt", scene);
+  std::filesystem::path stats_file = directory / "stats.json";
+
+  ASSERT_EQ(0, RunConverter("--pbrt_version=3 --stats=\"" +
+                            stats_file.string() + "\" \"" +
+                            (directory / "scene.pbrt").string() + "\""));
+  std::map<std::string, double> expected = {
+      {"attribute_begin", 1}, {"attribute_end", 1}, {"look_at", 1},
+      {"shape", 3},           {"translate", 1},     {"world_begin", 1},
+      {"world_end", 1}};
+  EXPECT_EQ(expected, ReadDirectiveCounts(stats_file));
+
+  std::optional<Struct> stats = ReadJson(stats_file);
+  ASSERT_TRUE(stats);
+  ASSERT_TRUE(stats->fields().contains("files_converted"));
+  ASSERT_TRUE(stats->fields().contains("bytes_parsed"));
+  ASSERT_TRUE(stats->fields().contains("files"));
+  EXPECT_EQ(1.0, Field(*stats, "files_converted").number_value());
+  EXPECT_EQ(static_cast<double>(scene.size()),
+            Field(*stats, "bytes_parsed").number_value());
+  EXPECT_EQ(1, Field(*stats, "files").list_value().values_size());
+}
+
+TEST(Stats, WrittenWhenAnInputFails) {
+  std::filesystem::path directory = MakeTestDirectory("stats_failure");
+  WriteFile(directory / "a.pbrt", kScene);
+  WriteFile(directory / "broken.pbrt", "NotADirective\n");
+  WriteFile(directory / "c.pbrt", kScene);
+  WriteFile(directory / "manifest.txt", "3 a.pbrt\n3 broken.pbrt\n3 c.pbrt\n");
+  std::filesystem::path stats_file = directory / "stats.json";
+
+  EXPECT_NE(0, ConvertManifest(directory / "manifest.txt",
+                               directory / "summary.json",
+                               "--stats=\"" + stats_file.string() + "\""));
+  std::optional<Struct> stats = ReadJson(stats_file);
+  ASSERT_TRUE(stats);
+  ASSERT_TRUE(stats->fields().contains("files_converted"));
+  ASSERT_TRUE(stats->fields().contains("files"));
+  EXPECT_EQ(2.0, Field(*stats, "files_converted").number_value());
+  EXPECT_EQ(3, Field(*stats, "files").list_value().values_size());
+
+  std::map<std::string, double> counts = ReadDirectiveCounts(stats_file);
+  EXPECT_EQ(2.0, counts["world_begin"]);
+  EXPECT_EQ(2.0, counts["shape"]);
+}
+
+TEST(Trace, HoldsSpanOfEachStep) {
+  std::filesystem::path directory = MakeTestDirectory("trace_spans");
+  WriteFile(directory / "scene.pbrt", kScene);
+  std::filesystem::path trace_file = directory / "trace.json";
+
+  ASSERT_EQ(0, RunConverter("--pbrt_version=3 --trace_file=\"" +
+                            trace_file.string() + "\" \"" +
+                            (directory / "scene.pbrt").string() + "\""));
+  std::optional<Struct> trace = ReadJson(trace_file);
+  ASSERT_TRUE(trace);
+  ASSERT_TRUE(trace->fields().contains("traceEvents"));
+
+  // Every span is a complete event, and the input is mapped and parsed within
+  // the span converting it
+  std::map<std::string, std::vector<const Struct*>> spans;
+  for (const Value& value :
+       Field(*trace, "traceEvents").list_value().values()) {
+    const Struct& event = value.struct_value();
+    ASSERT_TRUE(event.fields().contains("name"));
+    ASSERT_TRUE(event.fields().contains("ph"));
+    ASSERT_TRUE(event.fields().contains("ts"));
+    ASSERT_TRUE(event.fields().contains("dur"));
+    ASSERT_TRUE(event.fields().contains("tid"));
+    EXPECT_EQ("X", Field(event, "ph").string_value());
+    EXPECT_LE(0.0, Field(event, "dur").number_value());
+    spans[Field(event, "name").string_value()].push_back(&event);
+  }
+
+  for (const char* name : {"file", "convert", "map", "parse", "serialize"}) {
+    EXPECT_EQ(1u, spans[name].size()) << name;
+  }
+  ASSERT_EQ(1u, spans["convert"].size());
+
+  // Times are written to the nearest nanosecond
+  constexpr double kRounding = 0.001;
+  const Struct& convert = *spans["convert"][0];
+  double convert_start = Field(convert, "ts").number_value() - kRounding;
+  double convert_end = Field(convert, "ts").number_value() +
+                       Field(convert, "dur").number_value() + 2 * kRounding;
+  for (const char* name : {"map", "parse"}) {
+    for (const Struct* span : spans[name]) {
+      SCOPED_TRACE(name);
+      EXPECT_EQ(Field(convert, "tid").number_value(),
+                Field(*span, "tid").number_value());
+      EXPECT_LE(convert_start, Field(*span, "ts").number_value());
+      EXPECT_GE(convert_end, Field(*span, "ts").number_value() +
+                                 Field(*span, "dur").number_value());
+    }
+  }
+}
+
 }  // namespace